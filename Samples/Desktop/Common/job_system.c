@@ -0,0 +1,154 @@
+#include "job_system.h"
+#include <stdlib.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// Claims and runs jobs of the current batch until none is left.
+static void RunJobs(JobSystem* const js, JobFunc func, void* context, uint32_t count)
+{
+    for (;;)
+    {
+        mtx_lock(&js->lock);
+        const uint32_t index = js->next < count ? js->next++ : count;
+        mtx_unlock(&js->lock);
+
+        if (index == count)
+        {
+            return;
+        }
+        func(context, index);
+    }
+}
+
+static int WorkerMain(void* arg)
+{
+    JobSystem* js = arg;
+    uint32_t seenGeneration = 0;
+
+    for (;;)
+    {
+        mtx_lock(&js->lock);
+        while (js->generation == seenGeneration && !js->quit)
+        {
+            cnd_wait(&js->wake, &js->lock);
+        }
+        if (js->quit)
+        {
+            mtx_unlock(&js->lock);
+            return 0;
+        }
+        seenGeneration = js->generation;
+        JobFunc func = js->func;
+        void* context = js->context;
+        const uint32_t count = js->count;
+        mtx_unlock(&js->lock);
+
+        RunJobs(js, func, context, count);
+
+        // ParallelFor waits for every worker before posting the next batch, so no worker
+        // can miss a generation.
+        mtx_lock(&js->lock);
+        if (--js->busyWorkers == 0)
+        {
+            cnd_signal(&js->done);
+        }
+        mtx_unlock(&js->lock);
+    }
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool JobSystem_Init(JobSystem* const js, uint32_t threadCount)
+{
+    *js = (JobSystem){ 0 };
+
+    if (mtx_init(&js->lock, mtx_plain) != thrd_success ||
+        cnd_init(&js->wake) != thrd_success ||
+        cnd_init(&js->done) != thrd_success)
+    {
+        return false;
+    }
+
+    if (threadCount == 0)
+    {
+        return true;
+    }
+
+    js->threads = malloc(threadCount * sizeof(thrd_t));
+    if (!js->threads)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        if (thrd_create(&js->threads[i], WorkerMain, js) != thrd_success)
+        {
+            JobSystem_Destroy(js);
+            return false;
+        }
+        js->threadCount++;
+    }
+    return true;
+}
+
+void JobSystem_Destroy(JobSystem* const js)
+{
+    mtx_lock(&js->lock);
+    js->quit = true;
+    cnd_broadcast(&js->wake);
+    mtx_unlock(&js->lock);
+
+    for (uint32_t i = 0; i < js->threadCount; ++i)
+    {
+        thrd_join(js->threads[i], NULL);
+    }
+
+    free(js->threads);
+    js->threads = NULL;
+    js->threadCount = 0;
+
+    cnd_destroy(&js->done);
+    cnd_destroy(&js->wake);
+    mtx_destroy(&js->lock);
+}
+
+void JobSystem_ParallelFor(JobSystem* const js, uint32_t count, JobFunc func, void* context)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (js->threadCount == 0 || count == 1)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            func(context, i);
+        }
+        return;
+    }
+
+    mtx_lock(&js->lock);
+    js->func = func;
+    js->context = context;
+    js->count = count;
+    js->next = 0;
+    js->busyWorkers = js->threadCount;
+    js->generation++;
+    cnd_broadcast(&js->wake);
+    mtx_unlock(&js->lock);
+
+    RunJobs(js, func, context, count);
+
+    mtx_lock(&js->lock);
+    while (js->busyWorkers != 0)
+    {
+        cnd_wait(&js->done, &js->lock);
+    }
+    mtx_unlock(&js->lock);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <threads.h>
+
+// Runs one job: 'index' goes from 0 to the count given to JobSystem_ParallelFor.
+typedef void (*JobFunc)(void* context, uint32_t index);
+
+/***************************************************************************************************
+ * Minimal fork/join worker pool.                                                                  *
+ *                                                                                                 *
+ * JobSystem_ParallelFor hands out indices to the workers and to the calling thread, one at a     *
+ * time, and returns once every job has completed. Jobs should be coarse (a chunk of instances,   *
+ * a screen tile): claiming an index takes a lock.                                                 *
+ ***************************************************************************************************/
+typedef struct JobSystem
+{
+    thrd_t*  threads;
+    uint32_t threadCount;   // Worker threads, not counting the caller
+
+    mtx_t    lock;
+    cnd_t    wake;          // Signaled when a new batch of jobs is posted, or on shutdown
+    cnd_t    done;          // Signaled when the last worker leaves a batch
+
+    JobFunc  func;
+    void*    context;
+    uint32_t count;
+    uint32_t next;          // Next index to claim
+    uint32_t generation;    // Incremented for every batch of jobs
+    uint32_t busyWorkers;   // Workers that have not finished the current batch
+    bool     quit;
+} JobSystem;
+
+// 'threadCount' worker threads are spawned; 0 runs every job on the calling thread.
+bool JobSystem_Init        (JobSystem* const js, uint32_t threadCount);
+void JobSystem_Destroy     (JobSystem* const js);
+void JobSystem_ParallelFor (JobSystem* const js, uint32_t count, JobFunc func, void* context);
@@ -0,0 +1,241 @@
+#include "city_cull.h"
+#include <emmintrin.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+static void NormalizePlane(float plane[4])
+{
+    const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    for (int i = 0; i < 4; i++)
+    {
+        plane[i] *= scale;
+    }
+}
+
+typedef enum TileSide
+{
+    TileSide_Outside,
+    TileSide_Straddling,
+    TileSide_Inside,
+} TileSide;
+
+// Where the boxes of the cities of 'tile' are, grown by 'margin', relative to the frustum.
+static TileSide ClassifyTile(const CityFrustum* const frustum, const CityBounds* const bounds, float margin,
+                             const CityTile* const tile)
+{
+    TileSide side = TileSide_Inside;
+    for (int p = 0; p < 6; p++)
+    {
+        // The distance of the tile's center and how far the boxes reach from it along the normal, and
+        // the magnitude of the terms CityCull_Run sums, which bounds its rounding.
+        const float* plane = frustum->planes[p];
+        double distance = plane[3];
+        double reach = 0.0;
+        double magnitude = fabs(plane[3]) + 1.0;
+        for (int i = 0; i < 3; i++)
+        {
+            const double center = 0.5 * ((double)tile->lo[i] + tile->hi[i]) + bounds->center[i];
+            const double extent = 0.5 * ((double)tile->hi[i] - tile->lo[i]) + bounds->extents[i] + margin;
+            distance += plane[i] * center;
+            reach += fabs(plane[i]) * extent;
+            magnitude += fabs(plane[i]) * (fabs(center) + extent);
+        }
+        const double slack = 1e-5 * magnitude;
+        if (distance + reach < -slack)
+        {
+            return TileSide_Outside;
+        }
+        if (distance - reach <= slack)
+        {
+            side = TileSide_Straddling;
+        }
+    }
+    return side;
+}
+
+// Appends to visible[0, visibleCount) the cities [first, first + count) of a box on 'side' of the frustum, testing
+// them one by one if it straddles it, and returns the new count.
+static uint32_t ListCities(TileSide side, const CityFrustum* const frustum, const CityBounds* const bounds, float margin,
+                           const float* const x, const float* const y, const float* const z, uint32_t first, uint32_t count,
+                           uint32_t* const visible, uint32_t visibleCount)
+{
+    if (side == TileSide_Inside)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            visible[visibleCount++] = first + i;
+        }
+    }
+    else if (side == TileSide_Straddling)
+    {
+        // A multiple of 4 cities in, the box's positions are padded like the whole arrays.
+        uint32_t* const boxVisible = &visible[visibleCount];
+        const uint32_t boxVisibleCount = CityCull_Run(frustum, bounds, margin, &x[first], &y[first], &z[first], count, boxVisible);
+        for (uint32_t i = 0; i < boxVisibleCount; i++)
+        {
+            boxVisible[i] += first;
+        }
+        visibleCount += boxVisibleCount;
+    }
+    return visibleCount;
+}
+
+/*************************************************************************************
+ Public functions
+**************************************************************************************/
+
+void CityCull_ExtractFrustum(const float* const viewProj, CityFrustum* const frustum)
+{
+    // Clip coordinates are p * viewProj: plane j of the clip volume is a combination of columns of viewProj.
+    float column[4][4];
+    for (int c = 0; c < 4; c++)
+    {
+        for (int r = 0; r < 4; r++)
+        {
+            column[c][r] = viewProj[r * 4 + c];
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        frustum->planes[0][i] = column[3][i] + column[0][i];   // Left
+        frustum->planes[1][i] = column[3][i] - column[0][i];   // Right
+        frustum->planes[2][i] = column[3][i] + column[1][i];   // Bottom
+        frustum->planes[3][i] = column[3][i] - column[1][i];   // Top
+        frustum->planes[4][i] = column[2][i];                  // Near
+        frustum->planes[5][i] = column[3][i] - column[2][i];   // Far
+    }
+
+    for (int p = 0; p < 6; p++)
+    {
+        NormalizePlane(frustum->planes[p]);
+    }
+}
+
+void CityCull_ComputeBounds(const void* const vertices, uint32_t vertexCount, uint32_t stride, CityBounds* const bounds)
+{
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        float position[3];
+        memcpy(position, (const uint8_t*)vertices + (size_t)v * stride, sizeof(position));
+        for (int i = 0; i < 3; i++)
+        {
+            lo[i] = fminf(lo[i], position[i]);
+            hi[i] = fmaxf(hi[i], position[i]);
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        bounds->center[i] = vertexCount ? 0.5f * (lo[i] + hi[i]) : 0.0f;
+        bounds->extents[i] = vertexCount ? 0.5f * (hi[i] - lo[i]) : 0.0f;
+    }
+}
+
+uint32_t CityCull_Run(const CityFrustum* const frustum, const CityBounds* const bounds, float margin,
+                      const float* const x, const float* const y, const float* const z, uint32_t cityCount,
+                      uint32_t* const visible)
+{
+    // A city at p is outside plane n if n.p + n.center + d < -(|n|.(extents + margin)): only n.p varies.
+    __m128 nx[6], ny[6], nz[6], threshold[6];
+    for (int p = 0; p < 6; p++)
+    {
+        const float* plane = frustum->planes[p];
+        float reach = plane[3];
+        for (int i = 0; i < 3; i++)
+        {
+            reach += plane[i] * bounds->center[i] + fabsf(plane[i]) * (bounds->extents[i] + margin);
+        }
+        nx[p] = _mm_set1_ps(plane[0]);
+        ny[p] = _mm_set1_ps(plane[1]);
+        nz[p] = _mm_set1_ps(plane[2]);
+        threshold[p] = _mm_set1_ps(-reach);
+    }
+
+    uint32_t visibleCount = 0;
+    for (uint32_t first = 0; first < cityCount; first += 4)
+    {
+        const __m128 px = _mm_loadu_ps(&x[first]);
+        const __m128 py = _mm_loadu_ps(&y[first]);
+        const __m128 pz = _mm_loadu_ps(&z[first]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, nx[p]), _mm_mul_ps(py, ny[p])), _mm_mul_ps(pz, nz[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, threshold[p]));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        if (cityCount - first < 4)
+        {
+            mask &= (1 << (cityCount - first)) - 1;
+        }
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            visible[visibleCount] = first + lane;
+            visibleCount += (mask >> lane) & 1;
+        }
+    }
+    return visibleCount;
+}
+
+uint32_t CityCull_TileCount(uint32_t cityCount)
+{
+    const uint32_t tileCount = (cityCount + CITY_CULL_TILE - 1) / CITY_CULL_TILE;
+    return tileCount + (tileCount + CITY_CULL_GROUP - 1) / CITY_CULL_GROUP;
+}
+
+void CityCull_ComputeTiles(const float* const x, const float* const y, const float* const z, uint32_t cityCount,
+                           CityTile* const tiles)
+{
+    const uint32_t tileCount = (cityCount + CITY_CULL_TILE - 1) / CITY_CULL_TILE;
+    for (uint32_t t = 0; t < CityCull_TileCount(cityCount); t++)
+    {
+        tiles[t] = (CityTile){ { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+    }
+    for (uint32_t city = 0; city < cityCount; city++)
+    {
+        const float position[3] = { x[city], y[city], z[city] };
+        CityTile* const tile = &tiles[city / CITY_CULL_TILE];
+        CityTile* const group = &tiles[tileCount + city / (CITY_CULL_TILE * CITY_CULL_GROUP)];
+        for (int i = 0; i < 3; i++)
+        {
+            tile->lo[i] = fminf(tile->lo[i], position[i]);
+            tile->hi[i] = fmaxf(tile->hi[i], position[i]);
+            group->lo[i] = fminf(group->lo[i], position[i]);
+            group->hi[i] = fmaxf(group->hi[i], position[i]);
+        }
+    }
+}
+
+uint32_t CityCull_RunTiles(const CityFrustum* const frustum, const CityBounds* const bounds, float margin,
+                           const CityTile* const tiles, const float* const x, const float* const y,
+                           const float* const z, uint32_t cityCount, uint32_t* const visible)
+{
+    const uint32_t tileCount = (cityCount + CITY_CULL_TILE - 1) / CITY_CULL_TILE;
+    const uint32_t groupSize = CITY_CULL_TILE * CITY_CULL_GROUP;
+    uint32_t visibleCount = 0;
+    for (uint32_t groupFirst = 0; groupFirst < cityCount; groupFirst += groupSize)
+    {
+        const uint32_t groupCount = cityCount - groupFirst < groupSize ? cityCount - groupFirst : groupSize;
+        const TileSide groupSide = ClassifyTile(frustum, bounds, margin, &tiles[tileCount + groupFirst / groupSize]);
+        if (groupSide != TileSide_Straddling)
+        {
+            visibleCount = ListCities(groupSide, frustum, bounds, margin, x, y, z, groupFirst, groupCount, visible, visibleCount);
+            continue;
+        }
+
+        for (uint32_t first = groupFirst; first < groupFirst + groupCount; first += CITY_CULL_TILE)
+        {
+            const uint32_t count = groupFirst + groupCount - first < CITY_CULL_TILE ? groupFirst + groupCount - first : CITY_CULL_TILE;
+            const TileSide side = ClassifyTile(frustum, bounds, margin, &tiles[first / CITY_CULL_TILE]);
+            visibleCount = ListCities(side, frustum, bounds, margin, x, y, z, first, count, visible, visibleCount);
+        }
+    }
+    return visibleCount;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+// Model-space bounding box of the city mesh; every city is a translated copy.
+typedef struct CityBounds
+{
+    float center[3];
+    float extents[3];   // Half sizes
+} CityBounds;
+
+// Planes (a, b, c, d) of the view frustum, inside where a*x + b*y + c*z + d >= 0, normalized.
+typedef struct CityFrustum
+{
+    float planes[6][4];
+} CityFrustum;
+
+// Consecutive cities CityCull_RunTiles tests as one box before testing them one by one, and consecutive
+// tiles it tests as one box, a group, before testing them one by one.
+#define CITY_CULL_TILE 64
+#define CITY_CULL_GROUP 64
+
+// Box of the positions of the cities of a tile or group.
+typedef struct CityTile
+{
+    float lo[3];
+    float hi[3];
+} CityTile;
+
+// From a row-major view-projection for row vectors, as XMStoreFloat4x4 writes it, with D3D's [0, 1] depth.
+void     CityCull_ExtractFrustum(const float* const viewProj, CityFrustum* const frustum);
+
+// Bounding box of 'vertexCount' vertices whose first three floats are the position.
+void     CityCull_ComputeBounds(const void* const vertices, uint32_t vertexCount, uint32_t stride, CityBounds* const bounds);
+
+/*
+ * Writes to 'visible' the index of every city whose box, grown by 'margin' on every side, intersects the
+ * frustum, in increasing order, and returns how many there are.
+ *
+ * The positions are SoA, and they and 'visible' are padded to a multiple of 4 cities; each box is tested
+ * against the six planes, four cities at a time. The test is conservative: a box near a frustum corner
+ * may pass without being on screen.
+ */
+uint32_t CityCull_Run(const CityFrustum* const frustum, const CityBounds* const bounds, float margin,
+                      const float* const x, const float* const y, const float* const z, uint32_t cityCount,
+                      uint32_t* const visible);
+
+// Boxes CityCull_ComputeTiles writes for 'cityCount' cities.
+uint32_t CityCull_TileCount   (uint32_t cityCount);
+
+// Boxes of tiles [0, (cityCount + CITY_CULL_TILE - 1) / CITY_CULL_TILE), tile t holding the cities from
+// t * CITY_CULL_TILE to the next tile or cityCount, followed by the boxes of their groups.
+void     CityCull_ComputeTiles(const float* const x, const float* const y, const float* const z, uint32_t cityCount,
+                               CityTile* const tiles);
+
+/*
+ * Same result as CityCull_Run, the cities being tested a group, then a tile at a time: the cities of a
+ * box outside a plane are skipped, those of a box inside every plane all listed, and the others tested
+ * at the next level down. A box only falls on either side when it clears the plane by more than the
+ * rounding of the per-city test, so that both agree. The cost follows the cities near the frustum, plus
+ * a test per group.
+ */
+uint32_t CityCull_RunTiles(const CityFrustum* const frustum, const CityBounds* const bounds, float margin,
+                           const CityTile* const tiles, const float* const x, const float* const y,
+                           const float* const z, uint32_t cityCount, uint32_t* const visible);
@@ -0,0 +1,319 @@
+/*************************************************************************************
+ City culling tests.
+
+ Culls random city grids from random cameras and compares the SSE plane test of
+ CityCull_Run with the same test done here one city at a time, in double precision:
+ every city clearly inside all six planes must be listed, in increasing order, and
+ no city clearly outside one of them. No city with a point of its box on screen
+ may be culled, and the padding past the last city is never listed. Also checks
+ that the margin grows the boxes, the frustum planes are normalized, and the
+ bounds of a vertex buffer with a stride against its min and max. Culling by
+ tiles and groups of tiles must list exactly the cities CityCull_Run does, on
+ layouts where whole tiles and groups fall on either side of the frustum and on
+ scattered cities.
+
+ Usage: CityCullTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "city_cull.h"
+#include "test_check.h"
+
+#define CITY_COUNT 1003
+#define PADDED     1008
+#define GRID_COLUMNS 37
+#define GRID_COUNT (GRID_COLUMNS * 400)
+#define TILE_COUNT ((GRID_COUNT + CITY_CULL_TILE - 1) / CITY_CULL_TILE)
+#define GROUP_COUNT ((TILE_COUNT + CITY_CULL_GROUP - 1) / CITY_CULL_GROUP)
+
+static float s_x[PADDED], s_y[PADDED], s_z[PADDED];
+static uint32_t s_visible[PADDED];
+
+static float s_gridX[GRID_COUNT], s_gridY[GRID_COUNT], s_gridZ[GRID_COUNT];
+static uint32_t s_gridVisible[GRID_COUNT], s_tileVisible[GRID_COUNT];
+static CityTile s_tiles[TILE_COUNT + GROUP_COUNT];
+
+static const CityBounds c_bounds = { { 0.0f, 1.3f, 0.0f }, { 7.6f, 1.25f, 7.6f } };
+
+// Off center, for the tiles, whose boxes must be moved by it as well as grown.
+static const CityBounds c_offsetBounds = { { 6.0f, 1.3f, -5.0f }, { 3.8f, 1.25f, 3.8f } };
+
+static void Multiply(const float* const a, const float* const b, float* const out)
+{
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            out[r * 4 + c] = a[r * 4 + 0] * b[0 * 4 + c] + a[r * 4 + 1] * b[1 * 4 + c] + a[r * 4 + 2] * b[2 * 4 + c] + a[r * 4 + 3] * b[3 * 4 + c];
+        }
+    }
+}
+
+// Left-handed perspective from an eye turned by 'yaw' around y, row-major for row vectors.
+static void BuildViewProj(const float eye[3], float yaw, float* const viewProj)
+{
+    const float fovy = 0.8f, aspect = 1.6f, zNear = 1.0f, zFar = 1000.0f;
+    const float h = 1.0f / tanf(0.5f * fovy), w = h / aspect, q = zFar / (zFar - zNear);
+    const float projection[16] = { w, 0, 0, 0, 0, h, 0, 0, 0, 0, q, 1, 0, 0, -q * zNear, 0 };
+
+    const float c = cosf(yaw), s = sinf(yaw);
+    const float right[3] = { c, 0, -s }, up[3] = { 0, 1, 0 }, forward[3] = { s, 0, c };
+    const float view[16] = {
+        right[0], up[0], forward[0], 0,
+        right[1], up[1], forward[1], 0,
+        right[2], up[2], forward[2], 0,
+        -(right[0] * eye[0] + right[1] * eye[1] + right[2] * eye[2]),
+        -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]),
+        -(forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2]), 1 };
+    Multiply(view, projection, viewProj);
+}
+
+// 1 if the box of city i, grown by 'margin', is inside every plane by more than 'slack', -1 if it is outside one
+// by more than 'slack', 0 if it is too close to call.
+static int Classify(const CityFrustum* const frustum, float margin, uint32_t i, double slack)
+{
+    int result = 1;
+    for (int p = 0; p < 6; p++)
+    {
+        const float* const plane = frustum->planes[p];
+        const double position[3] = { s_x[i] + c_bounds.center[0], s_y[i] + c_bounds.center[1], s_z[i] + c_bounds.center[2] };
+        double distance = plane[3];
+        for (int k = 0; k < 3; k++)
+        {
+            distance += plane[k] * position[k] + fabs(plane[k]) * ((double)c_bounds.extents[k] + margin);
+        }
+        if (distance < -slack)
+        {
+            return -1;
+        }
+        if (distance <= slack)
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+// Whether any point of a 5 x 5 x 5 lattice over the box of city i projects inside the clip volume.
+static int OnScreen(const float* const viewProj, uint32_t i)
+{
+    for (int s = 0; s < 125; s++)
+    {
+        const float point[4] = {
+            s_x[i] + c_bounds.center[0] + c_bounds.extents[0] * ((float)(s % 5) / 2.0f - 1.0f),
+            s_y[i] + c_bounds.center[1] + c_bounds.extents[1] * ((float)((s / 5) % 5) / 2.0f - 1.0f),
+            s_z[i] + c_bounds.center[2] + c_bounds.extents[2] * ((float)(s / 25) / 2.0f - 1.0f), 1.0f };
+        float clip[4] = { 0 };
+        for (int c = 0; c < 4; c++)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                clip[c] += point[k] * viewProj[k * 4 + c];
+            }
+        }
+        if (clip[3] > 0.0f && fabsf(clip[0]) <= clip[3] && fabsf(clip[1]) <= clip[3] && clip[2] >= 0.0f && clip[2] <= clip[3])
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void TestRun(void)
+{
+    uint32_t misplaced = 0, missing = 0, extra = 0, culledOnScreen = 0, onScreen = 0, badPlanes = 0;
+    for (uint32_t t = 0; t < 200; t++)
+    {
+        const float eye[3] = { TestRandomFloat(-100.0f, 100.0f), TestRandomFloat(0.0f, 20.0f), TestRandomFloat(-100.0f, 100.0f) };
+        float viewProj[16];
+        BuildViewProj(eye, TestRandomFloat(0.0f, 6.2831853f), viewProj);
+        CityFrustum frustum;
+        CityCull_ExtractFrustum(viewProj, &frustum);
+        for (int p = 0; p < 6; p++)
+        {
+            const float* const n = frustum.planes[p];
+            badPlanes += fabsf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2] - 1.0f) > 1e-5f;
+        }
+
+        // The padding sits in front of the camera, where it would be visible if it were a city.
+        const uint32_t cityCount = CITY_COUNT - t % 4;
+        for (uint32_t i = 0; i < PADDED; i++)
+        {
+            s_x[i] = i < cityCount ? TestRandomFloat(-200.0f, 200.0f) : eye[0] + 50.0f * viewProj[0 * 4 + 2];
+            s_y[i] = i < cityCount ? 0.0f : eye[1];
+            s_z[i] = i < cityCount ? TestRandomFloat(-200.0f, 200.0f) : eye[2] + 50.0f * viewProj[2 * 4 + 2];
+        }
+
+        const float margin = t % 2 ? 16.0f : 0.0f;
+        const uint32_t count = CityCull_Run(&frustum, &c_bounds, margin, s_x, s_y, s_z, cityCount, s_visible);
+
+        uint8_t listed[PADDED] = { 0 };
+        for (uint32_t k = 0; k < count; k++)
+        {
+            misplaced += s_visible[k] >= cityCount || (k > 0 && s_visible[k] <= s_visible[k - 1]);
+            listed[s_visible[k] < PADDED ? s_visible[k] : 0] = 1;
+        }
+        for (uint32_t i = 0; i < cityCount; i++)
+        {
+            const int expected = Classify(&frustum, margin, i, 1e-3);
+            missing += expected > 0 && !listed[i];
+            extra += expected < 0 && listed[i];
+
+            const int seen = OnScreen(viewProj, i);
+            onScreen += seen;
+            culledOnScreen += seen && !listed[i];
+        }
+    }
+    CHECK(misplaced == 0);
+    CHECK(missing == 0);
+    CHECK(extra == 0);
+    CHECK(culledOnScreen == 0);
+    CHECK(onScreen > 0);
+    CHECK(badPlanes == 0);
+}
+
+static void TestBounds(void)
+{
+    // Position first, then other attributes: 7 floats a vertex.
+    enum { STRIDE_FLOATS = 7, VERTEX_COUNT = 500 };
+    static float vertices[VERTEX_COUNT * STRIDE_FLOATS];
+    float lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+    for (uint32_t v = 0; v < VERTEX_COUNT; v++)
+    {
+        for (int k = 0; k < STRIDE_FLOATS; k++)
+        {
+            // The other attributes are outside the positions' range, so reading them shows.
+            vertices[v * STRIDE_FLOATS + k] = k < 3 ? TestRandomFloat(-5.0f, 3.0f) + (float)k : 1000.0f;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = fminf(lo[k], vertices[v * STRIDE_FLOATS + k]);
+            hi[k] = fmaxf(hi[k], vertices[v * STRIDE_FLOATS + k]);
+        }
+    }
+
+    CityBounds bounds;
+    CityCull_ComputeBounds(vertices, VERTEX_COUNT, STRIDE_FLOATS * sizeof(float), &bounds);
+    for (int k = 0; k < 3; k++)
+    {
+        CHECK(fabsf(bounds.center[k] - bounds.extents[k] - lo[k]) < 1e-5f);
+        CHECK(fabsf(bounds.center[k] + bounds.extents[k] - hi[k]) < 1e-5f);
+    }
+
+    CityCull_ComputeBounds(vertices, 0, STRIDE_FLOATS * sizeof(float), &bounds);
+    CHECK(bounds.center[0] == 0.0f && bounds.center[1] == 0.0f && bounds.center[2] == 0.0f);
+    CHECK(bounds.extents[0] == 0.0f && bounds.extents[1] == 0.0f && bounds.extents[2] == 0.0f);
+}
+
+// Counts the boxes of 'size' cities of which none, then all, are listed in 'listed'.
+static void CountSides(const uint8_t* const listed, uint32_t count, uint32_t size, uint32_t sides[2])
+{
+    for (uint32_t first = 0; first < count; first += size)
+    {
+        const uint32_t last = count - first < size ? count : first + size;
+        uint32_t listedCount = 0;
+        for (uint32_t city = first; city < last; city++)
+        {
+            listedCount += listed[city];
+        }
+        sides[0] += listedCount == 0;
+        sides[1] += listedCount == last - first;
+    }
+}
+
+// Both cullings of 'count' cities at the positions in s_grid*, from random cameras between 'eyeLo' and 'eyeHi'
+// turned by up to 'yaw' either way from +z. Adds to 'sides' the tiles, then the groups, wholly culled and wholly
+// listed, the cases the boxes decide.
+static void CompareTiles(uint32_t count, const float eyeLo[3], const float eyeHi[3], float yaw, uint32_t sides[2][2])
+{
+    // Every city in the box of its tile and of its group.
+    const uint32_t tileCount = (count + CITY_CULL_TILE - 1) / CITY_CULL_TILE;
+    CHECK(CityCull_TileCount(count) == tileCount + (tileCount + CITY_CULL_GROUP - 1) / CITY_CULL_GROUP);
+    CityCull_ComputeTiles(s_gridX, s_gridY, s_gridZ, count, s_tiles);
+    uint32_t badBoxes = 0;
+    for (uint32_t city = 0; city < count; city++)
+    {
+        const CityTile* const boxes[2] = { &s_tiles[city / CITY_CULL_TILE], &s_tiles[tileCount + city / CITY_CULL_TILE / CITY_CULL_GROUP] };
+        for (int b = 0; b < 2; b++)
+        {
+            badBoxes += s_gridX[city] < boxes[b]->lo[0] || s_gridX[city] > boxes[b]->hi[0] || s_gridY[city] < boxes[b]->lo[1] ||
+                        s_gridY[city] > boxes[b]->hi[1] || s_gridZ[city] < boxes[b]->lo[2] || s_gridZ[city] > boxes[b]->hi[2];
+        }
+    }
+    CHECK(badBoxes == 0);
+
+    uint32_t mismatches = 0;
+    for (uint32_t t = 0; t < 200; t++)
+    {
+        float eye[3];
+        for (int k = 0; k < 3; k++)
+        {
+            eye[k] = TestRandomFloat(eyeLo[k], eyeHi[k]);
+        }
+        float viewProj[16];
+        BuildViewProj(eye, TestRandomFloat(-yaw, yaw), viewProj);
+        CityFrustum frustum;
+        CityCull_ExtractFrustum(viewProj, &frustum);
+
+        const float margin = t % 2 ? 16.0f : 0.0f;
+        const CityBounds* const bounds = t % 4 < 2 ? &c_bounds : &c_offsetBounds;
+        const uint32_t expected = CityCull_Run(&frustum, bounds, margin, s_gridX, s_gridY, s_gridZ, count, s_gridVisible);
+        const uint32_t actual = CityCull_RunTiles(&frustum, bounds, margin, s_tiles, s_gridX, s_gridY, s_gridZ, count, s_tileVisible);
+        mismatches += actual != expected || memcmp(s_gridVisible, s_tileVisible, expected * sizeof(uint32_t)) != 0;
+
+        static uint8_t listed[GRID_COUNT];
+        memset(listed, 0, sizeof(listed));
+        for (uint32_t k = 0; k < actual && k < GRID_COUNT; k++)
+        {
+            listed[s_tileVisible[k] < GRID_COUNT ? s_tileVisible[k] : 0] = 1;
+        }
+        CountSides(listed, count, CITY_CULL_TILE, sides[0]);
+        CountSides(listed, count, CITY_CULL_TILE * CITY_CULL_GROUP, sides[1]);
+    }
+    CHECK(mismatches == 0);
+}
+
+static void TestTiles(void)
+{
+    // The sample's layout: rows of GRID_COLUMNS cities 8 apart, rising slightly with the city index.
+    for (uint32_t city = 0; city < GRID_COUNT; city++)
+    {
+        s_gridX[city] = (float)(city % GRID_COLUMNS) * 8.0f;
+        s_gridY[city] = 0.02f * (float)city;
+        s_gridZ[city] = (float)(city / GRID_COLUMNS) * -8.0f;
+    }
+    const float aroundLo[3] = { -50.0f, 0.0f, -3250.0f }, aroundHi[3] = { 350.0f, 20.0f, 50.0f };
+    uint32_t sides[2][2] = { { 0 } };
+    CompareTiles(GRID_COUNT, aroundLo, aroundHi, 3.1415927f, sides);
+    CompareTiles(GRID_COUNT - 3, aroundLo, aroundHi, 3.1415927f, sides);
+
+    // A wall of cities 1 apart, 64 a row, seen from far enough for whole groups to be on screen.
+    for (uint32_t city = 0; city < GRID_COUNT; city++)
+    {
+        s_gridX[city] = (float)(city % 64);
+        s_gridY[city] = (float)(city / 64);
+        s_gridZ[city] = 0.0f;
+    }
+    const float wallLo[3] = { 0.0f, 0.0f, -400.0f }, wallHi[3] = { 64.0f, 230.0f, -200.0f };
+    CompareTiles(GRID_COUNT - 5, wallLo, wallHi, 0.1f, sides);
+    CHECK(sides[0][0] > 0 && sides[0][1] > 0);
+    CHECK(sides[1][0] > 0 && sides[1][1] > 0);
+
+    // Scattered cities make large boxes, mostly tested city by city.
+    for (uint32_t city = 0; city < GRID_COUNT; city++)
+    {
+        s_gridX[city] = TestRandomFloat(-50.0f, 350.0f);
+        s_gridY[city] = 0.0f;
+        s_gridZ[city] = TestRandomFloat(-3250.0f, 50.0f);
+    }
+    CompareTiles(GRID_COUNT - 1, aroundLo, aroundHi, 3.1415927f, sides);
+}
+
+int main(void)
+{
+    TestRun();
+    TestBounds();
+    TestTiles();
+    return TEST_RESULT();
+}
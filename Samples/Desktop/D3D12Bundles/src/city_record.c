@@ -0,0 +1,113 @@
+#include "city_record.h"
+#include "render_queue.h"
+
+typedef struct RecordJob
+{
+    CityRecorder* recorder;
+    const uint64_t* keys;
+    uint32_t keyCount;
+    uint32_t chunkCount;
+    CityRecordStats chunkStats[CITY_RECORD_MAX_CHUNKS];
+} RecordJob;
+
+static void RecordChunk(void* context, uint32_t chunk)
+{
+    RecordJob* const job = context;
+    CityRecorder* const recorder = job->recorder;
+    const uint32_t first = CityRecord_ChunkStart(job->keyCount, job->chunkCount, chunk);
+    const uint32_t end = CityRecord_ChunkStart(job->keyCount, job->chunkCount, chunk + 1);
+
+    // Nothing is bound when a command list or bundle begins.
+    uint32_t rootSignature = UINT32_MAX;
+    uint32_t pipeline = UINT32_MAX;
+    uint32_t descriptorTable = UINT32_MAX;
+    CityRecordStats stats = { 0 };
+
+    recorder->vtbl->Begin(recorder, chunk);
+    for (uint32_t i = first; i < end; i++)
+    {
+        const uint64_t key = job->keys[i];
+
+        if (RenderKey_RootSignature(key) != rootSignature)
+        {
+            rootSignature = RenderKey_RootSignature(key);
+            recorder->vtbl->SetRootSignature(recorder, chunk, rootSignature);
+            stats.rootSignatureSets++;
+
+            // Changing the root signature drops every binding.
+            descriptorTable = UINT32_MAX;
+        }
+        if (RenderKey_Pipeline(key) != pipeline)
+        {
+            pipeline = RenderKey_Pipeline(key);
+            recorder->vtbl->SetPipeline(recorder, chunk, pipeline);
+            stats.pipelineSets++;
+        }
+        if (RenderKey_DescriptorTable(key) != descriptorTable)
+        {
+            descriptorTable = RenderKey_DescriptorTable(key);
+            recorder->vtbl->SetDescriptorTable(recorder, chunk, descriptorTable);
+            stats.descriptorTableSets++;
+        }
+        recorder->vtbl->Draw(recorder, chunk);
+        stats.draws++;
+    }
+    recorder->vtbl->End(recorder, chunk);
+
+    job->chunkStats[chunk] = stats;
+}
+
+/*************************************************************************************
+ Public functions
+**************************************************************************************/
+
+uint32_t CityRecord_ChunkCount(uint32_t cityCount, uint32_t threadCount)
+{
+    uint32_t chunkCount = cityCount / CITY_RECORD_MIN_CHUNK_CITIES;
+    if (chunkCount > threadCount)
+    {
+        chunkCount = threadCount;
+    }
+    if (chunkCount > CITY_RECORD_MAX_CHUNKS)
+    {
+        chunkCount = CITY_RECORD_MAX_CHUNKS;
+    }
+    return chunkCount > 0 ? chunkCount : 1;
+}
+
+uint32_t CityRecord_ChunkStart(uint32_t cityCount, uint32_t chunkCount, uint32_t chunk)
+{
+    return (uint32_t)((uint64_t)cityCount * chunk / chunkCount);
+}
+
+void CityRecord_Run(CityRecorder* const recorder, JobSystem* const jobs, const uint64_t* const keys,
+                    uint32_t keyCount, uint32_t chunkCount, CityRecordStats* const stats)
+{
+    RecordJob job = {
+        .recorder = recorder,
+        .keys = keys,
+        .keyCount = keyCount,
+        .chunkCount = chunkCount,
+    };
+
+    if (chunkCount == 1)
+    {
+        RecordChunk(&job, 0);
+    }
+    else
+    {
+        JobSystem_ParallelFor(jobs, chunkCount, RecordChunk, &job);
+    }
+
+    if (stats)
+    {
+        *stats = (CityRecordStats){ 0 };
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            stats->rootSignatureSets += job.chunkStats[chunk].rootSignatureSets;
+            stats->pipelineSets += job.chunkStats[chunk].pipelineSets;
+            stats->descriptorTableSets += job.chunkStats[chunk].descriptorTableSets;
+            stats->draws += job.chunkStats[chunk].draws;
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include "job_system.h"
+
+// Most chunks the city draws are split into: each is recorded into its own command list or bundle.
+#define CITY_RECORD_MAX_CHUNKS 16
+
+// Fewest draws worth a chunk of their own: below that, a job and a command list cost more than they save.
+#define CITY_RECORD_MIN_CHUNK_CITIES 256
+
+typedef struct CityRecorder CityRecorder;
+
+/*
+ * The commands the city draws are made of, on some command list API: D3D12 in the sample, a mock in
+ * RecordBench. 'chunk' selects the command list. Calls for one chunk come from one thread, in order;
+ * calls for different chunks come from different threads at the same time.
+ */
+typedef struct CityRecorderVtbl
+{
+    void (*Begin)(CityRecorder* const recorder, uint32_t chunk);                                        // Reset, bind the state every draw shares
+    void (*SetRootSignature)(CityRecorder* const recorder, uint32_t chunk, uint32_t rootSignature);    // And the tables every draw shares
+    void (*SetPipeline)(CityRecorder* const recorder, uint32_t chunk, uint32_t pipeline);
+    void (*SetDescriptorTable)(CityRecorder* const recorder, uint32_t chunk, uint32_t descriptorTable); // The city's constants
+    void (*Draw)(CityRecorder* const recorder, uint32_t chunk);
+    void (*End)(CityRecorder* const recorder, uint32_t chunk);                                          // Close
+} CityRecorderVtbl;
+
+struct CityRecorder
+{
+    const CityRecorderVtbl* vtbl;
+};
+
+// State set calls CityRecord_Run issued, over all the chunks.
+typedef struct CityRecordStats
+{
+    uint32_t rootSignatureSets;
+    uint32_t pipelineSets;
+    uint32_t descriptorTableSets;
+    uint32_t draws;
+} CityRecordStats;
+
+// Chunks to split 'cityCount' draws into for 'threadCount' threads, the caller included: one per
+// thread, at most CITY_RECORD_MAX_CHUNKS, and no smaller than CITY_RECORD_MIN_CHUNK_CITIES. At least 1.
+uint32_t CityRecord_ChunkCount(uint32_t cityCount, uint32_t threadCount);
+
+// First of the draws of 'chunk', in the list: chunk i holds [CityRecord_ChunkStart(i), CityRecord_ChunkStart(i + 1)).
+uint32_t CityRecord_ChunkStart(uint32_t cityCount, uint32_t chunkCount, uint32_t chunk);
+
+/*
+ * Records the draws of 'keys', render queue sort keys (see render_queue.h), in order, split into
+ * 'chunkCount' contiguous chunks recorded as one job each. The commands of a chunk only depend on its
+ * keys, so executing the chunks in order gives the same stream of draws whatever the thread count, or
+ * the order the jobs ran in.
+ *
+ * A root signature, pipeline or descriptor table is only set when it differs from the previous draw of
+ * the chunk: with sorted keys, that is once per distinct state per chunk. 'stats' may be NULL.
+ */
+void CityRecord_Run(CityRecorder* const recorder, JobSystem* const jobs, const uint64_t* const keys,
+                    uint32_t keyCount, uint32_t chunkCount, CityRecordStats* const stats);
@@ -91,6 +91,36 @@ static inline D3D12_ROOT_PARAMETER1 CD3DX12_ROOT_PARAMETER1_AsDescriptorTable(
 	};
 }
 
+static inline D3D12_ROOT_PARAMETER1 CD3DX12_ROOT_PARAMETER1_AsConstants(
+	UINT num32BitValues,
+	UINT shaderRegister,
+	UINT registerSpace,
+	D3D12_SHADER_VISIBILITY visibility)
+{
+	return (D3D12_ROOT_PARAMETER1) {
+		.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+		.ShaderVisibility = visibility,
+		.Constants.Num32BitValues = num32BitValues,
+		.Constants.ShaderRegister = shaderRegister,
+		.Constants.RegisterSpace = registerSpace,
+	};
+}
+
+static inline D3D12_ROOT_PARAMETER1 CD3DX12_ROOT_PARAMETER1_AsShaderResourceView(
+	UINT shaderRegister,
+	UINT registerSpace,
+	D3D12_ROOT_DESCRIPTOR_FLAGS flags,
+	D3D12_SHADER_VISIBILITY visibility)
+{
+	return (D3D12_ROOT_PARAMETER1) {
+		.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV,
+		.ShaderVisibility = visibility,
+		.Descriptor.ShaderRegister = shaderRegister,
+		.Descriptor.RegisterSpace = registerSpace,
+		.Descriptor.Flags = flags,
+	};
+}
+
 static inline D3D12_DEPTH_STENCIL_DESC CD3DX12_DEFAULT_DEPTH_STENCIL_DESC(void)
 {
 	const D3D12_DEPTH_STENCILOP_DESC defaultStencilOp = { 
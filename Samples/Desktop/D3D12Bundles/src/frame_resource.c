@@ -11,26 +11,297 @@
 // The slope upwards of the city moving deeper into a row and/or column of buildings
 static const FLOAT CITY_SLOPE = 0.02f;
 
+// Tiles whose MVPs one job computes, 4096 cities. Fewer are done in one go.
+#define MVP_JOB_TILES (4096u / CITY_CULL_TILE)
+
+_Static_assert(CITY_CULL_TILE % MVP_BATCH_BLOCK == 0, "MVP batches start on a tile");
+
+// Bundles draw the cities within this distance of the frustum, so that small camera moves keep them valid.
+static const FLOAT BUNDLE_MARGIN = 16.0f;
+
+// Render queue states. The sample has one root signature and two pipelines, picked by city parity.
+enum
+{
+    ROOT_SIGNATURE_CITY = 0,
+};
+
+// CityRecorder on D3D12: one command list or bundle per chunk, each with its allocator.
+typedef struct D3D12CityRecorder
+{
+    CityRecorder base;
+    ID3D12CommandAllocator** allocators;
+    ID3D12GraphicsCommandList** commandLists;
+    ID3D12PipelineState* pipelines[2];              // By the render queue pipeline index
+    UINT numIndices;
+    D3D12_INDEX_BUFFER_VIEW* indexBufferViewDesc;
+    D3D12_VERTEX_BUFFER_VIEW* vertexBufferViewDesc;
+    ID3D12DescriptorHeap* cbvSrvDescriptorHeap;
+    ID3D12DescriptorHeap* samplerDescriptorHeap;
+    ID3D12RootSignature* rootSignature;
+    D3D12_GPU_DESCRIPTOR_HANDLE firstCityHandle;    // CBV of city 0 in this frame resource
+    UINT cbvSrvDescriptorSize;
+
+    // Direct command lists only: bundles inherit them from the command list executing them.
+    const D3D12_CPU_DESCRIPTOR_HANDLE* renderTargetView;
+    const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencilView;
+    const D3D12_VIEWPORT* viewport;
+    const RECT* scissorRect;
+} D3D12CityRecorder;
+
+typedef struct MvpJob
+{
+    FrameResource* fr;
+    const FLOAT* viewProj;
+    MvpKernel kernel;
+    UINT cityCount;
+    UINT tileCount;     // From fr->mvpTiles
+} MvpJob;
+
 static void SetCityPositions(FrameResource* const fr, FLOAT intervalCol, FLOAT intervalRow)
 {
-    for (UINT row = 0; row < fr->cityRowCount; row++)
+    const UINT cityCount = fr->cityRowCount * fr->cityColumnCount;
+    const UINT paddedCount = (cityCount + MVP_BATCH_BLOCK - 1) / MVP_BATCH_BLOCK * MVP_BATCH_BLOCK;
+    for (UINT city = 0; city < paddedCount; city++)
+    {
+        const UINT row = city < cityCount ? city / fr->cityColumnCount : 0;
+        const UINT col = city < cityCount ? city % fr->cityColumnCount : 0;
+        fr->cityX[city] = col * intervalCol;
+        // The y position ("up") is based off of the city's row and column position to prevent z-fighting.
+        fr->cityY[city] = CITY_SLOPE * (row * fr->cityColumnCount + col);
+        fr->cityZ[city] = row * intervalRow;
+    }
+}
+
+static void ComputeMvpJob(void* context, uint32_t index)
+{
+    const MvpJob* job = context;
+    const UINT lastTile = min((index + 1) * MVP_JOB_TILES, job->tileCount);
+    for (UINT i = index * MVP_JOB_TILES; i < lastTile; i++)
+    {
+        const UINT first = job->fr->mvpTiles[i] * CITY_CULL_TILE;
+        const UINT count = min((UINT)CITY_CULL_TILE, job->cityCount - first);
+        MvpBatch_Compute(job->kernel, job->viewProj, job->fr->cityX, job->fr->cityY, job->fr->cityZ,
+            first, count, &job->fr->pConstantBuffers[first], sizeof(SceneConstantBuffer));
+    }
+}
+
+// Adds to mvpTiles the tiles of 'cities' whose MVPs are older than the view.
+static void AddMvpTiles(FrameResource* const fr, const UINT* const cities, UINT cityCount)
+{
+    for (UINT i = 0; i < cityCount; i++)
+    {
+        const UINT tile = cities[i] / CITY_CULL_TILE;
+        if (fr->tileViews[tile] != fr->view)
+        {
+            fr->tileViews[tile] = fr->view;
+            fr->mvpTiles[fr->mvpTileCount++] = tile;
+        }
+    }
+}
+
+static void D3D12CityRecorder_Begin(CityRecorder* const base, uint32_t chunk)
+{
+    D3D12CityRecorder* const recorder = (D3D12CityRecorder*)base;
+    ID3D12GraphicsCommandList* const commandList = recorder->commandLists[chunk];
+
+    // Allocators, bundle allocators included, can only be reset once the GPU is done with them.
+    HRESULT hr = ID3D12CommandAllocator_Reset(recorder->allocators[chunk]);
+    if (FAILED(hr)) LogAndExit(hr);
+    hr = ID3D12GraphicsCommandList_Reset(commandList, recorder->allocators[chunk], recorder->pipelines[0]);
+    if (FAILED(hr)) LogAndExit(hr);
+
+    ID3D12DescriptorHeap* ppHeaps[] = { recorder->cbvSrvDescriptorHeap, recorder->samplerDescriptorHeap };
+    ID3D12GraphicsCommandList_SetDescriptorHeaps(commandList, _countof(ppHeaps), ppHeaps);
+    if (recorder->renderTargetView)
+    {
+        ID3D12GraphicsCommandList_RSSetViewports(commandList, 1, recorder->viewport);
+        ID3D12GraphicsCommandList_RSSetScissorRects(commandList, 1, recorder->scissorRect);
+        ID3D12GraphicsCommandList_OMSetRenderTargets(commandList, 1, recorder->renderTargetView, FALSE, recorder->depthStencilView);
+    }
+    ID3D12GraphicsCommandList_IASetPrimitiveTopology(commandList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    ID3D12GraphicsCommandList_IASetIndexBuffer(commandList, recorder->indexBufferViewDesc);
+    ID3D12GraphicsCommandList_IASetVertexBuffers(commandList, 0, 1, recorder->vertexBufferViewDesc);
+}
+
+static void D3D12CityRecorder_SetRootSignature(CityRecorder* const base, uint32_t chunk, uint32_t rootSignature)
+{
+    D3D12CityRecorder* const recorder = (D3D12CityRecorder*)base;
+    ID3D12GraphicsCommandList* const commandList = recorder->commandLists[chunk];
+    (void)rootSignature;  // Always ROOT_SIGNATURE_CITY
+
+    // If the root signature matches the root signature of the caller, then
+    // bindings are inherited, otherwise the bind space is reset.
+    ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, recorder->rootSignature);
+
+    // The texture and sampler tables every city shares.
+    D3D12_GPU_DESCRIPTOR_HANDLE cbvSrvHandle;
+    ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(recorder->cbvSrvDescriptorHeap, &cbvSrvHandle);
+    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, RootParameter_Texture, cbvSrvHandle);
+    D3D12_GPU_DESCRIPTOR_HANDLE samplerHandle;
+    ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(recorder->samplerDescriptorHeap, &samplerHandle);
+    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, RootParameter_Sampler, samplerHandle);
+}
+
+static void D3D12CityRecorder_SetPipeline(CityRecorder* const base, uint32_t chunk, uint32_t pipeline)
+{
+    D3D12CityRecorder* const recorder = (D3D12CityRecorder*)base;
+    ID3D12GraphicsCommandList_SetPipelineState(recorder->commandLists[chunk], recorder->pipelines[pipeline]);
+}
+
+static void D3D12CityRecorder_SetDescriptorTable(CityRecorder* const base, uint32_t chunk, uint32_t city)
+{
+    D3D12CityRecorder* const recorder = (D3D12CityRecorder*)base;
+    // Set this city's CBV table: the render queue table is the city.
+    const D3D12_GPU_DESCRIPTOR_HANDLE cityHandle = { recorder->firstCityHandle.ptr + (UINT64)city * recorder->cbvSrvDescriptorSize };
+    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(recorder->commandLists[chunk], RootParameter_CityConstants, cityHandle);
+}
+
+static void D3D12CityRecorder_Draw(CityRecorder* const base, uint32_t chunk)
+{
+    D3D12CityRecorder* const recorder = (D3D12CityRecorder*)base;
+    ID3D12GraphicsCommandList_DrawIndexedInstanced(recorder->commandLists[chunk], recorder->numIndices, 1, 0, 0, 0);
+}
+
+static void D3D12CityRecorder_End(CityRecorder* const base, uint32_t chunk)
+{
+    D3D12CityRecorder* const recorder = (D3D12CityRecorder*)base;
+    const HRESULT hr = ID3D12GraphicsCommandList_Close(recorder->commandLists[chunk]);
+    if (FAILED(hr)) LogAndExit(hr);
+}
+
+static const CityRecorderVtbl D3D12CityRecorderVtbl = {
+    .Begin = D3D12CityRecorder_Begin,
+    .SetRootSignature = D3D12CityRecorder_SetRootSignature,
+    .SetPipeline = D3D12CityRecorder_SetPipeline,
+    .SetDescriptorTable = D3D12CityRecorder_SetDescriptorTable,
+    .Draw = D3D12CityRecorder_Draw,
+    .End = D3D12CityRecorder_End,
+};
+
+static void InitRecorder(D3D12CityRecorder* const recorder,
+    const FrameResource* const fr,
+    ID3D12CommandAllocator** const allocators,
+    ID3D12GraphicsCommandList** const commandLists,
+    ID3D12PipelineState* const pso1,
+    ID3D12PipelineState* const pso2,
+    UINT frameResourceIndex, 
+    UINT numIndices, 
+    D3D12_INDEX_BUFFER_VIEW* const indexBufferViewDesc,
+    D3D12_VERTEX_BUFFER_VIEW* const vertexBufferViewDesc,
+    ID3D12DescriptorHeap* const cbvSrvDescriptorHeap,
+    UINT cbvSrvDescriptorSize, 
+    ID3D12DescriptorHeap* const samplerDescriptorHeap,
+    ID3D12RootSignature* const rootSignature)
+{
+    *recorder = (D3D12CityRecorder){
+        .base.vtbl = &D3D12CityRecorderVtbl,
+        .allocators = allocators,
+        .commandLists = commandLists,
+        .pipelines = { pso1, pso2 },
+        .numIndices = numIndices,
+        .indexBufferViewDesc = indexBufferViewDesc,
+        .vertexBufferViewDesc = vertexBufferViewDesc,
+        .cbvSrvDescriptorHeap = cbvSrvDescriptorHeap,
+        .samplerDescriptorHeap = samplerDescriptorHeap,
+        .rootSignature = rootSignature,
+        .cbvSrvDescriptorSize = cbvSrvDescriptorSize,
+    };
+
+    // Calculate the descriptor offset due to multiple frame resources.
+    // 1 SRV + how many CBVs we have currently.
+    UINT frameResourceDescriptorOffset = 1 + (frameResourceIndex * fr->cityRowCount * fr->cityColumnCount);
+    ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(cbvSrvDescriptorHeap, &recorder->firstCityHandle);
+    recorder->firstCityHandle.ptr += ((UINT64)frameResourceDescriptorOffset) * ((UINT64)cbvSrvDescriptorSize);
+}
+
+/*
+ * Fills drawQueue with the draws of 'cities' and sorts it. The pixel shader is different on each
+ * pipeline just as a PSO setting demonstration: sorted, a chunk sets each pipeline once instead of
+ * alternating them city by city. Within a pipeline the cities go front to back, by the clip space
+ * depth of their origin, so that the depth test rejects more of the farther ones.
+ */
+static void QueueCities(FrameResource* const fr, const UINT* const cities, UINT cityCount)
+{
+    RenderQueue_Clear(&fr->drawQueue);
+    for (UINT i = 0; i < cityCount; i++)
     {
-        FLOAT rowOffset = row * intervalRow;
-        for (UINT col = 0; col < fr->cityColumnCount; col++)
+        const UINT city = cities[i];
+
+        // The view is unknown until the first constant buffer update: the order doesn't matter then.
+        FLOAT depth = 0.0f;
+        if (fr->constantsValid)
         {
-            FLOAT colOffset = col * intervalCol;
-            // The y position ("up") is based off of the city's row and column position to prevent z-fighting.
-            XMMATRIX translated = XM_MAT_TRANSLATION(colOffset, CITY_SLOPE * (row * fr->cityColumnCount + col), rowOffset);
-            XM_STORE_FLOAT4X4(&fr->modelMatrices[row * fr->cityColumnCount + col], translated);
+            const FLOAT* const m = (const FLOAT*)&fr->viewProj;  // Row vectors: clip = (x, y, z, 1) * m
+            const FLOAT x = fr->cityX[city], y = fr->cityY[city], z = fr->cityZ[city];
+            const FLOAT clipZ = x * m[2] + y * m[6] + z * m[10] + m[14];
+            const FLOAT clipW = x * m[3] + y * m[7] + z * m[11] + m[15];
+            depth = clipW > 0.0f ? clipZ / clipW : 0.0f;
         }
+        RenderQueue_Push(&fr->drawQueue, RenderKey_Make(ROOT_SIGNATURE_CITY, city % 2, depth, city));
     }
+    RenderQueue_Sort(&fr->drawQueue);
 }
 
-void FrameResource_Init(FrameResource* const fr, ID3D12Device* const device, UINT cityRowCount, UINT cityColumnCount){
+// Chunks for 'cityCount' draws: one per thread of 'jobs', the caller included, as far as the frame resource has.
+static UINT RecordChunkCount(const FrameResource* const fr, const JobSystem* const jobs, UINT cityCount)
+{
+    return min(CityRecord_ChunkCount(cityCount, jobs->threadCount + 1), fr->recordChunkCount);
+}
+
+static void RecordBundles(FrameResource* const fr,
+    JobSystem* const jobs,
+    ID3D12PipelineState* const pso1,
+    ID3D12PipelineState* const pso2,
+    UINT frameResourceIndex, 
+    UINT numIndices, 
+    D3D12_INDEX_BUFFER_VIEW* const indexBufferViewDesc,
+    D3D12_VERTEX_BUFFER_VIEW* const vertexBufferViewDesc,
+    ID3D12DescriptorHeap* const cbvSrvDescriptorHeap,
+    UINT cbvSrvDescriptorSize, 
+    ID3D12DescriptorHeap* const samplerDescriptorHeap,
+    ID3D12RootSignature* const rootSignature)
+{
+    D3D12CityRecorder recorder;
+    InitRecorder(&recorder, fr, fr->bundleAllocators, fr->bundles, pso1, pso2, frameResourceIndex, numIndices, indexBufferViewDesc,
+        vertexBufferViewDesc, cbvSrvDescriptorHeap, cbvSrvDescriptorSize, samplerDescriptorHeap, rootSignature);
+
+    QueueCities(fr, fr->bundleCities, fr->bundleCityCount);
+    fr->bundleCount = RecordChunkCount(fr, jobs, fr->bundleCityCount);
+    CityRecord_Run(&recorder.base, jobs, fr->drawQueue.keys, fr->drawQueue.count, fr->bundleCount, &fr->recordStats);
+}
+
+void FrameResource_Init(FrameResource* const fr, ID3D12Device* const device, UINT cityRowCount, UINT cityColumnCount, UINT recordChunkCount){
     fr->fenceValue = 0;
     fr->cityRowCount = cityRowCount;
     fr->cityColumnCount = cityColumnCount;
-    fr->modelMatrices = HeapAlloc(GetProcessHeap(), 0, sizeof(XMFLOAT4X4) * fr->cityRowCount * fr->cityColumnCount);
+    fr->constantsValid = false;
+    fr->view = 0;
+
+    const UINT paddedCount = (cityRowCount * cityColumnCount + MVP_BATCH_BLOCK - 1) / MVP_BATCH_BLOCK * MVP_BATCH_BLOCK;
+    fr->cityX = HeapAlloc(GetProcessHeap(), 0, sizeof(FLOAT) * paddedCount * 3);
+    if (!fr->cityX) LogAndExit(E_OUTOFMEMORY);
+    fr->cityY = fr->cityX + paddedCount;
+    fr->cityZ = fr->cityY + paddedCount;
+
+    fr->visibleCities = HeapAlloc(GetProcessHeap(), 0, sizeof(UINT) * paddedCount * 2);
+    fr->inBundle = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, paddedCount);
+    if (!fr->visibleCities || !fr->inBundle) LogAndExit(E_OUTOFMEMORY);
+
+    // No tile has MVPs for a view yet: the views are numbered from 1.
+    fr->cityTileCount = (cityRowCount * cityColumnCount + CITY_CULL_TILE - 1) / CITY_CULL_TILE;
+    fr->cityTiles = HeapAlloc(GetProcessHeap(), 0, sizeof(CityTile) * CityCull_TileCount(cityRowCount * cityColumnCount));
+    fr->tileViews = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(UINT) * fr->cityTileCount * 2);
+    if (!fr->cityTiles || !fr->tileViews) LogAndExit(E_OUTOFMEMORY);
+    fr->mvpTiles = fr->tileViews + fr->cityTileCount;
+    fr->mvpTileCount = 0;
+    if (!RenderQueue_Init(&fr->drawQueue, cityRowCount * cityColumnCount)) LogAndExit(E_OUTOFMEMORY);
+    fr->recordStats = (CityRecordStats){ 0 };
+    fr->bundleCities = fr->visibleCities + paddedCount;
+    fr->visibleCityCount = 0;
+    fr->bundleCityCount = 0;
+    fr->cityCommandListCount = 0;
+    fr->bundleCount = 0;
+    fr->recordChunkCount = min(max(recordChunkCount, 1u), (UINT)CITY_RECORD_MAX_CHUNKS);
 
     // The command allocator is used by the main sample class when 
     // resetting the command list in the main update loop. Each frame 
@@ -43,11 +314,44 @@ void FrameResource_Init(FrameResource* const fr, ID3D12Device* const device, UIN
         (void**)&fr->commandAllocator);
     if(FAILED(hr))    LogAndExit(hr);
 
-    hr = ID3D12Device_CreateCommandAllocator(device, 
-        D3D12_COMMAND_LIST_TYPE_BUNDLE, 
-        __IID(&fr->bundleAllocator), 
-        (void**)&fr->bundleAllocator);
-    if(FAILED(hr)) LogAndExit(hr);
+    // A command list and a bundle per chunk the city draws are recorded in, each recorded by one thread.
+    // They are created closed, the recording resets them.
+    for (UINT chunk = 0; chunk < fr->recordChunkCount; chunk++)
+    {
+        hr = ID3D12Device_CreateCommandAllocator(device, 
+            D3D12_COMMAND_LIST_TYPE_DIRECT, 
+            __IID(&fr->cityAllocators[chunk]),
+            (void**)&fr->cityAllocators[chunk]);
+        if(FAILED(hr)) LogAndExit(hr);
+        hr = ID3D12Device_CreateCommandList(device, 
+            0, 
+            D3D12_COMMAND_LIST_TYPE_DIRECT, 
+            fr->cityAllocators[chunk], 
+            NULL, 
+            __IID(&fr->cityCommandLists[chunk]), 
+            (void**)&fr->cityCommandLists[chunk]);
+        if(FAILED(hr)) LogAndExit(hr);
+        NAME_D3D12_OBJECT_INDEXED(fr->cityCommandLists, chunk);
+        hr = ID3D12GraphicsCommandList_Close(fr->cityCommandLists[chunk]);
+        if(FAILED(hr)) LogAndExit(hr);
+
+        hr = ID3D12Device_CreateCommandAllocator(device, 
+            D3D12_COMMAND_LIST_TYPE_BUNDLE, 
+            __IID(&fr->bundleAllocators[chunk]), 
+            (void**)&fr->bundleAllocators[chunk]);
+        if(FAILED(hr)) LogAndExit(hr);
+        hr = ID3D12Device_CreateCommandList(device, 
+            0, 
+            D3D12_COMMAND_LIST_TYPE_BUNDLE, 
+            fr->bundleAllocators[chunk], 
+            NULL, 
+            __IID(&fr->bundles[chunk]), 
+            (void**)&fr->bundles[chunk]);
+        if(FAILED(hr)) LogAndExit(hr);
+        NAME_D3D12_OBJECT_INDEXED(fr->bundles, chunk);
+        hr = ID3D12GraphicsCommandList_Close(fr->bundles[chunk]);
+        if(FAILED(hr)) LogAndExit(hr);
+    }
 
     D3D12_HEAP_PROPERTIES uploadHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     D3D12_RESOURCE_DESC uploadBuffer = CD3DX12_RESOURCE_DESC_BUFFER(sizeof(SceneConstantBuffer) * fr->cityRowCount * fr->cityColumnCount, D3D12_RESOURCE_FLAG_NONE, 0);
@@ -71,13 +375,28 @@ void FrameResource_Init(FrameResource* const fr, ID3D12Device* const device, UIN
     hr = ID3D12Resource_Map(fr->cbvUploadHeap, 0, &readRange, (void**)(&fr->pConstantBuffers));
     if(FAILED(hr)) LogAndExit(hr);
 
-    // Update all of the model matrices once; our cities don't move so 
+    // The list of cities the instanced draws read, also written every frame.
+    D3D12_RESOURCE_DESC instanceBuffer = CD3DX12_RESOURCE_DESC_BUFFER(sizeof(UINT) * paddedCount, D3D12_RESOURCE_FLAG_NONE, 0);
+    hr = ID3D12Device_CreateCommittedResource(device,
+        &uploadHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &instanceBuffer,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        NULL,
+        __IID(&fr->instanceUploadHeap),
+        (void**)&fr->instanceUploadHeap);
+    if (FAILED(hr)) LogAndExit(hr);
+    hr = ID3D12Resource_Map(fr->instanceUploadHeap, 0, &readRange, (void**)(&fr->pInstanceCities));
+    if(FAILED(hr)) LogAndExit(hr);
+
+    // Place all of the cities once; our cities don't move so 
     // we don't need to do this ever again.
     SetCityPositions(fr, 8.0f, -8.0f);
+    CityCull_ComputeTiles(fr->cityX, fr->cityY, fr->cityZ, cityRowCount * cityColumnCount, fr->cityTiles);
 }
 
 void FrameResource_InitBundle(FrameResource* const fr,
-    ID3D12Device* const device,
+    JobSystem* const jobs,
     ID3D12PipelineState* const pso1,
     ID3D12PipelineState* const pso2,
     UINT frameResourceIndex, 
@@ -89,24 +408,21 @@ void FrameResource_InitBundle(FrameResource* const fr,
     ID3D12DescriptorHeap* const samplerDescriptorHeap,
     ID3D12RootSignature* const rootSignature)
 {
-    HRESULT hr = ID3D12Device_CreateCommandList(device, 
-        0, 
-        D3D12_COMMAND_LIST_TYPE_BUNDLE, 
-        fr->bundleAllocator, 
-        pso1, 
-        __IID(&fr->bundle), 
-        (void**)&fr->bundle);
-    if(FAILED(hr)) LogAndExit(hr);
-    NAME_D3D12_OBJECT(fr->bundle);
+    fr->bundleCityCount = fr->cityRowCount * fr->cityColumnCount;
+    for (UINT city = 0; city < fr->bundleCityCount; city++)
+    {
+        fr->bundleCities[city] = city;
+        fr->inBundle[city] = 1;
+    }
 
-    FrameResource_PopulateCommandList(fr, fr->bundle, pso1, pso2, frameResourceIndex, numIndices, indexBufferViewDesc,
+    RecordBundles(fr, jobs, pso1, pso2, frameResourceIndex, numIndices, indexBufferViewDesc,
         vertexBufferViewDesc, cbvSrvDescriptorHeap, cbvSrvDescriptorSize, samplerDescriptorHeap, rootSignature);
-    hr = ID3D12GraphicsCommandList_Close(fr->bundle);
-    if (FAILED(hr)) LogAndExit(hr);
 }
 
-void FrameResource_PopulateCommandList(FrameResource* const fr,
-    ID3D12GraphicsCommandList* const commandList,
+void FrameResource_RecordBundle(FrameResource* const fr,
+    JobSystem* const jobs,
+    const CityFrustum* const frustum,
+    const CityBounds* const bounds,
     ID3D12PipelineState* const pso1,
     ID3D12PipelineState* const pso2,
     UINT frameResourceIndex, 
@@ -118,8 +434,84 @@ void FrameResource_PopulateCommandList(FrameResource* const fr,
     ID3D12DescriptorHeap* const samplerDescriptorHeap,
     ID3D12RootSignature* const rootSignature)
 {
-    // If the root signature matches the root signature of the caller, then
-    // bindings are inherited, otherwise the bind space is reset.
+    for (UINT i = 0; i < fr->bundleCityCount; i++)
+    {
+        fr->inBundle[fr->bundleCities[i]] = 0;
+    }
+    fr->bundleCityCount = CityCull_RunTiles(frustum, bounds, BUNDLE_MARGIN, fr->cityTiles, fr->cityX, fr->cityY, fr->cityZ,
+        fr->cityRowCount * fr->cityColumnCount, fr->bundleCities);
+    for (UINT i = 0; i < fr->bundleCityCount; i++)
+    {
+        fr->inBundle[fr->bundleCities[i]] = 1;
+    }
+
+    RecordBundles(fr, jobs, pso1, pso2, frameResourceIndex, numIndices, indexBufferViewDesc,
+        vertexBufferViewDesc, cbvSrvDescriptorHeap, cbvSrvDescriptorSize, samplerDescriptorHeap, rootSignature);
+}
+
+void FrameResource_RecordCommandLists(FrameResource* const fr,
+    JobSystem* const jobs,
+    ID3D12PipelineState* const pso1,
+    ID3D12PipelineState* const pso2,
+    UINT frameResourceIndex, 
+    UINT numIndices, 
+    D3D12_INDEX_BUFFER_VIEW* const indexBufferViewDesc,
+    D3D12_VERTEX_BUFFER_VIEW* const vertexBufferViewDesc,
+    ID3D12DescriptorHeap* const cbvSrvDescriptorHeap,
+    UINT cbvSrvDescriptorSize, 
+    ID3D12DescriptorHeap* const samplerDescriptorHeap,
+    ID3D12RootSignature* const rootSignature,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* const renderTargetView,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* const depthStencilView,
+    const D3D12_VIEWPORT* const viewport,
+    const RECT* const scissorRect)
+{
+    D3D12CityRecorder recorder;
+    InitRecorder(&recorder, fr, fr->cityAllocators, fr->cityCommandLists, pso1, pso2, frameResourceIndex, numIndices, indexBufferViewDesc,
+        vertexBufferViewDesc, cbvSrvDescriptorHeap, cbvSrvDescriptorSize, samplerDescriptorHeap, rootSignature);
+    recorder.renderTargetView = renderTargetView;
+    recorder.depthStencilView = depthStencilView;
+    recorder.viewport = viewport;
+    recorder.scissorRect = scissorRect;
+
+    QueueCities(fr, fr->visibleCities, fr->visibleCityCount);
+    fr->cityCommandListCount = RecordChunkCount(fr, jobs, fr->visibleCityCount);
+    CityRecord_Run(&recorder.base, jobs, fr->drawQueue.keys, fr->drawQueue.count, fr->cityCommandListCount, &fr->recordStats);
+}
+
+void FrameResource_PopulateInstanced(FrameResource* const fr,
+    ID3D12GraphicsCommandList* const commandList,
+    ID3D12PipelineState* const pso1,
+    ID3D12PipelineState* const pso2,
+    UINT numIndices, 
+    D3D12_INDEX_BUFFER_VIEW* const indexBufferViewDesc,
+    D3D12_VERTEX_BUFFER_VIEW* const vertexBufferViewDesc,
+    ID3D12DescriptorHeap* const cbvSrvDescriptorHeap,
+    ID3D12DescriptorHeap* const samplerDescriptorHeap,
+    ID3D12RootSignature* const rootSignature)
+{
+    // Group the visible cities by pipeline state, even cities first: one draw per group. The upload
+    // heap is write-combined, so it is only written, in two sequential streams.
+    UINT evenCount = 0;
+    for (UINT i = 0; i < fr->visibleCityCount; i++)
+    {
+        evenCount += (fr->visibleCities[i] % 2) == 0;
+    }
+    UINT even = 0;
+    UINT odd = evenCount;
+    for (UINT i = 0; i < fr->visibleCityCount; i++)
+    {
+        const UINT city = fr->visibleCities[i];
+        if (city % 2 == 0)
+        {
+            fr->pInstanceCities[even++] = city;
+        }
+        else
+        {
+            fr->pInstanceCities[odd++] = city;
+        }
+    }
+
     ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, rootSignature);
 
     ID3D12DescriptorHeap* ppHeaps[] = { cbvSrvDescriptorHeap, samplerDescriptorHeap };
@@ -129,64 +521,104 @@ void FrameResource_PopulateCommandList(FrameResource* const fr,
     ID3D12GraphicsCommandList_IASetVertexBuffers(commandList, 0, 1, vertexBufferViewDesc);
     D3D12_GPU_DESCRIPTOR_HANDLE cbvSrvHandle;
     ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(cbvSrvDescriptorHeap, &cbvSrvHandle);
-    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, 0, cbvSrvHandle);
+    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, RootParameter_Texture, cbvSrvHandle);
     D3D12_GPU_DESCRIPTOR_HANDLE samplerHandle;
     ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(samplerDescriptorHeap, &samplerHandle);
-    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, 1, samplerHandle);
+    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, RootParameter_Sampler, samplerHandle);
 
-    // Calculate the descriptor offset due to multiple frame resources.
-    // 1 SRV + how many CBVs we have currently.
-    UINT frameResourceDescriptorOffset = 1 + (frameResourceIndex * fr->cityRowCount * fr->cityColumnCount);
-    cbvSrvHandle.ptr += ((UINT64)frameResourceDescriptorOffset) * ((UINT64)cbvSrvDescriptorSize);
+    // The constant buffers as a structured buffer (t1), and the cities to draw (t2).
+    ID3D12GraphicsCommandList_SetGraphicsRootShaderResourceView(commandList, RootParameter_CityMvps, ID3D12Resource_GetGPUVirtualAddress(fr->cbvUploadHeap));
+    ID3D12GraphicsCommandList_SetGraphicsRootShaderResourceView(commandList, RootParameter_InstanceCities, ID3D12Resource_GetGPUVirtualAddress(fr->instanceUploadHeap));
 
-    BOOL usePso1 = TRUE;
-    for (UINT row = 0; row < fr->cityRowCount; row++)
+    // The pixel shader is different on each PSO just as a PSO setting demonstration.
+    const UINT firstInstance[2] = { 0, evenCount };
+    const UINT instanceCount[2] = { evenCount, fr->visibleCityCount - evenCount };
+    for (UINT group = 0; group < 2; group++)
     {
-        for (UINT col = 0; col < fr->cityColumnCount; col++)
+        if (instanceCount[group] == 0)
         {
-            // Alternate which PSO to use; the pixel shader is different on 
-            // each just as a PSO setting demonstration.
-            ID3D12GraphicsCommandList_SetPipelineState(commandList, usePso1 ? pso1 : pso2);
-            usePso1 = !usePso1;
-            // Set this city's CBV table and move to the next descriptor.
-            ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, 2, cbvSrvHandle);
-            cbvSrvHandle.ptr += (UINT64)cbvSrvDescriptorSize;
-            ID3D12GraphicsCommandList_DrawIndexedInstanced(commandList, numIndices, 1, 0, 0, 0);
+            continue;
         }
+        ID3D12GraphicsCommandList_SetPipelineState(commandList, group == 0 ? pso1 : pso2);
+        ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstant(commandList, RootParameter_FirstInstance, firstInstance[group], 0);
+        ID3D12GraphicsCommandList_DrawIndexedInstanced(commandList, numIndices, instanceCount[group], 0, 0, 0);
     }
 }
 
-void XM_CALLCONV FrameResource_UpdateConstantBuffers(FrameResource* const fr, FXMMATRIX view, CXMMATRIX projection)
+void FrameResource_CullCities(FrameResource* const fr, const CityFrustum* const frustum, const CityBounds* const bounds)
 {
-    XMMATRIX model;
-    XMFLOAT4X4 mvp;
+    fr->visibleCityCount = CityCull_RunTiles(frustum, bounds, 0.0f, fr->cityTiles, fr->cityX, fr->cityY, fr->cityZ,
+        fr->cityRowCount * fr->cityColumnCount, fr->visibleCities);
+}
 
-    for (UINT row = 0; row < fr->cityRowCount; row++)
+bool FrameResource_IsBundleStale(const FrameResource* const fr)
+{
+    UINT drawn = 0;
+    for (UINT i = 0; i < fr->visibleCityCount; i++)
     {
-        for (UINT col = 0; col < fr->cityColumnCount; col++)
-        {
-            UINT currentCityBlock = row * fr->cityColumnCount + col;
-            model = XMLoadFloat4x4(&fr->modelMatrices[currentCityBlock]);
+        drawn += fr->inBundle[fr->visibleCities[i]];
+    }
+    return drawn < fr->visibleCityCount || (fr->bundleCityCount - drawn) * 2 > fr->bundleCityCount;
+}
 
-            // Compute the model-view-projection matrix.
-            XMMATRIX mv_XMMATRIX = XMMatrixMultiply(&model, view);
-            XMMATRIX mvp_XMMATRIX = XMMatrixMultiply(&mv_XMMATRIX, projection);
-            XMMATRIX mvpTranspose_XMMATRIX = XMMatrixTranspose(&mvp_XMMATRIX);
-            XMStoreFloat4x4(&mvp, &mvpTranspose_XMMATRIX);
+void XM_CALLCONV FrameResource_SetView(FrameResource* const fr, FXMMATRIX view, CXMMATRIX projection)
+{
+    XMMATRIX viewProj_XMMATRIX = XMMatrixMultiply(view, projection);
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, &viewProj_XMMATRIX);
 
-            // Copy this matrix into the appropriate location in the upload heap subresource.
-            memcpy(&fr->pConstantBuffers[currentCityBlock], &mvp, sizeof(mvp));
-        }
+    // The cities don't move: the constant buffers only change with the camera.
+    if (fr->constantsValid && memcmp(&viewProj, &fr->viewProj, sizeof(viewProj)) == 0)
+    {
+        return;
     }
+    fr->viewProj = viewProj;
+    fr->constantsValid = true;
+    fr->view++;
+}
+
+void FrameResource_UpdateConstantBuffers(FrameResource* const fr, JobSystem* const jobs, MvpKernel kernel, bool bundleDrawn)
+{
+    // The cities drawn are near the frustum, so this follows the view rather than the grid. A resting
+    // camera adds no tile.
+    fr->mvpTileCount = 0;
+    AddMvpTiles(fr, fr->visibleCities, fr->visibleCityCount);
+    if (bundleDrawn)
+    {
+        AddMvpTiles(fr, fr->bundleCities, fr->bundleCityCount);
+    }
+
+    // Their cities' MVPs go straight into the upload heap, a cache line at a time.
+    MvpJob job = {
+        .fr = fr,
+        .viewProj = (const FLOAT*)&fr->viewProj,
+        .kernel = kernel,
+        .cityCount = fr->cityRowCount * fr->cityColumnCount,
+        .tileCount = fr->mvpTileCount,
+    };
+    JobSystem_ParallelFor(jobs, (job.tileCount + MVP_JOB_TILES - 1) / MVP_JOB_TILES, ComputeMvpJob, &job);
 }
 
 void FrameResource_Clean(FrameResource* const fr)
 {
     ID3D12Resource_Unmap(fr->cbvUploadHeap, 0, NULL);
     fr->pConstantBuffers = NULL;
-    HeapFree(GetProcessHeap(), 0, fr->modelMatrices);
+    ID3D12Resource_Unmap(fr->instanceUploadHeap, 0, NULL);
+    fr->pInstanceCities = NULL;
+    HeapFree(GetProcessHeap(), 0, fr->cityX);
+    HeapFree(GetProcessHeap(), 0, fr->visibleCities);
+    HeapFree(GetProcessHeap(), 0, fr->inBundle);
+    HeapFree(GetProcessHeap(), 0, fr->cityTiles);
+    HeapFree(GetProcessHeap(), 0, fr->tileViews);
+    RenderQueue_Destroy(&fr->drawQueue);
     RELEASE(fr->commandAllocator);
-    RELEASE(fr->bundleAllocator);
-    RELEASE(fr->bundle);
+    for (UINT chunk = 0; chunk < fr->recordChunkCount; chunk++)
+    {
+        RELEASE(fr->cityCommandLists[chunk]);
+        RELEASE(fr->cityAllocators[chunk]);
+        RELEASE(fr->bundles[chunk]);
+        RELEASE(fr->bundleAllocators[chunk]);
+    }
     RELEASE(fr->cbvUploadHeap);
+    RELEASE(fr->instanceUploadHeap);
 }
\ No newline at end of file
@@ -1,7 +1,13 @@
 #pragma once
 
 #include <windows.h>
+#include <stdbool.h>
 #include <DirectXMathC.h>
+#include "mvp_batch.h"
+#include "job_system.h"
+#include "city_cull.h"
+#include "city_record.h"
+#include "render_queue.h"
 
 typedef struct ID3D12Device ID3D12Device;
 typedef struct ID3D12CommandAllocator ID3D12CommandAllocator;
@@ -12,6 +18,8 @@ typedef struct ID3D12DescriptorHeap ID3D12DescriptorHeap;
 typedef struct ID3D12RootSignature ID3D12RootSignature;
 typedef struct D3D12_INDEX_BUFFER_VIEW D3D12_INDEX_BUFFER_VIEW;
 typedef struct D3D12_VERTEX_BUFFER_VIEW D3D12_VERTEX_BUFFER_VIEW;
+typedef struct D3D12_CPU_DESCRIPTOR_HANDLE D3D12_CPU_DESCRIPTOR_HANDLE;
+typedef struct D3D12_VIEWPORT D3D12_VIEWPORT;
 
 typedef struct SceneConstantBuffer
 {
@@ -19,25 +27,88 @@ typedef struct SceneConstantBuffer
     FLOAT padding[48];
 } SceneConstantBuffer;
 
+// 256-byte aligned for the CBVs, and the stride of the structured buffer the instanced vertex shader reads.
+_Static_assert(sizeof(SceneConstantBuffer) == 256, "SceneConstantBuffer must match the shaders' struct");
+
+// Parameters of the root signature, with the registers the shaders bind them to. The last three are for the
+// instanced draws only.
+typedef enum RootParameter
+{
+    RootParameter_Texture,          // Table of t0, pixel shader
+    RootParameter_Sampler,          // Table of s0, pixel shader
+    RootParameter_CityConstants,    // Table of b0, the CBV of one city
+    RootParameter_CityMvps,         // SRV t1, vertex shader: the constant buffers as a structured buffer
+    RootParameter_InstanceCities,   // SRV t2, vertex shader: the cities of the draws
+    RootParameter_FirstInstance,    // 1 constant in b1, vertex shader
+    RootParameter_Count,
+} RootParameter;
+
 typedef struct FrameResource
 {
     ID3D12CommandAllocator *commandAllocator;
-    ID3D12CommandAllocator *bundleAllocator;
-    ID3D12GraphicsCommandList *bundle;
     ID3D12Resource *cbvUploadHeap;
     SceneConstantBuffer* pConstantBuffers;
     UINT64 fenceValue;
 
-    XMFLOAT4X4 *modelMatrices;
+    // City positions, SoA and padded to MVP_BATCH_BLOCK: each model matrix is a translation.
+    FLOAT *cityX;
+    FLOAT *cityY;
+    FLOAT *cityZ;
     UINT cityRowCount;
     UINT cityColumnCount;
+
+    // View-projection of the frame, numbered: view is incremented whenever it changes, from 0 before the first.
+    XMFLOAT4X4 viewProj;
+    bool constantsValid;
+    UINT view;
+
+    // Boxes of CITY_CULL_TILE consecutive cities and of their groups, for the culling. The constant buffers
+    // are brought up to date a tile at a time, only for the cityTileCount tiles with a city drawn: tileViews
+    // holds the view each tile's MVPs were computed for. mvpTiles lists the tiles of the last update.
+    CityTile *cityTiles;
+    UINT *tileViews;
+    UINT *mvpTiles;
+    UINT cityTileCount;
+    UINT mvpTileCount;
+
+    // Cities drawn this frame, from the CPU culling pass. Padded like the positions.
+    UINT *visibleCities;
+    UINT visibleCityCount;
+
+    // Cities the bundle draws: those visible when it was recorded, with a margin. It is recorded
+    // again when it misses a visible city or when most of its draws are culled.
+    UINT *bundleCities;
+    UINT bundleCityCount;
+    UINT8 *inBundle;         // Per city, 1 if the bundle draws it
+
+    // The city draws are recorded in parallel, in up to recordChunkCount chunks: each chunk has its
+    // direct command list and its bundle, each with its allocator. Executed in order, they draw the cities
+    // in order.
+    UINT recordChunkCount;
+    ID3D12CommandAllocator *cityAllocators[CITY_RECORD_MAX_CHUNKS];
+    ID3D12GraphicsCommandList *cityCommandLists[CITY_RECORD_MAX_CHUNKS];
+    UINT cityCommandListCount;  // Recorded by the last FrameResource_RecordCommandLists
+    ID3D12CommandAllocator *bundleAllocators[CITY_RECORD_MAX_CHUNKS];
+    ID3D12GraphicsCommandList *bundles[CITY_RECORD_MAX_CHUNKS];
+    UINT bundleCount;           // Recorded by the last FrameResource_RecordBundle
+
+    // The city draws as render queue keys, sorted before they are recorded: grouped by pipeline state,
+    // front to back. recordStats counts the state sets of the last recording.
+    RenderQueue drawQueue;
+    CityRecordStats recordStats;
+
+    // Instanced draws: the visible cities grouped by pipeline state, read by the vertex shader.
+    ID3D12Resource *instanceUploadHeap;
+    UINT *pInstanceCities;
 } FrameResource;
 
-void FrameResource_Init(FrameResource * const fr, ID3D12Device* const device, UINT cityRowCount, UINT cityColumnCount);
+// 'recordChunkCount' is the most chunks the city draws will be recorded in, see CityRecord_ChunkCount.
+void FrameResource_Init(FrameResource * const fr, ID3D12Device* const device, UINT cityRowCount, UINT cityColumnCount, UINT recordChunkCount);
 void FrameResource_Clean(FrameResource* const fr);
 
+// Records the bundles with every city, until the first FrameResource_RecordBundle.
 void FrameResource_InitBundle(FrameResource* const fr,
-    ID3D12Device* const device,
+    JobSystem* const jobs,
     ID3D12PipelineState* const pso1,
     ID3D12PipelineState* const pso2,
     UINT frameResourceIndex, 
@@ -50,8 +121,29 @@ void FrameResource_InitBundle(FrameResource* const fr,
     ID3D12RootSignature* const rootSignature
 );
 
-void FrameResource_PopulateCommandList(FrameResource* const fr,
-    ID3D12GraphicsCommandList* const commandList,
+// Records the bundles again for the cities within a margin of the frustum, split over 'jobs'. The GPU
+// must be done with this frame resource.
+void FrameResource_RecordBundle(FrameResource* const fr,
+    JobSystem* const jobs,
+    const CityFrustum* const frustum,
+    const CityBounds* const bounds,
+    ID3D12PipelineState* const pso1,
+    ID3D12PipelineState* const pso2,
+    UINT frameResourceIndex, 
+    UINT numIndices, 
+    D3D12_INDEX_BUFFER_VIEW* const indexBufferViewDesc,
+    D3D12_VERTEX_BUFFER_VIEW* const vertexBufferViewDesc,
+    ID3D12DescriptorHeap* const cbvSrvDescriptorHeap,
+    UINT cbvSrvDescriptorSize, 
+    ID3D12DescriptorHeap* const samplerDescriptorHeap,
+    ID3D12RootSignature* const rootSignature
+);
+
+// Records the draws of the visible cities into cityCommandLists, split over 'jobs', sorted by state
+// then front to back. Each list binds the render targets and all the state it uses, so that they can
+// be executed, in order, after the list that clears the targets.
+void FrameResource_RecordCommandLists(FrameResource* const fr,
+    JobSystem* const jobs,
     ID3D12PipelineState* const pso1,
     ID3D12PipelineState* const pso2,
     UINT frameResourceIndex, 
@@ -61,7 +153,37 @@ void FrameResource_PopulateCommandList(FrameResource* const fr,
     ID3D12DescriptorHeap* const cbvSrvDescriptorHeap,
     UINT cbvSrvDescriptorSize, 
     ID3D12DescriptorHeap* const samplerDescriptorHeap,
+    ID3D12RootSignature* const rootSignature,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* const renderTargetView,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* const depthStencilView,
+    const D3D12_VIEWPORT* const viewport,
+    const RECT* const scissorRect
+);
+
+// Records the visible cities as one instanced draw per pipeline state. The vertex shader reads each
+// city's MVP from the constant buffers, bound as a structured buffer, so no descriptor is needed per city.
+void FrameResource_PopulateInstanced(FrameResource* const fr,
+    ID3D12GraphicsCommandList* const commandList,
+    ID3D12PipelineState* const pso1,
+    ID3D12PipelineState* const pso2,
+    UINT numIndices, 
+    D3D12_INDEX_BUFFER_VIEW* const indexBufferViewDesc,
+    D3D12_VERTEX_BUFFER_VIEW* const vertexBufferViewDesc,
+    ID3D12DescriptorHeap* const cbvSrvDescriptorHeap,
+    ID3D12DescriptorHeap* const samplerDescriptorHeap,
     ID3D12RootSignature* const rootSignature
 );
 
-void XM_CALLCONV FrameResource_UpdateConstantBuffers(FrameResource* const fr, FXMMATRIX view, CXMMATRIX projection);
\ No newline at end of file
+// Sets the view-projection of the frame, which the culling, the draw order and the constant buffers follow.
+void XM_CALLCONV FrameResource_SetView(FrameResource* const fr, FXMMATRIX view, CXMMATRIX projection);
+
+// Fills visibleCities with the cities that intersect the frustum, testing groups and tiles of them first.
+void FrameResource_CullCities(FrameResource* const fr, const CityFrustum* const frustum, const CityBounds* const bounds);
+
+// True if the bundle misses a visible city, or if most of its draws are culled.
+bool FrameResource_IsBundleStale(const FrameResource* const fr);
+
+// Writes with 'kernel' the MVPs of the tiles holding a visible city, or a city of the bundle if 'bundleDrawn',
+// that were computed for an older view. Spread over 'jobs' when there are many. Call it after the culling
+// and after recording the bundle.
+void FrameResource_UpdateConstantBuffers(FrameResource* const fr, JobSystem* const jobs, MvpKernel kernel, bool bundleDrawn);
\ No newline at end of file
@@ -1,6 +1,14 @@
+#include <stdio.h>
 #include "window.h"
 #include "sample.h"
 
 int CALLBACK WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nCmdShow) {
-    return Win32App_Run(&(DXSample){ .title = "D3D12Bundles", .width = 1280, .height = 720 }, hInstance, nCmdShow);
-}
\ No newline at end of file
+    DXSample sample = { .title = "D3D12Bundles", .width = 1280, .height = 720 };
+    // Optional city grid: rows then columns. Sample_Init falls back to the default grid if it isn't valid.
+    if (sscanf_s(lpCmdLine, "%u %u", &sample.cityRowCount, &sample.cityColumnCount) != 2)
+    {
+        sample.cityRowCount = 0;
+        sample.cityColumnCount = 0;
+    }
+    return Win32App_Run(&sample, hInstance, nCmdShow);
+}
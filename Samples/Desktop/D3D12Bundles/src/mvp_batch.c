@@ -0,0 +1,225 @@
+#include "mvp_batch.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MVP_BATCH_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2   __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#else
+#define MVP_BATCH_X64 0
+#endif
+
+// Every matrix is 16 floats: one cache line.
+#define MVP_FLOATS 16
+
+// The transposed MVP of a city at the origin: row r is (viewProj[0][r], viewProj[1][r], viewProj[2][r], 0).
+static void BuildTemplate(const float* const viewProj, float out[MVP_FLOATS])
+{
+    for (int r = 0; r < 4; r++)
+    {
+        out[r * 4 + 0] = viewProj[0 * 4 + r];
+        out[r * 4 + 1] = viewProj[1 * 4 + r];
+        out[r * 4 + 2] = viewProj[2 * 4 + r];
+        out[r * 4 + 3] = 0.0f;
+    }
+}
+
+static void ComputeScalar(const float* const viewProj, const float* const x, const float* const y, const float* const z,
+                          uint32_t first, uint32_t count, uint8_t* const dst, size_t dstStride)
+{
+    float matrix[MVP_FLOATS];
+    BuildTemplate(viewProj, matrix);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t city = first + i;
+        for (int r = 0; r < 4; r++)
+        {
+            matrix[r * 4 + 3] = x[city] * viewProj[0 * 4 + r] + y[city] * viewProj[1 * 4 + r] + z[city] * viewProj[2 * 4 + r] + viewProj[3 * 4 + r];
+        }
+        memcpy(dst + i * dstStride, matrix, sizeof(matrix));
+    }
+}
+
+#if MVP_BATCH_X64
+
+static TARGET_AVX2 void ComputeAvx2(const float* const viewProj, const float* const x, const float* const y, const float* const z,
+                                    uint32_t first, uint32_t count, uint8_t* const dst, size_t dstStride)
+{
+    float matrix[MVP_FLOATS];
+    BuildTemplate(viewProj, matrix);
+    const __m256 rows01 = _mm256_loadu_ps(&matrix[0]);
+    const __m256 rows23 = _mm256_loadu_ps(&matrix[8]);
+
+    __m256 columnX[4], columnY[4], columnZ[4], columnW[4];
+    for (int r = 0; r < 4; r++)
+    {
+        columnX[r] = _mm256_set1_ps(viewProj[0 * 4 + r]);
+        columnY[r] = _mm256_set1_ps(viewProj[1 * 4 + r]);
+        columnZ[r] = _mm256_set1_ps(viewProj[2 * 4 + r]);
+        columnW[r] = _mm256_set1_ps(viewProj[3 * 4 + r]);
+    }
+
+    for (uint32_t i = 0; i < count; i += 8)
+    {
+        const __m256 px = _mm256_loadu_ps(&x[first + i]);
+        const __m256 py = _mm256_loadu_ps(&y[first + i]);
+        const __m256 pz = _mm256_loadu_ps(&z[first + i]);
+
+        // Last column of the 8 matrices: translation * viewProj
+        __m256 w[4];
+        for (int r = 0; r < 4; r++)
+        {
+            w[r] = _mm256_fmadd_ps(px, columnX[r], _mm256_fmadd_ps(py, columnY[r], _mm256_fmadd_ps(pz, columnZ[r], columnW[r])));
+        }
+
+        const uint32_t lanes = count - i < 8 ? count - i : 8;
+        for (uint32_t lane = 0; lane < lanes; lane++)
+        {
+            const __m256i broadcast = _mm256_set1_epi32((int)lane);
+            const __m256 w01 = _mm256_blend_ps(_mm256_permutevar8x32_ps(w[0], broadcast), _mm256_permutevar8x32_ps(w[1], broadcast), 0xF0);
+            const __m256 w23 = _mm256_blend_ps(_mm256_permutevar8x32_ps(w[2], broadcast), _mm256_permutevar8x32_ps(w[3], broadcast), 0xF0);
+
+            float* const out = (float*)(dst + (i + lane) * dstStride);
+            _mm256_stream_ps(out + 0, _mm256_blend_ps(rows01, w01, 0x88));
+            _mm256_stream_ps(out + 8, _mm256_blend_ps(rows23, w23, 0x88));
+        }
+    }
+    _mm_sfence();
+}
+
+static TARGET_AVX512 void ComputeAvx512(const float* const viewProj, const float* const x, const float* const y, const float* const z,
+                                        uint32_t first, uint32_t count, uint8_t* const dst, size_t dstStride)
+{
+    float matrix[MVP_FLOATS];
+    BuildTemplate(viewProj, matrix);
+    const __m512 rows = _mm512_loadu_ps(matrix);
+
+    __m512 columnX[4], columnY[4], columnZ[4], columnW[4];
+    for (int r = 0; r < 4; r++)
+    {
+        columnX[r] = _mm512_set1_ps(viewProj[0 * 4 + r]);
+        columnY[r] = _mm512_set1_ps(viewProj[1 * 4 + r]);
+        columnZ[r] = _mm512_set1_ps(viewProj[2 * 4 + r]);
+        columnW[r] = _mm512_set1_ps(viewProj[3 * 4 + r]);
+    }
+
+    for (uint32_t i = 0; i < count; i += 16)
+    {
+        const __m512 px = _mm512_loadu_ps(&x[first + i]);
+        const __m512 py = _mm512_loadu_ps(&y[first + i]);
+        const __m512 pz = _mm512_loadu_ps(&z[first + i]);
+
+        // Last column of the 16 matrices: translation * viewProj
+        __m512 w[4];
+        for (int r = 0; r < 4; r++)
+        {
+            w[r] = _mm512_fmadd_ps(px, columnX[r], _mm512_fmadd_ps(py, columnY[r], _mm512_fmadd_ps(pz, columnZ[r], columnW[r])));
+        }
+
+        const uint32_t lanes = count - i < 16 ? count - i : 16;
+        for (uint32_t lane = 0; lane < lanes; lane++)
+        {
+            const __m512i broadcast = _mm512_set1_epi32((int)lane);
+            __m512 line = _mm512_mask_permutexvar_ps(rows, 0x0008, broadcast, w[0]);
+            line = _mm512_mask_permutexvar_ps(line, 0x0080, broadcast, w[1]);
+            line = _mm512_mask_permutexvar_ps(line, 0x0800, broadcast, w[2]);
+            line = _mm512_mask_permutexvar_ps(line, 0x8000, broadcast, w[3]);
+            _mm512_stream_ps((float*)(dst + (i + lane) * dstStride), line);
+        }
+    }
+    _mm_sfence();
+}
+
+#endif
+
+/*************************************************************************************
+ Public functions
+**************************************************************************************/
+
+MvpKernel MvpBatch_DetectKernel(void)
+{
+#if MVP_BATCH_X64
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return MvpKernel_Scalar;
+    }
+
+    __cpuidex(info, 1, 0);
+    const int osxsave = (info[2] >> 27) & 1;
+    const int fma = (info[2] >> 12) & 1;
+    if (!osxsave)
+    {
+        return MvpKernel_Scalar;
+    }
+
+    // The OS must save the YMM (and ZMM) registers on context switches.
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    const int avx2 = (info[1] >> 5) & 1;
+    const int avx512f = (info[1] >> 16) & 1;
+
+    if (avx512f && (xcr0 & 0xE6) == 0xE6)
+    {
+        return MvpKernel_Avx512;
+    }
+    if (avx2 && fma && (xcr0 & 0x6) == 0x6)
+    {
+        return MvpKernel_Avx2;
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return MvpKernel_Avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return MvpKernel_Avx2;
+    }
+#endif
+#endif
+    return MvpKernel_Scalar;
+}
+
+const char* MvpBatch_KernelName(MvpKernel kernel)
+{
+    switch (kernel)
+    {
+    case MvpKernel_Avx2:   return "AVX2";
+    case MvpKernel_Avx512: return "AVX-512";
+    default:               return "scalar";
+    }
+}
+
+void MvpBatch_Compute(MvpKernel kernel, const float* const viewProj,
+                      const float* const x, const float* const y, const float* const z,
+                      uint32_t first, uint32_t count, void* const dst, size_t dstStride)
+{
+#if MVP_BATCH_X64
+    const int aligned = ((uintptr_t)dst & 63) == 0 && (dstStride & 63) == 0;
+    if (kernel == MvpKernel_Avx512 && aligned)
+    {
+        ComputeAvx512(viewProj, x, y, z, first, count, dst, dstStride);
+        return;
+    }
+    if (kernel == MvpKernel_Avx2 && aligned)
+    {
+        ComputeAvx2(viewProj, x, y, z, first, count, dst, dstStride);
+        return;
+    }
+#else
+    (void)kernel;
+#endif
+    ComputeScalar(viewProj, x, y, z, first, count, dst, dstStride);
+}
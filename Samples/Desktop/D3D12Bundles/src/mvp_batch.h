@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The position arrays given to MvpBatch_Compute are padded to a multiple of this many cities, and
+// 'first' is a multiple of it, so that the widest kernel can always load a whole block.
+#define MVP_BATCH_BLOCK 16
+
+typedef enum MvpKernel
+{
+    MvpKernel_Scalar,
+    MvpKernel_Avx2,
+    MvpKernel_Avx512,
+} MvpKernel;
+
+// Widest kernel both the CPU and the OS support.
+MvpKernel MvpBatch_DetectKernel(void);
+
+const char* MvpBatch_KernelName(MvpKernel kernel);
+
+/*
+ * Writes the transposed model-view-projection matrix of cities [first, first + count), for the shaders,
+ * to the first 64 bytes of dst + i * dstStride.
+ *
+ * The model matrix of a city is a translation by (x, y, z), so its MVP is viewProj with a new last row:
+ * only the last column of the transposed matrix differs between cities. The kernels compute that column
+ * for 8 (AVX2) or 16 (AVX-512) cities at once from the SoA positions, and write each matrix as one
+ * cache line with streaming stores: the destination is meant to be a write-combined upload heap, which
+ * must not be read and is best written whole lines at a time. The SIMD kernels need dst and dstStride
+ * aligned on 64 bytes.
+ *
+ * viewProj is row-major, for row vectors, as XMStoreFloat4x4 writes it.
+ */
+void MvpBatch_Compute(MvpKernel kernel, const float* const viewProj,
+                      const float* const x, const float* const y, const float* const z,
+                      uint32_t first, uint32_t count, void* const dst, size_t dstStride);
@@ -0,0 +1,126 @@
+/*************************************************************************************
+ MVP batch tests.
+
+ Runs every kernel the CPU supports on random view-projections and city positions,
+ and checks each matrix written against the transposed product of the city's
+ translation and the view-projection, computed here in double precision. Counts
+ that are not a multiple of the kernels' width, ranges starting past the first
+ block, and constant-buffer strides leave the bytes around each matrix untouched.
+ A destination or stride off the 64-byte alignment falls back to the scalar
+ kernel, with the same results.
+
+ Usage: MvpBatchTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "mvp_batch.h"
+#include "test_check.h"
+
+#define MAX_CITIES   (20 * MVP_BATCH_BLOCK)
+#define MAX_STRIDE   256
+#define GUARD_BYTE   0xCD
+
+static float s_x[MAX_CITIES], s_y[MAX_CITIES], s_z[MAX_CITIES];
+
+// Room for MAX_CITIES matrices at the largest stride, aligned by hand at run time.
+static uint8_t s_buffer[MAX_CITIES * MAX_STRIDE + 128];
+
+static void CheckBatch(MvpKernel kernel, const float* const viewProj, uint32_t first, uint32_t count,
+                       size_t offset, size_t stride)
+{
+    uint8_t* const dst = (uint8_t*)(((uintptr_t)s_buffer + 63) & ~(uintptr_t)63) + offset;
+    memset(s_buffer, GUARD_BYTE, sizeof(s_buffer));
+    MvpBatch_Compute(kernel, viewProj, s_x, s_y, s_z, first, count, dst, stride);
+
+    uint32_t badValues = 0, badGuards = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t city = first + i;
+        const double translation[4] = { s_x[city], s_y[city], s_z[city], 1.0 };
+
+        // Row r of the transposed MVP is column r of translation * viewProj.
+        float matrix[16];
+        memcpy(matrix, dst + i * stride, sizeof(matrix));
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                // Float rounding errs relative to the terms summed, which may cancel out.
+                double expected = viewProj[c * 4 + r], magnitude = fabs(expected);
+                if (c == 3)
+                {
+                    expected = magnitude = 0.0;
+                    for (uint32_t k = 0; k < 4; ++k)
+                    {
+                        expected += translation[k] * viewProj[k * 4 + r];
+                        magnitude += fabs(translation[k] * viewProj[k * 4 + r]);
+                    }
+                }
+                badValues += fabs(matrix[r * 4 + c] - expected) > 1e-6 * magnitude;
+            }
+        }
+
+        // The bytes between this matrix and the next one.
+        for (size_t b = sizeof(matrix); b < stride; ++b)
+        {
+            badGuards += dst[i * stride + b] != GUARD_BYTE;
+        }
+    }
+
+    // Nothing before the first matrix or past the last one.
+    for (uint8_t* b = s_buffer; b < dst; ++b)
+    {
+        badGuards += *b != GUARD_BYTE;
+    }
+    for (uint8_t* b = dst + count * stride; b < s_buffer + sizeof(s_buffer); ++b)
+    {
+        badGuards += *b != GUARD_BYTE;
+    }
+    CHECK(badValues == 0);
+    CHECK(badGuards == 0);
+}
+
+static void TestKernel(MvpKernel kernel)
+{
+    printf("%s kernel\n", MvpBatch_KernelName(kernel));
+    const uint32_t counts[] = { 0, 1, 7, 8, 9, 15, 16, 17, 33, 100, MAX_CITIES - 2 * MVP_BATCH_BLOCK };
+    const size_t strides[] = { 64, 128, MAX_STRIDE };
+    for (uint32_t t = 0; t < 20; ++t)
+    {
+        float viewProj[16];
+        for (uint32_t k = 0; k < 16; ++k)
+        {
+            viewProj[k] = TestRandomFloat(-2.0f, 2.0f);
+        }
+        for (uint32_t i = 0; i < MAX_CITIES; ++i)
+        {
+            s_x[i] = TestRandomFloat(-1000.0f, 1000.0f);
+            s_y[i] = TestRandomFloat(-10.0f, 10.0f);
+            s_z[i] = TestRandomFloat(-1000.0f, 1000.0f);
+        }
+
+        const uint32_t count = counts[t % _countof(counts)];
+        const uint32_t first = (t % 3) * MVP_BATCH_BLOCK;
+        for (uint32_t s = 0; s < (uint32_t)_countof(strides); ++s)
+        {
+            CheckBatch(kernel, viewProj, first, count, 0, strides[s]);
+        }
+
+        // Unaligned, the kernel falls back to the scalar one.
+        CheckBatch(kernel, viewProj, first, count, 16, 64);
+        CheckBatch(kernel, viewProj, first, count, 0, 80);
+    }
+}
+
+int main(void)
+{
+    // The kernels up to the widest one the CPU has.
+    const MvpKernel widest = MvpBatch_DetectKernel();
+    const MvpKernel kernels[] = { MvpKernel_Scalar, MvpKernel_Avx2, MvpKernel_Avx512 };
+    for (uint32_t k = 0; k < (uint32_t)_countof(kernels) && kernels[k] <= widest; ++k)
+    {
+        TestKernel(kernels[k]);
+    }
+    return TEST_RESULT();
+}
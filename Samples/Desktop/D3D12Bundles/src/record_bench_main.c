@@ -0,0 +1,316 @@
+/*************************************************************************************
+ Headless recording benchmark.
+
+ Submits the city draws to a render queue, as the sample does, and records them through
+ CityRecord_Run into a mock command list backend, which encodes every command into
+ memory instead of calling D3D12.
+
+ First it times the radix sort of the keys, checks it against qsort, and counts the
+ state sets of a single command list recorded from the keys in city order, as the
+ sample did before the queue, and from the sorted keys. Then it records the sorted keys
+ with 1 to maxThreads threads. For each thread count it prints the recording time and
+ its speedup over one thread, the pipeline sets, and checks that the chunks, executed in
+ order, draw the same cities with the same pipelines as a single command list, and that
+ every run writes the same bytes.
+
+ The cities drawn are a fixed pseudo-random 'visible' percent of 'cities', as culling
+ would leave them, at pseudo-random depths. No window and no GPU are needed: this builds
+ on Linux too.
+
+ Usage: RecordBench [cities] [iterations] [maxThreads] [visible]
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "city_record.h"
+#include "render_queue.h"
+#include "job_system.h"
+
+enum MockOp
+{
+    MockOp_Begin = 1,
+    MockOp_SetRootSignature,
+    MockOp_SetPipeline,
+    MockOp_SetDescriptorTable,
+    MockOp_Draw,
+    MockOp_End,
+};
+
+#define MOCK_COMMAND(op, argument) (((uint64_t)(op) << 32) | (uint32_t)(argument))
+#define MOCK_OP(command) ((uint32_t)((command) >> 32))
+#define MOCK_ARGUMENT(command) ((uint32_t)(command))
+
+// A cursor per chunk, a cache line each: the chunks are written by different threads.
+typedef struct MockChunk
+{
+    uint64_t* next;
+    uint8_t padding[64 - sizeof(uint64_t*)];
+} MockChunk;
+
+// CityRecorder writing each chunk's commands to its own range of 'commands': a draw takes at most
+// four commands, and a chunk two more for Begin and End.
+typedef struct MockRecorder
+{
+    CityRecorder base;
+    uint64_t* commands;
+    uint32_t cityCount;
+    uint32_t chunkCount;
+    MockChunk chunks[CITY_RECORD_MAX_CHUNKS];
+} MockRecorder;
+
+static uint64_t* MockChunkStart(const MockRecorder* const recorder, uint32_t chunk)
+{
+    return recorder->commands + 4 * (size_t)CityRecord_ChunkStart(recorder->cityCount, recorder->chunkCount, chunk) + 2 * (size_t)chunk;
+}
+
+static void MockRecorder_Begin(CityRecorder* const base, uint32_t chunk)
+{
+    MockRecorder* const recorder = (MockRecorder*)base;
+    recorder->chunks[chunk].next = MockChunkStart(recorder, chunk);
+    *recorder->chunks[chunk].next++ = MOCK_COMMAND(MockOp_Begin, chunk);
+}
+
+static void MockRecorder_SetRootSignature(CityRecorder* const base, uint32_t chunk, uint32_t rootSignature)
+{
+    MockRecorder* const recorder = (MockRecorder*)base;
+    *recorder->chunks[chunk].next++ = MOCK_COMMAND(MockOp_SetRootSignature, rootSignature);
+}
+
+static void MockRecorder_SetPipeline(CityRecorder* const base, uint32_t chunk, uint32_t pipeline)
+{
+    MockRecorder* const recorder = (MockRecorder*)base;
+    *recorder->chunks[chunk].next++ = MOCK_COMMAND(MockOp_SetPipeline, pipeline);
+}
+
+static void MockRecorder_SetDescriptorTable(CityRecorder* const base, uint32_t chunk, uint32_t descriptorTable)
+{
+    MockRecorder* const recorder = (MockRecorder*)base;
+    *recorder->chunks[chunk].next++ = MOCK_COMMAND(MockOp_SetDescriptorTable, descriptorTable);
+}
+
+static void MockRecorder_Draw(CityRecorder* const base, uint32_t chunk)
+{
+    MockRecorder* const recorder = (MockRecorder*)base;
+    *recorder->chunks[chunk].next++ = MOCK_COMMAND(MockOp_Draw, 0);
+}
+
+static void MockRecorder_End(CityRecorder* const base, uint32_t chunk)
+{
+    MockRecorder* const recorder = (MockRecorder*)base;
+    *recorder->chunks[chunk].next++ = MOCK_COMMAND(MockOp_End, chunk);
+}
+
+static const CityRecorderVtbl MockRecorderVtbl = {
+    .Begin = MockRecorder_Begin,
+    .SetRootSignature = MockRecorder_SetRootSignature,
+    .SetPipeline = MockRecorder_SetPipeline,
+    .SetDescriptorTable = MockRecorder_SetDescriptorTable,
+    .Draw = MockRecorder_Draw,
+    .End = MockRecorder_End,
+};
+
+/*
+ * Executes the chunks in order, as the command queue would, and writes each draw as its
+ * (pipeline, city) to 'draws'. Returns the number of draws, or UINT32_MAX if a chunk is not
+ * well formed or draws without binding a root signature, a pipeline and a city first: state
+ * doesn't carry over from one command list to the next, and a root signature drops the tables.
+ */
+static uint32_t ExecuteMock(const MockRecorder* const recorder, uint64_t* const draws)
+{
+    uint32_t drawCount = 0;
+    for (uint32_t chunk = 0; chunk < recorder->chunkCount; chunk++)
+    {
+        const uint64_t* command = MockChunkStart(recorder, chunk);
+        const uint64_t* const end = recorder->chunks[chunk].next;
+        if (command == end || *command != MOCK_COMMAND(MockOp_Begin, chunk) || end[-1] != MOCK_COMMAND(MockOp_End, chunk))
+        {
+            return UINT32_MAX;
+        }
+
+        uint32_t rootSignature = UINT32_MAX;
+        uint32_t pipeline = UINT32_MAX;
+        uint32_t city = UINT32_MAX;
+        for (command++; command < end - 1; command++)
+        {
+            switch (MOCK_OP(*command))
+            {
+            case MockOp_SetRootSignature:   rootSignature = MOCK_ARGUMENT(*command); city = UINT32_MAX; break;
+            case MockOp_SetPipeline:        pipeline = MOCK_ARGUMENT(*command); break;
+            case MockOp_SetDescriptorTable: city = MOCK_ARGUMENT(*command); break;
+            case MockOp_Draw:
+                if (rootSignature == UINT32_MAX || pipeline == UINT32_MAX || city == UINT32_MAX)
+                {
+                    return UINT32_MAX;
+                }
+                draws[drawCount++] = ((uint64_t)pipeline << 32) | city;
+                break;
+            default:
+                return UINT32_MAX;
+            }
+        }
+    }
+    return drawCount;
+}
+
+static int CompareKeys(const void* a, const void* b)
+{
+    const uint64_t left = *(const uint64_t*)a;
+    const uint64_t right = *(const uint64_t*)b;
+    return (left > right) - (left < right);
+}
+
+static double ElapsedMs(const struct timespec* const start, const struct timespec* const end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e3 + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t totalCities = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+    const uint32_t iterations = argc > 2 ? (uint32_t)atoi(argv[2]) : 20;
+    const uint32_t maxThreads = argc > 3 ? (uint32_t)atoi(argv[3]) : 8;
+    const uint32_t visiblePercent = argc > 4 ? (uint32_t)atoi(argv[4]) : 60;
+    if (totalCities == 0 || iterations == 0 || maxThreads == 0)
+    {
+        fprintf(stderr, "Usage: RecordBench [cities] [iterations] [maxThreads] [visible]\n");
+        return EXIT_FAILURE;
+    }
+
+    // The keys of the visible cities, in increasing city order, picked and placed by a fixed LCG. The
+    // pipeline follows the city's parity, as in the sample.
+    uint64_t* const cityKeys = malloc(sizeof(uint64_t) * totalCities);
+    uint64_t* const expectedKeys = malloc(sizeof(uint64_t) * totalCities);
+    RenderQueue queue;
+    if (!cityKeys || !expectedKeys || !RenderQueue_Init(&queue, totalCities))
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    uint32_t cityCount = 0;
+    uint32_t random = 12345;
+    for (uint32_t city = 0; city < totalCities; city++)
+    {
+        random = random * 1664525u + 1013904223u;
+        if ((random >> 8) % 100 < visiblePercent)
+        {
+            random = random * 1664525u + 1013904223u;
+            const float depth = (float)(random >> 8) / (float)(1u << 24);
+            cityKeys[cityCount++] = RenderKey_Make(0, city % 2, depth, city);
+        }
+    }
+
+    const size_t commandCapacity = 4 * (size_t)cityCount + 2 * CITY_RECORD_MAX_CHUNKS;
+    MockRecorder recorder = { .base.vtbl = &MockRecorderVtbl, .cityCount = cityCount };
+    recorder.commands = malloc(sizeof(uint64_t) * commandCapacity);
+    uint64_t* const firstRun = malloc(sizeof(uint64_t) * commandCapacity);
+    uint64_t* const referenceDraws = malloc(sizeof(uint64_t) * (cityCount + 1));
+    uint64_t* const draws = malloc(sizeof(uint64_t) * (cityCount + 1));
+    if (!recorder.commands || !firstRun || !referenceDraws || !draws)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%u of %u cities, %u iterations\n", cityCount, totalCities, iterations);
+
+    // The sort, from the keys in city order every time.
+    double sortMs = 0.0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        memcpy(queue.keys, cityKeys, sizeof(uint64_t) * cityCount);
+        queue.count = cityCount;
+        struct timespec start, end;
+        timespec_get(&start, TIME_UTC);
+        RenderQueue_Sort(&queue);
+        timespec_get(&end, TIME_UTC);
+        sortMs += ElapsedMs(&start, &end);
+    }
+    memcpy(expectedKeys, cityKeys, sizeof(uint64_t) * cityCount);
+    struct timespec qsortStart, qsortEnd;
+    timespec_get(&qsortStart, TIME_UTC);
+    qsort(expectedKeys, cityCount, sizeof(uint64_t), CompareKeys);
+    timespec_get(&qsortEnd, TIME_UTC);
+    const bool sorted = memcmp(queue.keys, expectedKeys, sizeof(uint64_t) * cityCount) == 0;
+    printf("radix sort %.3f ms, qsort %.3f ms, same keys: %s\n", sortMs / iterations,
+        ElapsedMs(&qsortStart, &qsortEnd), sorted ? "yes" : "NO");
+
+    // State sets of a single command list, before and after the sort.
+    JobSystem jobs;
+    JobSystem_Init(&jobs, 0);
+    recorder.chunkCount = 1;
+    CityRecordStats unsortedStats;
+    CityRecord_Run(&recorder.base, &jobs, cityKeys, cityCount, 1, &unsortedStats);
+    CityRecordStats sortedStats;
+    CityRecord_Run(&recorder.base, &jobs, queue.keys, cityCount, 1, &sortedStats);
+    JobSystem_Destroy(&jobs);
+    printf("state sets   root signature  pipeline  descriptor table  draws\n");
+    printf("city order %16u %9u %17u %6u\n", unsortedStats.rootSignatureSets, unsortedStats.pipelineSets,
+        unsortedStats.descriptorTableSets, unsortedStats.draws);
+    printf("sorted     %16u %9u %17u %6u\n", sortedStats.rootSignatureSets, sortedStats.pipelineSets,
+        sortedStats.descriptorTableSets, sortedStats.draws);
+
+    // The reference: the sorted keys in a single command list, as recorded on one thread.
+    const uint32_t referenceDrawCount = ExecuteMock(&recorder, referenceDraws);
+    if (referenceDrawCount != cityCount)
+    {
+        fprintf(stderr, "The single command list doesn't draw every city\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("threads chunks    ms/record  speedup  pipeline sets  same draws  same bytes\n");
+
+    bool allPassed = sorted;
+    double singleThreadMs = 0.0;
+    for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount++)
+    {
+        if (!JobSystem_Init(&jobs, threadCount - 1))
+        {
+            fprintf(stderr, "Failed to start %u threads\n", threadCount);
+            return EXIT_FAILURE;
+        }
+        recorder.chunkCount = CityRecord_ChunkCount(cityCount, threadCount);
+
+        // One run to warm up and to compare the next ones with. The ranges of the chunks have gaps
+        // where a state isn't set again: they are cleared before every run.
+        memset(recorder.commands, 0, sizeof(uint64_t) * commandCapacity);
+        CityRecordStats stats;
+        CityRecord_Run(&recorder.base, &jobs, queue.keys, cityCount, recorder.chunkCount, &stats);
+        const uint32_t drawCount = ExecuteMock(&recorder, draws);
+        const bool sameDraws = drawCount == referenceDrawCount && memcmp(draws, referenceDraws, sizeof(uint64_t) * drawCount) == 0;
+        memcpy(firstRun, recorder.commands, sizeof(uint64_t) * commandCapacity);
+
+        bool sameBytes = true;
+        double totalMs = 0.0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            memset(recorder.commands, 0, sizeof(uint64_t) * commandCapacity);
+            struct timespec start, end;
+            timespec_get(&start, TIME_UTC);
+            CityRecord_Run(&recorder.base, &jobs, queue.keys, cityCount, recorder.chunkCount, NULL);
+            timespec_get(&end, TIME_UTC);
+            totalMs += ElapsedMs(&start, &end);
+            sameBytes = sameBytes && memcmp(firstRun, recorder.commands, sizeof(uint64_t) * commandCapacity) == 0;
+        }
+        JobSystem_Destroy(&jobs);
+
+        const double ms = totalMs / iterations;
+        if (threadCount == 1)
+        {
+            singleThreadMs = ms;
+        }
+        printf("%7u %6u %12.3f %8.2f %14u  %10s  %10s\n", threadCount, recorder.chunkCount, ms, singleThreadMs / ms,
+            stats.pipelineSets, sameDraws ? "yes" : "NO", sameBytes ? "yes" : "NO");
+        allPassed = allPassed && sameDraws && sameBytes;
+    }
+
+    RenderQueue_Destroy(&queue);
+    free(cityKeys);
+    free(expectedKeys);
+    free(recorder.commands);
+    free(firstRun);
+    free(referenceDraws);
+    free(draws);
+    return allPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
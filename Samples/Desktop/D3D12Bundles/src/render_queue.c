@@ -0,0 +1,88 @@
+#include "render_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RADIX_BYTES 8
+#define RADIX_BUCKETS 256
+
+/*************************************************************************************
+ Public functions
+**************************************************************************************/
+
+bool RenderQueue_Init(RenderQueue* const queue, uint32_t capacity)
+{
+    *queue = (RenderQueue){ 0 };
+    // Both buffers in one allocation, at least one key each.
+    const size_t keyCount = capacity > 0 ? capacity : 1;
+    queue->keys = malloc(sizeof(uint64_t) * keyCount * 2);
+    if (!queue->keys)
+    {
+        return false;
+    }
+    queue->scratch = queue->keys + keyCount;
+    queue->capacity = capacity;
+    return true;
+}
+
+void RenderQueue_Destroy(RenderQueue* const queue)
+{
+    // keys and scratch may have been swapped by a sort: the allocation starts at the lower one.
+    free(queue->keys < queue->scratch ? queue->keys : queue->scratch);
+    *queue = (RenderQueue){ 0 };
+}
+
+void RenderQueue_Sort(RenderQueue* const queue)
+{
+    const uint32_t count = queue->count;
+    if (count < 2)
+    {
+        return;
+    }
+
+    uint32_t histograms[RADIX_BYTES][RADIX_BUCKETS];
+    memset(histograms, 0, sizeof(histograms));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint64_t key = queue->keys[i];
+        for (uint32_t byte = 0; byte < RADIX_BYTES; byte++)
+        {
+            histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+        }
+    }
+
+    uint64_t* source = queue->keys;
+    uint64_t* destination = queue->scratch;
+    for (uint32_t byte = 0; byte < RADIX_BYTES; byte++)
+    {
+        uint32_t* const histogram = histograms[byte];
+
+        // Every key has the same value for this byte: the pass would not move anything.
+        if (histogram[(source[0] >> (byte * 8)) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        // Counts to offsets.
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+        {
+            const uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint64_t key = source[i];
+            destination[histogram[(key >> (byte * 8)) & 0xFF]++] = key;
+        }
+
+        uint64_t* const swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    // The sorted keys are in 'source', which is either buffer.
+    queue->keys = source;
+    queue->scratch = destination;
+}
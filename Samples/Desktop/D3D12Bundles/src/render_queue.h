@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * 64-bit draw sort key, from the most significant bits down:
+ *
+ *   root signature    4 bits   Most expensive to change: it resets every binding
+ *   pipeline          8 bits
+ *   depth            20 bits   Front to back, for early depth rejection
+ *   descriptor table 32 bits   Which table to bind: the payload of the draw
+ *
+ * Sorting the keys groups the draws by state, so that emitting them in order only sets a
+ * state when it changes.
+ */
+#define RENDER_KEY_DEPTH_BITS 20
+
+static inline uint64_t RenderKey_Make(uint32_t rootSignature, uint32_t pipeline, float depth, uint32_t descriptorTable)
+{
+    // 'depth' in [0, 1], as clip space z / w.
+    const float clamped = depth > 0.0f ? (depth < 1.0f ? depth : 1.0f) : 0.0f;
+    const uint64_t quantized = (uint64_t)(clamped * (float)((1u << RENDER_KEY_DEPTH_BITS) - 1));
+    return ((uint64_t)(rootSignature & 0xF) << 60) | ((uint64_t)(pipeline & 0xFF) << 52) | (quantized << 32) | descriptorTable;
+}
+
+static inline uint32_t RenderKey_RootSignature(uint64_t key)   { return (uint32_t)(key >> 60); }
+static inline uint32_t RenderKey_Pipeline(uint64_t key)        { return (uint32_t)(key >> 52) & 0xFF; }
+static inline uint32_t RenderKey_DescriptorTable(uint64_t key) { return (uint32_t)key; }
+
+typedef struct RenderQueue
+{
+    uint64_t* keys;
+    uint64_t* scratch;      // The other half of the radix sort's ping-pong
+    uint32_t count;
+    uint32_t capacity;
+} RenderQueue;
+
+bool RenderQueue_Init    (RenderQueue* const queue, uint32_t capacity);
+void RenderQueue_Destroy (RenderQueue* const queue);
+
+static inline void RenderQueue_Clear(RenderQueue* const queue)
+{
+    queue->count = 0;
+}
+
+// The queue must have room for it: a frame never submits more draws than the capacity.
+static inline void RenderQueue_Push(RenderQueue* const queue, uint64_t key)
+{
+    queue->keys[queue->count++] = key;
+}
+
+/*
+ * Sorts the keys in increasing order: LSD radix sort on bytes, stable. One pass over the keys
+ * builds the histograms of all eight bytes, and the bytes every key shares (a single root
+ * signature, the high bytes of the tables) are skipped, so a frame usually takes 4 to 6 passes.
+ */
+void RenderQueue_Sort(RenderQueue* const queue);
@@ -0,0 +1,152 @@
+/*************************************************************************************
+ Render queue tests.
+
+ Checks that keys order draws by root signature, then pipeline, then depth, then
+ city (the descriptor table), each field deciding only when the ones above it are
+ equal, and that every field reads back masked to its width. Depths below 0, NaN
+ included, quantize to 0 and depths above 1 to the largest value; increasing
+ depths never quantize lower. Sorts queues of 0 to 5000 keys, with all bytes
+ random or most of them shared, and compares them with qsort; a queue is sorted
+ twice and destroyed after its buffers may have swapped.
+
+ Usage: RenderQueueTest
+**************************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render_queue.h"
+#include "test_check.h"
+
+#define MAX_KEYS  5000
+#define MAX_DEPTH ((1u << RENDER_KEY_DEPTH_BITS) - 1)
+
+static uint64_t s_expected[MAX_KEYS];
+
+static uint32_t KeyDepth(uint64_t key)
+{
+    return (uint32_t)(key >> 32) & MAX_DEPTH;
+}
+
+static int CompareKeys(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void TestDepth(void)
+{
+    // Out of [0, 1], clamped to the ends.
+    const float below[] = { -0.0f, -1e-7f, -0.5f, -1.0f, -1e30f, -INFINITY, NAN };
+    const float above[] = { 1.0f, 1.0f + 1e-7f, 1.5f, 2.0f, 1e30f, INFINITY };
+    uint32_t badBelow = 0, badAbove = 0;
+    for (uint32_t i = 0; i < (uint32_t)_countof(below); ++i)
+    {
+        badBelow += KeyDepth(RenderKey_Make(3, 7, below[i], 11)) != 0;
+    }
+    for (uint32_t i = 0; i < (uint32_t)_countof(above); ++i)
+    {
+        badAbove += KeyDepth(RenderKey_Make(3, 7, above[i], 11)) != MAX_DEPTH;
+    }
+    CHECK(badBelow == 0);
+    CHECK(badAbove == 0);
+
+    // Increasing depths never quantize lower, and each step of 1 / MAX_DEPTH lands on its value or the one below.
+    uint32_t decreasing = 0, badSteps = 0;
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i <= 10000; ++i)
+    {
+        const uint32_t depth = KeyDepth(RenderKey_Make(0, 0, (float)i / 10000.0f, 0));
+        decreasing += depth < previous;
+        previous = depth;
+    }
+    for (uint32_t step = 0; step <= MAX_DEPTH; step += 4093)
+    {
+        const uint32_t depth = KeyDepth(RenderKey_Make(0, 0, (float)step / (float)MAX_DEPTH, 0));
+        badSteps += depth + 1 < step || depth > step;
+    }
+    CHECK(decreasing == 0);
+    CHECK(badSteps == 0);
+}
+
+// Makes a key from its fields, root signature first; the depth is given as the value it quantizes to,
+// aimed at the middle of its step.
+static uint64_t MakeKey(const uint32_t fields[4])
+{
+    return RenderKey_Make(fields[0], fields[1], ((float)fields[2] + 0.5f) / (float)MAX_DEPTH, fields[3]);
+}
+
+static void TestFields(void)
+{
+    // Each field reads back, masked to its width without spilling into the others.
+    uint32_t badFields = 0;
+    for (uint32_t t = 0; t < 20000; ++t)
+    {
+        const uint32_t rootSignature = TestRandom() & 0x1F, pipeline = TestRandom() & 0x1FF;
+        const uint32_t table = TestRandom() ^ (TestRandom() << 16);
+        const uint64_t key = RenderKey_Make(rootSignature, pipeline, TestRandomFloat(-0.5f, 1.5f), table);
+        badFields += RenderKey_RootSignature(key) != (rootSignature & 0xF) || RenderKey_Pipeline(key) != (pipeline & 0xFF) ||
+                     RenderKey_DescriptorTable(key) != table;
+    }
+    CHECK(badFields == 0);
+
+    // Two keys equal above one field and ordered by it: the fields below cannot reverse the order,
+    // even at their largest in the lower key and at 0 in the higher one.
+    const uint32_t widest[4] = { 0xF, 0xFF, MAX_DEPTH, UINT32_MAX };
+    uint32_t badOrder = 0;
+    for (uint32_t t = 0; t < 20000; ++t)
+    {
+        const uint32_t field = t % 4;
+        uint32_t lower[4], higher[4];
+        for (uint32_t f = 0; f < 4; ++f)
+        {
+            const uint32_t random = (TestRandom() ^ (TestRandom() << 16)) % ((uint64_t)widest[f] + 1);
+            lower[f] = f < field ? random : f == field ? random % widest[f] : widest[f];
+            higher[f] = f < field ? random : f == field ? lower[f] + 1 + TestRandom() % (widest[f] - lower[f]) : 0;
+        }
+        badOrder += MakeKey(lower) >= MakeKey(higher);
+    }
+    CHECK(badOrder == 0);
+}
+
+static void CheckSort(RenderQueue* const queue, uint32_t count, uint64_t mask)
+{
+    RenderQueue_Clear(queue);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint64_t key = (((uint64_t)TestRandom() << 40) ^ ((uint64_t)TestRandom() << 20) ^ TestRandom()) & mask;
+        RenderQueue_Push(queue, key);
+        s_expected[i] = key;
+    }
+    qsort(s_expected, count, sizeof(uint64_t), CompareKeys);
+    RenderQueue_Sort(queue);
+    CHECK(queue->count == count);
+    CHECK(memcmp(queue->keys, s_expected, count * sizeof(uint64_t)) == 0);
+}
+
+static void TestSort(void)
+{
+    // Every byte distinct, then the sample's keys: one root signature, two pipelines and few cities.
+    const uint64_t masks[] = { ~0ull, 0x0010FFFF0000FFFFull, 0xFF00000000000000ull, 0 };
+    const uint32_t counts[] = { 0, 1, 2, 3, 255, 256, 257, 1000, MAX_KEYS };
+    for (uint32_t m = 0; m < (uint32_t)_countof(masks); ++m)
+    {
+        for (uint32_t c = 0; c < (uint32_t)_countof(counts); ++c)
+        {
+            RenderQueue queue;
+            CHECK(RenderQueue_Init(&queue, counts[c]));
+            CheckSort(&queue, counts[c], masks[m]);
+            CheckSort(&queue, counts[c] / 2, masks[m]);
+            RenderQueue_Destroy(&queue);
+            CHECK(queue.keys == NULL && queue.count == 0);
+        }
+    }
+}
+
+int main(void)
+{
+    TestDepth();
+    TestFields();
+    TestSort();
+    return TEST_RESULT();
+}
@@ -47,11 +47,29 @@ void Sample_Init(DXSample* const sample) {
 	sample->rtvDescriptorSize = 0;
 	sample->currentFrameResourceIndex = 0;
 	sample->currFrameResource = NULL;
+	if (sample->cityRowCount == 0 || sample->cityColumnCount == 0 ||
+		(UINT64)sample->cityRowCount * sample->cityColumnCount > MaxCityCount)
+	{
+		sample->cityRowCount = DefaultCityRowCount;
+		sample->cityColumnCount = DefaultCityColumnCount;
+	}
+	const UINT64 cityDescriptorCount = (UINT64)FrameCount * sample->cityRowCount * sample->cityColumnCount + 1;
+	sample->cityDescriptors = cityDescriptorCount <= D3D12_MAX_SHADER_VISIBLE_DESCRIPTOR_HEAP_SIZE_TIER_1;
+	sample->renderMode = sample->cityDescriptors ? DefaultRenderMode : RenderMode_Instanced;
 	GetCurrentPath(sample->assetsPath, _countof(sample->assetsPath));
 
 	StepTimer_Init(&sample->timer);
 	sample->camera = SimpleCamera_Spawn((XMFLOAT3) { 8, 8, 30 });
 
+	// One worker per core besides this thread.
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	if (!JobSystem_Init(&sample->jobs, info.dwNumberOfProcessors > 1 ? info.dwNumberOfProcessors - 1 : 0)) LogAndExit(E_FAIL);
+	sample->mvpKernel = MvpBatch_DetectKernel();
+	char message[64];
+	sprintf_s(message, sizeof(message), "MVP kernel: %s\n", MvpBatch_KernelName(sample->mvpKernel));
+	OutputDebugStringA(message);
+
 	LoadPipeline(sample);
 	LoadAssets(sample);
 }
@@ -83,6 +101,7 @@ void Sample_Destroy(DXSample* const sample)
 		HeapFree(GetProcessHeap(), 0, sample->frameResources[i]);
 	}
 
+	JobSystem_Destroy(&sample->jobs);
 	ReleaseAll(sample);
 }
 
@@ -92,8 +111,11 @@ void Sample_Update(DXSample* const sample) {
 	if (sample->frameCounter == 50)
 	{
 		// Update window text with FPS value.
-		wchar_t fps[64];
-		swprintf_s(fps, 64, L"%ufps", sample->timer.framesPerSecond);
+		wchar_t fps[96];
+		static const wchar_t* const modeNames[RenderMode_Count] = { L"direct", L"bundles", L"instanced" };
+		swprintf_s(fps, 96, L"%ufps, %u/%u cities, %s, %u PSO sets", sample->timer.framesPerSecond,
+			sample->currFrameResource ? sample->currFrameResource->visibleCityCount : 0, sample->cityRowCount * sample->cityColumnCount,
+			modeNames[sample->renderMode], sample->currFrameResource ? sample->currFrameResource->recordStats.pipelineSets : 0);
 		SetWindowTextW(G_HWND, fps);
 		sample->frameCounter = 0;
 	}
@@ -121,18 +143,65 @@ void Sample_Update(DXSample* const sample) {
 	SimpleCamera_Update(&sample->camera, TicksToSeconds(sample->timer.elapsedTicks));
 	XMMATRIX viewMatrix = SimpleCamera_GetViewMatrix(sample->camera.position, sample->camera.lookDirection, sample->camera.upDirection);
 	XMMATRIX projMatrix = SimpleCamera_GetProjectionMatrix(0.8f, sample->aspectRatio, 1.0f, 1000.0f);
-	FrameResource_UpdateConstantBuffers(sample->currFrameResource, &viewMatrix, &projMatrix);
+	FrameResource_SetView(sample->currFrameResource, &viewMatrix, &projMatrix);
+
+	// Cull the cities against the frustum, and record the bundle again if the culled cities no longer
+	// match it. The GPU is done with this frame resource, bundle included.
+	CityFrustum frustum;
+	CityCull_ExtractFrustum((const float*)&sample->currFrameResource->viewProj, &frustum);
+	FrameResource_CullCities(sample->currFrameResource, &frustum, &sample->cityBounds);
+	if (sample->renderMode == RenderMode_Bundles && FrameResource_IsBundleStale(sample->currFrameResource))
+	{
+		FrameResource_RecordBundle(sample->currFrameResource,
+			&sample->jobs,
+			&frustum,
+			&sample->cityBounds,
+			sample->pipelineState1,
+			sample->pipelineState2,
+			sample->currentFrameResourceIndex,
+			sample->numIndices,
+			&sample->indexBufferView,
+			&sample->vertexBufferView,
+			sample->cbvSrvHeap,
+			sample->cbvSrvDescriptorSize,
+			sample->samplerHeap,
+			sample->rootSignature);
+	}
+
+	// The MVPs of the cities drawn, the bundle's included: those it draws off screen still have to be current.
+	FrameResource_UpdateConstantBuffers(sample->currFrameResource, &sample->jobs, sample->mvpKernel,
+		sample->renderMode == RenderMode_Bundles);
 }
 
 void Sample_Render(DXSample* const sample)
 {
 	PopulateCommandList(sample);
 
-	ID3D12CommandList* asCommandList = NULL;
-	CAST(sample->commandList, asCommandList);
-	ID3D12CommandList* ppCommandLists[] = { asCommandList };
-	ID3D12CommandQueue_ExecuteCommandLists(sample->commandQueue, _countof(ppCommandLists), ppCommandLists);
-	RELEASE(asCommandList);
+	// In direct mode the cities are drawn by the command lists the workers recorded, in order, between
+	// the clear and the transition to present.
+	ID3D12GraphicsCommandList* commandLists[CITY_RECORD_MAX_CHUNKS + 2];
+	UINT commandListCount = 0;
+	commandLists[commandListCount++] = sample->commandList;
+	if (sample->renderMode == RenderMode_Direct)
+	{
+		for (UINT i = 0; i < sample->currFrameResource->cityCommandListCount; i++)
+		{
+			commandLists[commandListCount++] = sample->currFrameResource->cityCommandLists[i];
+		}
+		commandLists[commandListCount++] = sample->presentCommandList;
+	}
+
+	ID3D12CommandList* ppCommandLists[CITY_RECORD_MAX_CHUNKS + 2];
+	for (UINT i = 0; i < commandListCount; i++)
+	{
+		ppCommandLists[i] = NULL;
+		CAST(commandLists[i], ppCommandLists[i]);
+	}
+	ID3D12CommandQueue_ExecuteCommandLists(sample->commandQueue, commandListCount, ppCommandLists);
+	for (UINT i = 0; i < commandListCount; i++)
+	{
+		RELEASE(ppCommandLists[i]);
+	}
 
 	// Present and update the frame index for the next frame.
 	HRESULT hr = IDXGISwapChain3_Present(sample->swapChain, 1, 0);
@@ -148,6 +217,10 @@ void Sample_Render(DXSample* const sample)
 
 void Sample_OnKeyDown(DXSample* const sample, UINT8 key) {
 	SimpleCamera_OnKeyDown(&sample->camera, key);
+	if (key == 'M' && sample->cityDescriptors)
+	{
+		sample->renderMode = (RenderMode)((sample->renderMode + 1) % RenderMode_Count);
+	}
 }
 
 void Sample_OnKeyUp(DXSample* const sample, UINT8 key) {
@@ -262,7 +335,7 @@ static void LoadPipeline(DXSample* const sample)
 		// SRV and CBV
 		D3D12_DESCRIPTOR_HEAP_DESC cbvSrvHeapDesc = {
 			.NumDescriptors =
-				FrameCount * CityRowCount * CityColumnCount        // FrameCount frames * CityRowCount * CityColumnCount.
+				(sample->cityDescriptors ? FrameCount * sample->cityRowCount * sample->cityColumnCount : 0) // FrameCount frames * cities, unless only instancing.
 				+ 1,                                               // + 1 for the SRV
 			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
 			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE
@@ -317,10 +390,17 @@ static void LoadAssets(DXSample* const sample)
 			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND)
 		};
 
-		D3D12_ROOT_PARAMETER1 rootParameters[3] = {
-			CD3DX12_ROOT_PARAMETER1_AsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL),
-			CD3DX12_ROOT_PARAMETER1_AsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL),
-			CD3DX12_ROOT_PARAMETER1_AsDescriptorTable(1, &ranges[2], D3D12_SHADER_VISIBILITY_ALL)
+		// The last three parameters are for the instanced draws: the constant buffers of all cities
+		// as a structured buffer, the cities to draw, and the first instance of the draw.
+		D3D12_ROOT_PARAMETER1 rootParameters[RootParameter_Count] = {
+			[RootParameter_Texture] = CD3DX12_ROOT_PARAMETER1_AsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL),
+			[RootParameter_Sampler] = CD3DX12_ROOT_PARAMETER1_AsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL),
+			[RootParameter_CityConstants] = CD3DX12_ROOT_PARAMETER1_AsDescriptorTable(1, &ranges[2], D3D12_SHADER_VISIBILITY_ALL),
+			[RootParameter_CityMvps] = CD3DX12_ROOT_PARAMETER1_AsShaderResourceView(/* register(t1) */ 1, 0,
+			D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_VERTEX),
+			[RootParameter_InstanceCities] = CD3DX12_ROOT_PARAMETER1_AsShaderResourceView(/* register(t2) */ 2, 0,
+			D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_VERTEX),
+			[RootParameter_FirstInstance] = CD3DX12_ROOT_PARAMETER1_AsConstants(1, /* register(b1) */ 1, 0, D3D12_SHADER_VISIBILITY_VERTEX)
 		};
 
 		const D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc = {
@@ -347,14 +427,17 @@ static void LoadAssets(DXSample* const sample)
 	/* Create the pipeline state, which includes loading shaders */
 	{
 		UINT8* pVertexShaderData;
+		UINT8* pInstancedVertexShaderData;
 		UINT8* pPixelShaderData1;
 		UINT8* pPixelShaderData2;
 		UINT vertexShaderDataLength;
+		UINT instancedVertexShaderDataLength;
 		UINT pixelShaderDataLength1;
 		UINT pixelShaderDataLength2;
 
 		/* Load pre-compiled shaders */
 		LoadShaderData(sample->assetsPath, L"shaders/shader_mesh_simple_vert.cso", &pVertexShaderData, &vertexShaderDataLength);
+		LoadShaderData(sample->assetsPath, L"shaders/shader_mesh_instanced_vert.cso", &pInstancedVertexShaderData, &instancedVertexShaderDataLength);
 		LoadShaderData(sample->assetsPath, L"shaders/shader_mesh_simple_pixel.cso", &pPixelShaderData1, &pixelShaderDataLength1);
 		LoadShaderData(sample->assetsPath, L"shaders/shader_mesh_alt_pixel.cso", &pPixelShaderData2, &pixelShaderDataLength2);
 
@@ -399,7 +482,25 @@ static void LoadAssets(DXSample* const sample)
 		if (FAILED(hr)) LogAndExit(hr);
 		NAME_D3D12_OBJECT(sample->pipelineState2);
 
+		// And the same two with the instanced vertex shader.
+		psoDesc.VS = (D3D12_SHADER_BYTECODE){
+				.pShaderBytecode = pInstancedVertexShaderData,
+				.BytecodeLength = instancedVertexShaderDataLength,
+		};
+		hr = ID3D12Device_CreateGraphicsPipelineState(sample->device, &psoDesc, __IID(&sample->instancedPipelineState2), (void**)&sample->instancedPipelineState2);
+		if (FAILED(hr)) LogAndExit(hr);
+		NAME_D3D12_OBJECT(sample->instancedPipelineState2);
+
+		psoDesc.PS = (D3D12_SHADER_BYTECODE){
+				.pShaderBytecode = pPixelShaderData1,
+				.BytecodeLength = pixelShaderDataLength1,
+		};
+		hr = ID3D12Device_CreateGraphicsPipelineState(sample->device, &psoDesc, __IID(&sample->instancedPipelineState1), (void**)&sample->instancedPipelineState1);
+		if (FAILED(hr)) LogAndExit(hr);
+		NAME_D3D12_OBJECT(sample->instancedPipelineState1);
+
 		CleanAllocatedDataFromFile(pVertexShaderData);
+		CleanAllocatedDataFromFile(pInstancedVertexShaderData);
 		CleanAllocatedDataFromFile(pPixelShaderData1);
 		CleanAllocatedDataFromFile(pPixelShaderData2);
 	}
@@ -415,6 +516,18 @@ static void LoadAssets(DXSample* const sample)
 	if (FAILED(hr)) LogAndExit(hr);
 	NAME_D3D12_OBJECT(sample->commandList);
 
+	hr = ID3D12Device_CreateCommandList(sample->device,
+		0,
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		sample->commandAllocator,
+		NULL, 
+		__IID(&sample->presentCommandList),
+		(void**)&sample->presentCommandList);
+	if (FAILED(hr)) LogAndExit(hr);
+	NAME_D3D12_OBJECT(sample->presentCommandList);
+	hr = ID3D12GraphicsCommandList_Close(sample->presentCommandList);
+	if (FAILED(hr)) LogAndExit(hr);
+
 	// Create render target views (RTVs).
 	D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
 	ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(sample->rtvHeap, &rtvHandle);
@@ -613,6 +726,12 @@ static void LoadAssets(DXSample* const sample)
 		ID3D12Device_CreateShaderResourceView(sample->device, sample->texture, &srvDesc, cbvSrvHandle);
 	}
 
+	// Every city draws the same mesh: one box, offset by the city position, bounds them all.
+	CityCull_ComputeBounds(pMeshData + SampleAssets_VERTEX_DATA_OFFSET,
+		SampleAssets_VERTEX_DATA_SIZE / SampleAssets_STANDARD_VERTEX_STRIDE,
+		SampleAssets_STANDARD_VERTEX_STRIDE,
+		&sample->cityBounds);
+
 	CleanAllocatedDataFromFile(pMeshData);
 
 	// Create the depth stencil view.
@@ -738,16 +857,39 @@ static void PopulateCommandList(DXSample* const sample)
 	ID3D12GraphicsCommandList_ClearRenderTargetView(sample->commandList, rtvCPUHandle, clearColor, 0, NULL);
 	ID3D12GraphicsCommandList_ClearDepthStencilView(sample->commandList, dsvCPUHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, NULL);
 
-	if (UseBundles)
+	if (sample->renderMode == RenderMode_Bundles)
 	{
-		// Execute the prebuilt bundle.
-		ID3D12GraphicsCommandList_ExecuteBundle(sample->commandList, sample->currFrameResource->bundle);
+		// Execute the prebuilt bundles, in order.
+		// Their cities cover the visible ones: FrameResource_IsBundleStale is checked in Sample_Update.
+		for (UINT i = 0; i < sample->currFrameResource->bundleCount; i++)
+		{
+			ID3D12GraphicsCommandList_ExecuteBundle(sample->commandList, sample->currFrameResource->bundles[i]);
+		}
 	}
-	else
+	else if (sample->renderMode == RenderMode_Instanced)
 	{
-		// Populate a new command list.
-		FrameResource_PopulateCommandList(sample->currFrameResource,
+		// Two instanced draws, whatever the number of cities.
+		FrameResource_PopulateInstanced(sample->currFrameResource,
 			sample->commandList,
+			sample->instancedPipelineState1,
+			sample->instancedPipelineState2,
+			sample->numIndices,
+			&sample->indexBufferView,
+			&sample->vertexBufferView,
+			sample->cbvSrvHeap,
+			sample->samplerHeap,
+			sample->rootSignature
+		);
+	}
+	else
+	{
+		// Record new command lists for the cities on the job system, one per worker, and close the
+		// frame in another list executed after them.
+		hr = ID3D12GraphicsCommandList_Close(sample->commandList);
+		if (FAILED(hr)) LogAndExit(hr);
+
+		FrameResource_RecordCommandLists(sample->currFrameResource,
+			&sample->jobs,
 			sample->pipelineState1,
 			sample->pipelineState2,
 			sample->currentFrameResourceIndex,
@@ -757,16 +899,25 @@ static void PopulateCommandList(DXSample* const sample)
 			sample->cbvSrvHeap,
 			sample->cbvSrvDescriptorSize,
 			sample->samplerHeap,
-			sample->rootSignature
+			sample->rootSignature,
+			&rtvCPUHandle,
+			&dsvCPUHandle,
+			&sample->viewport,
+			&sample->scissorRect
 		);
+
+		// The allocator can back another command list now that the first one is closed.
+		hr = ID3D12GraphicsCommandList_Reset(sample->presentCommandList, sample->currFrameResource->commandAllocator, NULL);
+		if (FAILED(hr)) LogAndExit(hr);
 	}
+	ID3D12GraphicsCommandList* const lastCommandList = sample->renderMode == RenderMode_Direct ? sample->presentCommandList : sample->commandList;
 
 	// Indicate that the back buffer will now be used to present.
 	const D3D12_RESOURCE_BARRIER transitionBarrierRTtoPresent = CD3DX12_DefaultTransition(sample->renderTargets[sample->frameIndex],
 		D3D12_RESOURCE_STATE_RENDER_TARGET,
 		D3D12_RESOURCE_STATE_PRESENT);
-	ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &transitionBarrierRTtoPresent);
-	hr = ID3D12GraphicsCommandList_Close(sample->commandList);
+	ID3D12GraphicsCommandList_ResourceBarrier(lastCommandList, 1, &transitionBarrierRTtoPresent);
+	hr = ID3D12GraphicsCommandList_Close(lastCommandList);
 	if (FAILED(hr)) LogAndExit(hr);
 }
 
@@ -782,12 +933,18 @@ static void CreateFrameResources(DXSample* const sample)
 	for (UINT frame = 0; frame < FrameCount; frame++)
 	{
 		FrameResource* pFrameResource = HeapAlloc(GetProcessHeap(), 0, sizeof(FrameResource));
-		FrameResource_Init(pFrameResource, sample->device, CityRowCount, CityColumnCount);
+		FrameResource_Init(pFrameResource, sample->device, sample->cityRowCount, sample->cityColumnCount,
+			CityRecord_ChunkCount(sample->cityRowCount * sample->cityColumnCount, sample->jobs.threadCount + 1));
+		sample->frameResources[frame] = pFrameResource;
+		if (!sample->cityDescriptors)
+		{
+			continue;
+		}
 
 		UINT64 cbOffset = 0;
-		for (UINT row = 0; row < CityRowCount; row++)
+		for (UINT row = 0; row < sample->cityRowCount; row++)
 		{
-			for (UINT col = 0; col < CityColumnCount; col++)
+			for (UINT col = 0; col < sample->cityColumnCount; col++)
 			{
 				D3D12_GPU_VIRTUAL_ADDRESS gpuVirtualAddress = ID3D12Resource_GetGPUVirtualAddress(pFrameResource->cbvUploadHeap);
 				// Describe and create a constant buffer view (CBV).
@@ -801,7 +958,7 @@ static void CreateFrameResources(DXSample* const sample)
 			}
 		}
 		FrameResource_InitBundle(pFrameResource,
-			sample->device,
+			&sample->jobs,
 			sample->pipelineState1,
 			sample->pipelineState2,
 			frame,
@@ -812,8 +969,6 @@ static void CreateFrameResources(DXSample* const sample)
 			sample->cbvSrvDescriptorSize,
 			sample->samplerHeap,
 			sample->rootSignature);
-
-		sample->frameResources[frame] = pFrameResource;
 	}
 }
 
@@ -835,6 +990,7 @@ static void ReleaseAll(DXSample* const sample)
 	}
 	RELEASE(sample->depthStencil);
 	RELEASE(sample->commandList);
+	RELEASE(sample->presentCommandList);
 	RELEASE(sample->commandQueue);
 	RELEASE(sample->commandAllocator);
 	RELEASE(sample->rootSignature);
@@ -844,6 +1000,8 @@ static void ReleaseAll(DXSample* const sample)
 	RELEASE(sample->samplerHeap);
 	RELEASE(sample->pipelineState1);
 	RELEASE(sample->pipelineState2);
+	RELEASE(sample->instancedPipelineState1);
+	RELEASE(sample->instancedPipelineState2);
 	RELEASE(sample->vertexBuffer);
 	RELEASE(sample->indexBuffer);
 	RELEASE(sample->texture);
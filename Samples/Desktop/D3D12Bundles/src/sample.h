@@ -5,11 +5,26 @@
 #include <d3d12.h>
 #include "simple_camera.h"
 #include "step_timer.h"
+#include "job_system.h"
+#include "mvp_batch.h"
+#include "city_cull.h"
 
 #define FrameCount 3
-#define CityRowCount 10
-#define CityColumnCount 3
-#define UseBundles 1
+// Grid used when the command line doesn't give one: D3D12Bundles.exe [rows columns]
+#define DefaultCityRowCount 10
+#define DefaultCityColumnCount 3
+// Each city takes a 256-byte constant buffer per frame in the upload heap.
+#define MaxCityCount (1u << 20)
+
+typedef enum RenderMode
+{
+    RenderMode_Direct,      // One draw per city, recorded every frame
+    RenderMode_Bundles,     // One draw per city, recorded in a bundle
+    RenderMode_Instanced,   // One instanced draw per pipeline state
+    RenderMode_Count,
+} RenderMode;
+
+#define DefaultRenderMode RenderMode_Bundles
 
 typedef struct IDXGISwapChain3 IDXGISwapChain3;
 
@@ -25,6 +40,9 @@ typedef struct DXSample
     WCHAR assetsPath[512];
     // Window title.
     CHAR *title;
+    // City grid, from the command line.
+    UINT cityRowCount;
+    UINT cityColumnCount;
 
     // Pipeline objects.
     D3D12_VIEWPORT viewport;
@@ -42,7 +60,11 @@ typedef struct DXSample
     ID3D12DescriptorHeap *samplerHeap;
     ID3D12PipelineState *pipelineState1;
     ID3D12PipelineState *pipelineState2;
+    ID3D12PipelineState *instancedPipelineState1;
+    ID3D12PipelineState *instancedPipelineState2;
     ID3D12GraphicsCommandList *commandList;
+    // Direct mode: closes the frame after the city command lists.
+    ID3D12GraphicsCommandList *presentCommandList;
 
     // App resources.
     UINT numIndices;
@@ -56,6 +78,18 @@ typedef struct DXSample
     UINT rtvDescriptorSize;
     SimpleCamera camera;
 
+    // Per-frame constants work: the widest MVP kernel the CPU has, and the threads to run it on.
+    MvpKernel mvpKernel;
+    JobSystem jobs;
+
+    // Culling: the box of the city mesh.
+    CityBounds cityBounds;
+
+    // How the cities are drawn; 'M' cycles through the modes. Past the shader-visible heap size there
+    // is no room for a CBV per city and frame, and only instancing is left.
+    RenderMode renderMode;
+    bool cityDescriptors;
+
     // Frame resources.
     struct FrameResource* frameResources[FrameCount];
     struct FrameResource* currFrameResource;
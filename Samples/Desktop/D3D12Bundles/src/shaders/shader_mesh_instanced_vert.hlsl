@@ -0,0 +1,56 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Same as shader_mesh_simple_vert, with the MVP of the city fetched by instance
+// instead of bound as a constant buffer per draw.
+
+struct VSInput
+{
+    float3 position    : POSITION;
+    float3 normal    : NORMAL;
+    float2 uv        : TEXCOORD0;
+    float3 tangent    : TANGENT;
+};
+
+struct PSInput
+{
+    float4 position    : SV_POSITION;
+    float2 uv        : TEXCOORD0;
+};
+
+// The constant buffers of every city, as laid out in the upload heap: 256 bytes each, the matrix
+// transposed like the one shader_mesh_simple_vert reads from cb0, so column_major here too.
+struct SceneConstantBuffer
+{
+    column_major float4x4 worldViewProj;
+    float4 padding[12];
+};
+
+StructuredBuffer<SceneConstantBuffer> g_cities : register(t1);
+
+// The cities drawn, grouped by pipeline state; each draw starts at g_firstInstance.
+StructuredBuffer<uint> g_instanceCities : register(t2);
+
+cbuffer DrawConstants : register(b1)
+{
+    uint g_firstInstance;
+};
+
+PSInput Main(VSInput input, uint instanceID : SV_InstanceID)
+{
+    PSInput result;
+    
+    const uint city = g_instanceCities[g_firstInstance + instanceID];
+    result.position = mul(float4(input.position, 1.0f), g_cities[city].worldViewProj);
+    result.uv = input.uv;
+    
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Checks for the headless tests. A failed check prints its location and condition, and the test
+ * keeps going so that one run reports every failure. main returns TEST_RESULT().
+ */
+static int g_testFailures = 0;
+
+#define CHECK(condition)                                                                        \
+    ((condition) ? (void)0                                                                      \
+                 : (void)(g_testFailures++, fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition)))
+
+// Fixed LCG for the random cases, so that every C runtime checks the same ones.
+static uint32_t g_testRandomState = 12345;
+
+static inline uint32_t TestRandom(void)
+{
+    g_testRandomState = g_testRandomState * 1664525u + 1013904223u;
+    return g_testRandomState >> 8;
+}
+
+// Uniform in [min, max].
+static inline float TestRandomFloat(float min, float max)
+{
+    return min + (max - min) * (float)TestRandom() / (float)(1u << 24);
+}
+
+#define TEST_RESULT() (g_testFailures == 0 ? (printf("All checks passed\n"), EXIT_SUCCESS) \
+                                           : (printf("%d checks failed\n", g_testFailures), EXIT_FAILURE))
@@ -0,0 +1,100 @@
+#include "dirty_ranges.h"
+#include <string.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static void RemoveAt(DirtyRanges* const dr, uint32_t index)
+{
+    memmove(&dr->ranges[index], &dr->ranges[index + 1], (dr->count - index - 1) * sizeof(DirtyRange));
+    dr->count--;
+}
+
+// Merges the pair of neighbouring ranges separated by the smallest gap.
+static void CoalesceClosest(DirtyRanges* const dr)
+{
+    uint32_t best = 0;
+    uint32_t bestGap = UINT32_MAX;
+    for (uint32_t i = 0; i + 1 < dr->count; ++i)
+    {
+        uint32_t gap = dr->ranges[i + 1].Begin - dr->ranges[i].End;
+        if (gap < bestGap)
+        {
+            bestGap = gap;
+            best = i;
+        }
+    }
+    dr->ranges[best].End = dr->ranges[best + 1].End;
+    RemoveAt(dr, best + 1);
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+void DirtyRanges_Clear(DirtyRanges* const dr)
+{
+    dr->count = 0;
+}
+
+bool DirtyRanges_IsEmpty(const DirtyRanges* const dr)
+{
+    return dr->count == 0;
+}
+
+void DirtyRanges_Add(DirtyRanges* const dr, uint32_t first, uint32_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    DirtyRange r = { .Begin = first, .End = first + count };
+
+    // Find the first range that ends at or after the new one begins (touching ranges are merged too).
+    uint32_t i = 0;
+    while (i < dr->count && dr->ranges[i].End < r.Begin)
+    {
+        ++i;
+    }
+
+    // Absorb every range overlapping or adjacent to the new one.
+    while (i < dr->count && dr->ranges[i].Begin <= r.End)
+    {
+        r.Begin = dr->ranges[i].Begin < r.Begin ? dr->ranges[i].Begin : r.Begin;
+        r.End = dr->ranges[i].End > r.End ? dr->ranges[i].End : r.End;
+        RemoveAt(dr, i);
+    }
+
+    if (dr->count == DIRTY_RANGES_CAPACITY)
+    {
+        CoalesceClosest(dr);
+        // Coalescing may have shifted the ranges after our slot, find it again.
+        i = 0;
+        while (i < dr->count && dr->ranges[i].End < r.Begin)
+        {
+            ++i;
+        }
+        if (i < dr->count && dr->ranges[i].Begin <= r.End)
+        {
+            if (r.Begin < dr->ranges[i].Begin) dr->ranges[i].Begin = r.Begin;
+            if (r.End > dr->ranges[i].End) dr->ranges[i].End = r.End;
+            return;
+        }
+    }
+
+    memmove(&dr->ranges[i + 1], &dr->ranges[i], (dr->count - i) * sizeof(DirtyRange));
+    dr->ranges[i] = r;
+    dr->count++;
+}
+
+uint32_t DirtyRanges_ElementCount(const DirtyRanges* const dr)
+{
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < dr->count; ++i)
+    {
+        total += dr->ranges[i].End - dr->ranges[i].Begin;
+    }
+    return total;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Beyond this many disjoint ranges, the closest neighbours are coalesced. Re-uploading a small
+// gap is cheaper than recording hundreds of tiny CopyBufferRegion calls.
+#define DIRTY_RANGES_CAPACITY 32
+
+// Half-open range [Begin, End) of elements modified on the CPU.
+typedef struct DirtyRange
+{
+    uint32_t Begin;
+    uint32_t End;
+} DirtyRange;
+
+/***************************************************************************************
+ * Sorted, non-overlapping set of modified element ranges.                             *
+ *                                                                                     *
+ * Used to track which instances changed since the last upload, so that only those     *
+ * bytes get written to the upload heap and copied to the GPU buffer.                  *
+ ***************************************************************************************/
+typedef struct DirtyRanges
+{
+    DirtyRange ranges[DIRTY_RANGES_CAPACITY];
+    uint32_t   count;
+} DirtyRanges;
+
+void     DirtyRanges_Clear       (DirtyRanges* const dr);
+void     DirtyRanges_Add         (DirtyRanges* const dr, uint32_t first, uint32_t count);
+bool     DirtyRanges_IsEmpty     (const DirtyRanges* const dr);
+
+// Total number of elements covered by all ranges.
+uint32_t DirtyRanges_ElementCount(const DirtyRanges* const dr);
@@ -0,0 +1,155 @@
+/*************************************************************************************
+ Dirty range tests.
+
+ Adds random ranges and compares the set with a bitmap of the elements added. While
+ the added elements form at most DIRTY_RANGES_CAPACITY runs, the ranges must be
+ exactly those runs; past it, they must still cover every added element, and the
+ neighbours closest to each other must be the ones coalesced. The ranges always
+ stay sorted, non-empty, apart from each other, and within the capacity.
+
+ Usage: DirtyRangesTest
+**************************************************************************************/
+
+#include <string.h>
+#include "dirty_ranges.h"
+#include "test_check.h"
+
+#define ELEMENT_COUNT 4096
+
+static uint8_t s_added[ELEMENT_COUNT];
+
+// Sorted, non-empty, neither overlapping nor touching, within the capacity, and ElementCount agrees.
+static bool IsWellFormed(const DirtyRanges* const dr)
+{
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < dr->count; ++i)
+    {
+        const DirtyRange r = dr->ranges[i];
+        if (r.Begin >= r.End || r.End > ELEMENT_COUNT || (i > 0 && r.Begin <= dr->ranges[i - 1].End))
+        {
+            return false;
+        }
+        total += r.End - r.Begin;
+    }
+    return dr->count <= DIRTY_RANGES_CAPACITY && total == DirtyRanges_ElementCount(dr) &&
+           (dr->count == 0) == DirtyRanges_IsEmpty(dr);
+}
+
+static bool IsCovered(const DirtyRanges* const dr, uint32_t element)
+{
+    for (uint32_t i = 0; i < dr->count; ++i)
+    {
+        if (element >= dr->ranges[i].Begin && element < dr->ranges[i].End)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t CountRuns(void)
+{
+    uint32_t runs = 0;
+    for (uint32_t e = 0; e < ELEMENT_COUNT; ++e)
+    {
+        runs += s_added[e] && (e == 0 || !s_added[e - 1]);
+    }
+    return runs;
+}
+
+static void TestRandomAdds(uint32_t maxLength, uint32_t addCount)
+{
+    DirtyRanges dr;
+    DirtyRanges_Clear(&dr);
+    memset(s_added, 0, sizeof(s_added));
+
+    uint32_t malformed = 0, uncovered = 0, inexact = 0;
+    bool coalesced = false;
+    for (uint32_t a = 0; a < addCount; ++a)
+    {
+        const uint32_t count = TestRandom() % (maxLength + 1);
+        uint32_t first = TestRandom() % (ELEMENT_COUNT - count);
+
+        // Every fourth range touches one already there, on one side or the other.
+        if (a % 4 == 3 && dr.count > 0)
+        {
+            const DirtyRange r = dr.ranges[TestRandom() % dr.count];
+            first = a % 8 == 3 ? r.End : r.Begin;
+            first = a % 8 == 3 || first < count ? first : first - count;
+            first = first + count > ELEMENT_COUNT ? ELEMENT_COUNT - count : first;
+        }
+        DirtyRanges_Add(&dr, first, count);
+        memset(&s_added[first], 1, count);
+
+        malformed += !IsWellFormed(&dr);
+
+        // Exact until the runs first outnumber the ranges, a superset ever after.
+        coalesced = coalesced || CountRuns() > DIRTY_RANGES_CAPACITY;
+        for (uint32_t e = 0; e < ELEMENT_COUNT; ++e)
+        {
+            const bool covered = IsCovered(&dr, e);
+            uncovered += s_added[e] && !covered;
+            inexact += !coalesced && !s_added[e] && covered;
+        }
+    }
+    CHECK(malformed == 0);
+    CHECK(uncovered == 0);
+    CHECK(inexact == 0);
+}
+
+static void TestCoalescing(void)
+{
+    // Single elements with gaps shrinking from 40: adding one past the capacity merges the closest
+    // two already there, the last two before it.
+    DirtyRanges dr;
+    DirtyRanges_Clear(&dr);
+    uint32_t positions[DIRTY_RANGES_CAPACITY + 1];
+    for (uint32_t i = 0; i <= DIRTY_RANGES_CAPACITY; ++i)
+    {
+        positions[i] = i == 0 ? 0 : positions[i - 1] + 41 - i;
+        DirtyRanges_Add(&dr, positions[i], 1);
+    }
+    uint32_t misplaced = 0;
+    for (uint32_t i = 0; i + 2 < DIRTY_RANGES_CAPACITY; ++i)
+    {
+        misplaced += dr.ranges[i].Begin != positions[i] || dr.ranges[i].End != positions[i] + 1;
+    }
+    CHECK(misplaced == 0);
+    CHECK(dr.count == DIRTY_RANGES_CAPACITY);
+    CHECK(dr.ranges[DIRTY_RANGES_CAPACITY - 2].Begin == positions[DIRTY_RANGES_CAPACITY - 2]);
+    CHECK(dr.ranges[DIRTY_RANGES_CAPACITY - 2].End == positions[DIRTY_RANGES_CAPACITY - 1] + 1);
+    CHECK(dr.ranges[DIRTY_RANGES_CAPACITY - 1].Begin == positions[DIRTY_RANGES_CAPACITY]);
+
+    // A new range in the gap that coalescing closes ends up inside the merged range, freeing a slot.
+    DirtyRanges_Clear(&dr);
+    for (uint32_t i = 0; i < DIRTY_RANGES_CAPACITY; ++i)
+    {
+        DirtyRanges_Add(&dr, i == 6 ? 560 : i * 100, i == 6 ? 50 : 10);     // [510, 560) is the smallest gap
+    }
+    DirtyRanges_Add(&dr, 520, 10);
+    CHECK(dr.count == DIRTY_RANGES_CAPACITY - 1);
+    CHECK(IsWellFormed(&dr));
+    CHECK(dr.ranges[5].Begin == 500 && dr.ranges[5].End == 610);
+    CHECK(dr.ranges[6].Begin == 700 && dr.ranges[30].End == 3110);
+
+    // Touching and overlapping ranges merge, empty ones are ignored, and Clear empties the set.
+    DirtyRanges_Clear(&dr);
+    DirtyRanges_Add(&dr, 10, 5);
+    DirtyRanges_Add(&dr, 15, 5);
+    DirtyRanges_Add(&dr, 5, 7);
+    DirtyRanges_Add(&dr, 30, 0);
+    CHECK(dr.count == 1 && dr.ranges[0].Begin == 5 && dr.ranges[0].End == 20);
+    DirtyRanges_Add(&dr, 0, 100);
+    CHECK(dr.count == 1 && dr.ranges[0].Begin == 0 && dr.ranges[0].End == 100);
+    DirtyRanges_Clear(&dr);
+    CHECK(DirtyRanges_IsEmpty(&dr) && DirtyRanges_ElementCount(&dr) == 0);
+}
+
+int main(void)
+{
+    TestRandomAdds(3, 20);
+    TestRandomAdds(40, 400);
+    TestRandomAdds(400, 200);
+    TestCoalescing();
+    return TEST_RESULT();
+}
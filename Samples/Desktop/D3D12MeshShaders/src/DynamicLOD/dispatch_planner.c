@@ -0,0 +1,159 @@
+#include "dispatch_planner.h"
+#include <stdlib.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static uint64_t DivRoundUp_uint64(uint64_t num, uint64_t denom)
+{
+    return (num + denom - 1) / denom;
+}
+
+// Mesh groups launched for 'count' instances of a single LOD (see MeshletAS.hlsl).
+static uint64_t LodMeshGroups(const DispatchLod* const lod, MeshletLimits limits, uint32_t count)
+{
+    const uint64_t unpacked = (uint64_t)(lod->MeshletCount - 1) * count;
+    return unpacked + DivRoundUp_uint64(count, DispatchPlan_LastMeshletPackCount(lod, limits));
+}
+
+static uint32_t GroupSize(DispatchGroupLimits limits)
+{
+    return limits.AmplificationGroupSize < MAX_AMPLIFICATION_GROUP_SIZE ? limits.AmplificationGroupSize : MAX_AMPLIFICATION_GROUP_SIZE;
+}
+
+// best[n] is the most mesh groups that at most n instances can launch, for every n up to the
+// amplification group size. Because of last-meshlet packing, spreading instances over several meshes
+// can launch more groups than putting all of them in the heaviest one (culled instances launch none).
+static void WorstCaseTable(const DispatchLod* const lods, uint32_t lodCount, DispatchGroupLimits limits,
+                           uint64_t best[MAX_AMPLIFICATION_GROUP_SIZE + 1])
+{
+    uint64_t next[MAX_AMPLIFICATION_GROUP_SIZE + 1];
+    const uint32_t groupSize = GroupSize(limits);
+
+    for (uint32_t n = 0; n <= groupSize; ++n)
+    {
+        best[n] = 0;
+    }
+
+    for (uint32_t l = 0; l < lodCount; ++l)
+    {
+        for (uint32_t n = 0; n <= groupSize; ++n)
+        {
+            next[n] = best[n];
+            for (uint32_t j = 1; j <= n; ++j)
+            {
+                const uint64_t groups = best[n - j] + LodMeshGroups(&lods[l], limits.Meshlet, j);
+                if (groups > next[n])
+                {
+                    next[n] = groups;
+                }
+            }
+        }
+        for (uint32_t n = 0; n <= groupSize; ++n)
+        {
+            best[n] = next[n];
+        }
+    }
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+uint32_t DispatchPlan_LastMeshletPackCount(const DispatchLod* const lod, MeshletLimits limits)
+{
+    if (lod->LastMeshletVertCount == 0 || lod->LastMeshletPrimCount == 0)
+    {
+        return 1;
+    }
+
+    const uint32_t byVerts = limits.MaxVerts / lod->LastMeshletVertCount;
+    const uint32_t byPrims = limits.MaxPrims / lod->LastMeshletPrimCount;
+    const uint32_t packCount = byVerts < byPrims ? byVerts : byPrims;
+    return packCount > 0 ? packCount : 1;
+}
+
+uint64_t DispatchPlan_WorstCaseMeshGroups(const DispatchLod* const lods, uint32_t lodCount, DispatchGroupLimits limits,
+                                          uint32_t instancesPerGroup)
+{
+    uint64_t best[MAX_AMPLIFICATION_GROUP_SIZE + 1];
+    WorstCaseTable(lods, lodCount, limits, best);
+
+    const uint32_t groupSize = GroupSize(limits);
+    return best[instancesPerGroup < groupSize ? instancesPerGroup : groupSize];
+}
+
+bool DispatchPlan_Build(DispatchPlan* const plan, const DispatchLod* const lods, uint32_t lodCount,
+                        DispatchGroupLimits limits, uint32_t instanceCount)
+{
+    plan->batchCount = 0;
+    plan->instancesPerGroup = 0;
+    plan->maxMeshGroups = 0;
+
+    for (uint32_t l = 0; l < lodCount; ++l)
+    {
+        if (lods[l].MeshletCount == 0)
+        {
+            return false;
+        }
+    }
+
+    // Largest amplification group occupancy whose worst case still fits in one DispatchMesh.
+    // One table covers every occupancy, so scenes with hundreds of meshes only pay for it once.
+    uint64_t best[MAX_AMPLIFICATION_GROUP_SIZE + 1];
+    WorstCaseTable(lods, lodCount, limits, best);
+
+    for (uint32_t n = GroupSize(limits); n > 0; --n)
+    {
+        if (best[n] <= MAX_DISPATCH_GROUP_COUNT)
+        {
+            plan->instancesPerGroup = n;
+            plan->maxMeshGroups = best[n];
+            break;
+        }
+    }
+
+    if (plan->instancesPerGroup == 0)
+    {
+        return false;
+    }
+
+    const uint64_t instancesPerBatch = (uint64_t)MAX_DISPATCH_GROUP_COUNT * plan->instancesPerGroup;
+    const uint64_t batchCount = DivRoundUp_uint64(instanceCount, instancesPerBatch);
+
+    if (batchCount > plan->batchCapacity)
+    {
+        DispatchBatch* batches = realloc(plan->batches, batchCount * sizeof(DispatchBatch));
+        if (!batches)
+        {
+            return false;
+        }
+        plan->batches = batches;
+        plan->batchCapacity = (uint32_t)batchCount;
+    }
+
+    for (uint64_t i = 0; i < batchCount; ++i)
+    {
+        const uint64_t offset = i * instancesPerBatch;
+        const uint64_t remaining = instanceCount - offset;
+        const uint32_t count = (uint32_t)(remaining < instancesPerBatch ? remaining : instancesPerBatch);
+
+        DispatchBatch* batch = &plan->batches[i];
+        batch->Params.InstanceOffset = (uint32_t)offset;
+        batch->Params.InstanceCount = count;
+        batch->Params.InstancesPerGroup = plan->instancesPerGroup;
+        batch->GroupCount = (uint32_t)DivRoundUp_uint64(count, plan->instancesPerGroup);
+    }
+    plan->batchCount = (uint32_t)batchCount;
+
+    return true;
+}
+
+void DispatchPlan_Release(DispatchPlan* const plan)
+{
+    free(plan->batches);
+    plan->batches = NULL;
+    plan->batchCount = 0;
+    plan->batchCapacity = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+#include "meshlet_mesh.h"
+
+typedef struct DrawParams DrawParams;
+
+// D3D12 caps every dimension of a DispatchMesh call, from the command list or from an
+// amplification shader, at 65535 threadgroups.
+#define MAX_DISPATCH_GROUP_COUNT 65535u
+
+// Widest amplification group the shaders are compiled for: one wave of 64 threads.
+#define MAX_AMPLIFICATION_GROUP_SIZE 64u
+
+// Threadgroup limits of the shaders the plan is for. DISPATCH_DEFAULT_GROUP_LIMITS matches shared.h.
+typedef struct DispatchGroupLimits
+{
+    uint32_t      AmplificationGroupSize;  // Instances one amplification group can cull, at most MAX_AMPLIFICATION_GROUP_SIZE
+    MeshletLimits Meshlet;                 // Outputs of one mesh shader group
+} DispatchGroupLimits;
+
+#define DISPATCH_DEFAULT_GROUP_LIMITS ((DispatchGroupLimits){ AS_GROUP_SIZE, { MAX_VERTS, MAX_PRIMS } })
+
+// The subset of a mesh's MeshDesc the amplification shader uses to size its mesh shader dispatch.
+typedef struct DispatchLod
+{
+    uint32_t MeshletCount;
+    uint32_t LastMeshletVertCount;
+    uint32_t LastMeshletPrimCount;
+} DispatchLod;
+
+typedef struct DispatchBatch
+{
+    DrawParams Params;     // Root constants for this batch
+    uint32_t   GroupCount; // Amplification threadgroups to dispatch
+} DispatchBatch;
+
+/***************************************************************************************************
+ * Splits the instances of a draw into DispatchMesh batches that respect the hardware limits:      *
+ *                                                                                                 *
+ *   - a batch never dispatches more than MAX_DISPATCH_GROUP_COUNT amplification groups;          *
+ *   - an amplification group never launches more than MAX_DISPATCH_GROUP_COUNT mesh groups,      *
+ *     whatever the LOD assignment of its instances. Heavy LODs get fewer instances per group.    *
+ *                                                                                                 *
+ * 'lods' lists every mesh the instances may be drawn with: all the LODs of all the models.       *
+ ***************************************************************************************************/
+typedef struct DispatchPlan
+{
+    DispatchBatch* batches;
+    uint32_t       batchCount;
+    uint32_t       batchCapacity;
+
+    uint32_t       instancesPerGroup;  // Instances culled by each amplification group
+    uint64_t       maxMeshGroups;      // Worst-case mesh groups launched by one amplification group
+} DispatchPlan;
+
+// Returns false if a single instance of the heaviest LOD already exceeds the limits, or on allocation failure.
+bool     DispatchPlan_Build           (DispatchPlan* const plan, const DispatchLod* const lods, uint32_t lodCount,
+                                       DispatchGroupLimits limits, uint32_t instanceCount);
+void     DispatchPlan_Release         (DispatchPlan* const plan);
+
+// Mesh groups launched in the worst case by an amplification group culling 'instancesPerGroup' instances.
+uint64_t DispatchPlan_WorstCaseMeshGroups(const DispatchLod* const lods, uint32_t lodCount, DispatchGroupLimits limits,
+                                          uint32_t instancesPerGroup);
+
+// Instances of a LOD's last meshlet packed into a single mesh group. Matches MeshletAS.hlsl.
+uint32_t DispatchPlan_LastMeshletPackCount(const DispatchLod* const lod, MeshletLimits limits);
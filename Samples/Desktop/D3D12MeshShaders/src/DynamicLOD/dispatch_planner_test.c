@@ -0,0 +1,221 @@
+/*************************************************************************************
+ Dispatch planner tests.
+
+ Builds plans from 0 to 2^32 - 1 instances and for meshlet counts around the 65535
+ group limit, and checks every plan: no batch dispatches more than 65535 amplification
+ groups, the batches cover every instance exactly once, and the instances per group
+ are the most for which every LOD assignment, found by brute force, launches at most
+ 65535 mesh groups. The same holds for every meshlet pipeline the sample compiles,
+ 64x126 and 128x256 meshlets at waves of 32 and 64, and for wider amplification
+ groups than the shaders support, which the planner caps.
+
+ Usage: DispatchPlannerTest
+**************************************************************************************/
+
+#include "dispatch_planner.h"
+#include "test_check.h"
+
+// Mesh groups 'count' instances of 'lod' launch, written out from MeshletAS.hlsl rather than taken
+// from the planner: every meshlet but the last once per instance, the last ones packed together.
+static uint64_t ReferenceMeshGroups(const DispatchLod* const lod, MeshletLimits limits, uint64_t count)
+{
+    uint64_t pack = 1;
+    if (lod->LastMeshletVertCount > 0 && lod->LastMeshletPrimCount > 0)
+    {
+        const uint64_t byVerts = limits.MaxVerts / lod->LastMeshletVertCount;
+        const uint64_t byPrims = limits.MaxPrims / lod->LastMeshletPrimCount;
+        pack = byVerts < byPrims ? byVerts : byPrims;
+        pack = pack > 0 ? pack : 1;
+    }
+    return (uint64_t)(lod->MeshletCount - 1) * count + (count + pack - 1) / pack;
+}
+
+// The most mesh groups 'instances' instances can launch, trying every split over the LODs, culled instances included.
+static uint64_t BruteForceWorstCase(const DispatchLod* const lods, uint32_t lodCount, MeshletLimits limits, uint32_t instances)
+{
+    if (lodCount == 0)
+    {
+        return 0;
+    }
+    uint64_t worst = 0;
+    for (uint32_t count = 0; count <= instances; ++count)
+    {
+        const uint64_t groups = ReferenceMeshGroups(&lods[0], limits, count) +
+                                BruteForceWorstCase(lods + 1, lodCount - 1, limits, instances - count);
+        worst = groups > worst ? groups : worst;
+    }
+    return worst;
+}
+
+// Checks a built plan against the limits, and that its batches cover [0, instanceCount) in order, once.
+static void CheckPlan(const DispatchPlan* const plan, DispatchGroupLimits limits, uint32_t instanceCount)
+{
+    CHECK(plan->instancesPerGroup > 0 && plan->instancesPerGroup <= limits.AmplificationGroupSize);
+    CHECK(plan->instancesPerGroup <= MAX_AMPLIFICATION_GROUP_SIZE);
+    CHECK(plan->maxMeshGroups <= MAX_DISPATCH_GROUP_COUNT);
+
+    uint64_t covered = 0;
+    for (uint32_t b = 0; b < plan->batchCount; ++b)
+    {
+        const DispatchBatch* const batch = &plan->batches[b];
+        CHECK(batch->Params.InstanceOffset == covered);
+        CHECK(batch->Params.InstanceCount > 0);
+        CHECK(batch->Params.InstancesPerGroup == plan->instancesPerGroup);
+        CHECK(batch->GroupCount > 0 && batch->GroupCount <= MAX_DISPATCH_GROUP_COUNT);
+
+        // Enough groups for the batch's instances, and no group left empty.
+        CHECK((uint64_t)batch->GroupCount * plan->instancesPerGroup >= batch->Params.InstanceCount);
+        CHECK((uint64_t)(batch->GroupCount - 1) * plan->instancesPerGroup < batch->Params.InstanceCount);
+        covered += batch->Params.InstanceCount;
+    }
+    CHECK(covered == instanceCount);
+}
+
+// Checks that the plan's instances per group is the largest whose worst case fits, by brute force.
+static void CheckOccupancy(const DispatchPlan* const plan, const DispatchLod* const lods, uint32_t lodCount,
+                           DispatchGroupLimits limits)
+{
+    const uint32_t groupSize = MIN(limits.AmplificationGroupSize, MAX_AMPLIFICATION_GROUP_SIZE);
+    const uint64_t worst = BruteForceWorstCase(lods, lodCount, limits.Meshlet, plan->instancesPerGroup);
+    CHECK(worst == plan->maxMeshGroups);
+    CHECK(worst == DispatchPlan_WorstCaseMeshGroups(lods, lodCount, limits, plan->instancesPerGroup));
+    CHECK(worst <= MAX_DISPATCH_GROUP_COUNT);
+    if (plan->instancesPerGroup < groupSize)
+    {
+        CHECK(BruteForceWorstCase(lods, lodCount, limits.Meshlet, plan->instancesPerGroup + 1) > MAX_DISPATCH_GROUP_COUNT);
+    }
+}
+
+static void TestInstanceCounts(void)
+{
+    // Light LODs: a full amplification group always fits, so batches hold 65535 * AS_GROUP_SIZE instances.
+    const DispatchLod lods[] = { { 1200, 40, 70 }, { 600, 12, 20 }, { 300, 64, 126 }, { 150, 1, 1 }, { 40, 33, 64 }, { 10, 5, 5 } };
+    const uint64_t batchSize = (uint64_t)MAX_DISPATCH_GROUP_COUNT * AS_GROUP_SIZE;
+    const uint32_t counts[] = {
+        0, 1, AS_GROUP_SIZE - 1, AS_GROUP_SIZE, AS_GROUP_SIZE + 1,
+        MAX_DISPATCH_GROUP_COUNT * AS_GROUP_SIZE - 1, MAX_DISPATCH_GROUP_COUNT * AS_GROUP_SIZE, MAX_DISPATCH_GROUP_COUNT * AS_GROUP_SIZE + 1,
+        UINT32_MAX,
+    };
+
+    DispatchPlan plan = { 0 };
+    for (size_t i = 0; i < _countof(counts); ++i)
+    {
+        CHECK(DispatchPlan_Build(&plan, lods, _countof(lods), DISPATCH_DEFAULT_GROUP_LIMITS, counts[i]));
+        CHECK(plan.instancesPerGroup == AS_GROUP_SIZE);
+        CHECK(plan.batchCount == (counts[i] + batchSize - 1) / batchSize);
+        CheckPlan(&plan, DISPATCH_DEFAULT_GROUP_LIMITS, counts[i]);
+    }
+    CheckOccupancy(&plan, lods, _countof(lods), DISPATCH_DEFAULT_GROUP_LIMITS);
+
+    // A plan built again for fewer instances drops the batches it no longer needs.
+    CHECK(DispatchPlan_Build(&plan, lods, _countof(lods), DISPATCH_DEFAULT_GROUP_LIMITS, AS_GROUP_SIZE + 1));
+    CHECK(plan.batchCount == 1 && plan.batches[0].GroupCount == 2);
+    CheckPlan(&plan, DISPATCH_DEFAULT_GROUP_LIMITS, AS_GROUP_SIZE + 1);
+    DispatchPlan_Release(&plan);
+}
+
+static void TestMeshletCounts(void)
+{
+    // A single LOD of n meshlets, the last one full or tiny, for n around 65535 / AS_GROUP_SIZE and around 65535.
+    const uint32_t meshletCounts[] = {
+        1, 2, 2047, 2048, 2049, 2050, 4096, 32767, 32768, 65533, 65534, 65535,
+    };
+    const uint32_t lastMeshlets[][2] = { { MAX_VERTS, MAX_PRIMS }, { 3, 1 }, { 0, 0 } };
+
+    DispatchPlan plan = { 0 };
+    for (size_t m = 0; m < _countof(meshletCounts); ++m)
+    {
+        for (size_t last = 0; last < _countof(lastMeshlets); ++last)
+        {
+            const DispatchLod lod = { meshletCounts[m], lastMeshlets[last][0], lastMeshlets[last][1] };
+            const uint32_t instanceCounts[] = { 1, MAX_DISPATCH_GROUP_COUNT, UINT32_MAX };
+            for (size_t i = 0; i < _countof(instanceCounts); ++i)
+            {
+                CHECK(DispatchPlan_Build(&plan, &lod, 1, DISPATCH_DEFAULT_GROUP_LIMITS, instanceCounts[i]));
+                CheckPlan(&plan, DISPATCH_DEFAULT_GROUP_LIMITS, instanceCounts[i]);
+            }
+            CheckOccupancy(&plan, &lod, 1, DISPATCH_DEFAULT_GROUP_LIMITS);
+        }
+    }
+
+    // 65535 full meshlets is one instance per group, exactly at the limit.
+    const DispatchLod largest = { 65535, MAX_VERTS, MAX_PRIMS };
+    CHECK(DispatchPlan_Build(&plan, &largest, 1, DISPATCH_DEFAULT_GROUP_LIMITS, UINT32_MAX));
+    CHECK(plan.instancesPerGroup == 1 && plan.maxMeshGroups == MAX_DISPATCH_GROUP_COUNT);
+    CHECK(plan.batchCount == (UINT32_MAX + (uint64_t)MAX_DISPATCH_GROUP_COUNT - 1) / MAX_DISPATCH_GROUP_COUNT);
+
+    // One more meshlet and a single instance doesn't fit, whatever the other LODs.
+    const DispatchLod tooLarge[] = { { 10, 5, 5 }, { 65536, MAX_VERTS, MAX_PRIMS } };
+    CHECK(!DispatchPlan_Build(&plan, tooLarge, _countof(tooLarge), DISPATCH_DEFAULT_GROUP_LIMITS, 10));
+    CHECK(!DispatchPlan_Build(&plan, &tooLarge[1], 1, DISPATCH_DEFAULT_GROUP_LIMITS, 1));
+
+    // A LOD without meshlets is invalid.
+    const DispatchLod empty = { 0, 0, 0 };
+    CHECK(!DispatchPlan_Build(&plan, &empty, 1, DISPATCH_DEFAULT_GROUP_LIMITS, 1));
+
+    // Spreading instances over meshes can beat the heaviest one: the last meshlets of each pack separately.
+    const DispatchLod spread[] = { { 2000, 1, 1 }, { 2000, 1, 1 }, { 2000, 1, 1 } };
+    CHECK(DispatchPlan_Build(&plan, spread, _countof(spread), DISPATCH_DEFAULT_GROUP_LIMITS, 1000));
+    CheckOccupancy(&plan, spread, _countof(spread), DISPATCH_DEFAULT_GROUP_LIMITS);
+    CheckPlan(&plan, DISPATCH_DEFAULT_GROUP_LIMITS, 1000);
+    DispatchPlan_Release(&plan);
+}
+
+static void TestPipelines(void)
+{
+    // The pipelines of MESHLET_PIPELINES in CMakeLists.txt, then an amplification group wider than the shaders.
+    const DispatchGroupLimits pipelines[] = {
+        { 32, { 64, 126 } }, { 32, { 128, 256 } }, { 64, { 64, 126 } }, { 64, { 128, 256 } }, { 128, { 64, 126 } },
+    };
+
+    // The same meshes split into fewer, larger meshlets for the wider variant, all with partly filled last meshlets.
+    const DispatchLod lodSets[][3] = {
+        { { 3000, 40, 70 }, { 900, 12, 20 }, { 20, 5, 5 } },
+        { { 1500, 90, 150 }, { 450, 12, 20 }, { 10, 5, 5 } },
+        { { 65535, 3, 1 }, { 2048, 64, 126 }, { 1, 1, 1 } },
+    };
+    const uint32_t instanceCounts[] = { 1, 1000, MAX_DISPATCH_GROUP_COUNT * 64 + 1, UINT32_MAX };
+
+    DispatchPlan plan = { 0 };
+    for (size_t p = 0; p < _countof(pipelines); ++p)
+    {
+        for (size_t s = 0; s < _countof(lodSets); ++s)
+        {
+            for (size_t i = 0; i < _countof(instanceCounts); ++i)
+            {
+                CHECK(DispatchPlan_Build(&plan, lodSets[s], _countof(lodSets[s]), pipelines[p], instanceCounts[i]));
+                CheckPlan(&plan, pipelines[p], instanceCounts[i]);
+            }
+            CheckOccupancy(&plan, lodSets[s], _countof(lodSets[s]), pipelines[p]);
+        }
+    }
+
+    // A last meshlet too large for the narrow limits still takes one group per instance.
+    const DispatchLod wideOnly = { 100, 128, 256 };
+    CHECK(DispatchPlan_Build(&plan, &wideOnly, 1, pipelines[0], 10));
+    CHECK(plan.maxMeshGroups == 100ull * plan.instancesPerGroup);
+    DispatchPlan_Release(&plan);
+}
+
+static void TestLastMeshletPacking(void)
+{
+    const MeshletLimits limits = { MAX_VERTS, MAX_PRIMS };
+    CHECK(DispatchPlan_LastMeshletPackCount(&(DispatchLod){ 1, MAX_VERTS, MAX_PRIMS }, limits) == 1);
+    CHECK(DispatchPlan_LastMeshletPackCount(&(DispatchLod){ 1, 10, 12 }, limits) == MIN(MAX_VERTS / 10, MAX_PRIMS / 12));
+    CHECK(DispatchPlan_LastMeshletPackCount(&(DispatchLod){ 1, 1, 1 }, limits) == MIN(MAX_VERTS, MAX_PRIMS));
+    CHECK(DispatchPlan_LastMeshletPackCount(&(DispatchLod){ 1, 0, 0 }, limits) == 1);
+    CHECK(DispatchPlan_LastMeshletPackCount(&(DispatchLod){ 1, MAX_VERTS + 1, 1 }, limits) == 1);
+
+    // Wider meshlet limits pack more of the same last meshlet.
+    const MeshletLimits wide = { 128, 256 };
+    CHECK(DispatchPlan_LastMeshletPackCount(&(DispatchLod){ 1, 10, 12 }, wide) == MIN(128 / 10, 256 / 12));
+}
+
+int main(void)
+{
+    TestInstanceCounts();
+    TestMeshletCounts();
+    TestPipelines();
+    TestLastMeshletPacking();
+    return TEST_RESULT();
+}
@@ -0,0 +1,258 @@
+#include "dispatch_sim.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include <string.h>
+
+/*****************************************************************
+    Private types
+******************************************************************/
+
+// Mirror of Payload in Common.hlsli.
+typedef struct SimPayload
+{
+    uint32_t BucketCount;
+    uint32_t MeshIndices[AS_GROUP_SIZE];
+    uint32_t InstanceCounts[AS_GROUP_SIZE];
+    uint32_t GroupOffsets[AS_GROUP_SIZE];
+    uint32_t InstanceList[AS_GROUP_SIZE];
+    uint32_t InstanceOffsets[AS_GROUP_SIZE];
+} SimPayload;
+
+// Per-LOD sums over the meshlets, so mesh groups can be accounted for without walking them.
+typedef struct LodTotals
+{
+    uint32_t MeshletCount;
+    uint32_t PackCount;
+
+    uint64_t UnpackedVerts; // Sums over every meshlet but the last
+    uint64_t UnpackedPrims;
+    uint64_t UnpackedBusy;
+
+    uint32_t LastVerts;
+    uint32_t LastPrims;
+} LodTotals;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static LodTotals ComputeLodTotals(const MeshletMesh* const mesh)
+{
+    LodTotals totals = { .MeshletCount = mesh->MeshletCount };
+    if (mesh->MeshletCount == 0)
+    {
+        return totals;
+    }
+
+    for (uint32_t i = 0; i + 1 < mesh->MeshletCount; ++i)
+    {
+        const Meshlet* m = &mesh->Meshlets[i];
+        totals.UnpackedVerts += m->VertCount;
+        totals.UnpackedPrims += m->PrimCount;
+        totals.UnpackedBusy += m->VertCount > m->PrimCount ? m->VertCount : m->PrimCount;
+    }
+
+    const Meshlet* last = &mesh->Meshlets[mesh->MeshletCount - 1];
+    totals.LastVerts = last->VertCount;
+    totals.LastPrims = last->PrimCount;
+
+    const DispatchLod lod = { mesh->MeshletCount, last->VertCount, last->PrimCount };
+    totals.PackCount = DispatchPlan_LastMeshletPackCount(&lod, DISPATCH_DEFAULT_GROUP_LIMITS.Meshlet);
+    return totals;
+}
+
+// One amplification shader threadgroup: cull, select LODs and compact into the payload.
+// Returns the number of lanes which had an instance to process. The simulated scenes have a
+// single model, so a mesh index is a LOD and buckets are the non-empty LODs in order.
+static uint32_t AmplificationGroup(SimPayload* const payload, const Constants* const constants, const DrawParams* const params,
+                                   const Instance* const instances, const LodTotals* const lods, uint32_t gid)
+{
+    uint32_t lodLevels[AS_GROUP_SIZE];
+    uint32_t lodCounts[MAX_LOD_LEVELS] = { 0 };
+    uint32_t activeLanes = 0;
+
+    memset(payload, 0, sizeof(*payload));
+
+    for (uint32_t gtid = 0; gtid < AS_GROUP_SIZE; ++gtid)
+    {
+        lodLevels[gtid] = MAX_LOD_LEVELS;
+
+        const uint32_t instanceIndex = gid * params->InstancesPerGroup + gtid;
+        if (gtid < params->InstancesPerGroup && instanceIndex < params->InstanceCount)
+        {
+            ++activeLanes;
+
+            const XMFLOAT4 boundingSphere = Instance_UnpackBoundingSphere(&instances[params->InstanceOffset + instanceIndex]);
+            if (InstanceCull_IsVisible(constants, boundingSphere) && InstanceCull_IsContributing(constants, boundingSphere))
+            {
+                lodLevels[gtid] = InstanceCull_ComputeLOD(constants, boundingSphere);
+                lodCounts[lodLevels[gtid]]++;
+            }
+        }
+    }
+
+    // One bucket per LOD present, with the prefix sums of the instance and mesh group counts.
+    uint32_t lodBuckets[MAX_LOD_LEVELS];
+    uint32_t instanceOffset = 0;
+    uint32_t groupOffset = 0;
+    for (uint32_t lod = 0; lod < MAX_LOD_LEVELS; ++lod)
+    {
+        const uint32_t count = lodCounts[lod];
+        if (count == 0)
+        {
+            continue;
+        }
+
+        const uint32_t bucket = payload->BucketCount++;
+        lodBuckets[lod] = bucket;
+        payload->MeshIndices[bucket] = lod;
+        payload->InstanceCounts[bucket] = count;
+        payload->InstanceOffsets[bucket] = instanceOffset;
+        payload->GroupOffsets[bucket] = groupOffset;
+
+        instanceOffset += count;
+        groupOffset += (lods[lod].MeshletCount - 1) * count + (count + lods[lod].PackCount - 1) / lods[lod].PackCount;
+    }
+
+    // Compaction, in lane order like WavePrefixCountBits.
+    uint32_t written[AS_GROUP_SIZE] = { 0 };
+    for (uint32_t gtid = 0; gtid < AS_GROUP_SIZE; ++gtid)
+    {
+        const uint32_t lod = lodLevels[gtid];
+        if (lod != MAX_LOD_LEVELS)
+        {
+            const uint32_t bucket = lodBuckets[lod];
+            payload->InstanceList[payload->InstanceOffsets[bucket] + written[bucket]++] = gid * params->InstancesPerGroup + gtid;
+        }
+    }
+
+    return activeLanes;
+}
+
+// Mesh groups launched by a payload: the DispatchMesh argument of MeshletAS.hlsl.
+static uint32_t PayloadMeshGroups(const SimPayload* const payload, const LodTotals* const lods)
+{
+    if (payload->BucketCount == 0)
+    {
+        return 0;
+    }
+
+    const uint32_t last = payload->BucketCount - 1;
+    const LodTotals* t = &lods[payload->MeshIndices[last]];
+    const uint32_t n = payload->InstanceCounts[last];
+    return payload->GroupOffsets[last] + (t->MeshletCount - 1) * n + (n + t->PackCount - 1) / t->PackCount;
+}
+
+// The mesh shader groups launched from one payload. Each LOD's groups are the MeshletCount - 1
+// full meshlets once per instance, then the last meshlet packed PackCount instances at a time.
+static void AccountMeshGroups(DispatchSimStats* const stats, const SimPayload* const payload, const LodTotals* const lods)
+{
+    for (uint32_t bucket = 0; bucket < payload->BucketCount; ++bucket)
+    {
+        const uint32_t lod = payload->MeshIndices[bucket];
+        const uint64_t n = payload->InstanceCounts[bucket];
+
+        const LodTotals* t = &lods[lod];
+        const uint64_t lastGroups = (n + t->PackCount - 1) / t->PackCount;
+        const uint64_t groups = (t->MeshletCount - 1) * n + lastGroups;
+        const uint64_t vertices = n * (t->UnpackedVerts + t->LastVerts);
+        const uint64_t primitives = n * (t->UnpackedPrims + t->LastPrims);
+        const uint32_t lastBusy = t->LastVerts > t->LastPrims ? t->LastVerts : t->LastPrims;
+        const uint64_t busy = n * (t->UnpackedBusy + lastBusy);
+
+        DispatchSimLodStats* s = &stats->Lods[lod];
+        s->Instances += n;
+        s->MeshGroups += groups;
+        s->PackedMeshGroups += lastGroups;
+        s->Vertices += vertices;
+        s->Primitives += primitives;
+        s->BusyLanes += busy;
+
+        stats->MeshGroups += groups;
+        stats->VertexLanes += vertices;
+        stats->PrimitiveLanes += primitives;
+        stats->BusyLanes += busy;
+    }
+}
+
+static double Percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+uint32_t DispatchSim_PayloadSize(void)
+{
+    return (uint32_t)sizeof(SimPayload);
+}
+
+void DispatchSim_Run(DispatchSimStats* const stats, const Constants* const constants, const DispatchPlan* const plan,
+                     const Instance* const instances, const MeshletMesh* const lods)
+{
+    LodTotals totals[MAX_LOD_LEVELS] = { 0 };
+    const uint32_t lodCount = constants->LODCount < MAX_LOD_LEVELS ? constants->LODCount : MAX_LOD_LEVELS;
+    for (uint32_t lod = 0; lod < lodCount; ++lod)
+    {
+        totals[lod] = ComputeLodTotals(&lods[lod]);
+    }
+
+    for (uint32_t b = 0; b < plan->batchCount; ++b)
+    {
+        const DispatchBatch* batch = &plan->batches[b];
+
+        stats->Dispatches++;
+        stats->Instances += batch->Params.InstanceCount;
+
+        for (uint32_t gid = 0; gid < batch->GroupCount; ++gid)
+        {
+            SimPayload payload;
+            const uint32_t activeLanes = AmplificationGroup(&payload, constants, &batch->Params, instances, totals, gid);
+
+            stats->AmplificationGroups++;
+            stats->IdleAmplificationLanes += AS_GROUP_SIZE - activeLanes;
+            stats->PayloadBytes += sizeof(SimPayload);
+            stats->VisibleInstances += payload.BucketCount ?
+                payload.InstanceOffsets[payload.BucketCount - 1] + payload.InstanceCounts[payload.BucketCount - 1] : 0;
+
+            const uint64_t meshGroups = PayloadMeshGroups(&payload, totals);
+            if (meshGroups > stats->MaxMeshGroupsPerDispatch)
+            {
+                stats->MaxMeshGroupsPerDispatch = meshGroups;
+            }
+
+            AccountMeshGroups(stats, &payload, totals);
+        }
+    }
+}
+
+void DispatchSim_Print(const DispatchSimStats* const stats, uint32_t lodCount, FILE* const out)
+{
+    const uint64_t meshLanes = stats->MeshGroups * MS_GROUP_SIZE;
+    const uint64_t ampLanes = stats->AmplificationGroups * AS_GROUP_SIZE;
+
+    fprintf(out, "instances: %llu submitted, %llu visible (%.1f%%)\n",
+        (unsigned long long)stats->Instances, (unsigned long long)stats->VisibleInstances,
+        Percent(stats->VisibleInstances, stats->Instances));
+    fprintf(out, "dispatches: %llu, amplification groups: %llu, idle AS lanes: %llu (%.1f%%)\n",
+        (unsigned long long)stats->Dispatches, (unsigned long long)stats->AmplificationGroups,
+        (unsigned long long)stats->IdleAmplificationLanes, Percent(stats->IdleAmplificationLanes, ampLanes));
+    fprintf(out, "payload: %u bytes/group, %llu bytes total, largest DispatchMesh: %llu groups\n",
+        DispatchSim_PayloadSize(), (unsigned long long)stats->PayloadBytes, (unsigned long long)stats->MaxMeshGroupsPerDispatch);
+    fprintf(out, "mesh groups: %llu, lanes: %llu, vertex %.1f%%, primitive %.1f%%, busy %.1f%%, wasted %llu\n",
+        (unsigned long long)stats->MeshGroups, (unsigned long long)meshLanes,
+        Percent(stats->VertexLanes, meshLanes), Percent(stats->PrimitiveLanes, meshLanes),
+        Percent(stats->BusyLanes, meshLanes), (unsigned long long)(meshLanes - stats->BusyLanes));
+
+    fprintf(out, "%4s %12s %12s %12s %14s %14s %8s\n", "LOD", "instances", "groups", "packed", "vertices", "primitives", "busy");
+    for (uint32_t lod = 0; lod < lodCount && lod < MAX_LOD_LEVELS; ++lod)
+    {
+        const DispatchSimLodStats* s = &stats->Lods[lod];
+        fprintf(out, "%4u %12llu %12llu %12llu %14llu %14llu %7.1f%%\n",
+            lod, (unsigned long long)s->Instances, (unsigned long long)s->MeshGroups, (unsigned long long)s->PackedMeshGroups,
+            (unsigned long long)s->Vertices, (unsigned long long)s->Primitives,
+            Percent(s->BusyLanes, s->MeshGroups * MS_GROUP_SIZE));
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "shared.h"
+#include "meshlet_mesh.h"
+#include "dispatch_planner.h"
+
+typedef struct Constants Constants;
+typedef struct Instance Instance;
+
+typedef struct DispatchSimLodStats
+{
+    uint64_t Instances;        // Visible instances assigned to this LOD
+    uint64_t MeshGroups;       // Mesh shader threadgroups launched
+    uint64_t PackedMeshGroups; // Of which render the last meshlet, possibly for several instances
+    uint64_t Vertices;         // Vertices exported
+    uint64_t Primitives;       // Primitives exported
+    uint64_t BusyLanes;        // Lanes exporting a vertex or a primitive
+} DispatchSimLodStats;
+
+/*******************************************************************************************************
+ * Workload of one frame as the amplification and mesh shaders would launch it.                       *
+ *                                                                                                     *
+ * A lane is one of the MS_GROUP_SIZE threads of a mesh shader group. It is busy if it exports a      *
+ * vertex, a primitive or both; every other lane of a launched group is idle.                          *
+ *******************************************************************************************************/
+typedef struct DispatchSimStats
+{
+    DispatchSimLodStats Lods[MAX_LOD_LEVELS];
+
+    uint64_t Instances;                  // Instances submitted
+    uint64_t VisibleInstances;           // Instances passing the frustum test
+    uint64_t Dispatches;                 // DispatchMesh calls recorded on the command list
+
+    uint64_t AmplificationGroups;
+    uint64_t IdleAmplificationLanes;     // Lanes without an instance (partial or capped groups)
+    uint64_t PayloadBytes;               // Payload exported by all amplification groups
+    uint64_t MaxMeshGroupsPerDispatch;   // Largest DispatchMesh issued by one amplification group
+
+    uint64_t MeshGroups;
+    uint64_t VertexLanes;                // Lanes exporting a vertex
+    uint64_t PrimitiveLanes;             // Lanes exporting a primitive
+    uint64_t BusyLanes;                  // Lanes exporting a vertex or a primitive
+} DispatchSimStats;
+
+// Size of the amplification to mesh shader payload (Payload in Common.hlsli).
+uint32_t DispatchSim_PayloadSize (void);
+
+/***************************************************************************************************
+ * Replays the culling, LOD selection, compaction and packing math of MeshletAS.hlsl and           *
+ * MeshletMS.hlsl on the CPU for every batch of the plan, and accumulates the result in 'stats'.  *
+ * 'lods' holds one mesh per LOD, constants->LODCount of them.                                     *
+ ***************************************************************************************************/
+void     DispatchSim_Run         (DispatchSimStats* const stats, const Constants* const constants, const DispatchPlan* const plan,
+                                  const Instance* const instances, const MeshletMesh* const lods);
+
+void     DispatchSim_Print       (const DispatchSimStats* const stats, uint32_t lodCount, FILE* const out);
@@ -0,0 +1,100 @@
+/*************************************************************************************
+ Headless dispatch simulator.
+
+ Loads the LOD chain, builds the same instance cube and per-frame constants as the
+ sample, then prints what the amplification and mesh shaders would launch.
+ No window and no GPU are needed.
+
+ Usage: DispatchSim [instanceLevel] [eyeX eyeY eyeZ] [lookX lookY lookZ]
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "model.h"
+#include "sample_commons.h"
+#include "scene_gen.h"
+#include "view_constants.h"
+#include "dispatch_planner.h"
+#include "dispatch_sim.h"
+
+#define SimLodCount 6
+
+static const float c_fovy = XM_PI / 3.0f;
+static const float c_aspectRatio = 1280.0f / 720.0f;
+
+int main(int argc, char** argv)
+{
+    uint32_t level = argc > 1 ? (uint32_t)atoi(argv[1]) : 10;
+    XMFLOAT3 eye = { 0, 75, 150 };
+    XMFLOAT3 look = { 0, 0, -1 };
+    if (argc > 4)
+    {
+        eye = (XMFLOAT3){ (float)atof(argv[2]), (float)atof(argv[3]), (float)atof(argv[4]) };
+    }
+    if (argc > 7)
+    {
+        look = (XMFLOAT3){ (float)atof(argv[5]), (float)atof(argv[6]), (float)atof(argv[7]) };
+    }
+
+    WCHAR basePath[512];
+    GetCurrentPath(basePath, _countof(basePath));
+
+    Model lods[SimLodCount] = { 0 };
+    MeshletMesh meshes[SimLodCount];
+    DispatchLod dispatchLods[SimLodCount];
+    for (uint32_t i = 0; i < SimLodCount; ++i)
+    {
+        wchar_t assetPath[64];
+        swprintf(assetPath, _countof(assetPath), L"lod_assets/Dragon_LOD%u.bin", i);
+
+        HRESULT hr = Model_LoadFromFile(&lods[i], basePath, assetPath);
+        if (FAILED(hr))
+        {
+            fprintf(stderr, "Failed to load %ls (0x%08X)\n", assetPath, (unsigned)hr);
+            return EXIT_FAILURE;
+        }
+
+        meshes[i] = Mesh_GetMeshletView(&lods[i].meshes[0]);
+        dispatchLods[i] = (DispatchLod){
+            .MeshletCount = meshes[i].MeshletCount,
+            .LastMeshletVertCount = meshes[i].Meshlets[meshes[i].MeshletCount - 1].VertCount,
+            .LastMeshletPrimCount = meshes[i].Meshlets[meshes[i].MeshletCount - 1].PrimCount,
+        };
+    }
+
+    const uint32_t instanceCount = SceneGen_CubeCount(level);
+    Instance* instances = malloc(instanceCount * sizeof(Instance));
+    if (!instances)
+    {
+        fprintf(stderr, "Out of memory for %u instances\n", instanceCount);
+        return EXIT_FAILURE;
+    }
+    SceneGen_Cube(instances, level, lods[0].boundingSphere.r);
+
+    DispatchPlan plan = { 0 };
+    if (!DispatchPlan_Build(&plan, dispatchLods, SimLodCount, DISPATCH_DEFAULT_GROUP_LIMITS, instanceCount))
+    {
+        fprintf(stderr, "No dispatch plan fits the threadgroup limits\n");
+        return EXIT_FAILURE;
+    }
+
+    Constants constants = { 0 };
+    ViewConstants_Build(&constants, eye, look, (XMFLOAT3){ 0, 1, 0 }, c_fovy, c_aspectRatio, 1.0f, 1e4f);
+    constants.LODCount = SimLodCount;
+
+    DispatchSimStats stats = { 0 };
+    DispatchSim_Run(&stats, &constants, &plan, instances, meshes);
+
+    printf("level %u, eye (%g, %g, %g), look (%g, %g, %g), %u instances per AS group\n",
+        level, eye.x, eye.y, eye.z, look.x, look.y, look.z, plan.instancesPerGroup);
+    DispatchSim_Print(&stats, SimLodCount, stdout);
+
+    DispatchPlan_Release(&plan);
+    free(instances);
+    for (uint32_t i = 0; i < SimLodCount; ++i)
+    {
+        free(lods[i].meshes);
+        free(lods[i].buffer);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include "frame_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// Completed frame 'index' in recording order, 0 for the oldest held.
+static const FrameStats* Oldest(const FrameStatsRing* const ring, uint32_t index)
+{
+    const uint32_t first = (ring->next + ring->capacity - ring->count) % ring->capacity;
+    return &ring->frames[(first + index) % ring->capacity];
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool FrameStatsRing_Init(FrameStatsRing* const ring, uint32_t capacity, uint32_t lodCount)
+{
+    *ring = (FrameStatsRing){ 0 };
+    ring->frames = calloc(capacity ? capacity : 1, sizeof(FrameStats));
+    if (!ring->frames)
+    {
+        return false;
+    }
+    ring->capacity = capacity ? capacity : 1;
+    ring->lodCount = lodCount < MAX_LOD_LEVELS ? lodCount : MAX_LOD_LEVELS;
+    return true;
+}
+
+void FrameStatsRing_Destroy(FrameStatsRing* const ring)
+{
+    free(ring->frames);
+    *ring = (FrameStatsRing){ 0 };
+}
+
+FrameStats* FrameStatsRing_Begin(FrameStatsRing* const ring)
+{
+    ring->current = &ring->frames[ring->next];
+    *ring->current = (FrameStats){ .Frame = ring->frameIndex };
+    return ring->current;
+}
+
+void FrameStatsRing_End(FrameStatsRing* const ring, double frameTimeMs)
+{
+    if (!ring->current)
+    {
+        return;
+    }
+    ring->current->FrameTimeMs = frameTimeMs;
+    ring->current = NULL;
+
+    ring->next = (ring->next + 1) % ring->capacity;
+    ring->count += ring->count < ring->capacity ? 1 : 0;
+    ++ring->frameIndex;
+}
+
+const FrameStats* FrameStatsRing_Get(const FrameStatsRing* const ring, uint32_t age)
+{
+    if (age >= ring->count)
+    {
+        return NULL;
+    }
+    return Oldest(ring, ring->count - 1 - age);
+}
+
+bool FrameStatsRing_WriteCsv(const FrameStatsRing* const ring, const char* const path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "frame,frameTimeMs,instancesSubmitted,instancesVisible");
+    for (uint32_t lod = 0; lod < ring->lodCount; ++lod)
+    {
+        fprintf(file, ",lod%u", lod);
+    }
+    fprintf(file, ",meshlets,triangles,bytesUploaded,drawCalls,psoChanges,lodBias,minScreenSize\n");
+
+    for (uint32_t i = 0; i < ring->count; ++i)
+    {
+        const FrameStats* s = Oldest(ring, i);
+        fprintf(file, "%llu,%.3f,%u,%u", (unsigned long long)s->Frame, s->FrameTimeMs, s->InstancesSubmitted, s->InstancesVisible);
+        for (uint32_t lod = 0; lod < ring->lodCount; ++lod)
+        {
+            fprintf(file, ",%u", s->LodHistogram[lod]);
+        }
+        fprintf(file, ",%llu,%llu,%llu,%u,%u,%.2f,%.4f\n", (unsigned long long)s->Meshlets, (unsigned long long)s->Triangles,
+            (unsigned long long)s->BytesUploaded, s->DrawCalls, s->PsoChanges, s->LodBias, s->MinScreenSize);
+    }
+
+    const bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+bool FrameStatsRing_WriteJson(const FrameStatsRing* const ring, const char* const path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"frames\": [");
+    for (uint32_t i = 0; i < ring->count; ++i)
+    {
+        const FrameStats* s = Oldest(ring, i);
+        fprintf(file, "%s\n    { \"frame\": %llu, \"frameTimeMs\": %.3f, \"instancesSubmitted\": %u, \"instancesVisible\": %u, \"lodHistogram\": [",
+            i ? "," : "", (unsigned long long)s->Frame, s->FrameTimeMs, s->InstancesSubmitted, s->InstancesVisible);
+        for (uint32_t lod = 0; lod < ring->lodCount; ++lod)
+        {
+            fprintf(file, "%s%u", lod ? ", " : "", s->LodHistogram[lod]);
+        }
+        fprintf(file, "], \"meshlets\": %llu, \"triangles\": %llu, \"bytesUploaded\": %llu, \"drawCalls\": %u, \"psoChanges\": %u, "
+            "\"lodBias\": %.2f, \"minScreenSize\": %.4f }",
+            (unsigned long long)s->Meshlets, (unsigned long long)s->Triangles, (unsigned long long)s->BytesUploaded,
+            s->DrawCalls, s->PsoChanges, s->LodBias, s->MinScreenSize);
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    const bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+void FrameStats_CountLods(FrameStats* const stats, const uint8_t* const lods, uint32_t instanceCount)
+{
+    stats->InstancesSubmitted = instanceCount;
+    stats->InstancesVisible = 0;
+    for (uint32_t lod = 0; lod < MAX_LOD_LEVELS; ++lod)
+    {
+        stats->LodHistogram[lod] = 0;
+    }
+
+    for (uint32_t i = 0; i < instanceCount; ++i)
+    {
+        if (lods[i] < MAX_LOD_LEVELS)
+        {
+            ++stats->LodHistogram[lods[i]];
+            ++stats->InstancesVisible;
+        }
+    }
+}
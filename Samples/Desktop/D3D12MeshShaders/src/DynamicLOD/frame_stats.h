@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+#define FRAME_STATS_DEFAULT_CAPACITY 1024
+#define FRAME_STATS_CULLED           0xFF // lods value of culled instances, as VISIBILITY_CULLED
+
+// Workload of one frame. Counters a path cannot observe stay 0, e.g. the sample culls on the GPU.
+typedef struct FrameStats
+{
+    uint64_t Frame;                          // Index of the frame since the ring was created
+    double   FrameTimeMs;
+
+    uint32_t InstancesSubmitted;
+    uint32_t InstancesVisible;
+    uint32_t LodHistogram[MAX_LOD_LEVELS];   // Visible instances per LOD
+
+    uint64_t Meshlets;                       // Meshlets dispatched
+    uint64_t Triangles;                      // Triangles dispatched
+    uint64_t BytesUploaded;                  // Bytes written to upload heaps or copied from them
+    uint32_t DrawCalls;                      // DispatchMesh calls
+    uint32_t PsoChanges;                     // Pipeline state objects bound
+
+    float    LodBias;                        // Constants.LODBias and MinScreenSize the frame was drawn with
+    float    MinScreenSize;
+} FrameStats;
+
+/***************************************************************************************************
+ * Ring buffer of the statistics of the last 'capacity' frames.                                    *
+ *                                                                                                 *
+ * A frame is recorded between FrameStatsRing_Begin and FrameStatsRing_End, which stamps its time. *
+ * The recorded frames can be exported as CSV or JSON, oldest first, to correlate frame times with *
+ * the workload that produced them.                                                                *
+ ***************************************************************************************************/
+typedef struct FrameStatsRing
+{
+    FrameStats* frames;
+    uint32_t    capacity;
+    uint32_t    count;      // Completed frames held, at most capacity
+    uint32_t    next;       // Slot of the frame being recorded
+    uint32_t    lodCount;   // LodHistogram entries exported
+    uint64_t    frameIndex;
+    FrameStats* current;    // Frame being recorded, NULL outside Begin/End
+} FrameStatsRing;
+
+bool              FrameStatsRing_Init     (FrameStatsRing* const ring, uint32_t capacity, uint32_t lodCount);
+void              FrameStatsRing_Destroy  (FrameStatsRing* const ring);
+
+// Starts recording a frame and returns its zeroed statistics.
+FrameStats*       FrameStatsRing_Begin    (FrameStatsRing* const ring);
+void              FrameStatsRing_End      (FrameStatsRing* const ring, double frameTimeMs);
+
+// Completed frame 'age' frames ago, 0 for the last one. NULL if the ring does not hold it.
+const FrameStats* FrameStatsRing_Get      (const FrameStatsRing* const ring, uint32_t age);
+
+// Both overwrite 'path'. Return false if it cannot be written.
+bool              FrameStatsRing_WriteCsv (const FrameStatsRing* const ring, const char* const path);
+bool              FrameStatsRing_WriteJson(const FrameStatsRing* const ring, const char* const path);
+
+// Fills the instance counts and LOD histogram from per-instance LODs, FRAME_STATS_CULLED if culled.
+void              FrameStats_CountLods    (FrameStats* const stats, const uint8_t* const lods, uint32_t instanceCount);
@@ -0,0 +1,148 @@
+/*************************************************************************************
+ Frame statistics tests.
+
+ Records more frames than the ring holds and checks what it keeps: the last
+ 'capacity' frames, numbered since creation and returned by age, with a zeroed
+ FrameStats for every new frame. Checks the LOD histogram of FrameStats_CountLods,
+ and the CSV and JSON exports byte for byte, oldest frame first, 64-bit counters
+ included. The exports are written to the working directory and removed.
+
+ Usage: FrameStatsTest
+**************************************************************************************/
+
+#include <string.h>
+#include "frame_stats.h"
+#include "test_check.h"
+
+static const char* const c_csvPath = "frame_stats_test.csv";
+static const char* const c_jsonPath = "frame_stats_test.json";
+
+// Reads a whole file into a string. Returns NULL if it cannot be read.
+static char* ReadText(const char* const path)
+{
+    FILE* file = fopen(path, "r");  // Text mode, as written: line ends read back as \n
+    if (!file)
+    {
+        return NULL;
+    }
+    char* text = calloc(1, 4096);
+    if (text)
+    {
+        fread(text, 1, 4095, file);
+    }
+    fclose(file);
+    return text;
+}
+
+// Records 'frameCount' frames, frame f drawing f calls.
+static void Record(FrameStatsRing* const ring, uint32_t frameCount)
+{
+    const uint8_t lods[] = { 0, 1, FRAME_STATS_CULLED, 3, 1, 5, FRAME_STATS_CULLED };
+    for (uint32_t f = 0; f < frameCount; ++f)
+    {
+        FrameStats* const stats = FrameStatsRing_Begin(ring);
+        CHECK(stats->Frame == f && stats->DrawCalls == 0 && stats->Meshlets == 0 && stats->LodHistogram[1] == 0);
+
+        FrameStats_CountLods(stats, lods, f < 2 ? 5 : (uint32_t)_countof(lods));
+        stats->Meshlets = 1000ull * f;
+        stats->Triangles = 5000000000ull * f;
+        stats->BytesUploaded = 256ull * f;
+        stats->DrawCalls = f;
+        stats->PsoChanges = 1;
+        stats->LodBias = 0.25f * (float)f;
+        stats->MinScreenSize = 0.0125f;
+        FrameStatsRing_End(ring, 1.5 * f);
+    }
+}
+
+static void TestRing(void)
+{
+    FrameStatsRing ring;
+    CHECK(FrameStatsRing_Init(&ring, 3, 4));
+    CHECK(FrameStatsRing_Get(&ring, 0) == NULL);
+
+    // Ending a frame that was never begun records nothing.
+    FrameStatsRing_End(&ring, 1.0);
+    CHECK(ring.count == 0 && FrameStatsRing_Get(&ring, 0) == NULL);
+
+    Record(&ring, 2);
+    CHECK(ring.count == 2);
+    CHECK(FrameStatsRing_Get(&ring, 0)->Frame == 1 && FrameStatsRing_Get(&ring, 1)->Frame == 0);
+    CHECK(FrameStatsRing_Get(&ring, 2) == NULL);
+
+    // Past the capacity, the oldest frames are dropped.
+    FrameStatsRing_Destroy(&ring);
+    CHECK(FrameStatsRing_Init(&ring, 3, 4));
+    Record(&ring, 5);
+    CHECK(ring.count == 3);
+    for (uint32_t age = 0; age < 3; ++age)
+    {
+        const FrameStats* const stats = FrameStatsRing_Get(&ring, age);
+        CHECK(stats->Frame == 4 - age && stats->DrawCalls == 4 - age && stats->FrameTimeMs == 1.5 * (4 - age));
+    }
+    CHECK(FrameStatsRing_Get(&ring, 3) == NULL);
+
+    // Two frames see 5 instances, the others 7. Culled ones are submitted, not visible, in no LOD.
+    const FrameStats* const last = FrameStatsRing_Get(&ring, 0);
+    CHECK(last->InstancesSubmitted == 7 && last->InstancesVisible == 5);
+    CHECK(last->LodHistogram[0] == 1 && last->LodHistogram[1] == 2 && last->LodHistogram[2] == 0);
+    CHECK(last->LodHistogram[3] == 1 && last->LodHistogram[5] == 1);
+
+    // Frames 2 to 4, oldest first. LOD 5 is counted but only 4 LODs are exported.
+    CHECK(FrameStatsRing_WriteCsv(&ring, c_csvPath));
+    char* const csv = ReadText(c_csvPath);
+    CHECK(csv != NULL && strcmp(csv,
+        "frame,frameTimeMs,instancesSubmitted,instancesVisible,lod0,lod1,lod2,lod3,"
+        "meshlets,triangles,bytesUploaded,drawCalls,psoChanges,lodBias,minScreenSize\n"
+        "2,3.000,7,5,1,2,0,1,2000,10000000000,512,2,1,0.50,0.0125\n"
+        "3,4.500,7,5,1,2,0,1,3000,15000000000,768,3,1,0.75,0.0125\n"
+        "4,6.000,7,5,1,2,0,1,4000,20000000000,1024,4,1,1.00,0.0125\n") == 0);
+    free(csv);
+    remove(c_csvPath);
+
+    CHECK(FrameStatsRing_WriteJson(&ring, c_jsonPath));
+    char* const json = ReadText(c_jsonPath);
+    CHECK(json != NULL && strcmp(json,
+        "{\n  \"frames\": [\n"
+        "    { \"frame\": 2, \"frameTimeMs\": 3.000, \"instancesSubmitted\": 7, \"instancesVisible\": 5, \"lodHistogram\": [1, 2, 0, 1], "
+        "\"meshlets\": 2000, \"triangles\": 10000000000, \"bytesUploaded\": 512, \"drawCalls\": 2, \"psoChanges\": 1, "
+        "\"lodBias\": 0.50, \"minScreenSize\": 0.0125 },\n"
+        "    { \"frame\": 3, \"frameTimeMs\": 4.500, \"instancesSubmitted\": 7, \"instancesVisible\": 5, \"lodHistogram\": [1, 2, 0, 1], "
+        "\"meshlets\": 3000, \"triangles\": 15000000000, \"bytesUploaded\": 768, \"drawCalls\": 3, \"psoChanges\": 1, "
+        "\"lodBias\": 0.75, \"minScreenSize\": 0.0125 },\n"
+        "    { \"frame\": 4, \"frameTimeMs\": 6.000, \"instancesSubmitted\": 7, \"instancesVisible\": 5, \"lodHistogram\": [1, 2, 0, 1], "
+        "\"meshlets\": 4000, \"triangles\": 20000000000, \"bytesUploaded\": 1024, \"drawCalls\": 4, \"psoChanges\": 1, "
+        "\"lodBias\": 1.00, \"minScreenSize\": 0.0125 }\n"
+        "  ]\n}\n") == 0);
+    free(json);
+    remove(c_jsonPath);
+
+    FrameStatsRing_Destroy(&ring);
+}
+
+static void TestEdgeCases(void)
+{
+    // A capacity of 0 holds one frame, and LOD counts past MAX_LOD_LEVELS are clamped.
+    FrameStatsRing ring;
+    CHECK(FrameStatsRing_Init(&ring, 0, MAX_LOD_LEVELS + 10));
+    CHECK(ring.capacity == 1 && ring.lodCount == MAX_LOD_LEVELS);
+    Record(&ring, 3);
+    CHECK(ring.count == 1 && FrameStatsRing_Get(&ring, 0)->Frame == 2);
+
+    // An empty ring exports an empty list.
+    FrameStatsRing_Destroy(&ring);
+    CHECK(FrameStatsRing_Init(&ring, 4, 2));
+    CHECK(FrameStatsRing_WriteJson(&ring, c_jsonPath));
+    char* const json = ReadText(c_jsonPath);
+    CHECK(json != NULL && strcmp(json, "{\n  \"frames\": [\n  ]\n}\n") == 0);
+    free(json);
+    remove(c_jsonPath);
+    FrameStatsRing_Destroy(&ring);
+}
+
+int main(void)
+{
+    TestRing();
+    TestEdgeCases();
+    return TEST_RESULT();
+}
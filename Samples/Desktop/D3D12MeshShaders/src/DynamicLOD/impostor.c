@@ -0,0 +1,219 @@
+#include "impostor.h"
+#include "instance_pack.h"
+#include "soft_raster.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static float Sign(float x)
+{
+    return x < 0.0f ? -1.0f : 1.0f;
+}
+
+static XMFLOAT3 Normalized(XMFLOAT3 v)
+{
+    const float len = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+    const float inv = len > 0.0f ? 1.0f / len : 0.0f;
+    return (XMFLOAT3){ v.x * inv, v.y * inv, v.z * inv };
+}
+
+static XMFLOAT3 Cross(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return (XMFLOAT3){ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static float Dot(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Unit direction to octahedral coordinates in [-1, 1]^2: the upper hemisphere (y >= 0) maps to the
+// inner diamond, the lower one folds onto the corners.
+static void OctEncode(XMFLOAT3 d, float* const u, float* const v)
+{
+    const float l1 = fabsf(d.x) + fabsf(d.y) + fabsf(d.z);
+    const float x = l1 > 0.0f ? d.x / l1 : 0.0f;
+    const float y = l1 > 0.0f ? d.y / l1 : 1.0f;
+    const float z = l1 > 0.0f ? d.z / l1 : 0.0f;
+    if (y >= 0.0f)
+    {
+        *u = x;
+        *v = z;
+    }
+    else
+    {
+        *u = (1.0f - fabsf(z)) * Sign(x);
+        *v = (1.0f - fabsf(x)) * Sign(z);
+    }
+}
+
+static XMFLOAT3 OctDecode(float u, float v)
+{
+    XMFLOAT3 d = { u, 1.0f - fabsf(u) - fabsf(v), v };
+    if (d.y < 0.0f)
+    {
+        d.x = (1.0f - fabsf(v)) * Sign(u);
+        d.z = (1.0f - fabsf(u)) * Sign(v);
+    }
+    return Normalized(d);
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool Impostor_Bake(ImpostorAtlas* const atlas, JobSystem* const jobs, const MeshletMesh* const mesh,
+                   XMFLOAT4 boundingSphere, uint32_t viewsPerSide, uint32_t cellSize)
+{
+    *atlas = (ImpostorAtlas){
+        .viewsPerSide = viewsPerSide,
+        .cellSize = cellSize,
+        .width = viewsPerSide * cellSize,
+        .boundingSphere = boundingSphere,
+    };
+    atlas->texels = calloc((size_t)atlas->width * atlas->width, sizeof(uint32_t));
+
+    SoftRasterizer rast;
+    if (!atlas->texels || !SoftRaster_Init(&rast, jobs, cellSize, cellSize))
+    {
+        Impostor_Destroy(atlas);
+        return false;
+    }
+
+    // A single, untransformed instance: the mesh stage outputs object-space normals.
+    XMFLOAT4X4 identity;
+    float* m = (float*)&identity;
+    for (int k = 0; k < 16; ++k)
+    {
+        m[k] = k % 5 == 0 ? 1.0f : 0.0f;
+    }
+    Instance instance;
+    Instance_Pack(&instance, &identity, boundingSphere);
+    const uint8_t lod = 0;
+
+    const XMFLOAT3 center = { boundingSphere.x, boundingSphere.y, boundingSphere.z };
+    const float r = boundingSphere.w;
+
+    bool ok = true;
+    for (uint32_t cell = 0; ok && cell < viewsPerSide * viewsPerSide; ++cell)
+    {
+        XMFLOAT3 right, up;
+        const XMFLOAT3 direction = Impostor_CellDirection(atlas, cell);
+        const XMFLOAT3 forward = { -direction.x, -direction.y, -direction.z };
+        Impostor_Basis(direction, &right, &up);
+
+        // Orthographic projection of the bounding sphere onto the whole viewport, depth in [0, 1] across it. The
+        // constant buffer holds matrices transposed: each row below is one clip-space output.
+        const float rows[4][4] =
+        {
+            { right.x / r, right.y / r, right.z / r, -Dot(right, center) / r },
+            { up.x / r, up.y / r, up.z / r, -Dot(up, center) / r },
+            { forward.x / (2.0f * r), forward.y / (2.0f * r), forward.z / (2.0f * r), 0.5f - Dot(forward, center) / (2.0f * r) },
+            { 0.0f, 0.0f, 0.0f, 1.0f },
+        };
+        Constants constants = { 0 };
+        memcpy(&constants.ViewProj, rows, sizeof(rows));
+        memcpy(&constants.View, rows, sizeof(rows));
+        constants.RenderMode = SOFT_RASTER_RENDER_NORMALS;
+        constants.LODCount = 1;
+
+        SoftRasterStats stats;
+        SoftRaster_Clear(&rast, 0);
+        ok = SoftRaster_DrawCulled(&rast, &constants, &instance, 1, &lod, mesh, &stats);
+
+        const uint32_t x0 = (cell % viewsPerSide) * cellSize;
+        const uint32_t y0 = (cell / viewsPerSide) * cellSize;
+        for (uint32_t y = 0; y < cellSize; ++y)
+        {
+            memcpy(&atlas->texels[(size_t)(y0 + y) * atlas->width + x0], &rast.color[(size_t)y * cellSize], cellSize * sizeof(uint32_t));
+        }
+    }
+
+    SoftRaster_Destroy(&rast);
+    if (!ok)
+    {
+        Impostor_Destroy(atlas);
+    }
+    return ok;
+}
+
+void Impostor_Destroy(ImpostorAtlas* const atlas)
+{
+    free(atlas->texels);
+    *atlas = (ImpostorAtlas){ 0 };
+}
+
+XMFLOAT3 Impostor_CellDirection(const ImpostorAtlas* const atlas, uint32_t cell)
+{
+    const float n = (float)atlas->viewsPerSide;
+    const float u = ((float)(cell % atlas->viewsPerSide) + 0.5f) / n * 2.0f - 1.0f;
+    const float v = ((float)(cell / atlas->viewsPerSide) + 0.5f) / n * 2.0f - 1.0f;
+    return OctDecode(u, v);
+}
+
+void Impostor_SelectViews(const ImpostorAtlas* const atlas, XMFLOAT3 direction, ImpostorViews* const views)
+{
+    float u, v;
+    OctEncode(direction, &u, &v);
+
+    // Position in cell units, cell centers at integers; clamped at the border, where the octahedral map wraps.
+    const float last = (float)(atlas->viewsPerSide - 1);
+    const float gx = fminf(fmaxf((u * 0.5f + 0.5f) * (float)atlas->viewsPerSide - 0.5f, 0.0f), last);
+    const float gy = fminf(fmaxf((v * 0.5f + 0.5f) * (float)atlas->viewsPerSide - 0.5f, 0.0f), last);
+    const uint32_t x0 = (uint32_t)gx;
+    const uint32_t y0 = (uint32_t)gy;
+    const uint32_t x1 = x0 + 1 < atlas->viewsPerSide ? x0 + 1 : x0;
+    const uint32_t y1 = y0 + 1 < atlas->viewsPerSide ? y0 + 1 : y0;
+    const float fx = gx - (float)x0;
+    const float fy = gy - (float)y0;
+
+    views->Cells[0] = y0 * atlas->viewsPerSide + x0;
+    views->Cells[1] = y0 * atlas->viewsPerSide + x1;
+    views->Cells[2] = y1 * atlas->viewsPerSide + x0;
+    views->Cells[3] = y1 * atlas->viewsPerSide + x1;
+    views->Weights[0] = (1.0f - fx) * (1.0f - fy);
+    views->Weights[1] = fx * (1.0f - fy);
+    views->Weights[2] = (1.0f - fx) * fy;
+    views->Weights[3] = fx * fy;
+}
+
+void Impostor_Basis(XMFLOAT3 direction, XMFLOAT3* const right, XMFLOAT3* const up)
+{
+    // Left-handed, like the sample's camera: right = up x forward. Straight above or below, z stands in for up.
+    const XMFLOAT3 forward = Normalized((XMFLOAT3){ -direction.x, -direction.y, -direction.z });
+    const XMFLOAT3 worldUp = fabsf(forward.y) > 0.999f ? (XMFLOAT3){ 0.0f, 0.0f, 1.0f } : (XMFLOAT3){ 0.0f, 1.0f, 0.0f };
+    *right = Normalized(Cross(worldUp, forward));
+    *up = Cross(forward, *right);
+}
+
+float Impostor_Sample(const ImpostorAtlas* const atlas, const ImpostorViews* const views, float u, float v,
+                      XMFLOAT3* const normal)
+{
+    const uint32_t last = atlas->cellSize - 1;
+    uint32_t tx = (uint32_t)fmaxf(u * (float)atlas->cellSize, 0.0f);
+    uint32_t ty = (uint32_t)fmaxf(v * (float)atlas->cellSize, 0.0f);
+    tx = tx < last ? tx : last;
+    ty = ty < last ? ty : last;
+
+    float coverage = 0.0f;
+    *normal = (XMFLOAT3){ 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 4; ++i)
+    {
+        const uint32_t cell = views->Cells[i];
+        const uint32_t x = (cell % atlas->viewsPerSide) * atlas->cellSize + tx;
+        const uint32_t y = (cell / atlas->viewsPerSide) * atlas->cellSize + ty;
+        const uint32_t texel = atlas->texels[(size_t)y * atlas->width + x];
+
+        // Transparent texels hold no normal: weighting by coverage keeps them out of the blend.
+        const float w = views->Weights[i] * (float)(texel >> 24) * (1.0f / 255.0f);
+        normal->x += w * ((float)(texel & 0xFF) * (2.0f / 255.0f) - 1.0f);
+        normal->y += w * ((float)((texel >> 8) & 0xFF) * (2.0f / 255.0f) - 1.0f);
+        normal->z += w * ((float)((texel >> 16) & 0xFF) * (2.0f / 255.0f) - 1.0f);
+        coverage += w;
+    }
+    return coverage;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+#include "meshlet_mesh.h"
+#include "job_system.h"
+
+#define IMPOSTOR_DEFAULT_VIEWS     8     // Views per side of the octahedral grid
+#define IMPOSTOR_DEFAULT_CELL_SIZE 64    // Pixels per side of a view
+#define IMPOSTOR_SCREEN_SIZE       0.05f // Suggested screen size below which the last LOD becomes an impostor
+
+// The atlas cells nearest to a view direction, with bilinear weights summing to 1.
+typedef struct ImpostorViews
+{
+    uint32_t Cells[4];
+    float    Weights[4];
+} ImpostorViews;
+
+/****************************************************************************************************
+ * Images of a model from viewsPerSide^2 directions, for drawing it as a single camera-facing quad. *
+ *                                                                                                  *
+ * The directions sit at the cell centers of an octahedral map of the sphere (y up), so every       *
+ * direction has views around it. Each cell holds an orthographic image of the bounding sphere,     *
+ * baked with the software rasterizer: the object-space normal, scaled to [0, 1], in RGB and the    *
+ * coverage in A, so that impostors are lit like the meshes at run time.                            *
+ *                                                                                                  *
+ * An image looks along -direction, with Impostor_Basis(direction) as its right and up axes. A      *
+ * quad drawn with the same basis and spanning the sphere's diameter lines up with the mesh; its    *
+ * pixels blend the nearest views at the same texture coordinates.                                  *
+ ****************************************************************************************************/
+typedef struct ImpostorAtlas
+{
+    uint32_t  viewsPerSide;
+    uint32_t  cellSize;
+    uint32_t  width;            // viewsPerSide * cellSize, the atlas is square
+    uint32_t* texels;           // RGBA8 (R in the low byte), width * width
+    XMFLOAT4  boundingSphere;   // Object space, as baked
+} ImpostorAtlas;
+
+// Renders 'mesh' from every view direction. Returns false on allocation failure.
+bool     Impostor_Bake          (ImpostorAtlas* const atlas, JobSystem* const jobs, const MeshletMesh* const mesh,
+                                 XMFLOAT4 boundingSphere, uint32_t viewsPerSide, uint32_t cellSize);
+void     Impostor_Destroy       (ImpostorAtlas* const atlas);
+
+// Unit object-space direction, from the model towards the viewer, of a cell.
+XMFLOAT3 Impostor_CellDirection (const ImpostorAtlas* const atlas, uint32_t cell);
+
+// The views nearest to an object-space direction from the model towards the viewer, which need not be normalized.
+void     Impostor_SelectViews   (const ImpostorAtlas* const atlas, XMFLOAT3 direction, ImpostorViews* const views);
+
+// Right and up axes of the image seen from 'direction', both unit length.
+void     Impostor_Basis         (XMFLOAT3 direction, XMFLOAT3* const right, XMFLOAT3* const up);
+
+// Blends the views at texture coordinates (u, v) in [0, 1], v down. Returns the coverage, and the blended object-space
+// normal, not normalized, in 'normal'.
+float    Impostor_Sample        (const ImpostorAtlas* const atlas, const ImpostorViews* const views, float u, float v,
+                                 XMFLOAT3* const normal);
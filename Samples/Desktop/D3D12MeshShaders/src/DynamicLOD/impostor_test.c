@@ -0,0 +1,321 @@
+/*************************************************************************************
+ Impostor tests.
+
+ Checks the view selection of the octahedral atlas: every cell direction selects
+ its own cell alone, and any direction gets four neighbouring cells with weights
+ summing to 1, the heaviest one near it. Checks that Impostor_Basis is
+ orthonormal and faces the viewer, straight above and below included.
+
+ Bakes a sphere and checks each view: covered in the middle and empty in the
+ corners, with the normal towards the viewer at the center and tilted up or right
+ as the texture coordinates move, so the bake lines up with Impostor_Basis. Then
+ draws a lumpy model with the software rasterizer as meshes and as impostors: the
+ silhouettes must match within 6% of the covered pixels, with two triangles per
+ impostor, and clearing the atlas must draw the meshes again bit for bit.
+
+ Usage: ImpostorTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "impostor.h"
+#include "instance_pack.h"
+#include "soft_raster.h"
+#include "test_check.h"
+#include "test_view.h"
+
+#define LATITUDES  32
+#define LONGITUDES 64
+#define WIDTH      640
+#define HEIGHT     360
+#define INSTANCE_COUNT 12
+
+static const uint32_t c_background = 0xFF402020;
+
+typedef struct TestMesh
+{
+    float    (*vertices)[6];    // Position, normal
+    uint32_t* indices;
+    uint32_t* primitives;
+    Meshlet*  meshlets;
+    MeshletMesh mesh;
+} TestMesh;
+
+static float Dot(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static float Length(XMFLOAT3 a)
+{
+    return sqrtf(Dot(a, a));
+}
+
+// Distance from the center in a direction: 1 for a sphere, bulging towards +x, +y and +z for the lumpy model.
+static float ShapeRadius(bool lumpy, float x, float y, float z)
+{
+    if (!lumpy)
+    {
+        return 1.0f;
+    }
+    const float bulge = x > 0.0f ? x * x * x * x : 0.0f;
+    return 1.0f + 0.6f * bulge + 0.25f * (y > 0.7f ? (y - 0.7f) * 3.0f : 0.0f) + 0.15f * z;
+}
+
+// A latitude-longitude mesh, one meshlet of two clockwise triangles per quad.
+static bool BuildMesh(TestMesh* const m, bool lumpy)
+{
+    const uint32_t quadCount = LATITUDES * LONGITUDES;
+    *m = (TestMesh){ 0 };
+    m->vertices = malloc(sizeof(float[6]) * quadCount * 4);
+    m->indices = malloc(sizeof(uint32_t) * quadCount * 4);
+    m->primitives = malloc(sizeof(uint32_t) * quadCount * 2);
+    m->meshlets = malloc(sizeof(Meshlet) * quadCount);
+    if (!m->vertices || !m->indices || !m->primitives || !m->meshlets)
+    {
+        return false;
+    }
+
+    for (uint32_t q = 0; q < quadCount; ++q)
+    {
+        const uint32_t a = q / LONGITUDES, b = q % LONGITUDES;
+        for (uint32_t k = 0; k < 4; ++k)
+        {
+            const float theta = XM_PI * (float)(a + (k >> 1)) / LATITUDES;
+            const float phi = 2.0f * XM_PI * (float)(b + ((k & 1) ^ (k >> 1))) / LONGITUDES;
+            const float n[3] = { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+            const float r = ShapeRadius(lumpy, n[0], n[1], n[2]);
+            float* const v = m->vertices[q * 4 + k];
+            for (int i = 0; i < 3; ++i)
+            {
+                v[i] = n[i] * r;
+                v[3 + i] = n[i];
+            }
+            m->indices[q * 4 + k] = q * 4 + k;
+        }
+        m->primitives[q * 2] = 0 | 1 << 10 | 2 << 20;
+        m->primitives[q * 2 + 1] = 0 | 2 << 10 | 3 << 20;
+        m->meshlets[q] = (Meshlet){ 4, q * 4, 2, q * 2 };
+    }
+
+    m->mesh = (MeshletMesh){
+        .Vertices = (const uint8_t*)m->vertices,
+        .VertexStride = sizeof(float[6]),
+        .VertexCount = quadCount * 4,
+        .Meshlets = m->meshlets,
+        .MeshletCount = quadCount,
+        .UniqueVertexIndices = (const uint8_t*)m->indices,
+        .IndexSize = 4,
+        .PrimitiveIndices = m->primitives,
+    };
+    return true;
+}
+
+static void DestroyMesh(TestMesh* const m)
+{
+    free(m->vertices);
+    free(m->indices);
+    free(m->primitives);
+    free(m->meshlets);
+}
+
+static void TestViewSelection(void)
+{
+    const ImpostorAtlas atlas = { .viewsPerSide = IMPOSTOR_DEFAULT_VIEWS };
+    const uint32_t cellCount = IMPOSTOR_DEFAULT_VIEWS * IMPOSTOR_DEFAULT_VIEWS;
+
+    // A cell's own direction selects that cell alone.
+    uint32_t badCells = 0;
+    for (uint32_t cell = 0; cell < cellCount; ++cell)
+    {
+        const XMFLOAT3 d = Impostor_CellDirection(&atlas, cell);
+        ImpostorViews views;
+        Impostor_SelectViews(&atlas, d, &views);
+        float weight = 0.0f;
+        for (uint32_t k = 0; k < 4; ++k)
+        {
+            weight += views.Cells[k] == cell ? views.Weights[k] : 0.0f;
+        }
+        badCells += fabsf(Length(d) - 1.0f) > 1e-5f || fabsf(weight - 1.0f) > 1e-4f;
+    }
+    CHECK(badCells == 0);
+
+    // Any direction, scaled or not: four cells, weights summing to 1, the heaviest within two cells' spacing.
+    uint32_t badWeights = 0, farViews = 0;
+    for (uint32_t i = 0; i < 10000; ++i)
+    {
+        const XMFLOAT3 d = { TestRandomFloat(-1, 1), TestRandomFloat(-1, 1), TestRandomFloat(-1, 1) };
+        const float length = Length(d);
+        if (length < 0.01f)
+        {
+            continue;
+        }
+        ImpostorViews views;
+        Impostor_SelectViews(&atlas, d, &views);
+
+        float sum = 0.0f;
+        uint32_t heaviest = 0;
+        for (uint32_t k = 0; k < 4; ++k)
+        {
+            badWeights += views.Cells[k] >= cellCount || views.Weights[k] < 0.0f;
+            sum += views.Weights[k];
+            heaviest = views.Weights[k] > views.Weights[heaviest] ? k : heaviest;
+        }
+        badWeights += fabsf(sum - 1.0f) > 1e-5f;
+        farViews += Dot(Impostor_CellDirection(&atlas, views.Cells[heaviest]), d) < 0.8f * length;
+    }
+    CHECK(badWeights == 0);
+    CHECK(farViews == 0);
+}
+
+static void TestBasis(void)
+{
+    uint32_t bad = 0;
+    for (uint32_t i = 0; i < 1002; ++i)
+    {
+        // Straight above and below, then random directions.
+        XMFLOAT3 d = i == 0 ? (XMFLOAT3){ 0, 2, 0 } : i == 1 ? (XMFLOAT3){ 0, -1, 0 }
+                   : (XMFLOAT3){ TestRandomFloat(-1, 1), TestRandomFloat(-1, 1), TestRandomFloat(-1, 1) };
+        const float length = Length(d);
+        if (length < 0.01f)
+        {
+            continue;
+        }
+        d = (XMFLOAT3){ d.x / length, d.y / length, d.z / length };
+
+        XMFLOAT3 right, up;
+        Impostor_Basis(d, &right, &up);
+        bad += fabsf(Length(right) - 1.0f) > 1e-4f || fabsf(Length(up) - 1.0f) > 1e-4f;
+        bad += fabsf(Dot(right, up)) > 1e-4f || fabsf(Dot(right, d)) > 1e-4f || fabsf(Dot(up, d)) > 1e-4f;
+
+        // Left-handed, looking along -d: right x up is the forward axis -d.
+        const XMFLOAT3 forward = { right.y * up.z - right.z * up.y, right.z * up.x - right.x * up.z, right.x * up.y - right.y * up.x };
+        bad += Dot(forward, d) > -0.999f;
+
+        // Up stays above the horizon, unless looking straight down or up.
+        bad += fabsf(d.y) < 0.99f && up.y <= 0.0f;
+    }
+    CHECK(bad == 0);
+}
+
+static void TestBakedSphere(JobSystem* const jobs)
+{
+    TestMesh sphere;
+    ImpostorAtlas atlas;
+    CHECK(BuildMesh(&sphere, false));
+    CHECK(Impostor_Bake(&atlas, jobs, &sphere.mesh, (XMFLOAT4){ 0, 0, 0, 1 }, IMPOSTOR_DEFAULT_VIEWS, IMPOSTOR_DEFAULT_CELL_SIZE));
+    CHECK(atlas.width == IMPOSTOR_DEFAULT_VIEWS * IMPOSTOR_DEFAULT_CELL_SIZE && atlas.texels != NULL);
+
+    uint32_t bad = 0;
+    for (uint32_t cell = 0; cell < IMPOSTOR_DEFAULT_VIEWS * IMPOSTOR_DEFAULT_VIEWS && atlas.texels; ++cell)
+    {
+        const XMFLOAT3 d = Impostor_CellDirection(&atlas, cell);
+        XMFLOAT3 right, up, n;
+        Impostor_Basis(d, &right, &up);
+        const ImpostorViews views = { { cell, cell, cell, cell }, { 1, 0, 0, 0 } };
+
+        // The middle faces the viewer; the corners are past the sphere's outline.
+        bad += Impostor_Sample(&atlas, &views, 0.5f, 0.5f, &n) < 0.99f || Dot(n, d) < 0.95f * Length(n);
+        bad += Impostor_Sample(&atlas, &views, 0.02f, 0.02f, &n) > 0.01f;
+        bad += Impostor_Sample(&atlas, &views, 0.98f, 0.98f, &n) > 0.01f;
+
+        // Half way up, v down, the normal tilts up by 30 degrees; half way right, it tilts right.
+        bad += Impostor_Sample(&atlas, &views, 0.5f, 0.25f, &n) < 0.99f || fabsf(Dot(n, up) / Length(n) - 0.5f) > 0.1f;
+        bad += Impostor_Sample(&atlas, &views, 0.75f, 0.5f, &n) < 0.99f || fabsf(Dot(n, right) / Length(n) - 0.5f) > 0.1f;
+    }
+    CHECK(bad == 0);
+
+    Impostor_Destroy(&atlas);
+    DestroyMesh(&sphere);
+}
+
+static void TestDraw(JobSystem* const jobs)
+{
+    const float radius = 1.75f;
+    TestMesh model;
+    ImpostorAtlas atlas;
+    CHECK(BuildMesh(&model, true));
+    CHECK(Impostor_Bake(&atlas, jobs, &model.mesh, (XMFLOAT4){ 0, 0, 0, radius }, IMPOSTOR_DEFAULT_VIEWS, IMPOSTOR_DEFAULT_CELL_SIZE));
+
+    // A grid of instances turned by different yaws, some a little off the rows.
+    Instance instances[INSTANCE_COUNT];
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        const float yaw = 0.55f * (float)i;
+        XMFLOAT4X4 world = { 0 };
+        float* const w = (float*)&world;
+        w[0] = cosf(yaw);
+        w[2] = -sinf(yaw);
+        w[8] = sinf(yaw);
+        w[10] = cosf(yaw);
+        w[5] = w[15] = 1.0f;
+        w[12] = ((float)(i % 4) - 1.5f) * 4.5f;
+        w[13] = ((float)(i / 4) - 1.0f) * 4.5f + (i % 2 ? 1.0f : 0.0f);
+        w[14] = 12.0f;
+        Instance_Pack(&instances[i], &world, (XMFLOAT4){ w[12], w[13], w[14], radius });
+    }
+
+    Constants constants = { 0 };
+    TestView_Build(&constants, (XMFLOAT3){ 0, 0, 0 }, 0.0f, 1.0472f, (float)WIDTH / HEIGHT);
+    constants.LODCount = 1;
+
+    SoftRasterizer rast;
+    SoftRasterStats stats;
+    uint32_t* const meshes = malloc(sizeof(uint32_t) * WIDTH * HEIGHT);
+    CHECK(meshes != NULL && SoftRaster_Init(&rast, jobs, WIDTH, HEIGHT));
+    if (!meshes)
+    {
+        return;
+    }
+    SoftRaster_Clear(&rast, c_background);
+    CHECK(SoftRaster_Draw(&rast, &constants, instances, INSTANCE_COUNT, &model.mesh, &stats));
+    CHECK(stats.Impostors == 0 && stats.VisibleInstances == INSTANCE_COUNT);
+    memcpy(meshes, rast.color, sizeof(uint32_t) * WIDTH * HEIGHT);
+
+    // Every instance as an impostor: two triangles each, about the same pixels.
+    SoftRaster_SetImpostors(&rast, &atlas, 1.0f);
+    SoftRaster_Clear(&rast, c_background);
+    CHECK(SoftRaster_Draw(&rast, &constants, instances, INSTANCE_COUNT, &model.mesh, &stats));
+    CHECK(stats.Impostors == INSTANCE_COUNT && stats.Triangles == 2 * INSTANCE_COUNT);
+
+    uint32_t covered = 0, mismatches = 0;
+    for (uint32_t i = 0; i < WIDTH * HEIGHT; ++i)
+    {
+        const bool mesh = meshes[i] != c_background, impostor = rast.color[i] != c_background;
+        covered += mesh;
+        mismatches += mesh != impostor;
+    }
+    CHECK(covered > 10000);
+    CHECK(mismatches < covered * 0.06f);
+
+    // Above the threshold, and with no atlas, the meshes are drawn as before.
+    SoftRaster_SetImpostors(&rast, &atlas, 0.0f);
+    SoftRaster_Clear(&rast, c_background);
+    CHECK(SoftRaster_Draw(&rast, &constants, instances, INSTANCE_COUNT, &model.mesh, &stats));
+    CHECK(stats.Impostors == 0 && memcmp(meshes, rast.color, sizeof(uint32_t) * WIDTH * HEIGHT) == 0);
+    SoftRaster_SetImpostors(&rast, NULL, 1.0f);
+    SoftRaster_Clear(&rast, c_background);
+    CHECK(SoftRaster_Draw(&rast, &constants, instances, INSTANCE_COUNT, &model.mesh, &stats));
+    CHECK(stats.Impostors == 0 && memcmp(meshes, rast.color, sizeof(uint32_t) * WIDTH * HEIGHT) == 0);
+
+    SoftRaster_Destroy(&rast);
+    free(meshes);
+    Impostor_Destroy(&atlas);
+    DestroyMesh(&model);
+}
+
+int main(void)
+{
+    JobSystem jobs;
+    if (!JobSystem_Init(&jobs, 3))
+    {
+        fprintf(stderr, "Cannot start the job system\n");
+        return EXIT_FAILURE;
+    }
+    TestViewSelection();
+    TestBasis();
+    TestBakedSphere(&jobs);
+    TestDraw(&jobs);
+    JobSystem_Destroy(&jobs);
+    return TEST_RESULT();
+}
@@ -0,0 +1,275 @@
+#include "instance_animation.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+#define ANIMATION_JOB_SIZE 4096  // Instances integrated by one job, a multiple of 4
+#define ANIMATION_PLANES   12
+
+static const float c_pi = 3.14159265f;
+static const float c_minSpeed = 0.25f;  // Fraction of the requested speed every instance moves at least
+static const float c_maxSpin = 1.0f;    // Radians per second
+
+/*****************************************************************
+    Private types
+******************************************************************/
+
+typedef struct AnimationContext
+{
+    InstanceAnimation* anim;
+    Instance*          instances;
+    float              seconds;
+} AnimationContext;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// xorshift32: reproducible across platforms, unlike rand().
+static uint32_t NextRandom(uint32_t* const state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Uniform in [lo, hi].
+static float RandomRange(uint32_t* const state, float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(NextRandom(state) >> 8) * (1.0f / 16777215.0f);
+}
+
+static __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Wraps angles to [-pi, pi], whatever the number of turns.
+static __m128 WrapAngle(__m128 a)
+{
+    const __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(a, _mm_set1_ps(0.5f / c_pi))));
+    return _mm_sub_ps(a, _mm_mul_ps(turns, _mm_set1_ps(2.0f * c_pi)));
+}
+
+// sin(a) for a in [-pi, pi], folded to [-pi/2, pi/2] for a degree 11 Taylor polynomial (error below 1e-7).
+static __m128 Sin(__m128 a)
+{
+    const __m128 halfPi = _mm_set1_ps(0.5f * c_pi);
+    const __m128 pi = _mm_set1_ps(c_pi);
+    a = Select(_mm_cmpgt_ps(a, halfPi), _mm_sub_ps(pi, a), a);
+    a = Select(_mm_cmplt_ps(a, _mm_sub_ps(_mm_setzero_ps(), halfPi)), _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), pi), a), a);
+
+    const __m128 a2 = _mm_mul_ps(a, a);
+    __m128 p = _mm_set1_ps(-1.0f / 39916800.0f);
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f / 362880.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(-1.0f / 5040.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f / 120.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(-1.0f / 6.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(p, a);
+}
+
+// Reverses the velocity of the lanes past a bound, moving them back inside.
+static void Bounce(__m128* const pos, __m128* const vel, __m128 lo, __m128 hi)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 speed = _mm_andnot_ps(sign, *vel);
+    *vel = Select(_mm_cmplt_ps(*pos, lo), speed, *vel);
+    *vel = Select(_mm_cmpgt_ps(*pos, hi), _mm_or_ps(speed, sign), *vel);
+    *pos = _mm_min_ps(_mm_max_ps(*pos, lo), hi);
+}
+
+// Writes four instances from their components: row k of 'rows' holds component k of the four lanes.
+static void StoreInstances(Instance* const out, uint32_t count, __m128 rows[4][4])
+{
+    Instance packed[4];
+    float* dst = count == 4 ? (float*)out : (float*)packed;
+    for (int k = 0; k < 4; ++k)
+    {
+        _MM_TRANSPOSE4_PS(rows[k][0], rows[k][1], rows[k][2], rows[k][3]);
+        for (int j = 0; j < 4; ++j)
+        {
+            _mm_storeu_ps(dst + j * 16 + k * 4, rows[k][j]);
+        }
+    }
+    if (count < 4)
+    {
+        memcpy(out, packed, count * sizeof(Instance));
+    }
+}
+
+static void AnimationJob(void* context, uint32_t index)
+{
+    const AnimationContext* ctx = context;
+    InstanceAnimation* anim = ctx->anim;
+    const uint32_t begin = index * ANIMATION_JOB_SIZE;
+    const uint32_t end = begin + ANIMATION_JOB_SIZE < anim->stride ? begin + ANIMATION_JOB_SIZE : anim->stride;
+
+    const __m128 dt = _mm_set1_ps(ctx->seconds);
+    const __m128 minX = _mm_set1_ps(anim->boundsMin.x);
+    const __m128 minY = _mm_set1_ps(anim->boundsMin.y);
+    const __m128 minZ = _mm_set1_ps(anim->boundsMin.z);
+    const __m128 maxX = _mm_set1_ps(anim->boundsMax.x);
+    const __m128 maxY = _mm_set1_ps(anim->boundsMax.y);
+    const __m128 maxZ = _mm_set1_ps(anim->boundsMax.z);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 halfPi = _mm_set1_ps(0.5f * c_pi);
+
+    for (uint32_t i = begin; i < end; i += 4)
+    {
+        __m128 vx = _mm_load_ps(anim->velX + i);
+        __m128 vy = _mm_load_ps(anim->velY + i);
+        __m128 vz = _mm_load_ps(anim->velZ + i);
+        __m128 px = _mm_add_ps(_mm_load_ps(anim->posX + i), _mm_mul_ps(vx, dt));
+        __m128 py = _mm_add_ps(_mm_load_ps(anim->posY + i), _mm_mul_ps(vy, dt));
+        __m128 pz = _mm_add_ps(_mm_load_ps(anim->posZ + i), _mm_mul_ps(vz, dt));
+        Bounce(&px, &vx, minX, maxX);
+        Bounce(&py, &vy, minY, maxY);
+        Bounce(&pz, &vz, minZ, maxZ);
+
+        const __m128 angle = WrapAngle(_mm_add_ps(_mm_load_ps(anim->angle + i), _mm_mul_ps(_mm_load_ps(anim->spin + i), dt)));
+        const __m128 s = Sin(angle);
+        const __m128 c = Sin(WrapAngle(_mm_add_ps(angle, halfPi)));
+
+        _mm_store_ps(anim->posX + i, px);
+        _mm_store_ps(anim->posY + i, py);
+        _mm_store_ps(anim->posZ + i, pz);
+        _mm_store_ps(anim->velX + i, vx);
+        _mm_store_ps(anim->velY + i, vy);
+        _mm_store_ps(anim->velZ + i, vz);
+        _mm_store_ps(anim->angle + i, angle);
+
+        if (i >= anim->count)
+        {
+            continue;
+        }
+
+        // World is RotationY(angle) then the translation. Its transposed rows are (c, 0, s, x),
+        // (0, 1, 0, y) and (-s, 0, c, z); the sphere center follows the same transform.
+        const __m128 cx = _mm_load_ps(anim->centerX + i);
+        const __m128 cy = _mm_load_ps(anim->centerY + i);
+        const __m128 cz = _mm_load_ps(anim->centerZ + i);
+        __m128 rows[4][4] = {
+            { c, zero, s, px },
+            { zero, one, zero, py },
+            { _mm_sub_ps(zero, s), zero, c, pz },
+            {
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(c, cx), _mm_mul_ps(s, cz)), px),
+                _mm_add_ps(cy, py),
+                _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, cz), _mm_mul_ps(s, cx)), pz),
+                _mm_load_ps((const float*)anim->packedRadius + i),
+            },
+        };
+        StoreInstances(&ctx->instances[i], anim->count - i < 4 ? anim->count - i : 4, rows);
+    }
+}
+
+static bool Reserve(InstanceAnimation* const anim, uint32_t stride)
+{
+    if (stride > anim->capacity)
+    {
+        float* planes = _mm_malloc((size_t)ANIMATION_PLANES * stride * sizeof(float), 16);
+        if (!planes)
+        {
+            return false;
+        }
+        _mm_free(anim->planes);
+        anim->planes = planes;
+        anim->capacity = stride;
+    }
+
+    float* p = anim->planes;
+    float** arrays[] = {
+        &anim->posX, &anim->posY, &anim->posZ, &anim->velX, &anim->velY, &anim->velZ,
+        &anim->angle, &anim->spin, &anim->centerX, &anim->centerY, &anim->centerZ, (float**)&anim->packedRadius,
+    };
+    for (uint32_t k = 0; k < ANIMATION_PLANES; ++k)
+    {
+        *arrays[k] = p + (size_t)k * stride;
+    }
+    memset(p, 0, (size_t)ANIMATION_PLANES * stride * sizeof(float));
+    return true;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+void InstanceAnimation_Init(InstanceAnimation* const anim, JobSystem* const jobs)
+{
+    *anim = (InstanceAnimation){ .jobs = jobs };
+}
+
+void InstanceAnimation_Destroy(InstanceAnimation* const anim)
+{
+    _mm_free(anim->planes);
+    *anim = (InstanceAnimation){ 0 };
+}
+
+bool InstanceAnimation_Start(InstanceAnimation* const anim, const Instance* const instances, uint32_t instanceCount,
+                             float speed, uint32_t seed)
+{
+    anim->count = 0;
+    if (!Reserve(anim, (instanceCount + 3) & ~3u))
+    {
+        return false;
+    }
+    anim->count = instanceCount;
+    anim->stride = (instanceCount + 3) & ~3u;
+
+    anim->boundsMin = (XMFLOAT3){ 0, 0, 0 };
+    anim->boundsMax = (XMFLOAT3){ 0, 0, 0 };
+    uint32_t state = seed ? seed : 1;
+    for (uint32_t i = 0; i < instanceCount; ++i)
+    {
+        const Instance* in = &instances[i];
+        const XMFLOAT3 pos = { in->World[0].w, in->World[1].w, in->World[2].w };
+        anim->posX[i] = pos.x;
+        anim->posY[i] = pos.y;
+        anim->posZ[i] = pos.z;
+        anim->centerX[i] = in->SphereCenter.x - pos.x;
+        anim->centerY[i] = in->SphereCenter.y - pos.y;
+        anim->centerZ[i] = in->SphereCenter.z - pos.z;
+        anim->packedRadius[i] = in->PackedRadius;
+
+        // Uniform direction, from a normalized point of the unit ball.
+        float x, y, z, lengthSq;
+        do
+        {
+            x = RandomRange(&state, -1.0f, 1.0f);
+            y = RandomRange(&state, -1.0f, 1.0f);
+            z = RandomRange(&state, -1.0f, 1.0f);
+            lengthSq = x * x + y * y + z * z;
+        } while (lengthSq > 1.0f || lengthSq < 1e-4f);
+        const float scale = RandomRange(&state, c_minSpeed, 1.0f) * speed / sqrtf(lengthSq);
+        anim->velX[i] = x * scale;
+        anim->velY[i] = y * scale;
+        anim->velZ[i] = z * scale;
+        anim->spin[i] = RandomRange(&state, -c_maxSpin, c_maxSpin);
+
+        anim->boundsMin = i == 0 ? pos : (XMFLOAT3){ fminf(anim->boundsMin.x, pos.x), fminf(anim->boundsMin.y, pos.y), fminf(anim->boundsMin.z, pos.z) };
+        anim->boundsMax = i == 0 ? pos : (XMFLOAT3){ fmaxf(anim->boundsMax.x, pos.x), fmaxf(anim->boundsMax.y, pos.y), fmaxf(anim->boundsMax.z, pos.z) };
+    }
+    return true;
+}
+
+void InstanceAnimation_Update(InstanceAnimation* const anim, Instance* const instances, float seconds,
+                              DirtyRanges* const dirty)
+{
+    if (anim->count == 0)
+    {
+        return;
+    }
+
+    AnimationContext ctx = { .anim = anim, .instances = instances, .seconds = seconds };
+    JobSystem_ParallelFor(anim->jobs, (anim->stride + ANIMATION_JOB_SIZE - 1) / ANIMATION_JOB_SIZE, AnimationJob, &ctx);
+    DirtyRanges_Add(dirty, 0, anim->count);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+#include "dirty_ranges.h"
+#include "job_system.h"
+
+typedef struct Instance Instance;
+
+/****************************************************************************************************
+ * Moves every instance of a scene each frame, to stress the upload, culling and LOD paths with a   *
+ * fully dynamic scene.                                                                             *
+ *                                                                                                  *
+ * Each instance drifts in a straight line, bouncing off the bounding box of the starting           *
+ * positions, and spins around the Y axis. The state lives in SoA arrays padded to a multiple of 4  *
+ * and is integrated four instances at a time with SSE, in parallel chunks over the job system.     *
+ * The same pass rewrites the packed World rows and bounding sphere centers of the instances.       *
+ ****************************************************************************************************/
+typedef struct InstanceAnimation
+{
+    JobSystem* jobs;
+
+    float*     planes;          // All the arrays below, 'stride' floats each
+    float*     posX;
+    float*     posY;
+    float*     posZ;
+    float*     velX;
+    float*     velY;
+    float*     velZ;
+    float*     angle;           // Rotation around Y, in [-pi, pi]
+    float*     spin;            // Radians per second
+    float*     centerX;         // Model-space bounding sphere center
+    float*     centerY;
+    float*     centerZ;
+    uint32_t*  packedRadius;    // PackedRadius of the instances, kept as is
+
+    uint32_t   count;
+    uint32_t   stride;          // count rounded up to 4
+    uint32_t   capacity;        // Floats per array allocated
+
+    XMFLOAT3   boundsMin;
+    XMFLOAT3   boundsMax;
+} InstanceAnimation;
+
+void InstanceAnimation_Init    (InstanceAnimation* const anim, JobSystem* const jobs);
+void InstanceAnimation_Destroy (InstanceAnimation* const anim);
+
+/****************************************************************************************************
+ * Takes the instances as the starting state, with random velocities up to 'speed' units per second *
+ * drawn from 'seed'. The instances must be translated copies of their models, as SceneGen_Cube     *
+ * builds them: their rotation is replaced. Returns false on allocation failure.                    *
+ ****************************************************************************************************/
+bool InstanceAnimation_Start   (InstanceAnimation* const anim, const Instance* const instances, uint32_t instanceCount,
+                                float speed, uint32_t seed);
+
+// Advances the animation by 'seconds', rewrites the instances and marks them in 'dirty'.
+void InstanceAnimation_Update  (InstanceAnimation* const anim, Instance* const instances, float seconds,
+                                DirtyRanges* const dirty);
@@ -0,0 +1,207 @@
+/*************************************************************************************
+ Instance animation tests.
+
+ Animates a cube of 15625 instances for 200 frames and replays the same motion
+ with scalar code and the C library's sinf and cosf: the packed World rows and
+ bounding sphere centers must stay within 1e-4 of it. Also checks that instances
+ stay within the starting bounds, keep their model and radius bits, are all marked
+ dirty, and move the same on worker threads as on the calling thread alone. The
+ instance count is not a multiple of 4, so the padded SIMD lanes are covered too.
+
+ Usage: InstanceAnimationTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "instance_animation.h"
+#include "instance_pack.h"
+#include "scene_gen.h"
+#include "test_check.h"
+
+#define SCENE_LEVEL 12    // 15625 instances, several jobs
+#define FRAME_COUNT 200
+
+static const float c_speed = 10.0f;
+static const float c_frameTime = 0.1f;
+static const float c_modelCenterX = 0.3f;   // The models' bounding spheres are off center
+static const float c_tolerance = 1e-4f;
+
+typedef struct ReferenceState
+{
+    float position[3];
+    float velocity[3];
+    float angle;            // Unwrapped
+} ReferenceState;
+
+static Instance* MakeScene(uint32_t* const count)
+{
+    // Two fewer than the cube, to leave the last SIMD group partly filled.
+    *count = SceneGen_CubeCount(SCENE_LEVEL) - 2;
+    Instance* const instances = malloc(sizeof(Instance) * SceneGen_CubeCount(SCENE_LEVEL));
+    if (instances)
+    {
+        SceneGen_Cube(instances, SCENE_LEVEL, 2.0f);
+        for (uint32_t i = 0; i < *count; ++i)
+        {
+            instances[i].SphereCenter.x += c_modelCenterX;
+            Instance_SetModel(&instances[i], i % 3);
+        }
+    }
+    return instances;
+}
+
+static float MaxError(float error, float value)
+{
+    return fmaxf(error, fabsf(value));
+}
+
+static void TestAgainstScalar(JobSystem* const jobs)
+{
+    uint32_t count;
+    Instance* const instances = MakeScene(&count);
+    Instance* const original = malloc(sizeof(Instance) * (count + 2));
+    ReferenceState* const reference = malloc(sizeof(ReferenceState) * count);
+    CHECK(instances && original && reference);
+    if (!instances || !original || !reference)
+    {
+        free(instances);
+        free(original);
+        free(reference);
+        return;
+    }
+    memcpy(original, instances, sizeof(Instance) * (count + 2));
+
+    InstanceAnimation anim;
+    InstanceAnimation_Init(&anim, jobs);
+    CHECK(InstanceAnimation_Start(&anim, instances, count, c_speed, 7));
+    CHECK(anim.count == count && anim.stride % 4 == 0 && anim.stride >= count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        reference[i] = (ReferenceState){
+            { anim.posX[i], anim.posY[i], anim.posZ[i] },
+            { anim.velX[i], anim.velY[i], anim.velZ[i] },
+            0.0f,
+        };
+        CHECK(sqrtf(anim.velX[i] * anim.velX[i] + anim.velY[i] * anim.velY[i] + anim.velZ[i] * anim.velZ[i]) <= c_speed * 1.0001f);
+    }
+
+    DirtyRanges dirty;
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        DirtyRanges_Clear(&dirty);
+        InstanceAnimation_Update(&anim, instances, c_frameTime, &dirty);
+        CHECK(DirtyRanges_ElementCount(&dirty) == count);
+
+        // Straight lines, bouncing off the starting bounds, and a constant spin.
+        const float lo[3] = { anim.boundsMin.x, anim.boundsMin.y, anim.boundsMin.z };
+        const float hi[3] = { anim.boundsMax.x, anim.boundsMax.y, anim.boundsMax.z };
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ReferenceState* const r = &reference[i];
+            for (int k = 0; k < 3; ++k)
+            {
+                r->position[k] += r->velocity[k] * c_frameTime;
+                if (r->position[k] < lo[k])
+                {
+                    r->velocity[k] = fabsf(r->velocity[k]);
+                    r->position[k] = lo[k];
+                }
+                if (r->position[k] > hi[k])
+                {
+                    r->velocity[k] = -fabsf(r->velocity[k]);
+                    r->position[k] = hi[k];
+                }
+            }
+            r->angle += anim.spin[i] * c_frameTime;
+        }
+    }
+
+    float error = 0.0f;
+    uint32_t outOfBounds = 0, bitsChanged = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const ReferenceState* const r = &reference[i];
+        const Instance* const in = &instances[i];
+        const float c = cosf(r->angle), s = sinf(r->angle);
+
+        // Transposed rows of RotationY(angle) then the translation: (c, 0, s, x), (0, 1, 0, y), (-s, 0, c, z).
+        error = MaxError(error, in->World[0].x - c);
+        error = MaxError(error, in->World[0].y);
+        error = MaxError(error, in->World[0].z - s);
+        error = MaxError(error, in->World[0].w - r->position[0]);
+        error = MaxError(error, in->World[1].x);
+        error = MaxError(error, in->World[1].y - 1.0f);
+        error = MaxError(error, in->World[1].z);
+        error = MaxError(error, in->World[1].w - r->position[1]);
+        error = MaxError(error, in->World[2].x + s);
+        error = MaxError(error, in->World[2].y);
+        error = MaxError(error, in->World[2].z - c);
+        error = MaxError(error, in->World[2].w - r->position[2]);
+
+        // The model-space sphere center, turned and moved with the instance.
+        error = MaxError(error, in->SphereCenter.x - (c * c_modelCenterX + r->position[0]));
+        error = MaxError(error, in->SphereCenter.y - r->position[1]);
+        error = MaxError(error, in->SphereCenter.z - (-s * c_modelCenterX + r->position[2]));
+
+        outOfBounds += in->World[0].w < anim.boundsMin.x || in->World[0].w > anim.boundsMax.x ||
+                       in->World[1].w < anim.boundsMin.y || in->World[1].w > anim.boundsMax.y ||
+                       in->World[2].w < anim.boundsMin.z || in->World[2].w > anim.boundsMax.z;
+        bitsChanged += in->PackedRadius != original[i].PackedRadius;
+    }
+    CHECK(error < c_tolerance);
+    CHECK(outOfBounds == 0);
+    CHECK(bitsChanged == 0);
+
+    // The instances past the animated ones are left alone.
+    CHECK(memcmp(&instances[count], &original[count], sizeof(Instance) * 2) == 0);
+
+    InstanceAnimation_Destroy(&anim);
+    free(instances);
+    free(original);
+    free(reference);
+}
+
+static void TestThreadCount(void)
+{
+    // The same frames on 3 workers and on the calling thread alone: chunks are independent.
+    Instance* results[2] = { NULL, NULL };
+    uint32_t count = 0;
+    const uint32_t threadCounts[2] = { 3, 0 };
+    for (int run = 0; run < 2; ++run)
+    {
+        JobSystem jobs;
+        CHECK(JobSystem_Init(&jobs, threadCounts[run]));
+        results[run] = MakeScene(&count);
+        CHECK(results[run] != NULL);
+
+        InstanceAnimation anim;
+        InstanceAnimation_Init(&anim, &jobs);
+        CHECK(results[run] && InstanceAnimation_Start(&anim, results[run], count, c_speed, 11));
+        DirtyRanges dirty;
+        DirtyRanges_Clear(&dirty);
+        for (uint32_t frame = 0; frame < 20 && results[run]; ++frame)
+        {
+            InstanceAnimation_Update(&anim, results[run], c_frameTime, &dirty);
+        }
+        InstanceAnimation_Destroy(&anim);
+        JobSystem_Destroy(&jobs);
+    }
+    CHECK(results[0] && results[1] && memcmp(results[0], results[1], sizeof(Instance) * count) == 0);
+    free(results[0]);
+    free(results[1]);
+}
+
+int main(void)
+{
+    JobSystem jobs;
+    if (!JobSystem_Init(&jobs, 2))
+    {
+        fprintf(stderr, "Cannot start the job system\n");
+        return EXIT_FAILURE;
+    }
+    TestAgainstScalar(&jobs);
+    JobSystem_Destroy(&jobs);
+
+    TestThreadCount();
+    return TEST_RESULT();
+}
@@ -0,0 +1,49 @@
+#include "instance_cull.h"
+#include <math.h>
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool InstanceCull_IsVisible(const Constants* const constants, XMFLOAT4 boundingSphere)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4 p = constants->Planes[i];
+        const float d = p.x * boundingSphere.x + p.y * boundingSphere.y + p.z * boundingSphere.z + p.w;
+        if (d < -boundingSphere.w)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+float InstanceCull_ScreenSize(const Constants* const constants, XMFLOAT4 boundingSphere)
+{
+    const float vx = boundingSphere.x - constants->ViewPosition.x;
+    const float vy = boundingSphere.y - constants->ViewPosition.y;
+    const float vz = boundingSphere.z - constants->ViewPosition.z;
+    const float r = boundingSphere.w;
+
+    // fminf, like HLSL min, drops the NaN produced when the eye is inside the sphere.
+    const float size = constants->RecipTanHalfFovy * r / sqrtf(vx * vx + vy * vy + vz * vz - r * r);
+    return fminf(size, 1.0f);
+}
+
+bool InstanceCull_IsContributing(const Constants* const constants, XMFLOAT4 boundingSphere)
+{
+    return InstanceCull_ScreenSize(constants, boundingSphere) >= constants->MinScreenSize;
+}
+
+uint32_t InstanceCull_ComputeLOD(const Constants* const constants, XMFLOAT4 boundingSphere)
+{
+    return InstanceCull_ComputeModelLOD(constants, boundingSphere, constants->LODCount);
+}
+
+uint32_t InstanceCull_ComputeModelLOD(const Constants* const constants, XMFLOAT4 boundingSphere, uint32_t lodCount)
+{
+    const float steps = (float)(lodCount - 1);
+    const float lod = (1.0f - InstanceCull_ScreenSize(constants, boundingSphere)) * steps + constants->LODBias;
+    return (uint32_t)fminf(fmaxf(lod, 0.0f), steps);
+}
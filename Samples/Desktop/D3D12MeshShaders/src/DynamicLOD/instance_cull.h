@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+typedef struct Constants Constants;
+
+// CPU versions of IsVisible, IsContributing, ScreenSize and ComputeLOD in Common.hlsli. They must produce the same results,
+// so that CPU-side tools and culling agree with the amplification shader.
+
+// World-space bounding sphere (xyz = center, w = radius) vs. the six frustum planes.
+bool     InstanceCull_IsVisible       (const Constants* const constants, XMFLOAT4 boundingSphere);
+
+// Screen-space spread of the bounding sphere, at most 1.
+float    InstanceCull_ScreenSize      (const Constants* const constants, XMFLOAT4 boundingSphere);
+
+// Screen size at least constants->MinScreenSize.
+bool     InstanceCull_IsContributing  (const Constants* const constants, XMFLOAT4 boundingSphere);
+
+// Screen size mapped onto [0, LODCount - 1], plus constants->LODBias, clamped to the same range.
+uint32_t InstanceCull_ComputeLOD      (const Constants* const constants, XMFLOAT4 boundingSphere);
+
+// Same, onto [0, lodCount - 1], for models whose LOD chain differs from constants->LODCount.
+uint32_t InstanceCull_ComputeModelLOD (const Constants* const constants, XMFLOAT4 boundingSphere, uint32_t lodCount);
@@ -0,0 +1,172 @@
+#include "instance_pack.h"
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+static const uint16_t c_halfMaxFinite = 0x7BFF; // 65504.0
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static uint32_t FloatBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float FloatFromBits(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static XMFLOAT3 Cross(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return (XMFLOAT3){ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static float Dot(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+void Instance_Pack(Instance* const out, const XMFLOAT4X4* const world, XMFLOAT4 boundingSphere)
+{
+    const float* m = (const float*)world;
+
+    // Column k of the world matrix becomes row k of the transposed 3x4 matrix.
+    for (int k = 0; k < 3; ++k)
+    {
+        out->World[k] = (XMFLOAT4){ m[0 * 4 + k], m[1 * 4 + k], m[2 * 4 + k], m[3 * 4 + k] };
+    }
+
+    out->SphereCenter = (XMFLOAT3){ boundingSphere.x, boundingSphere.y, boundingSphere.z };
+    out->PackedRadius = HalfFromFloatRoundUp(boundingSphere.w);
+}
+
+void Instance_SetModel(Instance* const out, uint32_t model)
+{
+    out->PackedRadius = (out->PackedRadius & ~(INSTANCE_MODEL_MASK << INSTANCE_MODEL_SHIFT)) | (model << INSTANCE_MODEL_SHIFT);
+}
+
+uint32_t Instance_GetModel(const Instance* const in)
+{
+    return (in->PackedRadius >> INSTANCE_MODEL_SHIFT) & INSTANCE_MODEL_MASK;
+}
+
+void Instance_SetLod(Instance* const out, uint32_t lod)
+{
+    // INSTANCE_LOD_NONE wraps to 0.
+    out->PackedRadius = (out->PackedRadius & ~(0xFu << INSTANCE_LOD_SHIFT)) | ((lod + 1) << INSTANCE_LOD_SHIFT);
+}
+
+uint32_t Instance_GetLod(const Instance* const in)
+{
+    return (in->PackedRadius >> INSTANCE_LOD_SHIFT) - 1;
+}
+
+void Instance_UnpackWorld(const Instance* const in, XMFLOAT4X4* const world)
+{
+    float* m = (float*)world;
+    for (int row = 0; row < 4; ++row)
+    {
+        m[row * 4 + 0] = (&in->World[0].x)[row];
+        m[row * 4 + 1] = (&in->World[1].x)[row];
+        m[row * 4 + 2] = (&in->World[2].x)[row];
+        m[row * 4 + 3] = row == 3 ? 1.0f : 0.0f;
+    }
+}
+
+XMFLOAT4 Instance_UnpackBoundingSphere(const Instance* const in)
+{
+    return (XMFLOAT4){
+        in->SphereCenter.x,
+        in->SphereCenter.y,
+        in->SphereCenter.z,
+        FloatFromHalf((uint16_t)(in->PackedRadius & INSTANCE_RADIUS_MASK))
+    };
+}
+
+XMFLOAT3 Instance_TransformNormal(const Instance* const in, XMFLOAT3 normal)
+{
+    const XMFLOAT3 a0 = { in->World[0].x, in->World[0].y, in->World[0].z };
+    const XMFLOAT3 a1 = { in->World[1].x, in->World[1].y, in->World[1].z };
+    const XMFLOAT3 a2 = { in->World[2].x, in->World[2].y, in->World[2].z };
+
+    // The rows of the cofactor matrix are the cross products of the other two rows.
+    const XMFLOAT3 c0 = Cross(a1, a2);
+    const XMFLOAT3 c1 = Cross(a2, a0);
+    const XMFLOAT3 c2 = Cross(a0, a1);
+
+    // Mirroring transforms have a negative determinant, which would flip the normal.
+    const float s = Dot(a0, c0) < 0.0f ? -1.0f : 1.0f;
+    return (XMFLOAT3){ s * Dot(c0, normal), s * Dot(c1, normal), s * Dot(c2, normal) };
+}
+
+uint16_t HalfFromFloatRoundUp(float value)
+{
+    // Negative, zero and NaN radii all collapse to zero.
+    if (!(value > 0.0f))
+    {
+        return 0;
+    }
+
+    const uint32_t bits = FloatBits(value);
+    const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127;
+
+    if (exponent > 15)
+    {
+        return c_halfMaxFinite;
+    }
+
+    if (exponent < -14)
+    {
+        // Subnormal half: value / 2^-24, rounded up. A result of 1024 is the smallest normal half.
+        const float scaled = value * 16777216.0f;
+        uint32_t mantissa = (uint32_t)scaled;
+        if ((float)mantissa < scaled)
+        {
+            ++mantissa;
+        }
+        return (uint16_t)mantissa;
+    }
+
+    uint32_t half = ((uint32_t)(exponent + 15) << 10) | ((bits >> 13) & 0x3FF);
+    if (bits & 0x1FFF)
+    {
+        // A carry out of the mantissa correctly bumps the exponent.
+        ++half;
+    }
+    return (uint16_t)(half > c_halfMaxFinite ? c_halfMaxFinite : half);
+}
+
+float FloatFromHalf(uint16_t half)
+{
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+
+    if (exponent == 0)
+    {
+        // Zero or subnormal: mantissa * 2^-24
+        const float value = (float)mantissa * (1.0f / 16777216.0f);
+        return sign ? -value : value;
+    }
+
+    if (exponent == 31)
+    {
+        // Infinity or NaN
+        return FloatFromBits(sign | 0x7F800000 | (mantissa << 13));
+    }
+
+    return FloatFromBits(sign | ((exponent - 15 + 127) << 23) | (mantissa << 13));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include "shared.h"
+
+typedef struct Instance Instance;
+
+#define INSTANCE_RADIUS_MASK 0xFFFFu
+#define INSTANCE_MODEL_SHIFT 16
+#define INSTANCE_MODEL_MASK  0xFFFu
+#define INSTANCE_MAX_MODELS  4096u
+#define INSTANCE_LOD_SHIFT   28
+#define INSTANCE_LOD_NONE    0xFFFFFFFFu // Instance_GetLod of instances whose LOD the shaders select
+
+/***************************************************************************************************
+ * Packs a world matrix (row-vector convention, translation in the 4th row) and a world-space     *
+ * bounding sphere (xyz = center, w = radius) into the compact GPU instance format.               *
+ *                                                                                                 *
+ * The world matrix must be affine: its 4th column is dropped and assumed to be (0, 0, 0, 1).     *
+ * The radius is rounded up to the next half, so culling with the packed sphere stays             *
+ * conservative. Radii above 65504 are clamped to the largest finite half. The model index is 0.   *
+ ***************************************************************************************************/
+void     Instance_Pack                 (Instance* const out, const XMFLOAT4X4* const world, XMFLOAT4 boundingSphere);
+
+// Model index, below INSTANCE_MAX_MODELS, stored in bits 16 to 27 of PackedRadius.
+void     Instance_SetModel             (Instance* const out, uint32_t model);
+uint32_t Instance_GetModel             (const Instance* const in);
+
+// LOD selected on the CPU, below MAX_LOD_LEVELS, stored plus one in the top 4 bits of PackedRadius. Packed instances
+// hold INSTANCE_LOD_NONE, which lets the shaders select the LOD from the screen size.
+void     Instance_SetLod               (Instance* const out, uint32_t lod);
+uint32_t Instance_GetLod               (const Instance* const in);
+
+// Rebuilds the full (non-transposed) world matrix of a packed instance.
+void     Instance_UnpackWorld          (const Instance* const in, XMFLOAT4X4* const world);
+
+// Rebuilds the world-space bounding sphere (xyz = center, w = radius) of a packed instance.
+XMFLOAT4 Instance_UnpackBoundingSphere (const Instance* const in);
+
+// Same math as the shaders: the inverse transpose of the 3x3 part of World, up to a positive scale.
+XMFLOAT3 Instance_TransformNormal      (const Instance* const in, XMFLOAT3 normal);
+
+uint16_t HalfFromFloatRoundUp          (float value);
+float    FloatFromHalf                 (uint16_t half);
@@ -0,0 +1,226 @@
+/*************************************************************************************
+ Instance packing tests.
+
+ Packs and unpacks instances on the CPU: the world matrix round trip, the half radius
+ that must never round down, the model and LOD bit fields sharing PackedRadius with it,
+ and the normal transform derived from World, mirroring worlds included.
+
+ Usage: InstancePackTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "instance_pack.h"
+#include "test_check.h"
+
+static XMFLOAT4X4 Affine(float m00, float m01, float m02,
+                         float m10, float m11, float m12,
+                         float m20, float m21, float m22,
+                         float tx, float ty, float tz)
+{
+    const float rows[16] = { m00, m01, m02, 0.0f, m10, m11, m12, 0.0f, m20, m21, m22, 0.0f, tx, ty, tz, 1.0f };
+    XMFLOAT4X4 world;
+    memcpy(&world, rows, sizeof(world));
+    return world;
+}
+
+static float At(const XMFLOAT4X4* const m, int row, int column)
+{
+    return ((const float*)m)[row * 4 + column];
+}
+
+static uint16_t RadiusBits(const Instance* const in)
+{
+    return (uint16_t)(in->PackedRadius & INSTANCE_RADIUS_MASK);
+}
+
+// The half rounded to must hold the value, and the half just below it must not: rounding up, and never further.
+static void CheckRoundsUp(float value)
+{
+    const uint16_t half = HalfFromFloatRoundUp(value);
+    CHECK(FloatFromHalf(half) >= value);
+    CHECK(half == 0 || FloatFromHalf((uint16_t)(half - 1)) < value);
+}
+
+static void TestWorldRoundTrip(void)
+{
+    const XMFLOAT4X4 worlds[] = {
+        Affine(1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0),
+        Affine(2, 0, 0, 0, 1, 0, 0, 0, -1, 5, 6, 7),
+        Affine(0.36f, 0.48f, -0.8f, -0.8f, 0.6f, 0.0f, 0.48f, 0.64f, 0.6f, -120.5f, 3.25f, 1e4f),
+        Affine(1e-3f, 7, -3, 0.5f, -2e3f, 11, 13, 17, 19, -1e6f, 1e-6f, 42),
+    };
+
+    for (size_t i = 0; i < _countof(worlds); ++i)
+    {
+        Instance in;
+        const XMFLOAT3 translation = { At(&worlds[i], 3, 0), At(&worlds[i], 3, 1), At(&worlds[i], 3, 2) };
+        Instance_Pack(&in, &worlds[i], (XMFLOAT4){ translation.x, translation.y, translation.z, 1.5f });
+
+        XMFLOAT4X4 unpacked;
+        Instance_UnpackWorld(&in, &unpacked);
+        CHECK(memcmp(&unpacked, &worlds[i], sizeof(unpacked)) == 0);
+
+        // The GPU reads the transposed rows.
+        for (int k = 0; k < 3; ++k)
+        {
+            CHECK(in.World[k].x == At(&worlds[i], 0, k) && in.World[k].y == At(&worlds[i], 1, k));
+            CHECK(in.World[k].z == At(&worlds[i], 2, k) && in.World[k].w == At(&worlds[i], 3, k));
+        }
+
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&in);
+        CHECK(sphere.x == translation.x && sphere.y == translation.y && sphere.z == translation.z);
+        CHECK(sphere.w == 1.5f);
+    }
+}
+
+static void TestRadiusRoundsUp(void)
+{
+    // Exact halves are kept as they are.
+    CHECK(HalfFromFloatRoundUp(1.0f) == 0x3C00);
+    CHECK(HalfFromFloatRoundUp(0.5f) == 0x3800);
+    CHECK(HalfFromFloatRoundUp(1.5f) == 0x3E00);
+    CHECK(HalfFromFloatRoundUp(65504.0f) == 0x7BFF);
+    CHECK(HalfFromFloatRoundUp(ldexpf(1.0f, -14)) == 0x0400);   // Smallest normal
+    CHECK(HalfFromFloatRoundUp(ldexpf(5.0f, -24)) == 0x0005);   // Subnormal
+
+    // Anything in between goes to the next half.
+    CHECK(HalfFromFloatRoundUp(nextafterf(1.0f, 2.0f)) == 0x3C01);
+    CHECK(HalfFromFloatRoundUp(1e-9f) == 0x0001);               // Below the smallest subnormal
+    CHECK(HalfFromFloatRoundUp(ldexpf(5.5f, -24)) == 0x0006);
+
+    // A mantissa carry moves to the next exponent: just above the largest half below 2, and just
+    // above the largest subnormal.
+    CHECK(HalfFromFloatRoundUp(1.9995f) == 0x4000);
+    CHECK(HalfFromFloatRoundUp(nextafterf(ldexpf(1023.0f, -24), 1.0f)) == 0x0400);
+
+    // Past the largest finite half the radius is clamped, never turned into an infinity.
+    CHECK(HalfFromFloatRoundUp(65505.0f) == 0x7BFF);
+    CHECK(HalfFromFloatRoundUp(65520.0f) == 0x7BFF);
+    CHECK(HalfFromFloatRoundUp(70000.0f) == 0x7BFF);
+    CHECK(HalfFromFloatRoundUp(1e30f) == 0x7BFF);
+    CHECK(HalfFromFloatRoundUp(INFINITY) == 0x7BFF);
+
+    // Zero, negative and NaN radii are zero.
+    CHECK(HalfFromFloatRoundUp(0.0f) == 0);
+    CHECK(HalfFromFloatRoundUp(-0.0f) == 0);
+    CHECK(HalfFromFloatRoundUp(-1.0f) == 0);
+    CHECK(HalfFromFloatRoundUp(-1e-9f) == 0);
+    CHECK(HalfFromFloatRoundUp(NAN) == 0);
+
+    // Every half decodes to itself, and every float in the half range rounds up to the nearest one.
+    for (uint32_t half = 0; half <= 0x7BFF; ++half)
+    {
+        CHECK(HalfFromFloatRoundUp(FloatFromHalf((uint16_t)half)) == (half == 0 ? 0 : half));
+    }
+    uint32_t random = 12345;
+    for (int i = 0; i < 1000000; ++i)
+    {
+        random = random * 1664525u + 1013904223u;
+        const float value = ldexpf((float)(random >> 8) / 16777216.0f, (int)(random % 42) - 26);
+        if (value <= 65504.0f)
+        {
+            CheckRoundsUp(value);
+        }
+    }
+}
+
+static void TestBitFields(void)
+{
+    const XMFLOAT4X4 world = Affine(1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0);
+    const float radii[] = { 0.0f, 1e-6f, 1.0f, 3.3f, 65504.0f };
+
+    for (size_t r = 0; r < _countof(radii); ++r)
+    {
+        Instance in;
+        Instance_Pack(&in, &world, (XMFLOAT4){ 0, 0, 0, radii[r] });
+        const uint16_t radius = RadiusBits(&in);
+
+        // A freshly packed instance has model 0 and lets the shaders select its LOD.
+        CHECK(Instance_GetModel(&in) == 0);
+        CHECK(Instance_GetLod(&in) == INSTANCE_LOD_NONE);
+
+        for (uint32_t model = 0; model < INSTANCE_MAX_MODELS; model += (model < 16 ? 1 : 255))
+        {
+            for (uint32_t lod = 0; lod <= MAX_LOD_LEVELS; ++lod)
+            {
+                const uint32_t packedLod = lod == MAX_LOD_LEVELS ? INSTANCE_LOD_NONE : lod;
+
+                Instance_SetModel(&in, model);
+                Instance_SetLod(&in, packedLod);
+                CHECK(Instance_GetModel(&in) == model);
+                CHECK(Instance_GetLod(&in) == packedLod);
+                CHECK(RadiusBits(&in) == radius);
+
+                // Setting one field again leaves the other two alone.
+                Instance_SetModel(&in, INSTANCE_MAX_MODELS - 1 - model);
+                CHECK(Instance_GetLod(&in) == packedLod);
+                Instance_SetLod(&in, INSTANCE_LOD_NONE);
+                CHECK(Instance_GetModel(&in) == INSTANCE_MAX_MODELS - 1 - model);
+                CHECK(Instance_GetLod(&in) == INSTANCE_LOD_NONE);
+                CHECK(RadiusBits(&in) == radius);
+                CHECK(Instance_UnpackBoundingSphere(&in).w == FloatFromHalf(radius));
+            }
+        }
+    }
+}
+
+static XMFLOAT3 TransformVector(const XMFLOAT4X4* const m, XMFLOAT3 v)
+{
+    return (XMFLOAT3){
+        v.x * At(m, 0, 0) + v.y * At(m, 1, 0) + v.z * At(m, 2, 0),
+        v.x * At(m, 0, 1) + v.y * At(m, 1, 1) + v.z * At(m, 2, 1),
+        v.x * At(m, 0, 2) + v.y * At(m, 1, 2) + v.z * At(m, 2, 2),
+    };
+}
+
+static float Dot3(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static void TestNormals(void)
+{
+    // Determinants of both signs: rotation, non-uniform scale, a mirror, a mirrored shear.
+    const XMFLOAT4X4 worlds[] = {
+        Affine(0.36f, 0.48f, -0.8f, -0.8f, 0.6f, 0.0f, 0.48f, 0.64f, 0.6f, 1, 2, 3),
+        Affine(3, 0, 0, 0, 0.5f, 0, 0, 0, 2, 0, 0, 0),
+        Affine(-1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0),
+        Affine(2, 0, 0, 0, 1, 0, 0, 0, -1, 5, 6, 7),
+        Affine(1, 0.5f, 0, 0, -2, 0.25f, 0.3f, 0, -0.7f, 0, 0, 0),
+    };
+    const XMFLOAT3 normals[] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0.6f, -0.8f, 0 }, { 0.48f, 0.6f, 0.64f } };
+
+    for (size_t w = 0; w < _countof(worlds); ++w)
+    {
+        Instance in;
+        Instance_Pack(&in, &worlds[w], (XMFLOAT4){ 0, 0, 0, 1 });
+
+        for (size_t i = 0; i < _countof(normals); ++i)
+        {
+            const XMFLOAT3 n = normals[i];
+            const XMFLOAT3 transformed = Instance_TransformNormal(&in, n);
+
+            // Still perpendicular to the surface: to the transformed tangents.
+            const XMFLOAT3 helper = fabsf(n.x) < 0.9f ? (XMFLOAT3){ 1, 0, 0 } : (XMFLOAT3){ 0, 1, 0 };
+            const XMFLOAT3 t1 = { n.y * helper.z - n.z * helper.y, n.z * helper.x - n.x * helper.z, n.x * helper.y - n.y * helper.x };
+            const XMFLOAT3 t2 = { n.y * t1.z - n.z * t1.y, n.z * t1.x - n.x * t1.z, n.x * t1.y - n.y * t1.x };
+            const float length = sqrtf(Dot3(transformed, transformed));
+            CHECK(length > 0.0f);
+            CHECK(fabsf(Dot3(transformed, TransformVector(&worlds[w], t1))) <= 1e-5f * length * 8.0f);
+            CHECK(fabsf(Dot3(transformed, TransformVector(&worlds[w], t2))) <= 1e-5f * length * 8.0f);
+
+            // Not flipped: a point moved along the normal is still on the outer side once transformed.
+            CHECK(Dot3(transformed, TransformVector(&worlds[w], n)) > 0.0f);
+        }
+    }
+}
+
+int main(void)
+{
+    TestWorldRoundTrip();
+    TestRadiusRoundsUp();
+    TestBitFields();
+    TestNormals();
+    return TEST_RESULT();
+}
@@ -0,0 +1,140 @@
+#include "instance_sort.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+static const uint32_t c_lodBits = 8;
+static const uint32_t c_keyBytes = 3;   // 12 bits of model index, 8 bits of LOD
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static bool Reserve(InstanceSort* const sort, uint32_t count)
+{
+    if (count <= sort->capacity)
+    {
+        return true;
+    }
+
+    InstanceSort_Destroy(sort);
+    sort->keys = malloc(count * sizeof(uint32_t));
+    sort->order = malloc(count * sizeof(uint32_t));
+    sort->scratchKeys = malloc(count * sizeof(uint32_t));
+    sort->scratchOrder = malloc(count * sizeof(uint32_t));
+    sort->scratch = malloc((size_t)count * sizeof(Instance));
+    if (!sort->keys || !sort->order || !sort->scratchKeys || !sort->scratchOrder || !sort->scratch)
+    {
+        InstanceSort_Destroy(sort);
+        return false;
+    }
+    sort->capacity = count;
+    return true;
+}
+
+static uint32_t SortKey(const Instance* const instance, const Constants* const constants,
+                        const ModelDesc* const models, uint32_t modelCount)
+{
+    const uint32_t model = Instance_GetModel(instance);
+    const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(instance);
+
+    uint32_t lod = INSTANCE_SORT_CULLED;
+    if (model < modelCount && InstanceCull_IsVisible(constants, sphere))
+    {
+        // The LOD the amplification shader draws: the one selected on the CPU, if any.
+        lod = Instance_GetLod(instance);
+        if (lod >= models[model].LODCount)
+        {
+            lod = InstanceCull_ComputeModelLOD(constants, sphere, models[model].LODCount);
+        }
+    }
+    return model << c_lodBits | lod;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool InstanceSort_ByModelLod(InstanceSort* const sort, Instance* const instances, uint32_t count,
+                             const Constants* const constants, const ModelDesc* const models, uint32_t modelCount)
+{
+    if (count == 0)
+    {
+        return true;
+    }
+    if (!Reserve(sort, count))
+    {
+        return false;
+    }
+
+    // One histogram per key byte, all filled by a single read of the instances.
+    uint32_t histograms[3][256] = { 0 };
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t key = SortKey(&instances[i], constants, models, modelCount);
+        sort->keys[i] = key;
+        sort->order[i] = i;
+        for (uint32_t b = 0; b < c_keyBytes; ++b)
+        {
+            histograms[b][(key >> (8 * b)) & 0xFF]++;
+        }
+    }
+
+    for (uint32_t b = 0; b < c_keyBytes; ++b)
+    {
+        const uint32_t shift = 8 * b;
+        uint32_t* histogram = histograms[b];
+
+        // Every key has the same byte: the pass would not move anything.
+        if (histogram[(sort->keys[0] >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < 256; ++d)
+        {
+            const uint32_t n = histogram[d];
+            histogram[d] = offset;
+            offset += n;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t key = sort->keys[i];
+            const uint32_t slot = histogram[(key >> shift) & 0xFF]++;
+            sort->scratchKeys[slot] = key;
+            sort->scratchOrder[slot] = sort->order[i];
+        }
+
+        uint32_t* keys = sort->keys;
+        sort->keys = sort->scratchKeys;
+        sort->scratchKeys = keys;
+
+        uint32_t* order = sort->order;
+        sort->order = sort->scratchOrder;
+        sort->scratchOrder = order;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        sort->scratch[i] = instances[sort->order[i]];
+    }
+    memcpy(instances, sort->scratch, (size_t)count * sizeof(Instance));
+    return true;
+}
+
+void InstanceSort_Destroy(InstanceSort* const sort)
+{
+    free(sort->keys);
+    free(sort->order);
+    free(sort->scratchKeys);
+    free(sort->scratchOrder);
+    free(sort->scratch);
+    *sort = (InstanceSort){ 0 };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+typedef struct Constants Constants;
+typedef struct Instance Instance;
+typedef struct ModelDesc ModelDesc;
+
+#define INSTANCE_SORT_CULLED 0xFFu // LOD digit of culled instances: after every LOD of their model
+
+/****************************************************************************************************
+ * Reorders instances by (model, LOD), so that the instances culled by one amplification group      *
+ * share few meshes. MeshletAS.hlsl buckets the visible instances of a group by mesh: each distinct *
+ * mesh costs a pass of its compaction loop and one partly filled last-meshlet mesh group.          *
+ *                                                                                                  *
+ * The key is model << 8 | LOD, the LOD being the one the shaders draw: the LOD the instance carries *
+ * (see lod_select.h), or else the one they select for the given constants. It is                   *
+ * INSTANCE_SORT_CULLED for instances outside the frustum. It is sorted by an LSD radix sort, one   *
+ * byte per pass, skipping the bytes all keys share. The sort is stable, so instances keep the      *
+ * spatial order of the generator within a bucket.                                                  *
+ ****************************************************************************************************/
+typedef struct InstanceSort
+{
+    uint32_t* keys;
+    uint32_t* order;            // Original index of the instance at each sorted position
+    uint32_t* scratchKeys;
+    uint32_t* scratchOrder;
+    Instance* scratch;
+    uint32_t  capacity;
+} InstanceSort;
+
+/****************************************************************************************************
+ * Sorts 'instances' in place. 'models' gives the LOD count of each of the 'modelCount' models;     *
+ * instances of other models sort as culled. Returns false on allocation failure, leaving the       *
+ * instances untouched.                                                                             *
+ ****************************************************************************************************/
+bool InstanceSort_ByModelLod (InstanceSort* const sort, Instance* const instances, uint32_t count,
+                              const Constants* const constants, const ModelDesc* const models, uint32_t modelCount);
+
+void InstanceSort_Destroy    (InstanceSort* const sort);
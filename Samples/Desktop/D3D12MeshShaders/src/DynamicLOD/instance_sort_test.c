@@ -0,0 +1,191 @@
+/*************************************************************************************
+ Instance sort tests.
+
+ Sorts random multi-model scenes by (model, LOD) and checks the result against a
+ stable comparison sort of the keys the header describes: the instances end up in
+ key order, equal keys keep their original order, and the output is a permutation
+ of the input, as recorded in 'order'. Covers instances carrying a CPU-selected LOD,
+ culled instances, instances of unknown models, a single key, and empty scenes.
+
+ Usage: InstanceSortTest
+**************************************************************************************/
+
+#include <string.h>
+#include "instance_sort.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include "scene_gen.h"
+#include "test_check.h"
+
+#define SCENE_LEVEL 20
+#define MODEL_COUNT 300
+
+typedef struct KeyedIndex
+{
+    uint32_t key;
+    uint32_t index;
+} KeyedIndex;
+
+// Key order, then original order: a stable sort written as a comparison sort.
+static int CompareKeyedIndices(const void* a, const void* b)
+{
+    const KeyedIndex* const left = a;
+    const KeyedIndex* const right = b;
+    if (left->key != right->key)
+    {
+        return left->key < right->key ? -1 : 1;
+    }
+    return (left->index > right->index) - (left->index < right->index);
+}
+
+// The key as instance_sort.h specifies it, written out independently of instance_sort.c.
+static uint32_t ReferenceKey(const Instance* const instance, const Constants* const constants, const ModelDesc* const models, uint32_t modelCount)
+{
+    const uint32_t model = Instance_GetModel(instance);
+    const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(instance);
+    if (model >= modelCount || !InstanceCull_IsVisible(constants, sphere))
+    {
+        return model << 8 | INSTANCE_SORT_CULLED;
+    }
+    const uint32_t carried = Instance_GetLod(instance);
+    const uint32_t lod = carried < models[model].LODCount ? carried : InstanceCull_ComputeModelLOD(constants, sphere, models[model].LODCount);
+    return model << 8 | lod;
+}
+
+// Sorts a copy of 'instances' and compares it with the reference order.
+static void CheckSort(InstanceSort* const sort, const Instance* const instances, uint32_t count,
+                      const Constants* const constants, const ModelDesc* const models, uint32_t modelCount)
+{
+    Instance* const sorted = malloc(sizeof(Instance) * (count > 0 ? count : 1));
+    KeyedIndex* const expected = malloc(sizeof(KeyedIndex) * (count > 0 ? count : 1));
+    CHECK(sorted != NULL && expected != NULL);
+    if (!sorted || !expected)
+    {
+        free(sorted);
+        free(expected);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        sorted[i] = instances[i];
+        expected[i] = (KeyedIndex){ ReferenceKey(&instances[i], constants, models, modelCount), i };
+    }
+    if (count > 1)
+    {
+        qsort(expected, count, sizeof(KeyedIndex), CompareKeyedIndices);
+    }
+
+    CHECK(InstanceSort_ByModelLod(sort, sorted, count, constants, models, modelCount));
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mismatches += sort->order[i] != expected[i].index;
+        mismatches += memcmp(&sorted[i], &instances[expected[i].index], sizeof(Instance)) != 0;
+    }
+    CHECK(mismatches == 0);
+
+    free(sorted);
+    free(expected);
+}
+
+static Instance* MakeScene(uint32_t* const instanceCount)
+{
+    *instanceCount = SceneGen_CubeCount(SCENE_LEVEL);
+    Instance* const instances = malloc(sizeof(Instance) * *instanceCount);
+    if (instances)
+    {
+        SceneGen_Generate(instances, SceneLayoutRandom, SCENE_LEVEL, 3.0f, 7);
+    }
+    return instances;
+}
+
+// Culls the half-space x >= 0 only, with the LODs of a camera on the z axis.
+static Constants HalfSpaceConstants(void)
+{
+    Constants constants = { 0 };
+    constants.Planes[0] = (XMFLOAT4){ 1, 0, 0, 0 };
+    for (int i = 1; i < 6; ++i)
+    {
+        constants.Planes[i] = (XMFLOAT4){ 0, 0, 0, 1 };
+    }
+    constants.ViewPosition = (XMFLOAT3){ 0, 0, 300 };
+    constants.RecipTanHalfFovy = 1.7f;
+    constants.LODCount = 6;
+    return constants;
+}
+
+static void TestRandomModels(void)
+{
+    uint32_t count;
+    Instance* const instances = MakeScene(&count);
+    CHECK(instances != NULL);
+    if (!instances)
+    {
+        return;
+    }
+
+    ModelDesc models[MODEL_COUNT];
+    for (uint32_t m = 0; m < MODEL_COUNT; ++m)
+    {
+        models[m] = (ModelDesc){ 0, 1 + m % MAX_LOD_LEVELS };
+    }
+    const Constants constants = HalfSpaceConstants();
+    InstanceSort sort = { 0 };
+
+    // Random models, some past the model count, and a few LODs selected on the CPU, some past their model's chain.
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Instance_SetModel(&instances[i], TestRandom() % (MODEL_COUNT + 20));
+        if (TestRandom() % 8 == 0)
+        {
+            Instance_SetLod(&instances[i], TestRandom() % MAX_LOD_LEVELS);
+        }
+    }
+    CheckSort(&sort, instances, count, &constants, models, MODEL_COUNT);
+
+    // Few models: the model bytes above the first are all equal, and their passes skipped.
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Instance_SetModel(&instances[i], TestRandom() % 3);
+    }
+    CheckSort(&sort, instances, count, &constants, models, MODEL_COUNT);
+
+    // A single key, and smaller scenes reusing the buffers.
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Instance_SetModel(&instances[i], 5);
+        Instance_SetLod(&instances[i], 2);
+    }
+    CheckSort(&sort, instances, count, &constants, models, MODEL_COUNT);
+    CheckSort(&sort, instances, 1, &constants, models, MODEL_COUNT);
+    CheckSort(&sort, instances, 0, &constants, models, MODEL_COUNT);
+
+    // No models: everything sorts as culled, by model index.
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Instance_SetModel(&instances[i], TestRandom() % INSTANCE_MAX_MODELS);
+    }
+    CheckSort(&sort, instances, count, &constants, models, 0);
+
+    InstanceSort_Destroy(&sort);
+    free(instances);
+}
+
+static void TestEmpty(void)
+{
+    // An empty scene sorts with nothing allocated yet.
+    const Constants constants = HalfSpaceConstants();
+    const ModelDesc model = { 0, 1 };
+    Instance instance;
+    InstanceSort sort = { 0 };
+    CHECK(InstanceSort_ByModelLod(&sort, &instance, 0, &constants, &model, 1));
+    InstanceSort_Destroy(&sort);
+}
+
+int main(void)
+{
+    TestRandomModels();
+    TestEmpty();
+    return TEST_RESULT();
+}
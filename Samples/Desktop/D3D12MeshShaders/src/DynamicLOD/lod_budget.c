@@ -0,0 +1,107 @@
+#include "lod_budget.h"
+#include <math.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+static const float c_smoothing = 0.25f;          // Weight of the newest frame in the load
+static const float c_overTolerance = 0.05f;      // Load above 1 + this coarsens the scene
+static const float c_underTolerance = 0.15f;     // Load below 1 - this refines it
+static const uint32_t c_settleFrames = 4;        // Frames for a change to show in the measurements
+static const float c_maxBias = (float)(MAX_LOD_LEVELS - 1);
+static const float c_firstMinScreenSize = 0.005f;
+static const float c_maxMinScreenSize = 0.1f;
+static const float c_minScreenSizeGrowth = 1.5f;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static bool Coarsen(LodBudget* const budget)
+{
+    if (budget->bias < c_maxBias)
+    {
+        budget->bias = fminf(budget->bias + LOD_BUDGET_BIAS_STEP, c_maxBias);
+        return true;
+    }
+    if (budget->minScreenSize < c_maxMinScreenSize)
+    {
+        budget->minScreenSize = budget->minScreenSize > 0.0f
+            ? fminf(budget->minScreenSize * c_minScreenSizeGrowth, c_maxMinScreenSize)
+            : c_firstMinScreenSize;
+        return true;
+    }
+    return false;
+}
+
+static bool Refine(LodBudget* const budget)
+{
+    if (budget->minScreenSize > 0.0f)
+    {
+        budget->minScreenSize /= c_minScreenSizeGrowth;
+        budget->minScreenSize = budget->minScreenSize < c_firstMinScreenSize ? 0.0f : budget->minScreenSize;
+        return true;
+    }
+    if (budget->bias > -c_maxBias)
+    {
+        budget->bias = fmaxf(budget->bias - LOD_BUDGET_BIAS_STEP, -c_maxBias);
+        return true;
+    }
+    return false;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+void LodBudget_Init(LodBudget* const budget, float targetMs, uint64_t triangleBudget)
+{
+    *budget = (LodBudget){
+        .targetMs = targetMs,
+        .triangleBudget = triangleBudget,
+        .load = 1.0f,
+    };
+}
+
+bool LodBudget_Update(LodBudget* const budget, double frameTimeMs, uint64_t triangles)
+{
+    float load = 0.0f;
+    if (budget->targetMs > 0.0f)
+    {
+        load = (float)(frameTimeMs / budget->targetMs);
+    }
+    if (budget->triangleBudget > 0 && triangles > 0)
+    {
+        load = fmaxf(load, (float)((double)triangles / (double)budget->triangleBudget));
+    }
+    if (load == 0.0f)
+    {
+        return false;
+    }
+    budget->load += c_smoothing * (load - budget->load);
+
+    if (budget->settleFrames > 0)
+    {
+        --budget->settleFrames;
+        return false;
+    }
+
+    bool changed = false;
+    if (budget->load > 1.0f + c_overTolerance)
+    {
+        changed = Coarsen(budget);
+    }
+    else if (budget->load < 1.0f - c_underTolerance)
+    {
+        changed = Refine(budget);
+    }
+    budget->settleFrames = changed ? c_settleFrames : 0;
+    return changed;
+}
+
+void LodBudget_Apply(const LodBudget* const budget, Constants* const constants)
+{
+    constants->LODBias = budget->bias;
+    constants->MinScreenSize = budget->minScreenSize;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+typedef struct Constants Constants;
+
+#define LOD_BUDGET_BIAS_STEP  0.25f  // The bias moves by whole steps, so the LODs it selects stay put between changes
+#define LOD_BUDGET_HYSTERESIS 0.25f  // Suggested per-instance hysteresis, in LODs, for CPU LOD selection (see VisibilityCache)
+
+/****************************************************************************************************
+ * Feedback controller holding a frame time target, a triangle budget or both.                      *
+ *                                                                                                  *
+ * Every frame, the measured frame time and triangle count are divided by their budget, and the     *
+ * larger ratio is smoothed into the load. Above 1 plus a small tolerance, the controller coarsens  *
+ * the scene: first the LOD bias grows, one step at a time, up to the last LOD of every instance;   *
+ * then the minimum screen size of contributing instances grows, culling the smallest. Below a      *
+ * wider tolerance under 1, it undoes those in reverse order, and keeps lowering the bias into      *
+ * negative values while there is headroom, refining the scene.                                     *
+ *                                                                                                  *
+ * The two tolerances and a few frames of settling after each change keep the controller from       *
+ * oscillating around the target. The result reaches the shaders through Constants.LODBias and      *
+ * Constants.MinScreenSize.                                                                         *
+ ****************************************************************************************************/
+typedef struct LodBudget
+{
+    float    targetMs;          // 0 for no frame time target
+    uint64_t triangleBudget;    // 0 for no triangle budget
+
+    float    load;              // Smoothed ratio of the workload to the budget
+    float    bias;              // Multiple of LOD_BUDGET_BIAS_STEP
+    float    minScreenSize;
+    uint32_t settleFrames;      // Frames to wait before the next change
+} LodBudget;
+
+void LodBudget_Init   (LodBudget* const budget, float targetMs, uint64_t triangleBudget);
+
+// Feeds the measurements of a frame; 0 triangles when they are unknown. Returns true if the bias or size changed.
+bool LodBudget_Update (LodBudget* const budget, double frameTimeMs, uint64_t triangles);
+
+// Writes the current LODBias and MinScreenSize to the constants.
+void LodBudget_Apply  (const LodBudget* const budget, Constants* const constants);
@@ -0,0 +1,190 @@
+/*************************************************************************************
+ LOD budget tests.
+
+ Drives the controller with a simulated renderer whose frame time shrinks by 30%
+ for every LOD of bias and with the minimum screen size. Checks that the bias only
+ moves by whole steps, waits for each change to settle, converges under the target
+ and then holds still; that the minimum screen size only grows once the bias is at
+ the last LOD, and is undone first when there is headroom, down to a negative bias;
+ the triangle budget on its own; a controller without a budget; and
+ LodBudget_Apply.
+
+ Usage: LodBudgetTest
+**************************************************************************************/
+
+#include <math.h>
+#include "lod_budget.h"
+#include "test_check.h"
+
+static const float c_targetMs = 16.6f;
+static const float c_maxBias = (float)(MAX_LOD_LEVELS - 1);
+static const uint32_t c_minChangeGap = 5;    // A change and the frames it settles for
+
+typedef struct Simulation
+{
+    LodBudget budget;
+    uint32_t changes;
+    uint32_t lastChange;
+    uint32_t frame;
+    uint32_t badSteps;      // Bias changes other than one step, or off the step grid
+    uint32_t badOrder;      // A minimum size below the last LOD, or both moving at once
+    uint32_t badGaps;       // Changes closer than the settling allows
+} Simulation;
+
+// Frame time of the simulated renderer: 'workMs' at bias 0, less with coarser LODs and culling.
+static double FrameTimeMs(const LodBudget* const budget, double workMs)
+{
+    return workMs * pow(0.7, budget->bias) * (1.0 - 4.0 * budget->minScreenSize) + TestRandomFloat(-0.1f, 0.1f);
+}
+
+static void Step(Simulation* const sim, double frameTimeMs, uint64_t triangles)
+{
+    const float bias = sim->budget.bias;
+    const float minScreenSize = sim->budget.minScreenSize;
+    const bool changed = LodBudget_Update(&sim->budget, frameTimeMs, triangles);
+    const LodBudget* const b = &sim->budget;
+
+    CHECK(changed == (b->bias != bias || b->minScreenSize != minScreenSize));
+    sim->badSteps += b->bias != bias && fabsf(fabsf(b->bias - bias) - LOD_BUDGET_BIAS_STEP) > 1e-6f;
+    sim->badSteps += b->bias != floorf(b->bias / LOD_BUDGET_BIAS_STEP) * LOD_BUDGET_BIAS_STEP;
+    sim->badOrder += b->minScreenSize > 0.0f && b->bias != c_maxBias;
+    sim->badOrder += b->bias != bias && b->minScreenSize != minScreenSize;
+    if (changed)
+    {
+        sim->badGaps += sim->changes > 0 && sim->frame - sim->lastChange < c_minChangeGap;
+        sim->lastChange = sim->frame;
+        ++sim->changes;
+    }
+    ++sim->frame;
+}
+
+static void CheckWellBehaved(const Simulation* const sim)
+{
+    CHECK(sim->badSteps == 0);
+    CHECK(sim->badOrder == 0);
+    CHECK(sim->badGaps == 0);
+}
+
+static void TestConvergence(void)
+{
+    Simulation sim = { 0 };
+    LodBudget_Init(&sim.budget, c_targetMs, 0);
+    CHECK(sim.budget.bias == 0.0f && sim.budget.minScreenSize == 0.0f && sim.budget.load == 1.0f);
+
+    // 40 ms of work: the bias grows until the frame fits, then holds for the rest of the run.
+    for (uint32_t f = 0; f < 300; ++f)
+    {
+        Step(&sim, FrameTimeMs(&sim.budget, 40.0), 0);
+    }
+    CHECK(sim.budget.bias > 0.0f && sim.budget.minScreenSize == 0.0f);
+    CHECK(sim.frame - sim.lastChange > 150);
+    CHECK(FrameTimeMs(&sim.budget, 40.0) < c_targetMs * 1.05f);
+    CHECK(sim.changes < 20);
+
+    // Down to 10 ms: the bias comes back past 0 to refine the scene, and holds again.
+    const uint32_t changes = sim.changes;
+    for (uint32_t f = 0; f < 300; ++f)
+    {
+        Step(&sim, FrameTimeMs(&sim.budget, 10.0), 0);
+    }
+    CHECK(sim.budget.bias < 0.0f && sim.budget.minScreenSize == 0.0f);
+    CHECK(sim.frame - sim.lastChange > 150);
+    CHECK(FrameTimeMs(&sim.budget, 10.0) > c_targetMs * 0.8f);
+    CHECK(sim.changes - changes < 20);
+    CheckWellBehaved(&sim);
+}
+
+static void TestOverload(void)
+{
+    // Far over the target: the bias runs out before any instance is culled for its size.
+    Simulation sim = { 0 };
+    LodBudget_Init(&sim.budget, c_targetMs, 0);
+    for (uint32_t f = 0; f < 500; ++f)
+    {
+        Step(&sim, 5000.0, 0);
+    }
+    CHECK(sim.budget.bias == c_maxBias);
+    CHECK(sim.budget.minScreenSize > 0.0f && sim.budget.minScreenSize <= 0.1f);
+
+    // Everything is at its limit: nothing changes any more.
+    const uint32_t changes = sim.changes;
+    for (uint32_t f = 0; f < 20; ++f)
+    {
+        Step(&sim, 5000.0, 0);
+    }
+    CHECK(sim.changes == changes);
+
+    // Far under it: the minimum size goes first, then the bias, down to its negative limit.
+    for (uint32_t f = 0; f < 500; ++f)
+    {
+        Step(&sim, 1.0, 0);
+    }
+    CHECK(sim.budget.bias == -c_maxBias && sim.budget.minScreenSize == 0.0f);
+    CheckWellBehaved(&sim);
+}
+
+static void TestTriangleBudget(void)
+{
+    // Triangles alone, halving with every LOD of bias; no frame time target.
+    Simulation sim = { 0 };
+    LodBudget_Init(&sim.budget, 0.0f, 1000000);
+    for (uint32_t f = 0; f < 300; ++f)
+    {
+        const uint64_t triangles = (uint64_t)(6000000.0 * pow(0.5, sim.budget.bias));
+        Step(&sim, 1000.0, triangles);
+    }
+    CHECK(sim.budget.bias > 2.0f && sim.budget.bias < 3.0f);
+    CHECK(sim.frame - sim.lastChange > 150);
+    CheckWellBehaved(&sim);
+
+    // Unknown triangle counts are not measurements.
+    const LodBudget before = sim.budget;
+    for (uint32_t f = 0; f < 20; ++f)
+    {
+        CHECK(!LodBudget_Update(&sim.budget, 1000.0, 0));
+    }
+    CHECK(sim.budget.load == before.load && sim.budget.bias == before.bias);
+
+    // With both budgets, the larger load wins.
+    LodBudget_Init(&sim.budget, c_targetMs, 1000000);
+    for (uint32_t f = 0; f < 20; ++f)
+    {
+        LodBudget_Update(&sim.budget, 1.0, 4000000);
+    }
+    CHECK(sim.budget.bias > 0.0f);
+}
+
+static void TestNoBudget(void)
+{
+    LodBudget budget;
+    LodBudget_Init(&budget, 0.0f, 0);
+    for (uint32_t f = 0; f < 50; ++f)
+    {
+        CHECK(!LodBudget_Update(&budget, 100.0, 10000000));
+    }
+    CHECK(budget.bias == 0.0f && budget.minScreenSize == 0.0f);
+}
+
+static void TestApply(void)
+{
+    LodBudget budget;
+    LodBudget_Init(&budget, c_targetMs, 0);
+    budget.bias = -1.25f;
+    budget.minScreenSize = 0.0075f;
+
+    Constants constants = { 0 };
+    constants.LODCount = 5;
+    LodBudget_Apply(&budget, &constants);
+    CHECK(constants.LODBias == -1.25f && constants.MinScreenSize == 0.0075f);
+    CHECK(constants.LODCount == 5);
+}
+
+int main(void)
+{
+    TestConvergence();
+    TestOverload();
+    TestTriangleBudget();
+    TestNoBudget();
+    TestApply();
+    return TEST_RESULT();
+}
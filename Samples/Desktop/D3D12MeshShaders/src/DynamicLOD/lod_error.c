@@ -0,0 +1,435 @@
+#include "lod_error.h"
+#include "shared.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+static const float c_cellsPerTriangle = 4.0f;   // Upper bound of the grid size, in cells per reference triangle
+
+/*****************************************************************
+    Private types
+******************************************************************/
+
+// Reference triangles binned by the cells their bounding box overlaps.
+typedef struct TriangleGrid
+{
+    const MeshletMesh* mesh;
+    uint32_t*          corners;         // 3 vertex indices per triangle
+    uint32_t           triangleCount;
+
+    XMFLOAT3           origin;
+    float              cellSize;
+    int32_t            dims[3];
+    uint32_t*          cellStart;       // Triangles of cell c: cellTriangles[cellStart[c], cellStart[c + 1])
+    uint32_t*          cellTriangles;
+
+    uint32_t*          stamps;          // Last query that tested each triangle, as triangles span several cells
+    uint32_t           stamp;
+} TriangleGrid;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static XMFLOAT3 Sub(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return (XMFLOAT3){ a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static float Dot(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static XMFLOAT3 Cross(XMFLOAT3 a, XMFLOAT3 b)
+{
+    return (XMFLOAT3){ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static XMFLOAT3 Lerp(XMFLOAT3 a, XMFLOAT3 b, float t)
+{
+    return (XMFLOAT3){ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+}
+
+static float DistanceSq(XMFLOAT3 a, XMFLOAT3 b)
+{
+    const XMFLOAT3 d = Sub(a, b);
+    return Dot(d, d);
+}
+
+static XMFLOAT3 Position(const MeshletMesh* const mesh, uint32_t vertex)
+{
+    XMFLOAT3 p;
+    memcpy(&p, mesh->Vertices + (size_t)vertex * mesh->VertexStride, sizeof(p));
+    return p;
+}
+
+static uint32_t UniqueVertexIndex(const MeshletMesh* const mesh, uint32_t index)
+{
+    if (mesh->IndexSize == 4)
+    {
+        uint32_t v;
+        memcpy(&v, mesh->UniqueVertexIndices + (size_t)index * 4, sizeof(v));
+        return v;
+    }
+    uint16_t v;
+    memcpy(&v, mesh->UniqueVertexIndices + (size_t)index * 2, sizeof(v));
+    return v;
+}
+
+// Vertex indices of every triangle of every meshlet. NULL on allocation failure, or without triangles.
+static uint32_t* GatherTriangles(const MeshletMesh* const mesh, uint32_t* const triangleCount)
+{
+    uint32_t count = 0;
+    for (uint32_t m = 0; m < mesh->MeshletCount; ++m)
+    {
+        count += mesh->Meshlets[m].PrimCount;
+    }
+    *triangleCount = count;
+    if (count == 0)
+    {
+        return NULL;
+    }
+
+    uint32_t* corners = malloc((size_t)count * 3 * sizeof(uint32_t));
+    if (!corners)
+    {
+        return NULL;
+    }
+
+    uint32_t* out = corners;
+    for (uint32_t m = 0; m < mesh->MeshletCount; ++m)
+    {
+        const Meshlet* meshlet = &mesh->Meshlets[m];
+        for (uint32_t p = 0; p < meshlet->PrimCount; ++p)
+        {
+            const uint32_t packed = mesh->PrimitiveIndices[meshlet->PrimOffset + p];
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                *out++ = UniqueVertexIndex(mesh, meshlet->VertOffset + ((packed >> (10 * k)) & 0x3FF));
+            }
+        }
+    }
+    return corners;
+}
+
+// Squared distance from p to the closest point of triangle abc, after Ericson's Real-Time Collision Detection.
+static float PointTriangleDistanceSq(XMFLOAT3 p, XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c)
+{
+    const XMFLOAT3 ab = Sub(b, a);
+    const XMFLOAT3 ac = Sub(c, a);
+
+    const XMFLOAT3 ap = Sub(p, a);
+    const float d1 = Dot(ab, ap);
+    const float d2 = Dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        return Dot(ap, ap);
+    }
+
+    const XMFLOAT3 bp = Sub(p, b);
+    const float d3 = Dot(ab, bp);
+    const float d4 = Dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+    {
+        return Dot(bp, bp);
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        return DistanceSq(p, Lerp(a, b, d1 / (d1 - d3)));
+    }
+
+    const XMFLOAT3 cp = Sub(p, c);
+    const float d5 = Dot(ab, cp);
+    const float d6 = Dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+    {
+        return Dot(cp, cp);
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        return DistanceSq(p, Lerp(a, c, d2 / (d2 - d6)));
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+    {
+        return DistanceSq(p, Lerp(b, c, (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+
+    // Inside the face. Degenerate triangles, which have no face, are covered by their edges.
+    const float sum = va + vb + vc;
+    if (!(sum > 0.0f))
+    {
+        return fminf(fminf(Dot(ap, ap), Dot(bp, bp)), Dot(cp, cp));
+    }
+    const float v = vb / sum;
+    const float w = vc / sum;
+    const XMFLOAT3 q = { a.x + ab.x * v + ac.x * w, a.y + ab.y * v + ac.y * w, a.z + ab.z * v + ac.z * w };
+    return DistanceSq(p, q);
+}
+
+static int32_t CellCoord(const TriangleGrid* const grid, float value, float origin, int axis)
+{
+    const float cell = floorf((value - origin) / grid->cellSize);
+    const float last = (float)(grid->dims[axis] - 1);
+    return (int32_t)fminf(fmaxf(cell, 0.0f), last);
+}
+
+static size_t CellIndex(const TriangleGrid* const grid, int32_t x, int32_t y, int32_t z)
+{
+    return ((size_t)z * grid->dims[1] + y) * grid->dims[0] + x;
+}
+
+static void TriangleCells(const TriangleGrid* const grid, uint32_t t, int32_t lo[3], int32_t hi[3])
+{
+    const XMFLOAT3 a = Position(grid->mesh, grid->corners[t * 3 + 0]);
+    const XMFLOAT3 b = Position(grid->mesh, grid->corners[t * 3 + 1]);
+    const XMFLOAT3 c = Position(grid->mesh, grid->corners[t * 3 + 2]);
+
+    lo[0] = CellCoord(grid, fminf(fminf(a.x, b.x), c.x), grid->origin.x, 0);
+    lo[1] = CellCoord(grid, fminf(fminf(a.y, b.y), c.y), grid->origin.y, 1);
+    lo[2] = CellCoord(grid, fminf(fminf(a.z, b.z), c.z), grid->origin.z, 2);
+    hi[0] = CellCoord(grid, fmaxf(fmaxf(a.x, b.x), c.x), grid->origin.x, 0);
+    hi[1] = CellCoord(grid, fmaxf(fmaxf(a.y, b.y), c.y), grid->origin.y, 1);
+    hi[2] = CellCoord(grid, fmaxf(fmaxf(a.z, b.z), c.z), grid->origin.z, 2);
+}
+
+static void Grid_Destroy(TriangleGrid* const grid)
+{
+    free(grid->corners);
+    free(grid->cellStart);
+    free(grid->cellTriangles);
+    free(grid->stamps);
+    *grid = (TriangleGrid){ 0 };
+}
+
+static bool Grid_Build(TriangleGrid* const grid, const MeshletMesh* const mesh)
+{
+    *grid = (TriangleGrid){ .mesh = mesh };
+    grid->corners = GatherTriangles(mesh, &grid->triangleCount);
+    if (grid->triangleCount == 0)
+    {
+        return true;
+    }
+    if (!grid->corners)
+    {
+        return false;
+    }
+
+    XMFLOAT3 lo = { FLT_MAX, FLT_MAX, FLT_MAX };
+    XMFLOAT3 hi = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    double area = 0.0;
+    for (uint32_t t = 0; t < grid->triangleCount; ++t)
+    {
+        const XMFLOAT3 p[3] = {
+            Position(mesh, grid->corners[t * 3 + 0]),
+            Position(mesh, grid->corners[t * 3 + 1]),
+            Position(mesh, grid->corners[t * 3 + 2]),
+        };
+        for (int k = 0; k < 3; ++k)
+        {
+            lo = (XMFLOAT3){ fminf(lo.x, p[k].x), fminf(lo.y, p[k].y), fminf(lo.z, p[k].z) };
+            hi = (XMFLOAT3){ fmaxf(hi.x, p[k].x), fmaxf(hi.y, p[k].y), fmaxf(hi.z, p[k].z) };
+        }
+        const XMFLOAT3 n = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+        area += 0.5 * sqrt((double)Dot(n, n));
+    }
+
+    // Cells about twice the size of a mean triangle hold a few triangles each, but flat or thin meshes would
+    // need too many of them: the volume bounds the cell count.
+    const float count = (float)grid->triangleCount;
+    XMFLOAT3 extent = Sub(hi, lo);
+    const float largest = fmaxf(fmaxf(extent.x, extent.y), fmaxf(extent.z, FLT_MIN));
+    extent = (XMFLOAT3){ fmaxf(extent.x, largest * 1e-3f), fmaxf(extent.y, largest * 1e-3f), fmaxf(extent.z, largest * 1e-3f) };
+    grid->cellSize = fmaxf(2.0f * sqrtf((float)(area / count)), cbrtf(extent.x * extent.y * extent.z / (c_cellsPerTriangle * count)));
+    grid->origin = lo;
+    grid->dims[0] = (int32_t)fmaxf(ceilf(extent.x / grid->cellSize), 1.0f);
+    grid->dims[1] = (int32_t)fmaxf(ceilf(extent.y / grid->cellSize), 1.0f);
+    grid->dims[2] = (int32_t)fmaxf(ceilf(extent.z / grid->cellSize), 1.0f);
+
+    const size_t cellCount = (size_t)grid->dims[0] * grid->dims[1] * grid->dims[2];
+    grid->cellStart = calloc(cellCount + 1, sizeof(uint32_t));
+    grid->stamps = calloc(grid->triangleCount, sizeof(uint32_t));
+    if (!grid->cellStart || !grid->stamps)
+    {
+        Grid_Destroy(grid);
+        return false;
+    }
+
+    // Count the triangles of each cell, turn the counts into cell ends, then fill each cell backwards so
+    // that the ends become starts.
+    for (uint32_t t = 0; t < grid->triangleCount; ++t)
+    {
+        int32_t l[3], h[3];
+        TriangleCells(grid, t, l, h);
+        for (int32_t z = l[2]; z <= h[2]; ++z)
+            for (int32_t y = l[1]; y <= h[1]; ++y)
+                for (int32_t x = l[0]; x <= h[0]; ++x)
+                    ++grid->cellStart[CellIndex(grid, x, y, z)];
+    }
+
+    uint32_t total = 0;
+    for (size_t c = 0; c < cellCount; ++c)
+    {
+        total += grid->cellStart[c];
+        grid->cellStart[c] = total;
+    }
+    grid->cellStart[cellCount] = total;
+
+    grid->cellTriangles = malloc((size_t)total * sizeof(uint32_t));
+    if (!grid->cellTriangles)
+    {
+        Grid_Destroy(grid);
+        return false;
+    }
+
+    for (uint32_t t = 0; t < grid->triangleCount; ++t)
+    {
+        int32_t l[3], h[3];
+        TriangleCells(grid, t, l, h);
+        for (int32_t z = l[2]; z <= h[2]; ++z)
+            for (int32_t y = l[1]; y <= h[1]; ++y)
+                for (int32_t x = l[0]; x <= h[0]; ++x)
+                    grid->cellTriangles[--grid->cellStart[CellIndex(grid, x, y, z)]] = t;
+    }
+    return true;
+}
+
+static void TestCell(TriangleGrid* const grid, XMFLOAT3 p, int32_t x, int32_t y, int32_t z, float* const bestSq)
+{
+    const size_t cell = CellIndex(grid, x, y, z);
+    for (uint32_t i = grid->cellStart[cell]; i < grid->cellStart[cell + 1]; ++i)
+    {
+        const uint32_t t = grid->cellTriangles[i];
+        if (grid->stamps[t] == grid->stamp)
+        {
+            continue;
+        }
+        grid->stamps[t] = grid->stamp;
+
+        const float d = PointTriangleDistanceSq(p,
+            Position(grid->mesh, grid->corners[t * 3 + 0]),
+            Position(grid->mesh, grid->corners[t * 3 + 1]),
+            Position(grid->mesh, grid->corners[t * 3 + 2]));
+        *bestSq = d < *bestSq ? d : *bestSq;
+    }
+}
+
+// Squared distance from p to the reference surface.
+static float Grid_DistanceSq(TriangleGrid* const grid, XMFLOAT3 p)
+{
+    // A point outside the grid searches from the nearest cell: it is no closer to the other cells than that
+    // cell's nearest point is, so the ring bound below still holds.
+    const int32_t c[3] = {
+        CellCoord(grid, p.x, grid->origin.x, 0),
+        CellCoord(grid, p.y, grid->origin.y, 1),
+        CellCoord(grid, p.z, grid->origin.z, 2),
+    };
+    ++grid->stamp;
+
+    float bestSq = FLT_MAX;
+    for (int32_t k = 0; ; ++k)
+    {
+        // The cells k cells away from c along some axis, and no further along any.
+        int32_t lo[3], hi[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            lo[axis] = c[axis] - k > 0 ? c[axis] - k : 0;
+            hi[axis] = c[axis] + k < grid->dims[axis] - 1 ? c[axis] + k : grid->dims[axis] - 1;
+        }
+        for (int32_t y = lo[1]; y <= hi[1]; ++y)
+        {
+            for (int32_t x = lo[0]; x <= hi[0]; ++x)
+            {
+                if (abs(x - c[0]) == k || abs(y - c[1]) == k)
+                {
+                    for (int32_t z = lo[2]; z <= hi[2]; ++z)
+                    {
+                        TestCell(grid, p, x, y, z, &bestSq);
+                    }
+                }
+                else
+                {
+                    if (c[2] - k >= 0)
+                    {
+                        TestCell(grid, p, x, y, c[2] - k, &bestSq);
+                    }
+                    if (c[2] + k < grid->dims[2])
+                    {
+                        TestCell(grid, p, x, y, c[2] + k, &bestSq);
+                    }
+                }
+            }
+        }
+
+        // Cells further away are at least k cells from p's own.
+        const float reach = (float)k * grid->cellSize;
+        const bool covered = lo[0] == 0 && lo[1] == 0 && lo[2] == 0 &&
+                             hi[0] == grid->dims[0] - 1 && hi[1] == grid->dims[1] - 1 && hi[2] == grid->dims[2] - 1;
+        if (bestSq <= reach * reach || covered)
+        {
+            return bestSq;
+        }
+    }
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+float LodError_Estimate(const MeshletMesh* const reference, const MeshletMesh* const lod)
+{
+    TriangleGrid grid;
+    if (!Grid_Build(&grid, reference))
+    {
+        return -1.0f;
+    }
+    if (grid.triangleCount == 0)
+    {
+        // Nothing to measure against.
+        Grid_Destroy(&grid);
+        return 0.0f;
+    }
+
+    uint32_t triangleCount;
+    uint32_t* corners = GatherTriangles(lod, &triangleCount);
+    if (!corners && triangleCount > 0)
+    {
+        Grid_Destroy(&grid);
+        return -1.0f;
+    }
+
+    // The vertices the meshlets use: the vertex buffer may be a pool shared with the other LODs.
+    float maxSq = 0.0f;
+    for (uint32_t m = 0; m < lod->MeshletCount; ++m)
+    {
+        const Meshlet* meshlet = &lod->Meshlets[m];
+        for (uint32_t v = 0; v < meshlet->VertCount; ++v)
+        {
+            maxSq = fmaxf(maxSq, Grid_DistanceSq(&grid, Position(lod, UniqueVertexIndex(lod, meshlet->VertOffset + v))));
+        }
+    }
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const XMFLOAT3 a = Position(lod, corners[t * 3 + 0]);
+        const XMFLOAT3 b = Position(lod, corners[t * 3 + 1]);
+        const XMFLOAT3 c = Position(lod, corners[t * 3 + 2]);
+        const XMFLOAT3 centroid = { (a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f };
+        maxSq = fmaxf(maxSq, Grid_DistanceSq(&grid, centroid));
+    }
+
+    free(corners);
+    Grid_Destroy(&grid);
+    return sqrtf(maxSq);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include "meshlet_mesh.h"
+
+/****************************************************************************************************
+ * Geometric error of a simplified mesh, for LOD files that do not carry it (see                    *
+ * Mesh.GeometricError).                                                                            *
+ *                                                                                                  *
+ * The error is the largest distance from the vertices and triangle centroids of 'lod' to the       *
+ * surface of 'reference', its full-detail LOD: a one-sided Hausdorff distance, sampled. The        *
+ * centroids catch the flattening between vertices that stayed on the surface.                      *
+ *                                                                                                  *
+ * The reference triangles are binned in a uniform grid sized after their mean area, and each       *
+ * sample searches the cells around its own, ring by ring, until no closer triangle can remain.     *
+ ****************************************************************************************************/
+
+// In the units of the vertex positions. Negative on allocation failure.
+float LodError_Estimate (const MeshletMesh* const reference, const MeshletMesh* const lod);
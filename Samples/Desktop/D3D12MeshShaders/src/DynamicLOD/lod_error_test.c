@@ -0,0 +1,310 @@
+/*************************************************************************************
+ LOD error tests.
+
+ Compares LodError_Estimate with a brute-force search, in double precision and
+ over every reference triangle, on spheres of decreasing tessellation: the grid
+ search must find the same largest distance from the LOD's vertices and centroids
+ to the reference surface. Also covers LODs grown or shrunk past the reference,
+ points far outside its grid, a flat reference, 2- and 4-byte vertex indices, and
+ an identical or empty reference.
+
+ Usage: LodErrorTest
+**************************************************************************************/
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lod_error.h"
+#include "test_check.h"
+
+typedef struct TestMesh
+{
+    float*      positions;      // x, y, z, then an unused normal slot, as a vertex stride of 24 bytes
+    uint8_t*    indices;
+    uint32_t*   primitives;
+    Meshlet*    meshlets;
+    MeshletMesh mesh;
+} TestMesh;
+
+typedef struct Vec3d
+{
+    double x, y, z;
+} Vec3d;
+
+// A point of a latitude-longitude sphere, or of a plane in xz with waves of height proportional to the radius when 'flat'.
+static void SurfacePoint(bool flat, uint32_t a, uint32_t b, uint32_t rows, uint32_t columns, float radius, float* const p)
+{
+    if (flat)
+    {
+        const float x = 2.0f * (float)b / (float)columns - 1.0f;
+        const float z = 2.0f * (float)a / (float)rows - 1.0f;
+        p[0] = x;
+        p[1] = radius * 0.1f * sinf(3.0f * x) * cosf(2.0f * z);
+        p[2] = z;
+        return;
+    }
+    const float theta = 3.14159265f * (float)a / (float)rows;
+    const float phi = 6.28318531f * (float)b / (float)columns;
+    p[0] = radius * sinf(theta) * cosf(phi);
+    p[1] = radius * cosf(theta);
+    p[2] = radius * sinf(theta) * sinf(phi);
+}
+
+// A (rows + 1) x (columns + 1) vertex grid shared by every meshlet, each meshlet holding one row of quads.
+static bool BuildMesh(TestMesh* const m, bool flat, uint32_t rows, uint32_t columns, float radius, uint32_t indexSize)
+{
+    const uint32_t vertexCount = (rows + 1) * (columns + 1);
+    *m = (TestMesh){ 0 };
+    m->positions = malloc(sizeof(float) * 6 * vertexCount);
+    m->indices = malloc((size_t)indexSize * rows * (columns + 1) * 2);
+    m->primitives = malloc(sizeof(uint32_t) * rows * columns * 2);
+    m->meshlets = malloc(sizeof(Meshlet) * rows);
+    if (!m->positions || !m->indices || !m->primitives || !m->meshlets)
+    {
+        return false;
+    }
+
+    for (uint32_t a = 0; a <= rows; ++a)
+    {
+        for (uint32_t b = 0; b <= columns; ++b)
+        {
+            float* const p = &m->positions[6 * (a * (columns + 1) + b)];
+            SurfacePoint(flat, a, b, rows, columns, radius, p);
+            p[3] = p[4] = p[5] = 0.0f;
+        }
+    }
+
+    // Meshlet a uses the vertices of rows a and a + 1: local vertex k is column k % (columns + 1) of row a + k / (columns + 1).
+    for (uint32_t a = 0; a < rows; ++a)
+    {
+        const uint32_t vertOffset = a * (columns + 1) * 2;
+        for (uint32_t k = 0; k < (columns + 1) * 2; ++k)
+        {
+            const uint32_t vertex = (a + k / (columns + 1)) * (columns + 1) + k % (columns + 1);
+            if (indexSize == 2)
+            {
+                const uint16_t index = (uint16_t)vertex;
+                memcpy(m->indices + (size_t)(vertOffset + k) * 2, &index, 2);
+            }
+            else
+            {
+                memcpy(m->indices + (size_t)(vertOffset + k) * 4, &vertex, 4);
+            }
+        }
+        for (uint32_t b = 0; b < columns; ++b)
+        {
+            const uint32_t top = b, bottom = columns + 1 + b;
+            m->primitives[(a * columns + b) * 2] = top | (top + 1) << 10 | bottom << 20;
+            m->primitives[(a * columns + b) * 2 + 1] = (top + 1) | (bottom + 1) << 10 | bottom << 20;
+        }
+        m->meshlets[a] = (Meshlet){ (columns + 1) * 2, vertOffset, columns * 2, a * columns * 2 };
+    }
+
+    m->mesh = (MeshletMesh){
+        .Vertices = (const uint8_t*)m->positions,
+        .VertexStride = sizeof(float) * 6,
+        .VertexCount = vertexCount,
+        .Meshlets = m->meshlets,
+        .MeshletCount = rows,
+        .UniqueVertexIndices = m->indices,
+        .IndexSize = indexSize,
+        .PrimitiveIndices = m->primitives,
+    };
+    return true;
+}
+
+static void DestroyMesh(TestMesh* const m)
+{
+    free(m->positions);
+    free(m->indices);
+    free(m->primitives);
+    free(m->meshlets);
+}
+
+static Vec3d Sub(Vec3d a, Vec3d b)
+{
+    return (Vec3d){ a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static double Dot(Vec3d a, Vec3d b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static double SegmentDistanceSq(Vec3d p, Vec3d a, Vec3d b)
+{
+    const Vec3d ab = Sub(b, a);
+    const double length = Dot(ab, ab);
+    const double t = length > 0.0 ? fmin(fmax(Dot(Sub(p, a), ab) / length, 0.0), 1.0) : 0.0;
+    const Vec3d d = Sub(p, (Vec3d){ a.x + ab.x * t, a.y + ab.y * t, a.z + ab.z * t });
+    return Dot(d, d);
+}
+
+// Squared distance to a triangle: to its plane when p projects inside it, else to its closest edge.
+static double TriangleDistanceSq(Vec3d p, Vec3d a, Vec3d b, Vec3d c)
+{
+    const Vec3d ab = Sub(b, a), ac = Sub(c, a), ap = Sub(p, a);
+    const Vec3d n = { ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+    const double nn = Dot(n, n);
+    if (nn > 0.0)
+    {
+        // Barycentric coordinates of the projection.
+        const double d00 = Dot(ab, ab), d01 = Dot(ab, ac), d11 = Dot(ac, ac);
+        const double d20 = Dot(ap, ab), d21 = Dot(ap, ac);
+        const double denominator = d00 * d11 - d01 * d01;
+        const double v = (d11 * d20 - d01 * d21) / denominator;
+        const double w = (d00 * d21 - d01 * d20) / denominator;
+        if (v >= 0.0 && w >= 0.0 && v + w <= 1.0)
+        {
+            const double h = Dot(ap, n);
+            return h * h / nn;
+        }
+    }
+    return fmin(fmin(SegmentDistanceSq(p, a, b), SegmentDistanceSq(p, b, c)), SegmentDistanceSq(p, c, a));
+}
+
+static Vec3d VertexOf(const MeshletMesh* const mesh, uint32_t meshlet, uint32_t local)
+{
+    const uint32_t index = mesh->Meshlets[meshlet].VertOffset + local;
+    uint32_t vertex;
+    if (mesh->IndexSize == 2)
+    {
+        uint16_t v16;
+        memcpy(&v16, mesh->UniqueVertexIndices + (size_t)index * 2, 2);
+        vertex = v16;
+    }
+    else
+    {
+        memcpy(&vertex, mesh->UniqueVertexIndices + (size_t)index * 4, 4);
+    }
+    float p[3];
+    memcpy(p, mesh->Vertices + (size_t)vertex * mesh->VertexStride, sizeof(p));
+    return (Vec3d){ p[0], p[1], p[2] };
+}
+
+static void TriangleOf(const MeshletMesh* const mesh, uint32_t meshlet, uint32_t primitive, Vec3d corners[3])
+{
+    const uint32_t packed = mesh->PrimitiveIndices[mesh->Meshlets[meshlet].PrimOffset + primitive];
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+        corners[k] = VertexOf(mesh, meshlet, (packed >> (10 * k)) & 0x3FF);
+    }
+}
+
+static double SurfaceDistanceSq(const Vec3d (*const triangles)[3], uint32_t triangleCount, Vec3d p)
+{
+    double best = DBL_MAX;
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        best = fmin(best, TriangleDistanceSq(p, triangles[t][0], triangles[t][1], triangles[t][2]));
+    }
+    return best;
+}
+
+// The largest distance from the vertices and triangle centroids of 'lod' to 'reference', trying every triangle.
+static double BruteForceError(const MeshletMesh* const reference, const MeshletMesh* const lod)
+{
+    uint32_t triangleCount = 0;
+    for (uint32_t m = 0; m < reference->MeshletCount; ++m)
+    {
+        triangleCount += reference->Meshlets[m].PrimCount;
+    }
+    Vec3d (*const triangles)[3] = malloc(sizeof(Vec3d[3]) * (triangleCount + 1));
+    if (!triangles)
+    {
+        return -1.0;
+    }
+    for (uint32_t m = 0, t = 0; m < reference->MeshletCount; ++m)
+    {
+        for (uint32_t p = 0; p < reference->Meshlets[m].PrimCount; ++p)
+        {
+            TriangleOf(reference, m, p, triangles[t++]);
+        }
+    }
+
+    double worst = 0.0;
+    for (uint32_t m = 0; m < lod->MeshletCount; ++m)
+    {
+        for (uint32_t v = 0; v < lod->Meshlets[m].VertCount; ++v)
+        {
+            worst = fmax(worst, SurfaceDistanceSq(triangles, triangleCount, VertexOf(lod, m, v)));
+        }
+        for (uint32_t t = 0; t < lod->Meshlets[m].PrimCount; ++t)
+        {
+            Vec3d c[3];
+            TriangleOf(lod, m, t, c);
+            const Vec3d centroid = { (c[0].x + c[1].x + c[2].x) / 3.0, (c[0].y + c[1].y + c[2].y) / 3.0, (c[0].z + c[1].z + c[2].z) / 3.0 };
+            worst = fmax(worst, SurfaceDistanceSq(triangles, triangleCount, centroid));
+        }
+    }
+    free(triangles);
+    return sqrt(worst);
+}
+
+static void CheckEstimate(const MeshletMesh* const reference, const MeshletMesh* const lod)
+{
+    const double expected = BruteForceError(reference, lod);
+    const float estimate = LodError_Estimate(reference, lod);
+    CHECK(fabs(estimate - expected) <= 1e-5 + 1e-4 * expected);
+}
+
+static void TestSpheres(void)
+{
+    TestMesh reference;
+    CHECK(BuildMesh(&reference, false, 24, 48, 1.0f, 4));
+
+    // Coarser and coarser chains, the error growing with each.
+    float previous = 0.0f;
+    const uint32_t rows[] = { 12, 6, 3, 2 };
+    for (uint32_t l = 0; l < (uint32_t)_countof(rows); ++l)
+    {
+        TestMesh lod;
+        CHECK(BuildMesh(&lod, false, rows[l], rows[l] * 2, 1.0f, l % 2 ? 2 : 4));
+        CheckEstimate(&reference.mesh, &lod.mesh);
+        const float error = LodError_Estimate(&reference.mesh, &lod.mesh);
+        CHECK(error > previous);
+        previous = error;
+        DestroyMesh(&lod);
+    }
+
+    // Larger and smaller than the reference, and far outside its grid.
+    const float radii[] = { 1.1f, 0.7f, 0.05f, 6.0f };
+    for (uint32_t r = 0; r < (uint32_t)_countof(radii); ++r)
+    {
+        TestMesh lod;
+        CHECK(BuildMesh(&lod, false, 10, 20, radii[r], 2));
+        CheckEstimate(&reference.mesh, &lod.mesh);
+        DestroyMesh(&lod);
+    }
+
+    // The reference against itself, and against an empty mesh.
+    CHECK(LodError_Estimate(&reference.mesh, &reference.mesh) < 1e-6f);
+    const MeshletMesh empty = { .Vertices = reference.mesh.Vertices, .VertexStride = 24, .IndexSize = 4 };
+    CHECK(LodError_Estimate(&empty, &reference.mesh) == 0.0f);
+    CHECK(LodError_Estimate(&reference.mesh, &empty) == 0.0f);
+    DestroyMesh(&reference);
+}
+
+static void TestFlat(void)
+{
+    // A gently waving square, nearly flat: the grid is much thinner in y than in x and z.
+    TestMesh reference;
+    CHECK(BuildMesh(&reference, true, 30, 30, 0.2f, 4));
+    const uint32_t sizes[] = { 15, 7, 1 };
+    for (uint32_t s = 0; s < (uint32_t)_countof(sizes); ++s)
+    {
+        TestMesh lod;
+        CHECK(BuildMesh(&lod, true, sizes[s], sizes[s], s == 2 ? 0.0f : 0.2f, 4));
+        CheckEstimate(&reference.mesh, &lod.mesh);
+        DestroyMesh(&lod);
+    }
+    DestroyMesh(&reference);
+}
+
+int main(void)
+{
+    TestSpheres();
+    TestFlat();
+    return TEST_RESULT();
+}
@@ -0,0 +1,266 @@
+#include "lod_select.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+#define LOD_SELECT_STALE 0x80   // Set on the LODs of the last update while candidates are selected
+
+/*****************************************************************
+    Private types
+******************************************************************/
+
+// Consecutive instances written by an update, added to the dirty ranges as one.
+typedef struct DirtyRun
+{
+    uint32_t begin;
+    uint32_t end;
+} DirtyRun;
+
+// What an update selects against.
+typedef struct Selection
+{
+    const Constants*     constants;
+    const LodErrorChain* chains;
+    uint32_t             chainCount;
+    float                halfHeight;
+    float                threshold;
+    float                keepFiner;      // A kept LOD may err up to this much
+    float                keepCoarser;    // and its next LOD must err more than this
+} Selection;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// Radius of the bounding sphere on screen, in pixels. FLT_MAX if the eye is inside it.
+static float ProjectedRadius(const Constants* const constants, XMFLOAT4 sphere, float halfHeight)
+{
+    const float vx = sphere.x - constants->ViewPosition.x;
+    const float vy = sphere.y - constants->ViewPosition.y;
+    const float vz = sphere.z - constants->ViewPosition.z;
+    const float d2 = vx * vx + vy * vy + vz * vz - sphere.w * sphere.w;
+    return d2 > 0.0f ? constants->RecipTanHalfFovy * sphere.w / sqrtf(d2) * halfHeight : FLT_MAX;
+}
+
+static uint32_t CoarsestWithin(const LodErrorChain* const chain, float pixels, float threshold)
+{
+    uint32_t lod = 0;
+    while (lod + 1 < chain->LODCount && chain->Errors[lod + 1] * pixels <= threshold)
+    {
+        ++lod;
+    }
+    return lod;
+}
+
+static void MarkDirty(DirtyRun* const run, uint32_t instance, DirtyRanges* const dirty)
+{
+    if (instance != run->end)
+    {
+        if (run->end > run->begin)
+        {
+            DirtyRanges_Add(dirty, run->begin, run->end - run->begin);
+        }
+        run->begin = instance;
+    }
+    run->end = instance + 1;
+}
+
+static void FlushDirty(const DirtyRun* const run, DirtyRanges* const dirty)
+{
+    if (run->end > run->begin)
+    {
+        DirtyRanges_Add(dirty, run->begin, run->end - run->begin);
+    }
+}
+
+static Selection MakeSelection(const LodSelector* const selector, const Constants* const constants, float viewportHeight,
+                               const LodErrorChain* const chains, uint32_t chainCount)
+{
+    const float threshold = selector->pixelError * exp2f(constants->LODBias);
+    return (Selection){
+        .constants = constants,
+        .chains = chains,
+        .chainCount = chainCount,
+        .halfHeight = 0.5f * viewportHeight,
+        .threshold = threshold,
+        .keepFiner = threshold * (1.0f + selector->hysteresis),
+        .keepCoarser = threshold * (1.0f - selector->hysteresis),
+    };
+}
+
+// Selects the LOD of instance i into lods[i], LOD_SELECT_CULLED if it is not selected for. Returns whether the
+// instance changed.
+static bool SelectInstance(LodSelector* const selector, const Selection* const selection, uint32_t i,
+                           Instance* const instances, DirtyRun* const run, DirtyRanges* const dirty)
+{
+    Instance* const instance = &instances[i];
+    const uint32_t model = Instance_GetModel(instance);
+    const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(instance);
+    if (model >= selection->chainCount || !InstanceCull_IsVisible(selection->constants, sphere) ||
+        !InstanceCull_IsContributing(selection->constants, sphere))
+    {
+        selector->lods[i] = LOD_SELECT_CULLED;
+        return false;
+    }
+
+    const LodErrorChain* chain = &selection->chains[model];
+    const float pixels = ProjectedRadius(selection->constants, sphere, selection->halfHeight);
+
+    uint32_t lod = selector->lods[i] == LOD_SELECT_CULLED ? LOD_SELECT_CULLED : selector->lods[i] & ~LOD_SELECT_STALE;
+    const bool keep = lod < chain->LODCount &&
+                      chain->Errors[lod] * pixels <= selection->keepFiner &&
+                      (lod + 1 == chain->LODCount || chain->Errors[lod + 1] * pixels > selection->keepCoarser);
+    if (!keep)
+    {
+        lod = CoarsestWithin(chain, pixels, selection->threshold);
+    }
+    selector->lods[i] = (uint8_t)lod;
+
+    // Compared with the instance rather than the last choice: animation rewrites PackedRadius as it was.
+    if (Instance_GetLod(instance) == lod)
+    {
+        return false;
+    }
+    Instance_SetLod(instance, lod);
+    MarkDirty(run, i, dirty);
+    return true;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+void LodErrorChain_Init(LodErrorChain* const chain, const float* const errors, uint32_t lodCount, float radius)
+{
+    *chain = (LodErrorChain){ .LODCount = lodCount < MAX_LOD_LEVELS ? lodCount : MAX_LOD_LEVELS };
+
+    const float scale = radius > 0.0f ? 1.0f / radius : 0.0f;
+    float previous = 0.0f;
+    for (uint32_t l = 0; l < chain->LODCount; ++l)
+    {
+        previous = fmaxf(previous, errors[l] * scale);
+        chain->Errors[l] = previous;
+    }
+}
+
+bool LodSelector_Reset(LodSelector* const selector, uint32_t instanceCount)
+{
+    if (instanceCount > selector->capacity)
+    {
+        uint8_t* lods = realloc(selector->lods, instanceCount);
+        if (!lods)
+        {
+            return false;
+        }
+        selector->lods = lods;
+
+        uint32_t* visible = realloc(selector->visible, instanceCount * sizeof(uint32_t));
+        if (!visible)
+        {
+            return false;
+        }
+        selector->visible = visible;
+        selector->capacity = instanceCount;
+    }
+
+    memset(selector->lods, LOD_SELECT_CULLED, instanceCount);
+    selector->instanceCount = instanceCount;
+    selector->visibleCount = 0;
+    return true;
+}
+
+void LodSelector_Destroy(LodSelector* const selector)
+{
+    free(selector->lods);
+    free(selector->visible);
+    selector->lods = NULL;
+    selector->visible = NULL;
+    selector->instanceCount = 0;
+    selector->capacity = 0;
+    selector->visibleCount = 0;
+}
+
+uint32_t LodSelector_Update(LodSelector* const selector, const Constants* const constants, float viewportHeight,
+                            const LodErrorChain* const chains, uint32_t chainCount, Instance* const instances,
+                            DirtyRanges* const dirty)
+{
+    const Selection selection = MakeSelection(selector, constants, viewportHeight, chains, chainCount);
+
+    DirtyRun run = { 0, 0 };
+    uint32_t changed = 0;
+    selector->visibleCount = 0;
+    for (uint32_t i = 0; i < selector->instanceCount; ++i)
+    {
+        changed += SelectInstance(selector, &selection, i, instances, &run, dirty);
+        if (selector->lods[i] != LOD_SELECT_CULLED)
+        {
+            selector->visible[selector->visibleCount++] = i;
+        }
+    }
+    FlushDirty(&run, dirty);
+    return changed;
+}
+
+uint32_t LodSelector_UpdateCandidates(LodSelector* const selector, const Constants* const constants, float viewportHeight,
+                                      const LodErrorChain* const chains, uint32_t chainCount,
+                                      const uint32_t* const candidates, uint32_t candidateCount,
+                                      Instance* const instances, DirtyRanges* const dirty)
+{
+    const Selection selection = MakeSelection(selector, constants, viewportHeight, chains, chainCount);
+
+    // The instances visible last time keep their LOD for the hysteresis, marked until a candidate clears it.
+    for (uint32_t v = 0; v < selector->visibleCount; ++v)
+    {
+        selector->lods[selector->visible[v]] |= LOD_SELECT_STALE;
+    }
+
+    DirtyRun run = { 0, 0 };
+    uint32_t changed = 0;
+    for (uint32_t c = 0; c < candidateCount; ++c)
+    {
+        if (candidates[c] < selector->instanceCount)
+        {
+            changed += SelectInstance(selector, &selection, candidates[c], instances, &run, dirty);
+        }
+    }
+    FlushDirty(&run, dirty);
+
+    // Still marked: no longer a candidate, so out of the frustum.
+    for (uint32_t v = 0; v < selector->visibleCount; ++v)
+    {
+        const uint32_t i = selector->visible[v];
+        selector->lods[i] = selector->lods[i] & LOD_SELECT_STALE ? LOD_SELECT_CULLED : selector->lods[i];
+    }
+
+    selector->visibleCount = 0;
+    for (uint32_t c = 0; c < candidateCount; ++c)
+    {
+        if (candidates[c] < selector->instanceCount && selector->lods[candidates[c]] != LOD_SELECT_CULLED)
+        {
+            selector->visible[selector->visibleCount++] = candidates[c];
+        }
+    }
+    return changed;
+}
+
+void LodSelector_Release(LodSelector* const selector, Instance* const instances, DirtyRanges* const dirty)
+{
+    DirtyRun run = { 0, 0 };
+    for (uint32_t i = 0; i < selector->instanceCount; ++i)
+    {
+        if (Instance_GetLod(&instances[i]) != INSTANCE_LOD_NONE)
+        {
+            Instance_SetLod(&instances[i], INSTANCE_LOD_NONE);
+            MarkDirty(&run, i, dirty);
+        }
+    }
+    FlushDirty(&run, dirty);
+    LodSelector_Reset(selector, selector->instanceCount);
+}
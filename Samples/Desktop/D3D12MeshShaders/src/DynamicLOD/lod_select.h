@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+#include "dirty_ranges.h"
+
+typedef struct Constants Constants;
+typedef struct Instance Instance;
+
+#define LOD_SELECT_PIXEL_ERROR 1.0f  // Suggested threshold, in pixels
+#define LOD_SELECT_HYSTERESIS  0.25f // Suggested hysteresis, relative to the threshold
+#define LOD_SELECT_CULLED      0xFF  // lods value of culled instances, as FRAME_STATS_CULLED
+
+// Geometric error of each LOD of a model, relative to the radius of its bounding sphere.
+typedef struct LodErrorChain
+{
+    float    Errors[MAX_LOD_LEVELS];    // Non-decreasing
+    uint32_t LODCount;
+} LodErrorChain;
+
+/****************************************************************************************************
+ * CPU LOD selection by screen-space error.                                                         *
+ *                                                                                                  *
+ * An instance's LOD l would be drawn with an error of about Errors[l] * p pixels, p being the      *
+ * projected radius of its bounding sphere in pixels: the error scales with the instance like its   *
+ * radius. The selector picks the coarsest LOD whose error stays within the threshold, which        *
+ * Constants.LODBias scales by 2^bias, as LODs usually double the error of the previous one.        *
+ *                                                                                                  *
+ * With a hysteresis h, a visible instance keeps its LOD l while its error stays within             *
+ * (1 + h) * threshold and that of LOD l + 1 stays above (1 - h) * threshold, so instances near a    *
+ * switch distance do not flip LOD every time the camera or the LOD bias wavers.                    *
+ *                                                                                                  *
+ * The choice goes into the instances (Instance_SetLod), where the amplification shader reads it   *
+ * instead of selecting from the screen size. Only the instances whose LOD changed are marked       *
+ * dirty. Instances outside the frustum, or below Constants.MinScreenSize, are left as they are.    *
+ *                                                                                                  *
+ * LodSelector_UpdateCandidates only looks at the instances a spatial query returned, plus those    *
+ * visible on the previous update, so its cost follows the view rather than the scene.              *
+ ****************************************************************************************************/
+typedef struct LodSelector
+{
+    uint8_t*  lods;             // LOD per instance, LOD_SELECT_CULLED if culled or not selected yet
+    uint32_t* visible;          // Indices of the instances with a LOD, visibleCount of them
+    uint32_t  instanceCount;
+    uint32_t  capacity;
+    uint32_t  visibleCount;
+    float     pixelError;       // Threshold, set by the owner
+    float     hysteresis;       // Set by the owner. 0 selects exactly the coarsest LOD within the threshold.
+} LodSelector;
+
+// Fills the chain from the errors of each LOD in model units, which are made non-decreasing.
+void     LodErrorChain_Init   (LodErrorChain* const chain, const float* const errors, uint32_t lodCount, float radius);
+
+// Forgets every previous choice, for 'instanceCount' new instances. Returns false on allocation failure.
+bool     LodSelector_Reset    (LodSelector* const selector, uint32_t instanceCount);
+void     LodSelector_Destroy  (LodSelector* const selector);
+
+// Selects the LOD of every visible instance among the count given to the last reset, 'chains' being indexed by model;
+// instances of other models are left to the shaders. Returns the number of instances whose LOD changed.
+uint32_t LodSelector_Update   (LodSelector* const selector, const Constants* const constants, float viewportHeight,
+                               const LodErrorChain* const chains, uint32_t chainCount, Instance* const instances,
+                               DirtyRanges* const dirty);
+
+/****************************************************************************************************
+ * Same selection, testing only the 'candidateCount' instances of 'candidates', each listed at most *
+ * once, such as SpatialGrid_QueryFrustum returns. They must include every instance visible now:    *
+ * the instances visible on the previous update that are not candidates are taken as culled.        *
+ ****************************************************************************************************/
+uint32_t LodSelector_UpdateCandidates(LodSelector* const selector, const Constants* const constants, float viewportHeight,
+                                      const LodErrorChain* const chains, uint32_t chainCount,
+                                      const uint32_t* const candidates, uint32_t candidateCount,
+                                      Instance* const instances, DirtyRanges* const dirty);
+
+// Hands the LOD selection of every instance back to the shaders.
+void     LodSelector_Release  (LodSelector* const selector, Instance* const instances, DirtyRanges* const dirty);
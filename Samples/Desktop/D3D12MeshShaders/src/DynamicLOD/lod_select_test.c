@@ -0,0 +1,355 @@
+/*************************************************************************************
+ LOD selection tests.
+
+ Selects LODs for a random scene of two models and instances of unknown ones,
+ and checks every instance against the coarsest LOD within the pixel threshold,
+ computed here from the projected radius: visible instances carry it, the others
+ keep what they had, and exactly the changed instances are marked dirty. Covers
+ the 2^bias scaling of the threshold, the minimum screen size, error chains made
+ non-decreasing, and handing the selection back to the shaders.
+
+ Under a wobbling camera, the hysteresis bounds hold for every instance on every
+ frame, and stop the LOD changes that selection without hysteresis makes; they
+ still hold with the camera flying toward or away from the scene.
+
+ Selecting from candidates, every visible instance and some others in any order,
+ gives the same LODs, instances and change counts as selecting from all of them,
+ frame after frame with hysteresis, as instances leave and enter the frustum.
+
+ Usage: LodSelectTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "lod_select.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include "test_check.h"
+#include "test_view.h"
+
+#define INSTANCE_COUNT 4000
+#define CHAIN_COUNT    2     // Instances of model 2 have no chain
+
+static const float c_viewportHeight = 1080.0f;
+
+typedef struct Scene
+{
+    Instance      instances[INSTANCE_COUNT];
+    LodErrorChain chains[CHAIN_COUNT];
+    Constants     constants;
+} Scene;
+
+static void MakeScene(Scene* const scene)
+{
+    const float errors[CHAIN_COUNT][6] = { { 0.0f, 0.01f, 0.02f, 0.04f, 0.08f, 0.16f }, { 0.0f, 0.05f, 0.1f, 0.2f } };
+    LodErrorChain_Init(&scene->chains[0], errors[0], 6, 2.0f);
+    LodErrorChain_Init(&scene->chains[1], errors[1], 4, 1.0f);
+
+    // In front of the camera at 10 to 2000 units, some out of the frustum, of radius 1 to 3.
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        const float z = TestRandomFloat(10.0f, 2000.0f);
+        const float x = TestRandomFloat(-1.2f, 1.2f) * z;
+        const float y = TestRandomFloat(-0.8f, 0.8f) * z;
+        XMFLOAT4X4 world = { 0 };
+        float* const w = (float*)&world;
+        w[0] = w[5] = w[10] = w[15] = 1.0f;
+        w[12] = x;
+        w[13] = y;
+        w[14] = z;
+        Instance_Pack(&scene->instances[i], &world, (XMFLOAT4){ x, y, z, TestRandomFloat(1.0f, 3.0f) });
+        Instance_SetModel(&scene->instances[i], i % (CHAIN_COUNT + 1));
+    }
+
+    TestView_Build(&scene->constants, (XMFLOAT3){ 0, 0, 0 }, 0.0f, 1.0472f, 16.0f / 9.0f);
+}
+
+// Radius of the sphere on screen, in pixels, as lod_select.h defines it.
+static float Pixels(const Constants* const constants, XMFLOAT4 sphere)
+{
+    const float dx = sphere.x - constants->ViewPosition.x;
+    const float dy = sphere.y - constants->ViewPosition.y;
+    const float dz = sphere.z - constants->ViewPosition.z;
+    return constants->RecipTanHalfFovy * sphere.w / sqrtf(dx * dx + dy * dy + dz * dz - sphere.w * sphere.w) * 0.5f * c_viewportHeight;
+}
+
+// LOD_SELECT_CULLED if the instance is not selected for.
+static uint32_t ReferenceLod(const Scene* const scene, const Instance* const instance, float threshold)
+{
+    const uint32_t model = Instance_GetModel(instance);
+    const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(instance);
+    if (model >= CHAIN_COUNT || !InstanceCull_IsVisible(&scene->constants, sphere) ||
+        InstanceCull_ScreenSize(&scene->constants, sphere) < scene->constants.MinScreenSize)
+    {
+        return LOD_SELECT_CULLED;
+    }
+
+    const LodErrorChain* const chain = &scene->chains[model];
+    const float pixels = Pixels(&scene->constants, sphere);
+    uint32_t lod = 0;
+    for (uint32_t l = 1; l < chain->LODCount; ++l)
+    {
+        lod = chain->Errors[l] * pixels <= threshold ? l : lod;
+    }
+    return lod;
+}
+
+static bool IsDirty(const DirtyRanges* const dirty, uint32_t instance)
+{
+    for (uint32_t r = 0; r < dirty->count; ++r)
+    {
+        if (instance >= dirty->ranges[r].Begin && instance < dirty->ranges[r].End)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Updates without hysteresis and checks every instance against the reference.
+static void CheckUpdate(LodSelector* const selector, Scene* const scene)
+{
+    uint32_t before[INSTANCE_COUNT];
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        before[i] = Instance_GetLod(&scene->instances[i]);
+    }
+
+    DirtyRanges dirty;
+    DirtyRanges_Clear(&dirty);
+    const uint32_t changed = LodSelector_Update(selector, &scene->constants, c_viewportHeight, scene->chains, CHAIN_COUNT,
+                                                scene->instances, &dirty);
+
+    const float threshold = selector->pixelError * exp2f(scene->constants.LODBias);
+    uint32_t mismatches = 0, expectedChanges = 0, missedDirty = 0, visible = 0;
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        const uint32_t expected = ReferenceLod(scene, &scene->instances[i], threshold);
+        const uint32_t carried = Instance_GetLod(&scene->instances[i]);
+        mismatches += selector->lods[i] != expected;
+        mismatches += carried != (expected == LOD_SELECT_CULLED ? before[i] : expected);
+        expectedChanges += carried != before[i];
+        missedDirty += carried != before[i] && !IsDirty(&dirty, i);
+        visible += expected != LOD_SELECT_CULLED;
+    }
+    CHECK(mismatches == 0);
+    CHECK(changed == expectedChanges);
+    CHECK(missedDirty == 0);
+    CHECK(selector->visibleCount == visible);
+    CHECK((changed == 0) == DirtyRanges_IsEmpty(&dirty));
+}
+
+static void TestSelection(Scene* const scene)
+{
+    // Errors relative to the radius, made non-decreasing, and at most MAX_LOD_LEVELS of them.
+    CHECK(scene->chains[0].LODCount == 6 && scene->chains[0].Errors[5] == 0.08f);
+    const float unordered[] = { 0.0f, 0.3f, 0.1f, 0.5f, 0.5f, 0.6f, 0.7f, 0.8f, 0.9f, 1.0f };
+    LodErrorChain chain;
+    LodErrorChain_Init(&chain, unordered, (uint32_t)_countof(unordered), 2.0f);
+    CHECK(chain.LODCount == MAX_LOD_LEVELS);
+    CHECK(chain.Errors[1] == 0.15f && chain.Errors[2] == 0.15f && chain.Errors[3] == 0.25f);
+
+    LodSelector selector = { .pixelError = LOD_SELECT_PIXEL_ERROR, .hysteresis = 0.0f };
+    CHECK(LodSelector_Reset(&selector, INSTANCE_COUNT));
+    CheckUpdate(&selector, scene);
+    CHECK(selector.visibleCount > INSTANCE_COUNT / 4);
+
+    // Nothing moved: nothing changes.
+    DirtyRanges dirty;
+    DirtyRanges_Clear(&dirty);
+    CHECK(LodSelector_Update(&selector, &scene->constants, c_viewportHeight, scene->chains, CHAIN_COUNT, scene->instances, &dirty) == 0);
+    CHECK(DirtyRanges_IsEmpty(&dirty));
+
+    // A bias of 1 doubles the threshold, -1.5 divides it by 2^1.5; a minimum screen size culls the smallest.
+    scene->constants.LODBias = 1.0f;
+    CheckUpdate(&selector, scene);
+    scene->constants.LODBias = -1.5f;
+    CheckUpdate(&selector, scene);
+    scene->constants.MinScreenSize = 0.01f;
+    CheckUpdate(&selector, scene);
+    scene->constants.LODBias = 0.0f;
+    scene->constants.MinScreenSize = 0.0f;
+
+    // Released: every instance goes back to the shaders, and is marked dirty if it had a LOD.
+    uint32_t hadLod[INSTANCE_COUNT];
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        hadLod[i] = Instance_GetLod(&scene->instances[i]) != INSTANCE_LOD_NONE;
+    }
+    DirtyRanges_Clear(&dirty);
+    LodSelector_Release(&selector, scene->instances, &dirty);
+    uint32_t bad = 0;
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        bad += Instance_GetLod(&scene->instances[i]) != INSTANCE_LOD_NONE || selector.lods[i] != LOD_SELECT_CULLED;
+        bad += hadLod[i] && !IsDirty(&dirty, i);
+    }
+    CHECK(bad == 0);
+    CHECK(selector.visibleCount == 0);
+
+    // Fewer instances after a reset: the others are left alone.
+    CHECK(LodSelector_Reset(&selector, 10));
+    LodSelector_Update(&selector, &scene->constants, c_viewportHeight, scene->chains, CHAIN_COUNT, scene->instances, &dirty);
+    bad = 0;
+    for (uint32_t i = 10; i < INSTANCE_COUNT; ++i)
+    {
+        bad += Instance_GetLod(&scene->instances[i]) != INSTANCE_LOD_NONE;
+    }
+    CHECK(bad == 0 && selector.instanceCount == 10 && selector.capacity >= INSTANCE_COUNT);
+    LodSelector_Release(&selector, scene->instances, &dirty);
+    LodSelector_Destroy(&selector);
+}
+
+// LOD changes of instances visible on consecutive frames, with a camera wobbling by up to a unit while it moves back
+// by 'drift' units a frame, toward the scene when negative.
+static uint32_t Wobble(Scene* const scene, float hysteresis, float drift)
+{
+    LodSelector selector = { .pixelError = LOD_SELECT_PIXEL_ERROR, .hysteresis = hysteresis };
+    CHECK(LodSelector_Reset(&selector, INSTANCE_COUNT));
+
+    const float threshold = selector.pixelError;
+    uint8_t previous[INSTANCE_COUNT];
+    uint32_t changes = 0, outOfBounds = 0;
+    for (uint32_t frame = 0; frame < 100; ++frame)
+    {
+        const XMFLOAT3 eye = { 0.5f * sinf(0.9f * (float)frame), 0.2f * cosf(1.3f * (float)frame), sinf(0.7f * (float)frame) - drift * (float)frame };
+        TestView_Build(&scene->constants, eye, 0.0f, 1.0472f, 16.0f / 9.0f);
+
+        memcpy(previous, selector.lods, INSTANCE_COUNT);
+        DirtyRanges dirty;
+        DirtyRanges_Clear(&dirty);
+        LodSelector_Update(&selector, &scene->constants, c_viewportHeight, scene->chains, CHAIN_COUNT, scene->instances, &dirty);
+
+        // Every selected LOD errs at most (1 + h) times the threshold, and its next LOD more than (1 - h) times.
+        for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+        {
+            const uint32_t lod = selector.lods[i];
+            if (lod == LOD_SELECT_CULLED)
+            {
+                continue;
+            }
+            changes += previous[i] != LOD_SELECT_CULLED && previous[i] != lod;
+            const LodErrorChain* const chain = &scene->chains[Instance_GetModel(&scene->instances[i])];
+            const float pixels = Pixels(&scene->constants, Instance_UnpackBoundingSphere(&scene->instances[i]));
+            outOfBounds += chain->Errors[lod] * pixels > threshold * (1.0f + hysteresis) * 1.0001f;
+            outOfBounds += lod + 1 < chain->LODCount && chain->Errors[lod + 1] * pixels <= threshold * (1.0f - hysteresis) * 0.9999f;
+        }
+    }
+    CHECK(outOfBounds == 0);
+
+    DirtyRanges dirty;
+    DirtyRanges_Clear(&dirty);
+    LodSelector_Release(&selector, scene->instances, &dirty);
+    LodSelector_Destroy(&selector);
+    TestView_Build(&scene->constants, (XMFLOAT3){ 0, 0, 0 }, 0.0f, 1.0472f, 16.0f / 9.0f);
+    return changes;
+}
+
+static void TestHysteresis(Scene* const scene)
+{
+    CHECK(Wobble(scene, 0.0f, 0.0f) > 0);
+    CHECK(Wobble(scene, LOD_SELECT_HYSTERESIS, 0.0f) == 0);
+
+    // Moving back and forward, instances do change LOD, within the same bounds.
+    CHECK(Wobble(scene, LOD_SELECT_HYSTERESIS, 1.0f) > 0);
+    CHECK(Wobble(scene, LOD_SELECT_HYSTERESIS, -3.0f) > 0);
+}
+
+static void TestCandidates(Scene* const scene)
+{
+    Instance* const copy = malloc(sizeof(scene->instances));
+    uint32_t* const candidates = malloc(INSTANCE_COUNT * sizeof(uint32_t));
+    CHECK(copy && candidates);
+    if (!copy || !candidates)
+    {
+        free(copy);
+        free(candidates);
+        return;
+    }
+    memcpy(copy, scene->instances, sizeof(scene->instances));
+
+    LodSelector all = { .pixelError = LOD_SELECT_PIXEL_ERROR, .hysteresis = LOD_SELECT_HYSTERESIS };
+    LodSelector some = all;
+    CHECK(LodSelector_Reset(&all, INSTANCE_COUNT));
+    CHECK(LodSelector_Reset(&some, INSTANCE_COUNT));
+
+    uint32_t mismatches = 0, badCounts = 0, left = 0;
+    for (uint32_t frame = 0; frame < 60; ++frame)
+    {
+        // Turning and moving along z, so that instances leave and enter the frustum.
+        const XMFLOAT3 eye = { 0.0f, 0.0f, 20.0f * (float)(frame % 30) };
+        TestView_Build(&scene->constants, eye, 0.03f * (float)frame, 1.0472f, 16.0f / 9.0f);
+
+        // The visible instances and one in five of the others, in a shuffled order.
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+        {
+            if (InstanceCull_IsVisible(&scene->constants, Instance_UnpackBoundingSphere(&copy[i])) || TestRandom() % 5 == 0)
+            {
+                candidates[count++] = i;
+            }
+        }
+        for (uint32_t c = count; c > 1; --c)
+        {
+            const uint32_t other = TestRandom() % c, kept = candidates[c - 1];
+            candidates[c - 1] = candidates[other];
+            candidates[other] = kept;
+        }
+
+        static uint32_t before[INSTANCE_COUNT];
+        uint32_t wasVisible = 0;
+        for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+        {
+            before[i] = Instance_GetLod(&copy[i]);
+            wasVisible += some.lods[i] != LOD_SELECT_CULLED;
+        }
+
+        DirtyRanges dirtyAll, dirtySome;
+        DirtyRanges_Clear(&dirtyAll);
+        DirtyRanges_Clear(&dirtySome);
+        const uint32_t changedAll = LodSelector_Update(&all, &scene->constants, c_viewportHeight, scene->chains, CHAIN_COUNT,
+                                                       scene->instances, &dirtyAll);
+        const uint32_t changedSome = LodSelector_UpdateCandidates(&some, &scene->constants, c_viewportHeight, scene->chains,
+                                                                  CHAIN_COUNT, candidates, count, copy, &dirtySome);
+        badCounts += changedAll != changedSome || all.visibleCount != some.visibleCount;
+        for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+        {
+            mismatches += all.lods[i] != some.lods[i];
+            mismatches += Instance_GetLod(&scene->instances[i]) != Instance_GetLod(&copy[i]);
+            mismatches += Instance_GetLod(&copy[i]) != before[i] && !IsDirty(&dirtySome, i);
+        }
+        for (uint32_t v = 0; v < some.visibleCount; ++v)
+        {
+            mismatches += some.lods[some.visible[v]] == LOD_SELECT_CULLED;
+        }
+        left += wasVisible > some.visibleCount;
+    }
+    CHECK(mismatches == 0);
+    CHECK(badCounts == 0);
+    CHECK(left > 0);
+
+    DirtyRanges dirty;
+    DirtyRanges_Clear(&dirty);
+    LodSelector_Release(&all, scene->instances, &dirty);
+    LodSelector_Destroy(&all);
+    LodSelector_Destroy(&some);
+    free(copy);
+    free(candidates);
+    TestView_Build(&scene->constants, (XMFLOAT3){ 0, 0, 0 }, 0.0f, 1.0472f, 16.0f / 9.0f);
+}
+
+int main(void)
+{
+    Scene* const scene = calloc(1, sizeof(Scene));
+    if (!scene)
+    {
+        fprintf(stderr, "Cannot create the scene\n");
+        return EXIT_FAILURE;
+    }
+    MakeScene(scene);
+    TestSelection(scene);
+    TestHysteresis(scene);
+    TestCandidates(scene);
+    free(scene);
+    return TEST_RESULT();
+}
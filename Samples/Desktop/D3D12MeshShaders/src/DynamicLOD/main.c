@@ -6,6 +6,7 @@ int CALLBACK WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 		.title = "HelloTriangle",
 		.width = 1280,
 		.height = 720,
+		.scenePath = lpCmdLine, // DynamicLOD.exe [scene file]
 	};
 	return Win32App_Run(&sample, hInstance, nCmdShow);
 }
\ No newline at end of file
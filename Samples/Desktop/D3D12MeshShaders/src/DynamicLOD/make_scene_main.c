@@ -0,0 +1,202 @@
+/*************************************************************************************
+ Scene file writer.
+
+ Writes the instance cube of the sample as a scene file that DynamicLOD can stream:
+ level 100 gives 201^3 = 8120601 instances. A layout argument, such as "terrain" or
+ "clustered:7", replaces the cube with another SceneGen layout, generated from the
+ seed after the colon (1 by default).
+
+ With several models, each instance picks one at random, from the same seed. The instances are then
+ sorted by (model, LOD) as seen from the sample's starting camera, so that the
+ amplification groups of the first frames draw few distinct meshes.
+
+ Usage: MakeScene <output.scene> [instanceLevel] [layout[:seed]] [model...]
+        layouts: cube (default), random, clustered, terrain, corridor, flythrough
+        models default to lod_assets/Dragon
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model.h"
+#include "sample_commons.h"
+#include "simple_camera.h"
+#include "scene_gen.h"
+#include "scene_file.h"
+#include "instance_pack.h"
+#include "instance_sort.h"
+#include "view_constants.h"
+
+#define WriteChunk 65536
+
+// Number of consecutive "<name>_LOD<n>.bin" files, from LOD 0.
+static uint32_t CountLods(const WCHAR* const basePath, const char* const name)
+{
+    uint32_t count = 0;
+    while (count < MAX_LOD_LEVELS)
+    {
+        WCHAR path[1024];
+        swprintf(path, _countof(path), L"%s%hs_LOD%u.bin", basePath, name, count);
+        if (GetFileAttributesW(path) == INVALID_FILE_ATTRIBUTES)
+        {
+            break;
+        }
+        ++count;
+    }
+    return count;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: MakeScene <output.scene> [instanceLevel] [layout[:seed]] [model...]\n");
+        return EXIT_FAILURE;
+    }
+    const char* outputPath = argv[1];
+    const uint32_t level = argc > 2 ? (uint32_t)atoi(argv[2]) : 10;
+
+    // The layout is optional: an argument that does not name one is the first model.
+    SceneLayout layout = SceneLayoutCube;
+    uint32_t seed = 1;
+    int firstModel = 3;
+    if (argc > 3)
+    {
+        char layoutName[32];
+        snprintf(layoutName, sizeof(layoutName), "%s", argv[3]);
+        char* colon = strchr(layoutName, ':');
+        if (colon)
+        {
+            *colon = '\0';
+        }
+        if (SceneGen_ParseLayout(layoutName, &layout))
+        {
+            seed = colon ? (uint32_t)strtoul(colon + 1, NULL, 10) : seed;
+            firstModel = 4;
+        }
+    }
+
+    const char* defaultModel = "lod_assets/Dragon";
+    const char* const* modelNames = argc > firstModel ? (const char* const*)&argv[firstModel] : &defaultModel;
+    const uint32_t modelCount = argc > firstModel ? (uint32_t)(argc - firstModel) : 1;
+    if (modelCount > SCENE_FILE_MAX_MODELS)
+    {
+        fprintf(stderr, "At most %u models\n", SCENE_FILE_MAX_MODELS);
+        return EXIT_FAILURE;
+    }
+
+    WCHAR basePath[512];
+    GetCurrentPath(basePath, _countof(basePath));
+
+    // Only the radius and LOD count of the models are needed: instances are spaced for the
+    // largest one, like the sample does for the dragon, and sorted by LOD.
+    SceneFileModel* models = calloc(modelCount, sizeof(SceneFileModel));
+    ModelDesc* modelDescs = calloc(modelCount, sizeof(ModelDesc));
+    float* radii = calloc(modelCount, sizeof(float));
+    if (!models || !modelDescs || !radii)
+    {
+        fprintf(stderr, "Out of memory for %u models\n", modelCount);
+        return EXIT_FAILURE;
+    }
+
+    float maxRadius = 0.0f;
+    for (uint32_t i = 0; i < modelCount; ++i)
+    {
+        if (strlen(modelNames[i]) >= SCENE_MODEL_NAME_SIZE)
+        {
+            fprintf(stderr, "Model name too long: %s\n", modelNames[i]);
+            return EXIT_FAILURE;
+        }
+        strcpy(models[i].Name, modelNames[i]);
+
+        WCHAR lod0[SCENE_MODEL_NAME_SIZE + 16];
+        swprintf(lod0, _countof(lod0), L"%hs_LOD0.bin", modelNames[i]);
+
+        Model model = { 0 };
+        HRESULT hr = Model_LoadFromFile(&model, basePath, lod0);
+        if (FAILED(hr))
+        {
+            fprintf(stderr, "Failed to load %s_LOD0.bin (0x%08X)\n", modelNames[i], (unsigned)hr);
+            return EXIT_FAILURE;
+        }
+        radii[i] = model.boundingSphere.r;
+        maxRadius = radii[i] > maxRadius ? radii[i] : maxRadius;
+        free(model.meshes);
+        free(model.buffer);
+
+        modelDescs[i] = (ModelDesc){ .LODCount = CountLods(basePath, modelNames[i]) };
+    }
+
+    const uint32_t instanceCount = SceneGen_CubeCount(level);
+    Instance* instances = malloc((size_t)instanceCount * sizeof(Instance));
+    SceneFileInstance* records = malloc(WriteChunk * sizeof(SceneFileInstance));
+    if (!instances || !records)
+    {
+        fprintf(stderr, "Out of memory for %u instances\n", instanceCount);
+        return EXIT_FAILURE;
+    }
+    SceneGen_Generate(instances, layout, level, maxRadius, seed);
+
+    if (modelCount > 1)
+    {
+        // Not rand(), whose sequence differs between C libraries.
+        uint32_t state = SceneGen_Seed(seed);
+        for (uint32_t i = 0; i < instanceCount; ++i)
+        {
+            const uint32_t model = SceneGen_Random(&state) % modelCount;
+            instances[i].PackedRadius = HalfFromFloatRoundUp(radii[model]);
+            Instance_SetModel(&instances[i], model);
+        }
+
+        SimpleCamera camera = SimpleCamera_Spawn((XMFLOAT3){ 0, 75, 150 });
+        Constants constants = { 0 };
+        ViewConstants_Build(&constants, camera.position, camera.lookDirection, camera.upDirection,
+                            XM_PI / 3.0f, 1280.0f / 720.0f, 1.0f, 1e4f);
+
+        InstanceSort sort = { 0 };
+        if (!InstanceSort_ByModelLod(&sort, instances, instanceCount, &constants, modelDescs, modelCount))
+        {
+            fprintf(stderr, "Out of memory sorting %u instances\n", instanceCount);
+            return EXIT_FAILURE;
+        }
+        InstanceSort_Destroy(&sort);
+    }
+
+    FILE* file = fopen(outputPath, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to create %s\n", outputPath);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = SceneFile_WriteHeader(file, models, modelCount, instanceCount);
+
+    for (uint32_t first = 0; ok && first < instanceCount; first += WriteChunk)
+    {
+        const uint32_t count = instanceCount - first < WriteChunk ? instanceCount - first : WriteChunk;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Instance* instance = &instances[first + i];
+            records[i] = (SceneFileInstance){
+                .World = { instance->World[0], instance->World[1], instance->World[2] },
+                .Model = Instance_GetModel(instance),
+            };
+        }
+        ok = SceneFile_WriteInstances(file, records, count);
+    }
+
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write %s\n", outputPath);
+        return EXIT_FAILURE;
+    }
+    printf("Wrote %u instances (%s, seed %u) of %u models to %s\n", instanceCount, SceneGen_LayoutName(layout), seed, modelCount, outputPath);
+
+    free(records);
+    free(instances);
+    free(radii);
+    free(modelDescs);
+    free(models);
+    return EXIT_SUCCESS;
+}
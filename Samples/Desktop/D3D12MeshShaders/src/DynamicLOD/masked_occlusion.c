@@ -0,0 +1,895 @@
+#include "masked_occlusion.h"
+#include "instance_pack.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+#define CULL_JOB_SIZE 4096  // Instances handled by one job of the selection and test passes
+
+static const float c_minOccluderSize = 0.25f;  // Screen size of ComputeLOD below which an instance is not worth rasterizing
+
+/*****************************************************************
+    Private types
+******************************************************************/
+
+// A front-facing occluder triangle, vertices sorted top to bottom.
+typedef struct OccluderTriangle
+{
+    float    X[3];
+    float    Y[3];
+    float    Slope[3];         // dx/dy of the long (top-bottom), upper (top-middle) and lower (middle-bottom) edges
+    float    ZPlane[3];        // z = ZPlane[0] * x + ZPlane[1] * y + ZPlane[2]
+    float    ZMin;             // Nearest vertex
+    float    ZMax;             // Farthest vertex
+    uint16_t FirstX;           // Pixel columns and rows whose centers the bounding box contains
+    uint16_t LastX;
+    uint16_t FirstY;
+    uint16_t LastY;
+} OccluderTriangle;
+
+typedef struct OccluderCandidate
+{
+    float    Size;
+    uint32_t Instance;
+} OccluderCandidate;
+
+// The triangles of one occluder that survived setup, binned per row of tiles.
+struct MaskedOcclusionOccluder
+{
+    uint32_t  instance;
+    uint32_t  triangleCount;
+
+    uint32_t* bins;              // Triangle indices sorted by tile row
+    uint32_t  binCount;
+    uint32_t  binCapacity;
+    uint32_t* rowStart;          // tilesY + 1 offsets into 'bins'
+    bool      failed;            // An allocation failed
+};
+
+// Occluder candidates and test counts of one block of instances.
+struct MaskedOcclusionChunk
+{
+    OccluderCandidate candidates[MASKED_OCCLUSION_MAX_OCCLUDERS];   // Largest first
+    uint32_t          candidateCount;
+    uint32_t          tested;
+    uint32_t          occluded;
+};
+
+typedef struct CullContext
+{
+    MaskedOcclusion*  occ;
+    const Constants*  constants;
+    const Instance*   instances;
+    uint32_t          instanceCount;
+    const uint8_t*    lods;
+} CullContext;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static uint32_t LoadVertexIndex(const MeshletMesh* const mesh, uint32_t index)
+{
+    const uint8_t* addr = mesh->UniqueVertexIndices + (size_t)index * mesh->IndexSize;
+    if (mesh->IndexSize == 4)
+    {
+        uint32_t value;
+        memcpy(&value, addr, sizeof(value));
+        return value;
+    }
+    uint16_t value;
+    memcpy(&value, addr, sizeof(value));
+    return value;
+}
+
+static bool ReserveBins(struct MaskedOcclusionOccluder* const occluder, uint32_t needed)
+{
+    if (needed <= occluder->binCapacity)
+    {
+        return true;
+    }
+
+    uint32_t capacity = occluder->binCapacity ? occluder->binCapacity : 1024;
+    while (capacity < needed)
+    {
+        capacity *= 2;
+    }
+
+    uint32_t* bins = realloc(occluder->bins, capacity * sizeof(uint32_t));
+    if (!bins)
+    {
+        return false;
+    }
+    occluder->bins = bins;
+    occluder->binCapacity = capacity;
+    return true;
+}
+
+static uint32_t ChunkCount(uint32_t instanceCount)
+{
+    return (instanceCount + CULL_JOB_SIZE - 1) / CULL_JOB_SIZE;
+}
+
+static bool Reserve(MaskedOcclusion* const occ, uint32_t instanceCount)
+{
+    const uint32_t chunkCount = ChunkCount(instanceCount);
+    if (chunkCount > occ->chunkCapacity)
+    {
+        struct MaskedOcclusionChunk* chunks = realloc(occ->chunks, chunkCount * sizeof(struct MaskedOcclusionChunk));
+        if (!chunks)
+        {
+            return false;
+        }
+        occ->chunks = chunks;
+        occ->chunkCapacity = chunkCount;
+    }
+
+    if (instanceCount > occ->lodCapacity)
+    {
+        uint8_t* lods = realloc(occ->lods, instanceCount * sizeof(uint8_t));
+        if (!lods)
+        {
+            return false;
+        }
+        occ->lods = lods;
+        occ->lodCapacity = instanceCount;
+    }
+    return true;
+}
+
+// Inserts into a list sorted largest first, dropping the smallest entry when full.
+static void InsertCandidate(OccluderCandidate* const list, uint32_t* const count, OccluderCandidate candidate)
+{
+    if (*count == MASKED_OCCLUSION_MAX_OCCLUDERS && !(candidate.Size > list[*count - 1].Size))
+    {
+        return;
+    }
+
+    uint32_t i = *count < MASKED_OCCLUSION_MAX_OCCLUDERS ? (*count)++ : *count - 1;
+    while (i > 0 && candidate.Size > list[i - 1].Size)
+    {
+        list[i] = list[i - 1];
+        --i;
+    }
+    list[i] = candidate;
+}
+
+// The screen size InstanceCull_ComputeLOD derives the LOD from, unclamped.
+static float ScreenSize(const Constants* const constants, XMFLOAT4 sphere)
+{
+    const float dx = sphere.x - constants->ViewPosition.x;
+    const float dy = sphere.y - constants->ViewPosition.y;
+    const float dz = sphere.z - constants->ViewPosition.z;
+    const float d2 = dx * dx + dy * dy + dz * dz - sphere.w * sphere.w;
+    return d2 > 0.0f ? constants->RecipTanHalfFovy * sphere.w / sqrtf(d2) : INFINITY;
+}
+
+// Pass 1: copies the LODs of a block of instances and keeps its largest visible ones.
+static void SelectJob(void* context, uint32_t index)
+{
+    CullContext* ctx = context;
+    struct MaskedOcclusionChunk* chunk = &ctx->occ->chunks[index];
+    const uint32_t begin = index * CULL_JOB_SIZE;
+    const uint32_t end = begin + CULL_JOB_SIZE < ctx->instanceCount ? begin + CULL_JOB_SIZE : ctx->instanceCount;
+
+    memcpy(ctx->occ->lods + begin, ctx->lods + begin, end - begin);
+    *chunk = (struct MaskedOcclusionChunk){ 0 };
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        if (ctx->lods[i] == MASKED_OCCLUSION_CULLED)
+        {
+            continue;
+        }
+
+        const float size = ScreenSize(ctx->constants, Instance_UnpackBoundingSphere(&ctx->instances[i]));
+        if (size >= c_minOccluderSize)
+        {
+            InsertCandidate(chunk->candidates, &chunk->candidateCount, (OccluderCandidate){ size, i });
+        }
+    }
+}
+
+// Product of the transposed ViewProj and the world matrix of an instance: clip = rows . (p, 1).
+static void ObjectToClip(const Constants* const constants, const Instance* const instance, float rows[4][4])
+{
+    const float* viewProj = (const float*)&constants->ViewProj;
+    const float* world = &instance->World[0].x;
+    for (int k = 0; k < 4; ++k)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            rows[k][i] = viewProj[4 * k + 0] * world[i] + viewProj[4 * k + 1] * world[4 + i] + viewProj[4 * k + 2] * world[8 + i];
+        }
+        rows[k][3] += viewProj[4 * k + 3];
+    }
+}
+
+// ceil(v) for v >= 0, on four lanes: truncation, plus one where it rounded down.
+static __m128i CeilPositive(__m128 v)
+{
+    const __m128i t = _mm_cvttps_epi32(v);
+    return _mm_sub_epi32(t, _mm_castps_si128(_mm_cmpgt_ps(v, _mm_cvtepi32_ps(t))));
+}
+
+// First pixel whose center i + 0.5 is at or right of 'v', clamped to [0, size].
+static __m128i FirstCenter(__m128 v, __m128 size)
+{
+    return CeilPositive(_mm_min_ps(_mm_max_ps(_mm_sub_ps(v, _mm_set1_ps(0.5f)), _mm_setzero_ps()), size));
+}
+
+static void SetupTriangle(OccluderTriangle* const tri, const __m128 v[3], float area, const int32_t bounds[4])
+{
+    float x[3], y[3], z[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        float p[4];
+        _mm_storeu_ps(p, v[i]);
+        x[i] = p[0];
+        y[i] = p[1];
+        z[i] = p[2];
+    }
+
+    uint32_t top = 0;
+    uint32_t bottom = 0;
+    for (uint32_t i = 1; i < 3; ++i)
+    {
+        top = y[i] < y[top] ? i : top;
+        bottom = y[i] >= y[bottom] ? i : bottom;
+    }
+    const uint32_t order[3] = { top, 3 - top - bottom, bottom };
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        tri->X[i] = x[order[i]];
+        tri->Y[i] = y[order[i]];
+    }
+    tri->Slope[0] = (tri->X[2] - tri->X[0]) / (tri->Y[2] - tri->Y[0]);
+    tri->Slope[1] = (tri->X[1] - tri->X[0]) / (tri->Y[1] - tri->Y[0]);
+    tri->Slope[2] = (tri->X[2] - tri->X[1]) / (tri->Y[2] - tri->Y[1]);
+
+    const float invArea = 1.0f / area;
+    const float dz1 = z[1] - z[0];
+    const float dz2 = z[2] - z[0];
+    tri->ZPlane[0] = (dz1 * (y[2] - y[0]) - dz2 * (y[1] - y[0])) * invArea;
+    tri->ZPlane[1] = (dz2 * (x[1] - x[0]) - dz1 * (x[2] - x[0])) * invArea;
+    tri->ZPlane[2] = z[0] - tri->ZPlane[0] * x[0] - tri->ZPlane[1] * y[0];
+    tri->ZMin = fminf(z[0], fminf(z[1], z[2]));
+    tri->ZMax = fmaxf(z[0], fmaxf(z[1], z[2]));
+
+    tri->FirstX = (uint16_t)bounds[0];
+    tri->LastX = (uint16_t)(bounds[1] - 1);
+    tri->FirstY = (uint16_t)bounds[2];
+    tri->LastY = (uint16_t)(bounds[3] - 1);
+}
+
+// Counting sort of the triangles of an occluder by the rows of tiles they overlap.
+static void BinTriangles(const MaskedOcclusion* const occ, struct MaskedOcclusionOccluder* const occluder,
+                         const OccluderTriangle* const triangles, uint32_t triangleCount)
+{
+    occluder->triangleCount = triangleCount;
+    occluder->failed = false;
+
+    uint32_t* rowStart = occluder->rowStart;
+    memset(rowStart, 0, (occ->tilesY + 1) * sizeof(uint32_t));
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        for (uint32_t r = triangles[t].FirstY / MASKED_OCCLUSION_TILE_HEIGHT; r <= triangles[t].LastY / MASKED_OCCLUSION_TILE_HEIGHT; ++r)
+        {
+            rowStart[r + 1]++;
+        }
+    }
+    for (uint32_t r = 0; r < occ->tilesY; ++r)
+    {
+        rowStart[r + 1] += rowStart[r];
+    }
+
+    occluder->binCount = rowStart[occ->tilesY];
+    if (!ReserveBins(occluder, occluder->binCount))
+    {
+        occluder->failed = true;
+        return;
+    }
+
+    // Fill in order, using rowStart as the write cursor, then shift it back.
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        for (uint32_t r = triangles[t].FirstY / MASKED_OCCLUSION_TILE_HEIGHT; r <= triangles[t].LastY / MASKED_OCCLUSION_TILE_HEIGHT; ++r)
+        {
+            occluder->bins[rowStart[r]++] = t;
+        }
+    }
+    for (uint32_t r = occ->tilesY; r > 0; --r)
+    {
+        rowStart[r] = rowStart[r - 1];
+    }
+    rowStart[0] = 0;
+}
+
+/*
+* Pass 2: transforms the vertices of one occluder to screen space, four at a time, then culls its
+* triangles four at a time. Only the survivors are set up one by one.
+*/
+static void TransformJob(void* context, uint32_t index)
+{
+    CullContext* ctx = context;
+    MaskedOcclusion* occ = ctx->occ;
+    const uint32_t stride = occ->vertexStride;
+
+    float rows[4][4];
+    ObjectToClip(ctx->constants, &ctx->instances[occ->occluders[index].instance], rows);
+
+    const float* px = occ->positions;
+    const float* py = px + stride;
+    const float* pz = py + stride;
+    __m128* screen = (__m128*)occ->screen + (size_t)index * stride;
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 halfWidth = _mm_set1_ps(0.5f * (float)occ->width);
+    const __m128 halfHeight = _mm_set1_ps(0.5f * (float)occ->height);
+    for (uint32_t v = 0; v < stride; v += 4)
+    {
+        const __m128 x = _mm_load_ps(px + v);
+        const __m128 y = _mm_load_ps(py + v);
+        const __m128 z = _mm_load_ps(pz + v);
+
+        __m128 clip[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            clip[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(rows[k][0])), _mm_mul_ps(y, _mm_set1_ps(rows[k][1]))),
+                                 _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(rows[k][2])), _mm_set1_ps(rows[k][3])));
+        }
+
+        // Same viewport mapping as SoftRaster. Clip z is kept to find the vertices in front of the near plane.
+        const __m128 invW = _mm_div_ps(one, clip[3]);
+        __m128 sx = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(clip[0], invW), one), halfWidth);
+        __m128 sy = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(clip[1], invW)), halfHeight);
+        __m128 sz = _mm_mul_ps(clip[2], invW);
+        __m128 clipZ = clip[2];
+        _MM_TRANSPOSE4_PS(sx, sy, sz, clipZ);
+        screen[v + 0] = sx;
+        screen[v + 1] = sy;
+        screen[v + 2] = sz;
+        screen[v + 3] = clipZ;
+    }
+
+    const __m128 width = _mm_set1_ps((float)occ->width);
+    const __m128 height = _mm_set1_ps((float)occ->height);
+    OccluderTriangle* first = occ->triangles + (size_t)index * occ->triangleStride;
+    OccluderTriangle* out = first;
+    for (uint32_t t = 0; t < occ->triangleStride; t += 4)
+    {
+        const uint32_t* i = &occ->indices[3 * t];
+
+        // x, y, z and clip z of vertex k of the four triangles.
+        __m128 v[3][4];
+        __m128 x[3], y[3], z[3], clipZ[3];
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            for (uint32_t lane = 0; lane < 4; ++lane)
+            {
+                v[k][lane] = screen[i[3 * lane + k]];
+            }
+            x[k] = v[k][0];
+            y[k] = v[k][1];
+            z[k] = v[k][2];
+            clipZ[k] = v[k][3];
+            _MM_TRANSPOSE4_PS(x[k], y[k], z[k], clipZ[k]);
+        }
+
+        // Clockwise on screen (y down) is front facing, as in SoftRaster: back faces are hidden by the front ones.
+        // Dropping occluder triangles is always safe, so those reaching in front of the near plane are skipped, not clipped.
+        const __m128 area = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x[1], x[0]), _mm_sub_ps(y[2], y[0])),
+                                       _mm_mul_ps(_mm_sub_ps(y[1], y[0]), _mm_sub_ps(x[2], x[0])));
+        const __m128 behind = _mm_min_ps(clipZ[0], _mm_min_ps(clipZ[1], clipZ[2]));
+        __m128i keep = _mm_castps_si128(_mm_and_ps(_mm_cmpgt_ps(area, _mm_setzero_ps()), _mm_cmpge_ps(behind, _mm_setzero_ps())));
+
+        // Pixel rows and columns whose centers the bounding box contains; most triangles of small occluders have none.
+        const __m128i x0 = FirstCenter(_mm_min_ps(x[0], _mm_min_ps(x[1], x[2])), width);
+        const __m128i x1 = FirstCenter(_mm_max_ps(x[0], _mm_max_ps(x[1], x[2])), width);
+        const __m128i y0 = FirstCenter(_mm_min_ps(y[0], _mm_min_ps(y[1], y[2])), height);
+        const __m128i y1 = FirstCenter(_mm_max_ps(y[0], _mm_max_ps(y[1], y[2])), height);
+        keep = _mm_and_si128(keep, _mm_and_si128(_mm_cmpgt_epi32(x1, x0), _mm_cmpgt_epi32(y1, y0)));
+
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(keep));
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        float areas[4];
+        int32_t bounds[4][4];
+        _mm_storeu_ps(areas, area);
+        _mm_storeu_si128((__m128i*)bounds[0], x0);
+        _mm_storeu_si128((__m128i*)bounds[1], x1);
+        _mm_storeu_si128((__m128i*)bounds[2], y0);
+        _mm_storeu_si128((__m128i*)bounds[3], y1);
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            if (mask & (1 << lane))
+            {
+                const __m128 vertices[3] = { v[0][lane], v[1][lane], v[2][lane] };
+                const int32_t box[4] = { bounds[0][lane], bounds[1][lane], bounds[2][lane], bounds[3][lane] };
+                SetupTriangle(out++, vertices, areas[lane], box);
+            }
+        }
+    }
+    BinTriangles(occ, &occ->occluders[index], first, (uint32_t)(out - first));
+}
+
+/*
+* Pixel spans [start, end) of a triangle on four scanlines starting at row 'y'. Both ends are
+* clamped to the screen; rows outside the triangle get empty spans.
+*/
+static void RowSpans(const OccluderTriangle* const tri, uint32_t y, float width, int32_t start[4], int32_t end[4])
+{
+    const __m128 yc = _mm_add_ps(_mm_set1_ps((float)y + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+    const __m128 dyTop = _mm_sub_ps(yc, _mm_set1_ps(tri->Y[0]));
+    const __m128 dyMiddle = _mm_sub_ps(yc, _mm_set1_ps(tri->Y[1]));
+
+    // Either side of the middle vertex, the short edge is the upper or the lower one.
+    const __m128 upper = _mm_cmplt_ps(yc, _mm_set1_ps(tri->Y[1]));
+    const __m128 xLong = _mm_add_ps(_mm_set1_ps(tri->X[0]), _mm_mul_ps(dyTop, _mm_set1_ps(tri->Slope[0])));
+    const __m128 xUpper = _mm_add_ps(_mm_set1_ps(tri->X[0]), _mm_mul_ps(dyTop, _mm_set1_ps(tri->Slope[1])));
+    const __m128 xLower = _mm_add_ps(_mm_set1_ps(tri->X[1]), _mm_mul_ps(dyMiddle, _mm_set1_ps(tri->Slope[2])));
+    const __m128 xShort = _mm_or_ps(_mm_and_ps(upper, xUpper), _mm_andnot_ps(upper, xLower));
+
+    // Pixel i is covered when its center i + 0.5 is in [left, right).
+    const __m128 maxX = _mm_set1_ps(width);
+    const __m128i left = FirstCenter(_mm_min_ps(xLong, xShort), maxX);
+    const __m128i right = FirstCenter(_mm_max_ps(xLong, xShort), maxX);
+
+    const __m128i inside = _mm_castps_si128(_mm_and_ps(_mm_cmpge_ps(yc, _mm_set1_ps(tri->Y[0])), _mm_cmplt_ps(yc, _mm_set1_ps(tri->Y[2]))));
+    _mm_storeu_si128((__m128i*)start, _mm_and_si128(inside, left));
+    _mm_storeu_si128((__m128i*)end, _mm_and_si128(inside, right));
+}
+
+// Bits [start, end) of a 32-pixel row, clamped.
+static uint32_t SpanMask(int32_t start, int32_t end)
+{
+    start = start < 0 ? 0 : start;
+    end = end > MASKED_OCCLUSION_TILE_WIDTH ? MASKED_OCCLUSION_TILE_WIDTH : end;
+    if (end <= start)
+    {
+        return 0;
+    }
+    return (uint32_t)((((uint64_t)1 << (end - start)) - 1) << start);
+}
+
+static void UpdateTile(MaskedOcclusionTile* const tile, const uint32_t coverage[MASKED_OCCLUSION_TILE_HEIGHT], float z)
+{
+    // Behind the reference layer: nothing to learn.
+    if (z >= tile->ZMax0)
+    {
+        return;
+    }
+
+    // Much nearer than the working layer: merging would push it back, so drop it instead.
+    if (tile->ZMax1 - z > tile->ZMax0 - tile->ZMax1)
+    {
+        tile->ZMax1 = 0.0f;
+        memset(tile->Mask, 0, sizeof(tile->Mask));
+    }
+
+    tile->ZMax1 = fmaxf(tile->ZMax1, z);
+    uint32_t full = ~0u;
+    for (uint32_t r = 0; r < MASKED_OCCLUSION_TILE_HEIGHT; ++r)
+    {
+        tile->Mask[r] |= coverage[r];
+        full &= tile->Mask[r];
+    }
+
+    if (full == ~0u)
+    {
+        tile->ZMax0 = fminf(tile->ZMax0, tile->ZMax1);
+        tile->ZMax1 = 0.0f;
+        memset(tile->Mask, 0, sizeof(tile->Mask));
+    }
+}
+
+// Farthest depth of a triangle's plane over the part of a tile its bounding box overlaps.
+static float TileDepth(const OccluderTriangle* const tri, float x0, float y0)
+{
+    const float minX = fmaxf(x0, fminf(tri->X[0], fminf(tri->X[1], tri->X[2])));
+    const float maxX = fminf(x0 + MASKED_OCCLUSION_TILE_WIDTH, fmaxf(tri->X[0], fmaxf(tri->X[1], tri->X[2])));
+    const float minY = fmaxf(y0, tri->Y[0]);
+    const float maxY = fminf(y0 + MASKED_OCCLUSION_TILE_HEIGHT, tri->Y[2]);
+
+    const float zx = fmaxf(tri->ZPlane[0] * minX, tri->ZPlane[0] * maxX);
+    const float zy = fmaxf(tri->ZPlane[1] * minY, tri->ZPlane[1] * maxY);
+    return fminf(zx + zy + tri->ZPlane[2], tri->ZMax);
+}
+
+// Pass 3: clears one row of tiles and draws every occluder triangle overlapping it.
+static void RasterJob(void* context, uint32_t tileRow)
+{
+    CullContext* ctx = context;
+    MaskedOcclusion* occ = ctx->occ;
+    MaskedOcclusionTile* tiles = occ->tiles + (size_t)tileRow * occ->tilesX;
+    for (uint32_t tx = 0; tx < occ->tilesX; ++tx)
+    {
+        tiles[tx] = (MaskedOcclusionTile){ .ZMax0 = 1.0f };
+    }
+
+    const uint32_t y0 = tileRow * MASKED_OCCLUSION_TILE_HEIGHT;
+    for (uint32_t o = 0; o < occ->occluderCount; ++o)
+    {
+        const struct MaskedOcclusionOccluder* occluder = &occ->occluders[o];
+        const OccluderTriangle* tris = occ->triangles + (size_t)o * occ->triangleStride;
+        for (uint32_t b = occluder->rowStart[tileRow]; b < occluder->rowStart[tileRow + 1]; ++b)
+        {
+            const OccluderTriangle* tri = &tris[occluder->bins[b]];
+
+            // Occluders come roughly front to back: skip triangles behind every tile they overlap.
+            const uint32_t firstTile = tri->FirstX / MASKED_OCCLUSION_TILE_WIDTH;
+            const uint32_t lastTile = tri->LastX / MASKED_OCCLUSION_TILE_WIDTH;
+            bool hidden = true;
+            for (uint32_t tx = firstTile; tx <= lastTile && hidden; ++tx)
+            {
+                hidden = tri->ZMin >= tiles[tx].ZMax0;
+            }
+            if (hidden)
+            {
+                continue;
+            }
+
+            int32_t start[MASKED_OCCLUSION_TILE_HEIGHT];
+            int32_t end[MASKED_OCCLUSION_TILE_HEIGHT];
+            RowSpans(tri, y0, (float)occ->width, start, end);
+            RowSpans(tri, y0 + 4, (float)occ->width, start + 4, end + 4);
+
+            for (uint32_t tx = firstTile; tx <= lastTile; ++tx)
+            {
+                if (tri->ZMin >= tiles[tx].ZMax0)
+                {
+                    continue;
+                }
+
+                const int32_t x0 = (int32_t)(tx * MASKED_OCCLUSION_TILE_WIDTH);
+                uint32_t coverage[MASKED_OCCLUSION_TILE_HEIGHT];
+                uint32_t any = 0;
+                for (uint32_t r = 0; r < MASKED_OCCLUSION_TILE_HEIGHT; ++r)
+                {
+                    coverage[r] = SpanMask(start[r] - x0, end[r] - x0);
+                    any |= coverage[r];
+                }
+                if (any != 0)
+                {
+                    UpdateTile(&tiles[tx], coverage, TileDepth(tri, (float)x0, (float)y0));
+                }
+            }
+        }
+    }
+}
+
+/*
+* Screen rectangle and nearest depth of the bounding box of a sphere: the box corners are the
+* center's clip position plus or minus the columns of ViewProj scaled by the radius, four corners
+* per SSE vector. Returns false if the box reaches in front of the near plane.
+*/
+static bool ProjectBox(const Constants* const constants, XMFLOAT4 sphere, float width, float height,
+                       float* const minX, float* const maxX, float* const minY, float* const maxY, float* const minZ)
+{
+    const float* viewProj = (const float*)&constants->ViewProj;
+    const __m128 signX = _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    const __m128 signY = _mm_set_ps(1.0f, 1.0f, -1.0f, -1.0f);
+
+    __m128 lo[4];
+    __m128 hi[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        const float* row = viewProj + 4 * k;
+        const float center = row[0] * sphere.x + row[1] * sphere.y + row[2] * sphere.z + row[3];
+        const __m128 side = _mm_add_ps(_mm_set1_ps(center),
+            _mm_add_ps(_mm_mul_ps(signX, _mm_set1_ps(row[0] * sphere.w)), _mm_mul_ps(signY, _mm_set1_ps(row[1] * sphere.w))));
+        const __m128 dz = _mm_set1_ps(row[2] * sphere.w);
+        lo[k] = _mm_sub_ps(side, dz);
+        hi[k] = _mm_add_ps(side, dz);
+    }
+
+    const __m128 behind = _mm_or_ps(_mm_cmplt_ps(lo[2], _mm_setzero_ps()), _mm_cmplt_ps(hi[2], _mm_setzero_ps()));
+    if (_mm_movemask_ps(behind) != 0)
+    {
+        return false;
+    }
+
+    const __m128 invLo = _mm_div_ps(_mm_set1_ps(1.0f), lo[3]);
+    const __m128 invHi = _mm_div_ps(_mm_set1_ps(1.0f), hi[3]);
+    const __m128 xLo = _mm_mul_ps(lo[0], invLo);
+    const __m128 xHi = _mm_mul_ps(hi[0], invHi);
+    const __m128 yLo = _mm_mul_ps(lo[1], invLo);
+    const __m128 yHi = _mm_mul_ps(hi[1], invHi);
+    const __m128 zLo = _mm_mul_ps(lo[2], invLo);
+    const __m128 zHi = _mm_mul_ps(hi[2], invHi);
+
+    float xMin[4], xMax[4], yMin[4], yMax[4], z[4];
+    _mm_storeu_ps(xMin, _mm_min_ps(xLo, xHi));
+    _mm_storeu_ps(xMax, _mm_max_ps(xLo, xHi));
+    _mm_storeu_ps(yMin, _mm_min_ps(yLo, yHi));
+    _mm_storeu_ps(yMax, _mm_max_ps(yLo, yHi));
+    _mm_storeu_ps(z, _mm_min_ps(zLo, zHi));
+
+    float nx0 = xMin[0], nx1 = xMax[0], ny0 = yMin[0], ny1 = yMax[0], nz = z[0];
+    for (int i = 1; i < 4; ++i)
+    {
+        nx0 = fminf(nx0, xMin[i]);
+        nx1 = fmaxf(nx1, xMax[i]);
+        ny0 = fminf(ny0, yMin[i]);
+        ny1 = fmaxf(ny1, yMax[i]);
+        nz = fminf(nz, z[i]);
+    }
+
+    // Screen y goes down: the top of the rectangle is the largest NDC y.
+    *minX = (nx0 + 1.0f) * 0.5f * width;
+    *maxX = (nx1 + 1.0f) * 0.5f * width;
+    *minY = (1.0f - ny1) * 0.5f * height;
+    *maxY = (1.0f - ny0) * 0.5f * height;
+    *minZ = nz;
+    return true;
+}
+
+static bool IsOccluded(const MaskedOcclusion* const occ, const Constants* const constants, XMFLOAT4 sphere)
+{
+    float minX, maxX, minY, maxY, minZ;
+    if (!ProjectBox(constants, sphere, (float)occ->width, (float)occ->height, &minX, &maxX, &minY, &maxY, &minZ))
+    {
+        return false;
+    }
+
+    // Every pixel the box may touch. Off-screen boxes passed frustum culling conservatively: keep them.
+    const int32_t x0 = (int32_t)fmaxf(floorf(minX), 0.0f);
+    const int32_t x1 = (int32_t)fminf(ceilf(maxX), (float)occ->width);
+    const int32_t y0 = (int32_t)fmaxf(floorf(minY), 0.0f);
+    const int32_t y1 = (int32_t)fminf(ceilf(maxY), (float)occ->height);
+    if (x0 >= x1 || y0 >= y1)
+    {
+        return false;
+    }
+
+    for (int32_t ty = y0 / MASKED_OCCLUSION_TILE_HEIGHT; ty <= (y1 - 1) / MASKED_OCCLUSION_TILE_HEIGHT; ++ty)
+    {
+        const int32_t tileY = ty * MASKED_OCCLUSION_TILE_HEIGHT;
+        const int32_t firstRow = y0 > tileY ? y0 - tileY : 0;
+        const int32_t lastRow = y1 - tileY < MASKED_OCCLUSION_TILE_HEIGHT ? y1 - tileY : MASKED_OCCLUSION_TILE_HEIGHT;
+
+        for (int32_t tx = x0 / MASKED_OCCLUSION_TILE_WIDTH; tx <= (x1 - 1) / MASKED_OCCLUSION_TILE_WIDTH; ++tx)
+        {
+            const MaskedOcclusionTile* tile = &occ->tiles[(size_t)ty * occ->tilesX + tx];
+            if (minZ > tile->ZMax0)
+            {
+                continue;
+            }
+            if (minZ <= tile->ZMax1)
+            {
+                return false;
+            }
+
+            // Between the layers: hidden only where the working layer covers the rectangle.
+            const int32_t tileX = tx * MASKED_OCCLUSION_TILE_WIDTH;
+            const uint32_t columns = SpanMask(x0 - tileX, x1 - tileX);
+            for (int32_t r = firstRow; r < lastRow; ++r)
+            {
+                if (columns & ~tile->Mask[r])
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Pass 4: tests the visible instances of a block against the buffer.
+static void TestJob(void* context, uint32_t index)
+{
+    CullContext* ctx = context;
+    MaskedOcclusion* occ = ctx->occ;
+    struct MaskedOcclusionChunk* chunk = &occ->chunks[index];
+    const uint32_t begin = index * CULL_JOB_SIZE;
+    const uint32_t end = begin + CULL_JOB_SIZE < ctx->instanceCount ? begin + CULL_JOB_SIZE : ctx->instanceCount;
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        if (occ->lods[i] == MASKED_OCCLUSION_CULLED)
+        {
+            continue;
+        }
+
+        chunk->tested++;
+        if (IsOccluded(occ, ctx->constants, Instance_UnpackBoundingSphere(&ctx->instances[i])))
+        {
+            occ->lods[i] = MASKED_OCCLUSION_CULLED;
+            chunk->occluded++;
+        }
+    }
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool MaskedOcclusion_Init(MaskedOcclusion* const occ, JobSystem* const jobs, uint32_t width, uint32_t height)
+{
+    *occ = (MaskedOcclusion){
+        .jobs = jobs,
+        .width = width,
+        .height = height,
+        .tilesX = width / MASKED_OCCLUSION_TILE_WIDTH,
+        .tilesY = height / MASKED_OCCLUSION_TILE_HEIGHT,
+    };
+
+    if (width == 0 || height == 0 || width % MASKED_OCCLUSION_TILE_WIDTH != 0 || height % MASKED_OCCLUSION_TILE_HEIGHT != 0 || width > UINT16_MAX || height > UINT16_MAX)
+    {
+        return false;
+    }
+
+    occ->tiles = calloc((size_t)occ->tilesX * occ->tilesY, sizeof(MaskedOcclusionTile));
+    occ->occluders = calloc(MASKED_OCCLUSION_MAX_OCCLUDERS, sizeof(struct MaskedOcclusionOccluder));
+    if (!occ->tiles || !occ->occluders)
+    {
+        MaskedOcclusion_Destroy(occ);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < MASKED_OCCLUSION_MAX_OCCLUDERS; ++i)
+    {
+        occ->occluders[i].rowStart = calloc(occ->tilesY + 1, sizeof(uint32_t));
+        if (!occ->occluders[i].rowStart)
+        {
+            MaskedOcclusion_Destroy(occ);
+            return false;
+        }
+    }
+    return true;
+}
+
+void MaskedOcclusion_Destroy(MaskedOcclusion* const occ)
+{
+    if (occ->occluders)
+    {
+        for (uint32_t i = 0; i < MASKED_OCCLUSION_MAX_OCCLUDERS; ++i)
+        {
+            free(occ->occluders[i].bins);
+            free(occ->occluders[i].rowStart);
+        }
+    }
+
+    free(occ->occluders);
+    free(occ->tiles);
+    _mm_free(occ->positions);
+    free(occ->indices);
+    _mm_free(occ->screen);
+    free(occ->triangles);
+    free(occ->chunks);
+    free(occ->lods);
+    *occ = (MaskedOcclusion){ 0 };
+}
+
+bool MaskedOcclusion_SetOccluderMesh(MaskedOcclusion* const occ, const MeshletMesh* const mesh)
+{
+    _mm_free(occ->positions);
+    free(occ->indices);
+    _mm_free(occ->screen);
+    free(occ->triangles);
+    occ->positions = NULL;
+    occ->indices = NULL;
+    occ->screen = NULL;
+    occ->triangles = NULL;
+    occ->occluderMesh = NULL;
+
+    uint32_t triangleCount = 0;
+    for (uint32_t m = 0; m < mesh->MeshletCount; ++m)
+    {
+        triangleCount += mesh->Meshlets[m].PrimCount;
+    }
+
+    // Both are padded to the SIMD width. Padding vertices sit at the origin, padding triangles use
+    // vertex 0 three times and get culled as degenerate.
+    const uint32_t stride = (mesh->VertexCount + 3) & ~3u;
+    const uint32_t triangleStride = (triangleCount + 3) & ~3u;
+    occ->positions = _mm_malloc(3 * (size_t)stride * sizeof(float), 16);
+    occ->indices = calloc(3 * (size_t)triangleStride, sizeof(uint32_t));
+    occ->screen = _mm_malloc(4 * (size_t)stride * MASKED_OCCLUSION_MAX_OCCLUDERS * sizeof(float), 16);
+    occ->triangles = malloc((size_t)triangleStride * MASKED_OCCLUSION_MAX_OCCLUDERS * sizeof(OccluderTriangle));
+    if (!occ->positions || !occ->indices || !occ->screen || !occ->triangles)
+    {
+        return false;
+    }
+
+    memset(occ->positions, 0, 3 * (size_t)stride * sizeof(float));
+    for (uint32_t v = 0; v < mesh->VertexCount; ++v)
+    {
+        float position[3];
+        memcpy(position, mesh->Vertices + (size_t)v * mesh->VertexStride, sizeof(position));
+        occ->positions[v] = position[0];
+        occ->positions[stride + v] = position[1];
+        occ->positions[2 * stride + v] = position[2];
+    }
+
+    uint32_t* out = occ->indices;
+    for (uint32_t m = 0; m < mesh->MeshletCount; ++m)
+    {
+        const Meshlet* meshlet = &mesh->Meshlets[m];
+        for (uint32_t p = 0; p < meshlet->PrimCount; ++p)
+        {
+            const uint32_t packed = mesh->PrimitiveIndices[meshlet->PrimOffset + p];
+            *out++ = LoadVertexIndex(mesh, meshlet->VertOffset + (packed & 0x3FF));
+            *out++ = LoadVertexIndex(mesh, meshlet->VertOffset + ((packed >> 10) & 0x3FF));
+            *out++ = LoadVertexIndex(mesh, meshlet->VertOffset + ((packed >> 20) & 0x3FF));
+        }
+    }
+
+    occ->occluderMesh = mesh;
+    occ->vertexCount = mesh->VertexCount;
+    occ->vertexStride = stride;
+    occ->triangleCount = triangleCount;
+    occ->triangleStride = triangleStride;
+    return true;
+}
+
+bool MaskedOcclusion_Cull(MaskedOcclusion* const occ, const Constants* const constants, const Instance* const instances,
+                          uint32_t instanceCount, const uint8_t* const lods, MaskedOcclusionStats* const stats)
+{
+    *stats = (MaskedOcclusionStats){ 0 };
+    if (!Reserve(occ, instanceCount))
+    {
+        return false;
+    }
+
+    CullContext ctx = {
+        .occ = occ,
+        .constants = constants,
+        .instances = instances,
+        .instanceCount = instanceCount,
+        .lods = lods,
+    };
+
+    const uint32_t chunkCount = ChunkCount(instanceCount);
+    JobSystem_ParallelFor(occ->jobs, chunkCount, SelectJob, &ctx);
+
+    // Merge the per-block lists in block order, so the occluders do not depend on the thread count.
+    OccluderCandidate best[MASKED_OCCLUSION_MAX_OCCLUDERS];
+    uint32_t bestCount = 0;
+    for (uint32_t c = 0; c < chunkCount; ++c)
+    {
+        for (uint32_t i = 0; i < occ->chunks[c].candidateCount; ++i)
+        {
+            InsertCandidate(best, &bestCount, occ->chunks[c].candidates[i]);
+        }
+    }
+
+    // Largest first is roughly front to back, which keeps the working layers tight.
+    occ->occluderCount = occ->occluderMesh ? bestCount : 0;
+    for (uint32_t i = 0; i < occ->occluderCount; ++i)
+    {
+        occ->occluders[i].instance = best[i].Instance;
+    }
+
+    JobSystem_ParallelFor(occ->jobs, occ->occluderCount, TransformJob, &ctx);
+    for (uint32_t i = 0; i < occ->occluderCount; ++i)
+    {
+        if (occ->occluders[i].failed)
+        {
+            return false;
+        }
+        stats->OccluderTriangles += occ->occluders[i].triangleCount;
+    }
+
+    JobSystem_ParallelFor(occ->jobs, occ->tilesY, RasterJob, &ctx);
+    if (occ->occluderCount != 0)
+    {
+        JobSystem_ParallelFor(occ->jobs, chunkCount, TestJob, &ctx);
+    }
+
+    stats->Occluders = occ->occluderCount;
+    for (uint32_t c = 0; c < chunkCount; ++c)
+    {
+        stats->Tested += occ->chunks[c].tested;
+        stats->Occluded += occ->chunks[c].occluded;
+    }
+    return true;
+}
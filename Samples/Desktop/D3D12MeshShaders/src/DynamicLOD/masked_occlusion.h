@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+#include "meshlet_mesh.h"
+#include "job_system.h"
+
+typedef struct Constants Constants;
+typedef struct Instance Instance;
+
+#define MASKED_OCCLUSION_TILE_WIDTH    32   // Pixels per tile row: one coverage word
+#define MASKED_OCCLUSION_TILE_HEIGHT   8
+#define MASKED_OCCLUSION_MAX_OCCLUDERS 16   // Instances rasterized per frame, the largest on screen
+#define MASKED_OCCLUSION_CULLED        0xFF // lods value of culled instances
+
+typedef struct MaskedOcclusionStats
+{
+    uint32_t Occluders;
+    uint32_t OccluderTriangles;  // Front-facing triangles covering at least a pixel row and column
+    uint32_t Tested;             // Instances tested against the buffer: the visible ones
+    uint32_t Occluded;
+} MaskedOcclusionStats;
+
+// Two depth layers per tile: every pixel is nearer than ZMax0, and those in Mask than ZMax1.
+typedef struct MaskedOcclusionTile
+{
+    uint32_t Mask[MASKED_OCCLUSION_TILE_HEIGHT];   // One bit per pixel, bit x of word y
+    float    ZMax0;                                // Reference layer, 1 when nothing was drawn
+    float    ZMax1;                                // Working layer, farthest depth drawn into Mask
+} MaskedOcclusionTile;
+
+struct MaskedOcclusionChunk;
+struct MaskedOcclusionOccluder;
+struct OccluderTriangle;
+
+/****************************************************************************************************
+ * CPU occlusion culling against a low resolution masked depth buffer, after Andersson et al.,      *
+ * "Masked Software Occlusion Culling" (HPG 2016).                                                  *
+ *                                                                                                  *
+ * The buffer is split into 32x8 pixel tiles that hold a coverage mask and two maximum depths       *
+ * instead of per-pixel depths. A triangle merges into the working layer of each tile it covers;    *
+ * once the working layer covers the tile, it becomes the reference layer. When a triangle is much  *
+ * nearer than the working layer, the working layer is dropped instead, which can only make the     *
+ * buffer more conservative.                                                                        *
+ *                                                                                                  *
+ * A frame runs in four parallel passes over the job system:                                        *
+ *   1. the largest visible instances on screen are picked as occluders;                            *
+ *   2. their vertices are transformed and their triangles culled four at a time with SSE, and the  *
+ *      survivors binned per row of tiles;                                                          *
+ *   3. each row of tiles rasterizes its triangles, four scanlines at a time;                       *
+ *   4. every visible instance tests the screen rectangle and nearest depth of its bounding box     *
+ *      against the tiles it overlaps, and is culled when every one of them is nearer.              *
+ *                                                                                                  *
+ * Occluders are drawn with a single mesh, normally the coarsest LOD of the model. Simplification   *
+ * can move its silhouette slightly past the one of the drawn LOD, so the result is approximate at  *
+ * the edges of occluders, as with any occluder mesh that is not strictly conservative: an instance *
+ * showing a few pixels past an occluder's edge can be culled, and pops in once it shows more. An   *
+ * inner hull of the model, or its finest LOD, avoids it at the cost of more occluder triangles.    *
+ ****************************************************************************************************/
+typedef struct MaskedOcclusion
+{
+    JobSystem*                      jobs;
+
+    uint32_t                        width;
+    uint32_t                        height;
+    uint32_t                        tilesX;
+    uint32_t                        tilesY;
+    MaskedOcclusionTile*            tiles;
+
+    const MeshletMesh*              occluderMesh;
+    float*                          positions;           // Occluder mesh vertices, x, y then z planes of 'vertexStride' floats
+    uint32_t*                       indices;             // Occluder mesh triangles, 3 vertex indices each, padded with degenerate ones
+    uint32_t                        vertexCount;
+    uint32_t                        vertexStride;        // vertexCount rounded up to 4
+    uint32_t                        triangleCount;
+    uint32_t                        triangleStride;      // triangleCount rounded up to 4
+
+    struct MaskedOcclusionOccluder* occluders;           // MASKED_OCCLUSION_MAX_OCCLUDERS
+    uint32_t                        occluderCount;
+    float*                          screen;              // Screen x, y, z and clip z of the vertices, vertexStride per occluder
+    struct OccluderTriangle*        triangles;           // Set up triangles, triangleStride per occluder
+
+    struct MaskedOcclusionChunk*    chunks;
+    uint32_t                        chunkCapacity;
+
+    uint8_t*                        lods;                // LOD per instance, MASKED_OCCLUSION_CULLED if culled
+    uint32_t                        lodCapacity;
+} MaskedOcclusion;
+
+// 'width' must be a multiple of MASKED_OCCLUSION_TILE_WIDTH and 'height' of MASKED_OCCLUSION_TILE_HEIGHT.
+bool MaskedOcclusion_Init            (MaskedOcclusion* const occ, JobSystem* const jobs, uint32_t width, uint32_t height);
+void MaskedOcclusion_Destroy         (MaskedOcclusion* const occ);
+
+// Flattens the meshlets of the mesh occluders are drawn with. Returns false on allocation failure.
+bool MaskedOcclusion_SetOccluderMesh (MaskedOcclusion* const occ, const MeshletMesh* const mesh);
+
+/****************************************************************************************************
+ * Occlusion culls the instances that 'lods' marks visible, e.g. a VisibilityCache's lods, for the  *
+ * shader constants of a frame. occ->lods receives a copy of 'lods' where occluded instances are    *
+ * MASKED_OCCLUSION_CULLED. Returns false on allocation failure.                                    *
+ ****************************************************************************************************/
+bool MaskedOcclusion_Cull            (MaskedOcclusion* const occ, const Constants* const constants, const Instance* const instances,
+                                      uint32_t instanceCount, const uint8_t* const lods, MaskedOcclusionStats* const stats);
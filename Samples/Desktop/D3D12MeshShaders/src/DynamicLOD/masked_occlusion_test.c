@@ -0,0 +1,331 @@
+/*************************************************************************************
+ Masked occlusion tests.
+
+ Puts a wall of large boxes in front of the camera and thousands of small boxes
+ around it, every box drawn with the same cube occluder mesh, and checks the culler
+ is conservative: for every instance it culls, rays from the eye to points spread
+ over its bounding sphere all hit a wall box first, within a pixel of its
+ silhouette. The wall boxes are the largest on screen, so they are the occluders.
+ Also checks that it culls most of what the wall hides, keeps the LODs of the
+ rest, never revives culled instances, culls nothing without an occluder mesh, and
+ gives the same result on any number of threads.
+
+ The cube here is drawn exactly as the occluders are. Culling is only as
+ conservative as the occluder mesh: SoftRaster draws occluders with the coarsest
+ LOD, whose silhouette can reach past the drawn LOD's, so an instance peeking past
+ an occluder's edge may be culled and pop in as the camera moves.
+
+ Usage: MaskedOcclusionTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "masked_occlusion.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include "test_check.h"
+#include "test_view.h"
+
+#define WIDTH        512
+#define HEIGHT       288
+#define SMALL_BOXES  20000
+#define WALL_SIDE    4
+#define RAY_SAMPLES  256
+
+static const float c_fovy = 1.0472f;
+static const float c_wallHalfSize = 4.0f;
+static const float c_wallDepth = -20.0f;
+static const float c_smallHalfSize = 0.5f;
+static const XMFLOAT3 c_eye = { 0.0f, 0.0f, -50.0f };
+
+typedef struct Scene
+{
+    Instance* instances;
+    XMFLOAT4* boxes;        // Center and half size of each instance's box, the cube mesh scaled and moved
+    uint8_t*  lods;         // Frustum culling and LOD selection, the culler's input
+    uint32_t  count;
+} Scene;
+
+// The cube [-1, 1]^3, outward normals: clockwise on screen from outside, front facing as in SoftRaster.
+typedef struct CubeVertex
+{
+    float Position[3];
+    float Normal[3];
+} CubeVertex;
+
+static CubeVertex s_cubeVertices[8];
+static uint16_t s_cubeIndices[8];
+static uint32_t s_cubePrimitives[12];
+static Meshlet s_cubeMeshlet = { 8, 0, 12, 0 };
+
+static MeshletMesh CubeMesh(void)
+{
+    for (uint32_t v = 0; v < 8; ++v)
+    {
+        s_cubeVertices[v] = (CubeVertex){ { v & 1 ? 1.0f : -1.0f, v & 2 ? 1.0f : -1.0f, v & 4 ? 1.0f : -1.0f }, { 0, 0, 0 } };
+        s_cubeIndices[v] = (uint16_t)v;
+    }
+
+    // Two triangles per face, wound so that (b - a) x (c - a) points out of the cube.
+    static const uint32_t faces[6][4] = {
+        { 0, 2, 3, 1 }, { 4, 5, 7, 6 },     // -z, +z
+        { 0, 4, 6, 2 }, { 1, 3, 7, 5 },     // -x, +x
+        { 0, 1, 5, 4 }, { 2, 6, 7, 3 },     // -y, +y
+    };
+    for (uint32_t f = 0; f < 6; ++f)
+    {
+        const uint32_t* q = faces[f];
+        s_cubePrimitives[2 * f + 0] = q[0] | q[1] << 10 | q[2] << 20;
+        s_cubePrimitives[2 * f + 1] = q[0] | q[2] << 10 | q[3] << 20;
+    }
+
+    return (MeshletMesh){
+        .Vertices = (const uint8_t*)s_cubeVertices,
+        .VertexStride = sizeof(CubeVertex),
+        .VertexCount = 8,
+        .Meshlets = &s_cubeMeshlet,
+        .MeshletCount = 1,
+        .UniqueVertexIndices = (const uint8_t*)s_cubeIndices,
+        .IndexSize = sizeof(uint16_t),
+        .PrimitiveIndices = s_cubePrimitives,
+    };
+}
+
+static void AddBox(Scene* const scene, XMFLOAT3 center, float halfSize)
+{
+    const uint32_t i = scene->count++;
+    const float world[16] = { halfSize, 0, 0, 0, 0, halfSize, 0, 0, 0, 0, halfSize, 0, center.x, center.y, center.z, 1 };
+    XMFLOAT4X4 matrix;
+    memcpy(&matrix, world, sizeof(matrix));
+    Instance_Pack(&scene->instances[i], &matrix, (XMFLOAT4){ center.x, center.y, center.z, halfSize * sqrtf(3.0f) });
+    scene->boxes[i] = (XMFLOAT4){ center.x, center.y, center.z, halfSize };
+}
+
+static bool MakeScene(Scene* const scene, const Constants* const constants)
+{
+    const uint32_t capacity = WALL_SIDE * WALL_SIDE + SMALL_BOXES;
+    scene->instances = malloc(sizeof(Instance) * capacity);
+    scene->boxes = malloc(sizeof(XMFLOAT4) * capacity);
+    scene->lods = malloc(capacity);
+    scene->count = 0;
+    if (!scene->instances || !scene->boxes || !scene->lods)
+    {
+        return false;
+    }
+
+    // A wall of touching boxes across the middle of the view.
+    for (uint32_t y = 0; y < WALL_SIDE; ++y)
+    {
+        for (uint32_t x = 0; x < WALL_SIDE; ++x)
+        {
+            const float offset = (float)(WALL_SIDE - 1) * c_wallHalfSize;
+            AddBox(scene, (XMFLOAT3){ 2.0f * c_wallHalfSize * (float)x - offset, 2.0f * c_wallHalfSize * (float)y - offset, c_wallDepth },
+                   c_wallHalfSize);
+        }
+    }
+
+    // Small boxes behind the wall, mostly, and some between the wall and the eye.
+    for (uint32_t i = 0; i < SMALL_BOXES; ++i)
+    {
+        const bool front = i % 10 == 0;
+        const float z = front ? TestRandomFloat(-44.0f, c_wallDepth - c_wallHalfSize - 1.0f) : TestRandomFloat(c_wallDepth + c_wallHalfSize + 1.0f, 150.0f);
+        const float spread = 0.6f * (z - c_eye.z);
+        AddBox(scene, (XMFLOAT3){ TestRandomFloat(-spread, spread), TestRandomFloat(-spread, spread), z }, c_smallHalfSize);
+    }
+
+    for (uint32_t i = 0; i < scene->count; ++i)
+    {
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&scene->instances[i]);
+        scene->lods[i] = InstanceCull_IsVisible(constants, sphere) ? (uint8_t)InstanceCull_ComputeLOD(constants, sphere) : MASKED_OCCLUSION_CULLED;
+    }
+    return true;
+}
+
+static void DestroyScene(Scene* const scene)
+{
+    free(scene->instances);
+    free(scene->boxes);
+    free(scene->lods);
+}
+
+// Whether the segment from 'origin' to 'origin + direction' enters the box (center, half size w) before its end.
+static bool SegmentHitsBox(XMFLOAT3 origin, XMFLOAT3 direction, XMFLOAT4 box, float margin)
+{
+    const float o[3] = { origin.x - box.x, origin.y - box.y, origin.z - box.z };
+    const float d[3] = { direction.x, direction.y, direction.z };
+    const float h = box.w + margin;
+    float enter = 0.0f, leave = 1.0f;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (fabsf(d[k]) < 1e-12f)
+        {
+            if (fabsf(o[k]) > h)
+            {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (-h - o[k]) / d[k];
+        float t1 = (h - o[k]) / d[k];
+        if (t0 > t1)
+        {
+            const float t = t0;
+            t0 = t1;
+            t1 = t;
+        }
+        enter = fmaxf(enter, t0);
+        leave = fminf(leave, t1);
+    }
+    return enter <= leave && enter < 1.0f;
+}
+
+/*
+ * Whether 'sphere' is hidden by the given boxes, 'self' excluded: every ray from the eye to one of
+ * RAY_SAMPLES points spread over its surface and inside the frustum meets a box first. Each box
+ * grows by the size of a pixel at its near side, since the culler covers whole pixels from their
+ * centers.
+ */
+static bool RaysHidden(const Constants* const constants, XMFLOAT4 sphere, const XMFLOAT4* const boxes,
+                       const uint32_t* const occluders, uint32_t occluderCount, uint32_t self)
+{
+    const XMFLOAT3 eye = constants->ViewPosition;
+    const float pixelAngle = 2.0f / ((float)HEIGHT * constants->RecipTanHalfFovy);
+    for (uint32_t s = 0; s < RAY_SAMPLES; ++s)
+    {
+        // Fibonacci sphere.
+        const float y = 1.0f - 2.0f * ((float)s + 0.5f) / (float)RAY_SAMPLES;
+        const float r = sqrtf(1.0f - y * y);
+        const float phi = 2.39996323f * (float)s;
+        const XMFLOAT3 point = { sphere.x + sphere.w * r * cosf(phi), sphere.y + sphere.w * y, sphere.z + sphere.w * r * sinf(phi) };
+        const XMFLOAT3 direction = { point.x - eye.x, point.y - eye.y, point.z - eye.z };
+
+        // Points outside the frustum are not on screen, hidden or not.
+        bool hit = false;
+        for (int p = 0; p < 6 && !hit; ++p)
+        {
+            const XMFLOAT4 plane = constants->Planes[p];
+            hit = plane.x * point.x + plane.y * point.y + plane.z * point.z + plane.w < 0.0f;
+        }
+        for (uint32_t o = 0; o < occluderCount && !hit; ++o)
+        {
+            const XMFLOAT4 box = boxes[occluders[o]];
+            if (occluders[o] == self)
+            {
+                continue;
+            }
+            const float dx = box.x - eye.x, dy = box.y - eye.y, dz = box.z - eye.z;
+            const float nearDistance = sqrtf(dx * dx + dy * dy + dz * dz) - box.w * sqrtf(3.0f);
+            hit = SegmentHitsBox(eye, direction, box, pixelAngle * nearDistance);
+        }
+        if (!hit)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestConservative(JobSystem* const jobs, const Scene* const scene, const Constants* const constants, const MeshletMesh* const cube)
+{
+    MaskedOcclusion occ;
+    MaskedOcclusionStats stats;
+    CHECK(MaskedOcclusion_Init(&occ, jobs, WIDTH, HEIGHT));
+    CHECK(MaskedOcclusion_SetOccluderMesh(&occ, cube));
+    CHECK(MaskedOcclusion_Cull(&occ, constants, scene->instances, scene->count, scene->lods, &stats));
+
+    // The wall boxes, the first instances, are the largest on screen: they are the occluders.
+    uint32_t occluders[WALL_SIDE * WALL_SIDE];
+    for (uint32_t o = 0; o < WALL_SIDE * WALL_SIDE; ++o)
+    {
+        occluders[o] = o;
+    }
+    CHECK(stats.Occluders == WALL_SIDE * WALL_SIDE);
+    CHECK(stats.OccluderTriangles > 0);
+
+    uint32_t tested = 0, occluded = 0, revived = 0, changed = 0, notHidden = 0, missed = 0;
+    for (uint32_t i = 0; i < scene->count; ++i)
+    {
+        const uint8_t in = scene->lods[i];
+        const uint8_t out = occ.lods[i];
+        tested += in != MASKED_OCCLUSION_CULLED;
+        occluded += in != MASKED_OCCLUSION_CULLED && out == MASKED_OCCLUSION_CULLED;
+        revived += in == MASKED_OCCLUSION_CULLED && out != MASKED_OCCLUSION_CULLED;
+        changed += out != MASKED_OCCLUSION_CULLED && out != in;
+        if (in == MASKED_OCCLUSION_CULLED || i < WALL_SIDE * WALL_SIDE)
+        {
+            continue;
+        }
+
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&scene->instances[i]);
+        if (out == MASKED_OCCLUSION_CULLED)
+        {
+            notHidden += !RaysHidden(constants, sphere, scene->boxes, occluders, WALL_SIDE * WALL_SIDE, i);
+        }
+        else
+        {
+            // Hidden with a wide margin to spare: the culler should have found it.
+            const XMFLOAT4 grown = { sphere.x, sphere.y, sphere.z, sphere.w + 2.0f };
+            missed += RaysHidden(constants, grown, scene->boxes, occluders, WALL_SIDE * WALL_SIDE, i);
+        }
+    }
+
+    CHECK(notHidden == 0);
+    CHECK(revived == 0);
+    CHECK(changed == 0);
+    CHECK(stats.Tested == tested);
+    CHECK(stats.Occluded == occluded);
+
+    // Merging into two depth layers loses some occlusion, but not most of it.
+    CHECK(occluded > SMALL_BOXES / 4);
+    CHECK(missed * 10 < occluded);
+
+    // The same result on the calling thread alone.
+    JobSystem single;
+    MaskedOcclusion alone;
+    MaskedOcclusionStats aloneStats;
+    CHECK(JobSystem_Init(&single, 0));
+    CHECK(MaskedOcclusion_Init(&alone, &single, WIDTH, HEIGHT));
+    CHECK(MaskedOcclusion_SetOccluderMesh(&alone, cube));
+    CHECK(MaskedOcclusion_Cull(&alone, constants, scene->instances, scene->count, scene->lods, &aloneStats));
+    CHECK(memcmp(alone.lods, occ.lods, scene->count) == 0);
+    CHECK(memcmp(&aloneStats, &stats, sizeof(stats)) == 0);
+    MaskedOcclusion_Destroy(&alone);
+    JobSystem_Destroy(&single);
+
+    MaskedOcclusion_Destroy(&occ);
+}
+
+static void TestWithoutOccluderMesh(JobSystem* const jobs, const Scene* const scene, const Constants* const constants)
+{
+    MaskedOcclusion occ;
+    MaskedOcclusionStats stats;
+    CHECK(MaskedOcclusion_Init(&occ, jobs, WIDTH, HEIGHT));
+    CHECK(MaskedOcclusion_Cull(&occ, constants, scene->instances, scene->count, scene->lods, &stats));
+    CHECK(stats.Occluders == 0 && stats.Occluded == 0);
+    CHECK(memcmp(occ.lods, scene->lods, scene->count) == 0);
+    MaskedOcclusion_Destroy(&occ);
+}
+
+int main(void)
+{
+    Constants constants = { 0 };
+    constants.LODCount = MAX_LOD_LEVELS;
+    TestView_Build(&constants, c_eye, 0.0f, c_fovy, (float)WIDTH / (float)HEIGHT);
+
+    Scene scene = { 0 };
+    JobSystem jobs;
+    const MeshletMesh cube = CubeMesh();
+    if (!MakeScene(&scene, &constants) || !JobSystem_Init(&jobs, 3))
+    {
+        fprintf(stderr, "Initialization failed\n");
+        DestroyScene(&scene);
+        return EXIT_FAILURE;
+    }
+
+    TestConservative(&jobs, &scene, &constants, &cube);
+    TestWithoutOccluderMesh(&jobs, &scene, &constants);
+
+    JobSystem_Destroy(&jobs);
+    DestroyScene(&scene);
+    return TEST_RESULT();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Meshlet describes a portion of mesh, a chunk to use efficiently work group/shared storage sizes.
+typedef struct Meshlet
+{
+    uint32_t VertCount;
+    uint32_t VertOffset;
+    uint32_t PrimCount;
+    uint32_t PrimOffset;
+} Meshlet;
+
+// Most vertices and primitives of a meshlet. A mesh shader compiled for some limits draws any meshlet within them.
+typedef struct MeshletLimits
+{
+    uint32_t MaxVerts;
+    uint32_t MaxPrims;
+} MeshletLimits;
+
+/*****************************************************************************************************
+ * Read-only view over the meshlet data of one mesh, free of any graphics API type.                 *
+ *                                                                                                   *
+ * It points into the model buffer and owns nothing. The CPU-side tools (dispatch simulation,       *
+ * software rendering) work on it, so they can run without a D3D12 device.                          *
+ * Vertices use the same layout as the Vertex struct of the shaders: float3 position, then          *
+ * float3 normal, every VertexStride bytes.                                                          *
+ *****************************************************************************************************/
+typedef struct MeshletMesh
+{
+    const uint8_t*  Vertices;
+    uint32_t        VertexStride;
+    uint32_t        VertexCount;
+
+    const Meshlet*  Meshlets;
+    uint32_t        MeshletCount;
+
+    const uint8_t*  UniqueVertexIndices;
+    uint32_t        IndexSize;          // 2 or 4 bytes per unique vertex index
+    const uint32_t* PrimitiveIndices;   // 10:10:10 packed triangles
+} MeshletMesh;
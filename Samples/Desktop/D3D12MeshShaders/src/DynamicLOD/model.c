@@ -8,6 +8,7 @@
 #include <d3d12.h>
 #include "macros.h"
 #include "sample_commons.h"
+#include "shared.h"
 #include "dxheaders/barrier_helpers.h"
 
 #include "DirectXCollisionC.h"
@@ -36,6 +37,9 @@ const uint32_t c_sizeMap[] =
 
 const uint32_t c_prolog = 'MSHL';
 
+// The meshlets of version 0 files, and of the shipped assets, were built for the default shader limits.
+const MeshletLimits c_legacyMeshletLimits = { 64, 126 };
+
 /*****************************************************************
     Private functions
 ******************************************************************/
@@ -70,7 +74,15 @@ typedef struct Attribute
 enum FileVersion
 {
     FILE_VERSION_INITIAL = 0,
-    CURRENT_FILE_VERSION = FILE_VERSION_INITIAL
+    FILE_VERSION_MESHLET_VARIANTS = 1,
+    FILE_VERSION_GEOMETRIC_ERROR = 2,
+    FILE_VERSION_SHARED_VERTICES = 3,
+    CURRENT_FILE_VERSION = FILE_VERSION_SHARED_VERTICES
+};
+
+enum FileFlags
+{
+    FILE_FLAG_SHARED_VERTICES = 1,  // The meshes index the vertices of LOD 0 (see Mesh.SharedVertices)
 };
 
 struct FileHeader
@@ -123,6 +135,41 @@ uint32_t Mesh_GetVertexIndex(Span_uint8_t UniqueVertexIndices, uint32_t index, u
     return *((const uint16_t*)(addr));
 }
 
+uint32_t Mesh_FindMeshletVariant(const Mesh* const m, MeshletLimits limits)
+{
+    uint32_t best = UINT32_MAX;
+    for (uint32_t i = 0; i < m->MeshletVariantCount; ++i)
+    {
+        const MeshletLimits* v = &m->MeshletVariants[i].Limits;
+        if (v->MaxVerts > limits.MaxVerts || v->MaxPrims > limits.MaxPrims)
+        {
+            continue;
+        }
+
+        // Bigger meshlets mean fewer mesh shader groups for the same triangles.
+        const MeshletLimits* b = best != UINT32_MAX ? &m->MeshletVariants[best].Limits : NULL;
+        if (!b || v->MaxPrims > b->MaxPrims || (v->MaxPrims == b->MaxPrims && v->MaxVerts > b->MaxVerts))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+MeshletMesh Mesh_GetMeshletView(const Mesh* const m)
+{
+    return (MeshletMesh){
+        .Vertices = m->VerticesSpans[0].data,
+        .VertexStride = m->VertexStrides[0],
+        .VertexCount = m->VertexCount,
+        .Meshlets = m->Meshlets.data,
+        .MeshletCount = m->Meshlets.count,
+        .UniqueVertexIndices = m->UniqueVertexIndices.data,
+        .IndexSize = m->IndexSize,
+        .PrimitiveIndices = (const uint32_t*)m->PrimitiveIndices.data,
+    };
+}
+
 void Mesh_Release(Mesh* m)
 {
     for (int i = 0; i < m->numVerticesSpans; ++i) RELEASE(m->VertexResources[i]);
@@ -176,6 +223,65 @@ typedef struct MeshHeader
     uint32_t CullDataIndex;
 } MeshHeader;
 
+// The meshlet accessors of one extra variant of a mesh, in the order of MeshHeader.
+typedef struct MeshletHeader
+{
+    uint32_t MeshletIndex;
+    uint32_t MeshletSubsets;
+    uint32_t UniqueVertexIndex;
+    uint32_t PrimitiveIndex;
+    uint32_t CullDataIndex;
+} MeshletHeader;
+
+static MeshletVariant LoadMeshletVariant(MeshletLimits limits, const MeshletHeader* const header, const Accessor* const accessors,
+                                         const BufferView* const bufferViews, uint8_t* const buffer)
+{
+    MeshletVariant variant = { .Limits = limits };
+
+    const Accessor* accessor = &accessors[header->MeshletIndex];
+    variant.Meshlets.data = (Meshlet*)(buffer + bufferViews[accessor->BufferViewIdx].Offset);
+    variant.Meshlets.count = accessor->Count;
+
+    accessor = &accessors[header->MeshletSubsets];
+    variant.MeshletSubsets.data = (Subset*)(buffer + bufferViews[accessor->BufferViewIdx].Offset);
+    variant.MeshletSubsets.count = accessor->Count;
+
+    accessor = &accessors[header->UniqueVertexIndex];
+    variant.UniqueVertexIndices.data = buffer + bufferViews[accessor->BufferViewIdx].Offset;
+    variant.UniqueVertexIndices.count = bufferViews[accessor->BufferViewIdx].Size;
+
+    accessor = &accessors[header->PrimitiveIndex];
+    variant.PrimitiveIndices.data = (PackedTriangle*)(buffer + bufferViews[accessor->BufferViewIdx].Offset);
+    variant.PrimitiveIndices.count = accessor->Count;
+
+    accessor = &accessors[header->CullDataIndex];
+    variant.CullingData.data = (CullData*)(buffer + bufferViews[accessor->BufferViewIdx].Offset);
+    variant.CullingData.count = accessor->Count;
+
+    return variant;
+}
+
+// A mesh of a LOD chain being merged into a vertex pool, and the index arrays it will use.
+typedef struct MeshRewrite
+{
+    Mesh*        mesh;
+    uint32_t*    remap;         // Pool index of each vertex of the mesh, NULL if its indices already address the pool
+    uint32_t     indexSize;
+    Span_uint8_t indices;
+    Span_uint8_t uniqueVertexIndices[MAX_MESHLET_VARIANTS];
+} MeshRewrite;
+
+static void ActivateMeshletVariant(Mesh* const mesh, uint32_t index)
+{
+    const MeshletVariant* variant = &mesh->MeshletVariants[index];
+    mesh->ActiveMeshletVariant = index;
+    mesh->MeshletSubsets = variant->MeshletSubsets;
+    mesh->Meshlets = variant->Meshlets;
+    mesh->UniqueVertexIndices = variant->UniqueVertexIndices;
+    mesh->PrimitiveIndices = variant->PrimitiveIndices;
+    mesh->CullingData = variant->CullingData;
+}
+
 HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const wchar_t* const assetpath)
 {
     size_t bufferSize = wcslen(basepath) + wcslen(assetpath) + 1;
@@ -196,7 +302,7 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
     }
 
     // Validate header
-    if (header.Prolog != c_prolog || header.Version != CURRENT_FILE_VERSION)
+    if (header.Prolog != c_prolog || header.Version > CURRENT_FILE_VERSION)
     {
         fclose(file);
         return E_FAIL;
@@ -217,18 +323,76 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
         return E_FAIL;
     }
 
+    // Read the meshlet variants: their limits, then the headers of variants 1 and up, mesh by mesh
+    uint32_t variantCount = 1;
+    MeshletLimits variantLimits[MAX_MESHLET_VARIANTS] = { c_legacyMeshletLimits };
+    MeshletHeader* variantHeaders = NULL;
+    if (header.Version >= FILE_VERSION_MESHLET_VARIANTS)
+    {
+        if (fread(&variantCount, sizeof(variantCount), 1, file) != 1 || variantCount == 0 || variantCount > MAX_MESHLET_VARIANTS ||
+            fread(variantLimits, sizeof(MeshletLimits), variantCount, file) != variantCount)
+        {
+            free(meshesHeaders);
+            fclose(file);
+            return E_FAIL;
+        }
+
+        const size_t variantHeaderCount = (size_t)header.MeshCount * (variantCount - 1);
+        if (variantHeaderCount > 0)
+        {
+            variantHeaders = malloc(variantHeaderCount * sizeof(MeshletHeader));
+            if (!variantHeaders || fread(variantHeaders, sizeof(MeshletHeader), variantHeaderCount, file) != variantHeaderCount)
+            {
+                free(meshesHeaders);
+                free(variantHeaders);
+                fclose(file);
+                return E_FAIL;
+            }
+        }
+    }
+
+    // Read the geometric error of every mesh, unknown before version 2
+    float* geometricErrors = NULL;
+    if (header.Version >= FILE_VERSION_GEOMETRIC_ERROR && header.MeshCount > 0)
+    {
+        geometricErrors = malloc(header.MeshCount * sizeof(float));
+        if (!geometricErrors || fread(geometricErrors, sizeof(float), header.MeshCount, file) != header.MeshCount)
+        {
+            free(meshesHeaders);
+            free(variantHeaders);
+            free(geometricErrors);
+            fclose(file);
+            return E_FAIL;
+        }
+    }
+
+    // Read the file flags, none before version 3
+    uint32_t fileFlags = 0;
+    if (header.Version >= FILE_VERSION_SHARED_VERTICES && fread(&fileFlags, sizeof(fileFlags), 1, file) != 1)
+    {
+        free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
+        fclose(file);
+        return E_FAIL;
+    }
+
     // Read accessors
     size_t accessorDataSize = header.AccessorCount * sizeof(Accessor);
     Accessor* accessors = malloc(accessorDataSize);
     if (!accessors)
     {
         free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
         fclose(file);
         return E_FAIL;
     }
     if (fread(accessors, sizeof(Accessor), header.AccessorCount, file) != header.AccessorCount)
     {
         free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
         free(accessors);
         fclose(file);
         return E_FAIL;
@@ -240,6 +404,8 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
     if (!bufferViews)
     {
         free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
         free(accessors);
         fclose(file);
         return E_FAIL;
@@ -247,6 +413,8 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
     if (fread(bufferViews, sizeof(BufferView), header.BufferViewCount, file) != header.BufferViewCount)
     {
         free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
         free(accessors);
         free(bufferViews);
         fclose(file);
@@ -258,6 +426,8 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
     if (!m->buffer)
     {
         free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
         free(accessors);
         free(bufferViews);
         fclose(file);
@@ -266,6 +436,8 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
     if (fread(m->buffer, 1, header.BufferSize, file) != header.BufferSize)
     {
         free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
         free(accessors);
         free(bufferViews);
         free(m->buffer);
@@ -279,6 +451,8 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
     if (readSize != 0 && !feof(file))  // readSize == 0 means expected EOF
     {
         free(meshesHeaders);
+        free(variantHeaders);
+        free(geometricErrors);
         free(accessors);
         free(bufferViews);
         free(m->buffer);
@@ -297,6 +471,9 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
         MeshHeader* meshHeader = &meshesHeaders[ithMesh];
         Mesh* mesh = &m->meshes[ithMesh];
         mesh->numVerticesSpans = 0;
+        mesh->VertexCount = 0;
+        mesh->SharedVertices = (fileFlags & FILE_FLAG_SHARED_VERTICES) != 0;
+        mesh->VertexSource = NULL;
 
         /* Load indices data */
         {
@@ -394,56 +571,45 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
             mesh->LayoutDesc.NumElements++;
         }
 
-        // Meshlet data
-        {
-            Accessor* accessor = &accessors[meshHeader->MeshletIndex];
-            BufferView* bufferView = &bufferViews[accessor->BufferViewIdx];
-
-            mesh->Meshlets.data = (Meshlet*)(m->buffer + bufferView->Offset);
-            mesh->Meshlets.count = accessor->Count;
-        }
-
-        // Meshlet Subset data
-        {
-            Accessor* accessor = &accessors[meshHeader->MeshletSubsets];
-            BufferView* bufferView = &bufferViews[accessor->BufferViewIdx];
-
-            mesh->MeshletSubsets.data = (Subset*)(m->buffer + bufferView->Offset);
-            mesh->MeshletSubsets.count = accessor->Count;
-        }
-
-        // Unique Vertex Index data
-        {
-            Accessor* accessor = &accessors[meshHeader->UniqueVertexIndex];
-            BufferView* bufferView = &bufferViews[accessor->BufferViewIdx];
-
-            mesh->UniqueVertexIndices.data = m->buffer + bufferView->Offset;
-            mesh->UniqueVertexIndices.count = bufferView->Size;
-        }
-
-        // Primitive Index data
+        // Meshlet data (meshlets, subsets, unique vertex indices, primitive indices and cull data) of every variant
         {
-            Accessor* accessor = &accessors[meshHeader->PrimitiveIndex];
-            BufferView* bufferView = &bufferViews[accessor->BufferViewIdx];
-
-            mesh->PrimitiveIndices.data = (PackedTriangle*)(m->buffer + bufferView->Offset);
-            mesh->PrimitiveIndices.count = accessor->Count;
+            const MeshletHeader first = {
+                .MeshletIndex = meshHeader->MeshletIndex,
+                .MeshletSubsets = meshHeader->MeshletSubsets,
+                .UniqueVertexIndex = meshHeader->UniqueVertexIndex,
+                .PrimitiveIndex = meshHeader->PrimitiveIndex,
+                .CullDataIndex = meshHeader->CullDataIndex,
+            };
+            mesh->MeshletVariants[0] = LoadMeshletVariant(variantLimits[0], &first, accessors, bufferViews, m->buffer);
+
+            for (uint32_t v = 1; v < variantCount; ++v)
+            {
+                const MeshletHeader* variantHeader = &variantHeaders[ithMesh * (variantCount - 1) + v - 1];
+                mesh->MeshletVariants[v] = LoadMeshletVariant(variantLimits[v], variantHeader, accessors, bufferViews, m->buffer);
+            }
+            mesh->MeshletVariantCount = variantCount;
+            ActivateMeshletVariant(mesh, 0);
         }
 
-        // Cull data
-        {
-            Accessor* accessor = &accessors[meshHeader->CullDataIndex];
-            BufferView* bufferView = &bufferViews[accessor->BufferViewIdx];
-
-            mesh->CullingData.data = (CullData*)(m->buffer + bufferView->Offset);
-            mesh->CullingData.count = accessor->Count;
-        }
+        mesh->GeometricError = geometricErrors ? geometricErrors[ithMesh] : -1.0f;
     }
+    free(variantHeaders);
+    free(geometricErrors);
+
+    // The headless tools draw with the default limits; the sample selects again for its pipeline.
+    Model_SelectMeshletVariant(m, (MeshletLimits){ MAX_VERTS, MAX_PRIMS });
 
-    // Build bounding spheres for each mesh
+    // Build bounding spheres for each mesh. Those without vertices get theirs from Model_ShareVertices.
+    m->boundingSphere = (XMBoundingSphere){0};
+    bool firstSphere = true;
     for (uint32_t ithMesh = 0; ithMesh < m->nMeshes; ++ithMesh) // m->meshCount would be the number of meshes
     {
         Mesh* mesh = &m->meshes[ithMesh]; // Access mesh using pointer
+        if (mesh->SharedVertices || mesh->numVerticesSpans == 0)
+        {
+            mesh->BoundingSphere = (XMBoundingSphere){0};
+            continue;
+        }
 
         uint32_t vbIndexPos = 0;
 
@@ -481,9 +647,10 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
 
         XMBoundingSphereFromPoints(&mesh->BoundingSphere, mesh->VertexCount, v0, stride);
 
-        if (ithMesh == 0)
+        if (firstSphere)
         {
             m->boundingSphere = mesh->BoundingSphere;
+            firstSphere = false;
         }
         else
         {
@@ -494,6 +661,210 @@ HRESULT Model_LoadFromFile(Model *const m, const wchar_t* const basepath, const
     return S_OK;
 }
 
+bool Model_SelectMeshletVariant(Model* const m, MeshletLimits limits)
+{
+    for (int i = 0; i < m->nMeshes; ++i)
+    {
+        if (Mesh_FindMeshletVariant(&m->meshes[i], limits) == UINT32_MAX)
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < m->nMeshes; ++i)
+    {
+        ActivateMeshletVariant(&m->meshes[i], Mesh_FindMeshletVariant(&m->meshes[i], limits));
+    }
+    return true;
+}
+
+// Copies 'indices' to new memory of the pool, mapped through 'remap' and resized to 'indexSize' bytes each.
+static Span_uint8_t RewriteIndices(VertexPool* const pool, Span_uint8_t indices, uint32_t oldSize, uint32_t indexSize,
+                                   const uint32_t* const remap, uint32_t vertexCount)
+{
+    const uint32_t count = (uint32_t)(indices.count / oldSize);
+    uint8_t* data = VertexPool_Alloc(pool, (size_t)count * indexSize);
+    if (!data)
+    {
+        return SPAN(uint8_t, NULL, 0);
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t index = Mesh_GetVertexIndex(indices, i, oldSize);
+        if (remap)
+        {
+            index = index < vertexCount ? remap[index] : 0; // Padding past the last index
+        }
+
+        if (indexSize == 4)
+        {
+            ((uint32_t*)data)[i] = index;
+        }
+        else
+        {
+            ((uint16_t*)data)[i] = (uint16_t)index;
+        }
+    }
+    return SPAN(uint8_t, data, (size_t)count * indexSize);
+}
+
+HRESULT Model_ShareVertices(Model* const lods, uint32_t lodCount, VertexPool* const pool)
+{
+    if (lodCount == 0 || lods[0].nMeshes == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    Mesh* const owner = &lods[0].meshes[0];
+    if (owner->SharedVertices || owner->numVerticesSpans != 1 || !owner->VerticesSpans[0].data)
+    {
+        return E_INVALIDARG;
+    }
+
+    uint32_t meshCount = 0;
+    for (uint32_t l = 0; l < lodCount; ++l)
+    {
+        for (int i = 0; i < lods[l].nMeshes; ++i)
+        {
+            const Mesh* mesh = &lods[l].meshes[i];
+            const bool sameLayout = mesh->numVerticesSpans == 1 && mesh->VerticesSpans[0].data &&
+                                    mesh->VertexStrides[0] == owner->VertexStrides[0] &&
+                                    mesh->LayoutDesc.NumElements == owner->LayoutDesc.NumElements &&
+                                    memcmp(mesh->LayoutElems, owner->LayoutElems, owner->LayoutDesc.NumElements * sizeof(D3D12_INPUT_ELEMENT_DESC)) == 0;
+            if (!mesh->SharedVertices && !sameLayout)
+            {
+                return E_INVALIDARG;
+            }
+            ++meshCount;
+        }
+    }
+
+    const uint32_t stride = owner->VertexStrides[0];
+    MeshRewrite* rewrites = calloc(meshCount, sizeof(MeshRewrite));
+    if (!rewrites || !VertexPool_Init(pool, stride, owner->VertexCount))
+    {
+        free(rewrites);
+        return E_OUTOFMEMORY;
+    }
+
+    // The first mesh goes in unchanged, then every other mesh with vertices of its own is merged in
+    HRESULT hr = S_OK;
+    for (uint32_t v = 0; v < owner->VertexCount && SUCCEEDED(hr); ++v)
+    {
+        if (VertexPool_Append(pool, owner->VerticesSpans[0].data + (size_t)v * stride) == VERTEX_POOL_INVALID)
+        {
+            hr = E_OUTOFMEMORY;
+        }
+    }
+
+    uint32_t r = 0;
+    for (uint32_t l = 0; l < lodCount; ++l)
+    {
+        for (int i = 0; i < lods[l].nMeshes; ++i, ++r)
+        {
+            MeshRewrite* rewrite = &rewrites[r];
+            rewrite->mesh = &lods[l].meshes[i];
+            if (rewrite->mesh == owner || rewrite->mesh->SharedVertices || FAILED(hr))
+            {
+                continue;
+            }
+
+            const Mesh* mesh = rewrite->mesh;
+            rewrite->remap = malloc((size_t)mesh->VertexCount * sizeof(uint32_t) + 1);
+            if (!rewrite->remap)
+            {
+                hr = E_OUTOFMEMORY;
+                continue;
+            }
+
+            for (uint32_t v = 0; v < mesh->VertexCount && SUCCEEDED(hr); ++v)
+            {
+                rewrite->remap[v] = VertexPool_Insert(pool, mesh->VerticesSpans[0].data + (size_t)v * stride);
+                if (rewrite->remap[v] == VERTEX_POOL_INVALID)
+                {
+                    hr = E_OUTOFMEMORY;
+                }
+            }
+        }
+    }
+
+    // Rewrite the indices of the merged meshes, and of every mesh if the pool needs wider indices
+    const bool wideIndices = pool->vertexCount > 0x10000;
+    for (uint32_t m = 0; m < meshCount && SUCCEEDED(hr); ++m)
+    {
+        MeshRewrite* rewrite = &rewrites[m];
+        const Mesh* mesh = rewrite->mesh;
+        rewrite->indexSize = wideIndices ? 4 : mesh->IndexSize;
+        if (!rewrite->remap && rewrite->indexSize == mesh->IndexSize)
+        {
+            continue;
+        }
+
+        rewrite->indices = RewriteIndices(pool, mesh->Indices, mesh->IndexSize, rewrite->indexSize, rewrite->remap, mesh->VertexCount);
+        hr = rewrite->indices.data ? S_OK : E_OUTOFMEMORY;
+        for (uint32_t v = 0; v < mesh->MeshletVariantCount && SUCCEEDED(hr); ++v)
+        {
+            rewrite->uniqueVertexIndices[v] = RewriteIndices(pool, mesh->MeshletVariants[v].UniqueVertexIndices, mesh->IndexSize,
+                                                             rewrite->indexSize, rewrite->remap, mesh->VertexCount);
+            hr = rewrite->uniqueVertexIndices[v].data ? S_OK : E_OUTOFMEMORY;
+        }
+    }
+
+    // Nothing can fail past here: point every mesh at the pool
+    for (uint32_t m = 0; m < meshCount && SUCCEEDED(hr); ++m)
+    {
+        const MeshRewrite* rewrite = &rewrites[m];
+        Mesh* mesh = rewrite->mesh;
+        if (rewrite->indices.data)
+        {
+            mesh->Indices = rewrite->indices;
+            mesh->IndexSize = rewrite->indexSize;
+            for (uint32_t v = 0; v < mesh->MeshletVariantCount; ++v)
+            {
+                mesh->MeshletVariants[v].UniqueVertexIndices = rewrite->uniqueVertexIndices[v];
+            }
+            ActivateMeshletVariant(mesh, mesh->ActiveMeshletVariant);
+        }
+
+        // Meshes without vertices take the layout and bounds of the vertices they index
+        if (mesh->SharedVertices)
+        {
+            memcpy(mesh->LayoutElems, owner->LayoutElems, sizeof(mesh->LayoutElems));
+            mesh->LayoutDesc.pInputElementDescs = mesh->LayoutElems;
+            mesh->LayoutDesc.NumElements = owner->LayoutDesc.NumElements;
+            mesh->BoundingSphere = owner->BoundingSphere;
+        }
+
+        memset(mesh->VerticesSpans, 0, sizeof(mesh->VerticesSpans));
+        mesh->VerticesSpans[0] = SPAN(uint8_t, pool->vertices, (size_t)pool->vertexCount * stride);
+        mesh->VertexStrides[0] = stride;
+        mesh->numVerticesSpans = 1;
+        mesh->VertexCount = pool->vertexCount;
+        mesh->VertexSource = mesh == owner ? NULL : owner;
+    }
+
+    for (uint32_t m = 0; m < meshCount; ++m)
+    {
+        free(rewrites[m].remap);
+    }
+    free(rewrites);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    for (uint32_t l = 0; l < lodCount && lods[l].nMeshes > 0; ++l)
+    {
+        lods[l].boundingSphere = lods[l].meshes[0].BoundingSphere;
+        for (int i = 1; i < lods[l].nMeshes; ++i)
+        {
+            XMBoundingSphereMerged(&lods[l].boundingSphere, &lods[l].boundingSphere, &lods[l].meshes[i].BoundingSphere);
+        }
+    }
+    return S_OK;
+}
+
 HRESULT Model_UploadGpuResources(Model *model, ID3D12Device2* device, ID3D12CommandQueue* cmdQueue, ID3D12CommandAllocator* cmdAlloc, ID3D12GraphicsCommandList6* cmdList)
 {
     for (uint32_t i = 0; i < model->nMeshes; ++i)
@@ -574,7 +945,17 @@ HRESULT Model_UploadGpuResources(Model *model, ID3D12Device2* device, ID3D12Comm
         m->IBView.Format = m->IndexSize == 4 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
         m->IBView.SizeInBytes = m->IndexCount * m->IndexSize;
 
-        for (uint32_t j = 0; j < m->numVerticesSpans; ++j)
+        // Meshes sharing a vertex pool draw from the buffers of the mesh that uploaded it
+        const uint32_t ownVertexSpans = m->VertexSource ? 0 : m->numVerticesSpans;
+        for (uint32_t j = 0; m->VertexSource && j < m->numVerticesSpans; ++j)
+        {
+            if (!m->VertexSource->VertexResources[j]) return E_INVALIDARG;
+            m->VertexResources[j] = m->VertexSource->VertexResources[j];
+            ID3D12Resource_AddRef(m->VertexResources[j]);
+            m->VBViews[j] = m->VertexSource->VBViews[j];
+        }
+
+        for (uint32_t j = 0; j < ownVertexSpans; ++j)
         {
             D3D12_RESOURCE_DESC vertexDesc = CD3DX12_RESOURCE_DESC_BUFFER(m->VerticesSpans[j].count, D3D12_RESOURCE_FLAG_NONE, 0);
             ID3D12Device_CreateCommittedResource(device,
@@ -660,7 +1041,7 @@ HRESULT Model_UploadGpuResources(Model *model, ID3D12Device2* device, ID3D12Comm
             (void**)&meshInfoUpload);
         if (FAILED(hr)) LogErrAndExit(hr);
 
-        for (uint32_t j = 0; j < m->numVerticesSpans; ++j)
+        for (uint32_t j = 0; j < ownVertexSpans; ++j)
         {
             D3D12_RESOURCE_DESC vertexDesc = CD3DX12_RESOURCE_DESC_BUFFER(m->VerticesSpans[j].count, D3D12_RESOURCE_FLAG_NONE, 0);
             hr = ID3D12Device_CreateCommittedResource(device,
@@ -731,7 +1112,7 @@ HRESULT Model_UploadGpuResources(Model *model, ID3D12Device2* device, ID3D12Comm
         // Populate our command list
         ID3D12GraphicsCommandList_Reset(cmdList, cmdAlloc, NULL);
 
-        for (uint32_t j = 0; j < m->numVerticesSpans; ++j)
+        for (uint32_t j = 0; j < ownVertexSpans; ++j)
         {
             ID3D12GraphicsCommandList_CopyResource(cmdList, m->VertexResources[j], vertexUploads[j]);
             D3D12_RESOURCE_BARRIER barrier = CD3DX12_Transition(m->VertexResources[j], 
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "d3d12.h"
+#include <stdbool.h>
 #include <DirectXMathC.h>
 #include "span.h"
+#include "meshlet_mesh.h"
+#include "vertex_pool.h"
 #include <DirectXCollisionC.h>
 
 /*****************************************************************************************************************************
@@ -23,15 +26,6 @@ enum Attribute_Type
  >> Mesh related types forward definitions
 ******************************************************************************************************************************/
 
-// Meshlet describes a portion of mesh, a chunk to use efficiently work group/shared storage sizes.
-typedef struct Meshlet
-{
-    uint32_t VertCount;
-    uint32_t VertOffset;
-    uint32_t PrimCount;
-    uint32_t PrimOffset;
-} Meshlet;
-
 typedef struct __declspec(align(256)) MeshInfo
 {
     uint32_t IndexSize;
@@ -71,6 +65,22 @@ SPAN_DEFINE(Meshlet);
 SPAN_DEFINE(PackedTriangle);
 SPAN_DEFINE(CullData);
 
+#define MAX_MESHLET_VARIANTS 4
+
+/*********************************************************************************************
+ * One meshlet partitioning of a mesh, built for some threadgroup limits. All the variants   *
+ * of a mesh index the same vertices: only the meshlet data is repeated.                     *
+ *********************************************************************************************/
+typedef struct MeshletVariant
+{
+    MeshletLimits             Limits;
+    Span_Subset               MeshletSubsets;
+    Span_Meshlet              Meshlets;
+    Span_uint8_t              UniqueVertexIndices;
+    Span_PackedTriangle       PrimitiveIndices;
+    Span_CullData             CullingData;
+} MeshletVariant;
+
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * 
  *                       ~~ The Mesh ~~                                *
@@ -127,9 +137,21 @@ typedef struct Mesh
     uint32_t                  VertexCount;    // this is the total number of vertices in the whole model, that is why it is a single value. 
                                                // in D3D12_VERTEX_BUFFER_VIEW, the SizeInBytes is calculated as VertexCount * VertexStride (if interleaved)
 
+    // Set for the meshes of version 3 files that carry no vertices: their indices address those of the first mesh
+    // of LOD 0, which Model_ShareVertices links them to.
+    bool                      SharedVertices;
+
+    // The mesh whose vertex buffers this one draws from, once Model_ShareVertices made them one pool. NULL if
+    // its vertex buffers are its own.
+    const struct Mesh*        VertexSource;
+
 
     XMBoundingSphere          BoundingSphere;
 
+    // Largest distance of this LOD's surface from the full-detail one, in model units. Negative if the file
+    // does not carry it (before version 2); lod_error.h estimates it then.
+    float                     GeometricError;
+
     /********************************************************************************************************************
     *                                               Indices                                                             *
     *                                                                                                                   *
@@ -156,6 +178,11 @@ typedef struct Mesh
     Span_PackedTriangle       PrimitiveIndices;
     Span_CullData             CullingData;
 
+    // Every partitioning in the file. The spans above are those of MeshletVariants[ActiveMeshletVariant].
+    MeshletVariant            MeshletVariants[MAX_MESHLET_VARIANTS];
+    uint32_t                  MeshletVariantCount;
+    uint32_t                  ActiveMeshletVariant;
+
     /***************************
     *  D3D resource references *
     ****************************/
@@ -196,6 +223,19 @@ void     Mesh_GetPrimitive            (Span_PackedTriangle PrimitiveIndices, uin
 uint32_t Mesh_GetVertexIndex          (Span_uint8_t UniqueVertexIndices, uint32_t index, uint32_t indexSize);
 
 
+/*************************************************************************************
+* API-independent view of the mesh for the CPU-side tools. Like the Vertices SRV,    *
+* it assumes position and normal live interleaved in the first vertex buffer.        *
+**************************************************************************************/
+MeshletMesh Mesh_GetMeshletView       (const Mesh* const m);
+
+
+/*************************************************************************************
+* The largest meshlet variant within 'limits', UINT32_MAX if none is.                *
+**************************************************************************************/
+uint32_t Mesh_FindMeshletVariant      (const Mesh* const m, MeshletLimits limits);
+
+
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
  *                             ~~ The Model ~~                                 *
@@ -233,6 +273,16 @@ typedef struct Model {
  *   - PrimitiveIndices: The primitive indices accessor for the mesh.                                                        *
  *   - CullData: The culling data accessor for the mesh.                                                                     *
  *                                                                                                                           *
+ * Version 1 files then carry extra meshlet partitionings of the same vertices: a variant count, the MeshletLimits of each   *
+ * variant, then for every mesh the five meshlet accessors above (Meshlets to CullData) of variants 1 and up. The mesh       *
+ * header holds variant 0. Version 0 files have a single variant, built for 64 vertices and 126 primitives.                  *
+ *                                                                                                                           *
+ * Version 2 files then carry one float per mesh, its GeometricError, which the CPU LOD selector (lod_select.h) turns into   *
+ * a screen-space error.                                                                                                     *
+ *                                                                                                                           *
+ * Version 3 files then carry a uint32 of flags. With FILE_FLAG_SHARED_VERTICES, the meshes have no vertex attributes: their *
+ * indices address the vertices of the first mesh of LOD 0, and they stay undrawable until Model_ShareVertices links them.   *
+ *                                                                                                                           *
  * The accessors describe how to access data in the buffer through `BufferView` structures, which specify the offset,        *
  * size, and stride for the data, enabling efficient reading of model data such as vertices, indices, and other attributes.  *
  *                                                                                                                           *
@@ -242,4 +292,28 @@ typedef struct Model {
  *****************************************************************************************************************************/
 HRESULT Model_LoadFromFile(Model* const m, const wchar_t* const basepath, const wchar_t* const assetpath);
 
+/*****************************************************************************************************************************
+ * Makes the largest meshlet variant within 'limits' the active one of every mesh, before Model_UploadGpuResources: only     *
+ * the active variant goes to the GPU, next to the single copy of the vertices. Returns false, changing nothing, if a mesh   *
+ * has no variant within the limits.                                                                                         *
+ *                                                                                                                           *
+ * Model_LoadFromFile already selects for the default MAX_VERTS and MAX_PRIMS, or the first variant if none fits them.       *
+ *****************************************************************************************************************************/
+bool    Model_SelectMeshletVariant(Model* const m, MeshletLimits limits);
+
+/*****************************************************************************************************************************
+ * Makes all the LODs of a model draw from one deduplicated vertex pool, before Model_UploadGpuResources.                    *
+ *                                                                                                                           *
+ * The vertices of the first mesh of LOD 0 go first and unchanged, so that its indices, and those of version 3 files, stay   *
+ * valid. The vertices of the other meshes are merged in, each reusing an equal one if the pool has it, and their indices    *
+ * and unique vertex indices (of every meshlet variant) are rewritten into the pool. Indices widen to 32 bits for every      *
+ * mesh if the pool outgrows 16-bit indices. Every mesh then spans the whole pool, which only the first mesh of LOD 0        *
+ * uploads: the others reference its buffers, so upload LOD 0 first.                                                         *
+ *                                                                                                                           *
+ * The meshes need a single interleaved vertex buffer of one layout. Returns E_INVALIDARG if they do not, and                *
+ * E_OUTOFMEMORY on allocation failure, changing no mesh either way. 'pool' owns the vertices and the rewritten indices, and *
+ * must be destroyed after a failure too.                                                                                    *
+ *****************************************************************************************************************************/
+HRESULT Model_ShareVertices(Model* const lods, uint32_t lodCount, VertexPool* const pool);
+
 HRESULT Model_UploadGpuResources(Model *model, ID3D12Device2* device, ID3D12CommandQueue* cmdQueue, ID3D12CommandAllocator* cmdAlloc, ID3D12GraphicsCommandList6* cmdList);
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "multi_frustum.h"
+#include "instance_pack.h"
+#include <emmintrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+#define CULL_JOB_SIZE 4096  // Instances handled by one job, a multiple of 4
+
+static const uint8_t c_bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+/*****************************************************************
+    Private types
+******************************************************************/
+
+typedef struct MultiFrustumChunk
+{
+    uint32_t visible[MULTI_FRUSTUM_MAX_VIEWS];
+    uint32_t visibleAny;
+} MultiFrustumChunk;
+
+typedef struct CullContext
+{
+    MultiFrustum*   mf;
+    const Instance* instances;
+    uint32_t        instanceCount;
+} CullContext;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// Same as FloatFromHalf for the non-negative radii Instance_Pack stores.
+static __m128 RadiusFromHalf(__m128i packed)
+{
+    const __m128i half = _mm_and_si128(packed, _mm_set1_epi32(INSTANCE_RADIUS_MASK));
+    const __m128 normal = _mm_castsi128_ps(_mm_add_epi32(_mm_slli_epi32(half, 13), _mm_set1_epi32((127 - 15) << 23)));
+    const __m128 subnormal = _mm_mul_ps(_mm_cvtepi32_ps(half), _mm_set1_ps(1.0f / 16777216.0f));
+    const __m128 isSubnormal = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7C00)), _mm_setzero_si128()));
+    return _mm_or_ps(_mm_and_ps(isSubnormal, subnormal), _mm_andnot_ps(isSubnormal, normal));
+}
+
+// Tests four spheres against every view: bit v of masks[j] is set if sphere j is visible in view v. Only the
+// spheres in 'lanes' (one bit each) are counted in the chunk.
+static void TestViews(const MultiFrustum* const mf, __m128 x, __m128 y, __m128 z, __m128 r, uint32_t lanes,
+                      uint32_t masks[4], MultiFrustumChunk* const chunk)
+{
+    const __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+    masks[0] = masks[1] = masks[2] = masks[3] = 0;
+
+    const float* p = mf->planes;
+    for (uint32_t v = 0; v < mf->viewCount; ++v)
+    {
+        // Like InstanceCull_IsVisible: outside as soon as d < -r for one plane, d summed in the same order.
+        __m128 outside = _mm_setzero_ps();
+        for (int i = 0; i < 6; ++i, p += 16)
+        {
+            const __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(p), x), _mm_mul_ps(_mm_load_ps(p + 4), y)),
+                                                   _mm_mul_ps(_mm_load_ps(p + 8), z)),
+                                        _mm_load_ps(p + 12));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negR));
+        }
+
+        const uint32_t inside = ~(uint32_t)_mm_movemask_ps(outside) & 0xFu;
+        chunk->visible[v] += c_bitCount[inside & lanes];
+        for (int j = 0; j < 4; ++j)
+        {
+            masks[j] |= ((inside >> j) & 1u) << v;
+        }
+    }
+}
+
+static void CullJob(void* context, uint32_t index)
+{
+    const CullContext* ctx = context;
+    MultiFrustum* mf = ctx->mf;
+    MultiFrustumChunk* chunk = &mf->chunks[index];
+    *chunk = (MultiFrustumChunk){ 0 };
+
+    const uint32_t begin = index * CULL_JOB_SIZE;
+    const uint32_t end = begin + CULL_JOB_SIZE < ctx->instanceCount ? begin + CULL_JOB_SIZE : ctx->instanceCount;
+
+    for (uint32_t i = begin; i < end; i += 4)
+    {
+        // SphereCenter and PackedRadius are the last 16 bytes of an instance.
+        __m128 rows[4];
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            const uint32_t k = i + j < end ? i + j : end - 1;
+            rows[j] = _mm_loadu_ps(&ctx->instances[k].SphereCenter.x);
+        }
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+        const uint32_t laneCount = end - i < 4 ? end - i : 4;
+        uint32_t masks[4];
+        TestViews(mf, rows[0], rows[1], rows[2], RadiusFromHalf(_mm_castps_si128(rows[3])), (1u << laneCount) - 1, masks, chunk);
+
+        for (uint32_t j = 0; j < laneCount; ++j)
+        {
+            mf->masks[i + j] = masks[j];
+            chunk->visibleAny += masks[j] != 0;
+        }
+    }
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool MultiFrustum_Init(MultiFrustum* const mf, JobSystem* const jobs)
+{
+    *mf = (MultiFrustum){ .jobs = jobs };
+    mf->planes = _mm_malloc((size_t)MULTI_FRUSTUM_MAX_VIEWS * 6 * 16 * sizeof(float), 16);
+    return mf->planes != NULL;
+}
+
+void MultiFrustum_Destroy(MultiFrustum* const mf)
+{
+    _mm_free(mf->planes);
+    free(mf->masks);
+    free(mf->chunks);
+    *mf = (MultiFrustum){ 0 };
+}
+
+void MultiFrustum_SetViews(MultiFrustum* const mf, const XMFLOAT4 (*const planes)[6], uint32_t viewCount)
+{
+    mf->viewCount = viewCount < MULTI_FRUSTUM_MAX_VIEWS ? viewCount : MULTI_FRUSTUM_MAX_VIEWS;
+
+    float* p = mf->planes;
+    for (uint32_t v = 0; v < mf->viewCount; ++v)
+    {
+        for (int i = 0; i < 6; ++i)
+        {
+            const float* plane = &planes[v][i].x;
+            for (int c = 0; c < 4; ++c, p += 4)
+            {
+                p[0] = p[1] = p[2] = p[3] = plane[c];
+            }
+        }
+    }
+}
+
+bool MultiFrustum_Cull(MultiFrustum* const mf, const Instance* const instances, uint32_t instanceCount,
+                       MultiFrustumStats* const stats)
+{
+    *stats = (MultiFrustumStats){ 0 };
+
+    const uint32_t chunkCount = (instanceCount + CULL_JOB_SIZE - 1) / CULL_JOB_SIZE;
+    if (instanceCount > mf->maskCapacity)
+    {
+        uint32_t* masks = realloc(mf->masks, instanceCount * sizeof(uint32_t));
+        if (!masks)
+        {
+            return false;
+        }
+        mf->masks = masks;
+        mf->maskCapacity = instanceCount;
+    }
+    if (chunkCount > mf->chunkCapacity)
+    {
+        MultiFrustumChunk* chunks = realloc(mf->chunks, chunkCount * sizeof(MultiFrustumChunk));
+        if (!chunks)
+        {
+            return false;
+        }
+        mf->chunks = chunks;
+        mf->chunkCapacity = chunkCount;
+    }
+
+    CullContext ctx = { .mf = mf, .instances = instances, .instanceCount = instanceCount };
+    JobSystem_ParallelFor(mf->jobs, chunkCount, CullJob, &ctx);
+
+    for (uint32_t c = 0; c < chunkCount; ++c)
+    {
+        for (uint32_t v = 0; v < mf->viewCount; ++v)
+        {
+            stats->Visible[v] += mf->chunks[c].visible[v];
+        }
+        stats->VisibleAny += mf->chunks[c].visibleAny;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+#include "job_system.h"
+
+typedef struct Instance Instance;
+
+#define MULTI_FRUSTUM_MAX_VIEWS 32  // One bit per view in the visibility masks
+
+typedef struct MultiFrustumStats
+{
+    uint32_t Visible[MULTI_FRUSTUM_MAX_VIEWS];  // Instances visible in each view
+    uint32_t VisibleAny;                        // Instances visible in at least one view
+} MultiFrustumStats;
+
+struct MultiFrustumChunk;
+
+/****************************************************************************************************
+ * Frustum culling of every instance against up to 32 views in a single pass: shadow cascades,      *
+ * stereo eyes, cube map faces...                                                                   *
+ *                                                                                                  *
+ * Each job walks its instances once, four at a time: their packed bounding spheres are loaded and  *
+ * transposed with SSE, then tested against the six planes of every view while they sit in          *
+ * registers. Instance memory is read once whatever the view count, where one pass per view would   *
+ * read it once per view. The result is a visibility bitmask per instance, bit v for view v,        *
+ * matching InstanceCull_IsVisible with the planes of that view.                                    *
+ ****************************************************************************************************/
+typedef struct MultiFrustum
+{
+    JobSystem* jobs;
+
+    float*     planes;      // Per view, per plane, x, y, z and w each repeated 4 times for SSE loads
+    uint32_t   viewCount;
+
+    uint32_t*  masks;       // Visibility mask per instance
+    uint32_t   maskCapacity;
+
+    struct MultiFrustumChunk* chunks;
+    uint32_t   chunkCapacity;
+} MultiFrustum;
+
+bool MultiFrustum_Init     (MultiFrustum* const mf, JobSystem* const jobs);
+void MultiFrustum_Destroy  (MultiFrustum* const mf);
+
+// Sets the normalized frustum planes of each view, in Constants.Planes order. At most MULTI_FRUSTUM_MAX_VIEWS views.
+void MultiFrustum_SetViews (MultiFrustum* const mf, const XMFLOAT4 (*const planes)[6], uint32_t viewCount);
+
+// Fills mf->masks for the instances. Returns false on allocation failure.
+bool MultiFrustum_Cull     (MultiFrustum* const mf, const Instance* const instances, uint32_t instanceCount,
+                            MultiFrustumStats* const stats);
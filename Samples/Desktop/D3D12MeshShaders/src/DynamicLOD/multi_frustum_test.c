@@ -0,0 +1,107 @@
+/*************************************************************************************
+ Multi-frustum culling tests.
+
+ Culls a random scene against 1 to 32 views at once, cameras turned all around
+ the inside of the scene, and compares every instance's visibility mask with
+ InstanceCull_IsVisible against the planes of each view: the masks must match bit
+ for bit, as must the per-view and any-view counts. The instance count is not a
+ multiple of 4, one instance has a subnormal radius, and the culler is reused with
+ fewer instances and views, including none.
+
+ Usage: MultiFrustumTest
+**************************************************************************************/
+
+#include <string.h>
+#include "multi_frustum.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include "scene_gen.h"
+#include "test_check.h"
+#include "test_view.h"
+
+#define SCENE_LEVEL 15    // 29791 instances
+
+static XMFLOAT4 s_planes[MULTI_FRUSTUM_MAX_VIEWS][6];
+static Constants s_views[MULTI_FRUSTUM_MAX_VIEWS];
+
+// Views spread around the y axis, each from a slightly different place.
+static void SetViews(MultiFrustum* const mf, uint32_t viewCount)
+{
+    for (uint32_t v = 0; v < viewCount && v < MULTI_FRUSTUM_MAX_VIEWS; ++v)
+    {
+        const XMFLOAT3 eye = { 3.0f * (float)v, 10.0f, -20.0f };
+        TestView_Build(&s_views[v], eye, 6.2831853f * (float)v / (float)viewCount, 1.0472f, 16.0f / 9.0f);
+        memcpy(s_planes[v], s_views[v].Planes, sizeof(s_planes[v]));
+    }
+    MultiFrustum_SetViews(mf, s_planes, viewCount);
+}
+
+static void CheckCull(MultiFrustum* const mf, const Instance* const instances, uint32_t count)
+{
+    MultiFrustumStats stats;
+    CHECK(MultiFrustum_Cull(mf, instances, count, &stats));
+
+    uint32_t visible[MULTI_FRUSTUM_MAX_VIEWS] = { 0 };
+    uint32_t visibleAny = 0, mismatches = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&instances[i]);
+        uint32_t mask = 0;
+        for (uint32_t v = 0; v < mf->viewCount; ++v)
+        {
+            if (InstanceCull_IsVisible(&s_views[v], sphere))
+            {
+                mask |= 1u << v;
+                ++visible[v];
+            }
+        }
+        visibleAny += mask != 0;
+        mismatches += mask != mf->masks[i];
+    }
+    CHECK(mismatches == 0);
+    CHECK(stats.VisibleAny == visibleAny);
+    for (uint32_t v = 0; v < mf->viewCount; ++v)
+    {
+        CHECK(stats.Visible[v] == visible[v]);
+    }
+}
+
+int main(void)
+{
+    const uint32_t count = SceneGen_CubeCount(SCENE_LEVEL) - 1;  // 2 past a multiple of 4
+    Instance* const instances = malloc(sizeof(Instance) * SceneGen_CubeCount(SCENE_LEVEL));
+    JobSystem jobs;
+    if (!instances || !JobSystem_Init(&jobs, 3))
+    {
+        fprintf(stderr, "Cannot create the scene\n");
+        return EXIT_FAILURE;
+    }
+    SceneGen_Generate(instances, SceneLayoutRandom, SCENE_LEVEL, 3.0f, 7);
+    instances[5].PackedRadius = (instances[5].PackedRadius & ~0xFFFFu) | 0x0123u;   // Subnormal half-float radius
+
+    MultiFrustum mf;
+    CHECK(MultiFrustum_Init(&mf, &jobs));
+
+    const uint32_t viewCounts[] = { 1, 2, 3, 4, 5, 6, 17, 31, 32 };
+    for (uint32_t k = 0; k < (uint32_t)_countof(viewCounts); ++k)
+    {
+        SetViews(&mf, viewCounts[k]);
+        CHECK(mf.viewCount == viewCounts[k]);
+        CheckCull(&mf, instances, count);
+    }
+
+    // The views are clamped, the buffers reused for smaller scenes, and no view sees nothing.
+    SetViews(&mf, MULTI_FRUSTUM_MAX_VIEWS + 4);
+    CHECK(mf.viewCount == MULTI_FRUSTUM_MAX_VIEWS);
+    CheckCull(&mf, instances, count);
+    SetViews(&mf, 6);
+    CheckCull(&mf, instances, 7);
+    CheckCull(&mf, instances, 0);
+    SetViews(&mf, 0);
+    CheckCull(&mf, instances, count);
+
+    MultiFrustum_Destroy(&mf);
+    JobSystem_Destroy(&jobs);
+    free(instances);
+    return TEST_RESULT();
+}
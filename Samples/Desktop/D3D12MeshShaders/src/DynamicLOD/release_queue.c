@@ -0,0 +1,82 @@
+#include "release_queue.h"
+#include <stdlib.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// Doubles the ring, unwrapping it so that the oldest entry comes first.
+static bool Grow(ReleaseQueue* const queue)
+{
+    const uint32_t capacity = queue->capacity > 0 ? queue->capacity * 2 : 16;
+    RetiredObject* entries = malloc(capacity * sizeof(RetiredObject));
+    if (!entries)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < queue->count; ++i)
+    {
+        entries[i] = queue->entries[(queue->head + i) % queue->capacity];
+    }
+    free(queue->entries);
+    queue->entries = entries;
+    queue->head = 0;
+    queue->capacity = capacity;
+    return true;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool ReleaseQueue_Init(ReleaseQueue* const queue, uint32_t capacity)
+{
+    *queue = (ReleaseQueue){ 0 };
+    if (capacity == 0)
+    {
+        return true;
+    }
+
+    queue->entries = malloc(capacity * sizeof(RetiredObject));
+    queue->capacity = queue->entries ? capacity : 0;
+    return queue->entries != NULL;
+}
+
+void ReleaseQueue_Destroy(ReleaseQueue* const queue)
+{
+    ReleaseQueue_Collect(queue, UINT64_MAX);
+    free(queue->entries);
+    *queue = (ReleaseQueue){ 0 };
+}
+
+bool ReleaseQueue_Retire(ReleaseQueue* const queue, void* object, ReleaseFunc release, uint64_t fenceValue)
+{
+    if (queue->count == queue->capacity && !Grow(queue))
+    {
+        return false;
+    }
+
+    queue->entries[(queue->head + queue->count) % queue->capacity] = (RetiredObject){
+        .object = object,
+        .release = release,
+        .fenceValue = fenceValue,
+    };
+    queue->count++;
+    return true;
+}
+
+uint32_t ReleaseQueue_Collect(ReleaseQueue* const queue, uint64_t completedValue)
+{
+    uint32_t released = 0;
+    while (queue->count > 0 && queue->entries[queue->head].fenceValue <= completedValue)
+    {
+        const RetiredObject retired = queue->entries[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+
+        retired.release(retired.object);
+        ++released;
+    }
+    return released;
+}
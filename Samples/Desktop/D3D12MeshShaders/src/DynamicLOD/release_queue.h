@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Frees one retired object, e.g. calls Release on a D3D12 resource.
+typedef void (*ReleaseFunc)(void* object);
+
+typedef struct RetiredObject
+{
+    void*       object;
+    ReleaseFunc release;
+    uint64_t    fenceValue;     // Released once the fence has completed this value
+} RetiredObject;
+
+/***************************************************************************************************
+ * Deferred destruction of objects the GPU may still be reading.                                   *
+ *                                                                                                 *
+ * Instead of draining the GPU before dropping a resource, the owner retires it with the fence    *
+ * value the queue will signal once the current frame's commands have executed, and carries on.   *
+ * Each frame, ReleaseQueue_Collect is given the fence's completed value and releases every       *
+ * object whose value it has reached.                                                              *
+ *                                                                                                 *
+ * Fence values only grow, so the objects form a FIFO in retirement order: collecting stops at    *
+ * the first one still in flight. The queue never reads a fence itself, so it works the same with *
+ * an ID3D12Fence or a counter.                                                                    *
+ ***************************************************************************************************/
+typedef struct ReleaseQueue
+{
+    RetiredObject* entries;     // Ring buffer of 'capacity' entries
+    uint32_t       head;        // Oldest entry
+    uint32_t       count;
+    uint32_t       capacity;
+} ReleaseQueue;
+
+bool     ReleaseQueue_Init    (ReleaseQueue* const queue, uint32_t capacity);
+
+// Releases every object left, in order. Only call it once the GPU is idle.
+void     ReleaseQueue_Destroy (ReleaseQueue* const queue);
+
+// Queues 'object' until 'fenceValue' completes. Returns false, the object untouched, on allocation failure.
+bool     ReleaseQueue_Retire  (ReleaseQueue* const queue, void* object, ReleaseFunc release, uint64_t fenceValue);
+
+// Releases the objects whose fence value is at most 'completedValue'. Returns how many were released.
+uint32_t ReleaseQueue_Collect (ReleaseQueue* const queue, uint64_t completedValue);
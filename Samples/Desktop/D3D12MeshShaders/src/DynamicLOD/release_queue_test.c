@@ -0,0 +1,116 @@
+/*************************************************************************************
+ Release queue tests.
+
+ Simulates frames in flight with a counter standing for the fence: every frame
+ retires a random number of objects with the value it signals, and a GPU a random
+ number of frames behind completes them. Every object must be released exactly
+ once, in retirement order, and only once its value has completed, while the ring
+ wraps and grows from any starting capacity. Destroying the queue releases what
+ is left.
+
+ Usage: ReleaseQueueTest
+**************************************************************************************/
+
+#include <string.h>
+#include "release_queue.h"
+#include "test_check.h"
+
+#define OBJECT_COUNT 20000
+
+typedef struct TestObject
+{
+    uint64_t fenceValue;    // The value it was retired with
+    uint32_t releases;
+} TestObject;
+
+static TestObject s_objects[OBJECT_COUNT];
+static uint32_t   s_releaseOrder[OBJECT_COUNT];
+static uint32_t   s_releasedCount;
+static uint64_t   s_completedValue;
+static uint32_t   s_early;
+
+static void ReleaseObject(void* object)
+{
+    TestObject* const o = object;
+    s_early += o->fenceValue > s_completedValue;
+    o->releases++;
+    if (s_releasedCount < OBJECT_COUNT)
+    {
+        s_releaseOrder[s_releasedCount++] = (uint32_t)(o - s_objects);
+    }
+}
+
+static void TestFrames(uint32_t capacity)
+{
+    memset(s_objects, 0, sizeof(s_objects));
+    s_releasedCount = 0;
+    s_completedValue = 0;
+    s_early = 0;
+
+    ReleaseQueue queue;
+    CHECK(ReleaseQueue_Init(&queue, capacity));
+
+    uint32_t retired = 0, badCounts = 0, inFlight = 0;
+    for (uint64_t frame = 1; retired < OBJECT_COUNT; ++frame)
+    {
+        // Frame 'frame' signals fence value 'frame'.
+        const uint32_t count = TestRandom() % 8;
+        for (uint32_t k = 0; k < count && retired < OBJECT_COUNT; ++k)
+        {
+            s_objects[retired].fenceValue = frame;
+            CHECK(ReleaseQueue_Retire(&queue, &s_objects[retired], ReleaseObject, frame));
+            ++retired;
+        }
+
+        // The GPU is 0 to 3 frames behind, never going backwards, and at least one behind at the end so
+        // that Destroy has something left.
+        const uint64_t lag = retired == OBJECT_COUNT ? 1 + TestRandom() % 3 : TestRandom() % 4;
+        if (frame > lag && frame - lag > s_completedValue)
+        {
+            s_completedValue = frame - lag;
+        }
+        const uint32_t before = s_releasedCount;
+        const uint32_t released = ReleaseQueue_Collect(&queue, s_completedValue);
+        badCounts += released != s_releasedCount - before;
+
+        // What is left is exactly what has not completed.
+        inFlight = 0;
+        for (uint32_t i = 0; i < retired; ++i)
+        {
+            inFlight += s_objects[i].fenceValue > s_completedValue;
+        }
+        badCounts += queue.count != inFlight || s_releasedCount + inFlight != retired;
+    }
+    CHECK(badCounts == 0);
+    CHECK(inFlight > 0);
+
+    ReleaseQueue_Destroy(&queue);
+    CHECK(queue.count == 0 && queue.entries == NULL);
+
+    uint32_t badReleases = 0, badOrder = 0;
+    for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+    {
+        badReleases += s_objects[i].releases != 1;
+        badOrder += s_releaseOrder[i] != i;
+    }
+    CHECK(badReleases == 0);
+    CHECK(badOrder == 0);
+    CHECK(s_early == inFlight);     // Only Destroy releases ahead of the fence
+}
+
+int main(void)
+{
+    TestFrames(0);
+    TestFrames(3);
+    TestFrames(64);
+
+    // Nothing to collect before anything completes, and an empty queue destroys cleanly.
+    ReleaseQueue queue;
+    CHECK(ReleaseQueue_Init(&queue, 0));
+    CHECK(ReleaseQueue_Collect(&queue, UINT64_MAX) == 0);
+    CHECK(ReleaseQueue_Retire(&queue, &s_objects[0], ReleaseObject, 5));
+    CHECK(ReleaseQueue_Collect(&queue, 4) == 0);
+    CHECK(ReleaseQueue_Collect(&queue, 5) == 1);
+    ReleaseQueue_Destroy(&queue);
+    return TEST_RESULT();
+}
@@ -1,8 +1,12 @@
 #define COBJMACROS
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "sample.h"
 #include "sample_commons.h"
+#include "scene_gen.h"
+#include "view_constants.h"
+#include "lod_error.h"
 #include "macros.h"
 #include "window.h"
 #include "d3dcompiler.h"
@@ -17,33 +21,55 @@
  Constants
 **************************************************************************************/
 
-enum DescriptorHeapIndex
+// Root parameters, in the order of ROOT_SIG in shaders/Common.hlsli.
+enum RootParameterIndex
 {
-	SRV_MeshInfoLODs = 0,
-	SRV_VertexLODs = SRV_MeshInfoLODs + MAX_LOD_LEVELS,
-	SRV_MeshletLODs = SRV_VertexLODs + MAX_LOD_LEVELS,
-	SRV_UniqueVertexIndexLODs = SRV_MeshletLODs + MAX_LOD_LEVELS,
-	SRV_PrimitiveIndexLODs = SRV_UniqueVertexIndexLODs + MAX_LOD_LEVELS,
-	SRV_Count = SRV_PrimitiveIndexLODs + MAX_LOD_LEVELS,
+	Root_Constants,
+	Root_DrawParams,
+	Root_Instances,
+	Root_Meshes,
+	Root_Models,
+	Root_Vertices,
+	Root_Meshlets,
+	Root_UniqueVertexIndices,
+	Root_PrimitiveIndices,
+};
+
+// The bindless tables follow each other in the SRV heap, each holding one descriptor per mesh.
+enum DescriptorTable
+{
+	Table_Vertices,
+	Table_Meshlets,
+	Table_UniqueVertexIndices,
+	Table_PrimitiveIndices,
+	Table_Count,
 };
 
 const float c_fovy = XM_PI / 3.0f;
 
-// Limit our dispatch threadgroup count to 65536 for indexing simplicity.
-const uint32_t c_maxGroupDispatchCount = 65536u;
+const char* c_defaultModel = "lod_assets/Dragon";
 
-const wchar_t* c_lodFilenames[LodsCount] =
+static const float c_animationSpeed = 2.0f;  // Top speed of animated instances, in model radii per second
+static const float c_lodTargetMs = 1000.0f / 60.0f;
+static const uint64_t c_lodTriangleBudget = 50000000;  // Triangles a frame, held while the CPU selects the LODs
+static const float c_lodPixelError = LOD_SELECT_PIXEL_ERROR;  // Screen-space error the CPU LOD selection allows
+static const float c_gridCellRadii = 4.0f;  // Cell size of the spatial grid, in model radii
+static const uint32_t c_sceneSeed = 1;  // Fixed, so every run generates the same scenes
+
+// Every MESHLET_PIPELINES entry of CMakeLists.txt, which compiles their amplification and mesh shaders.
+static const MeshletPipeline c_meshletPipelines[] =
 {
-	L"lod_assets/Dragon_LOD0.bin",
-	L"lod_assets/Dragon_LOD1.bin",
-	L"lod_assets/Dragon_LOD2.bin",
-	L"lod_assets/Dragon_LOD3.bin",
-	L"lod_assets/Dragon_LOD4.bin",
-	L"lod_assets/Dragon_LOD5.bin",
+	{ { 64, 126 }, 32 },
+	{ { 128, 256 }, 32 },
+	{ { 64, 126 }, 64 },
+	{ { 128, 256 }, 64 },
 };
 
-const wchar_t* c_ampShaderFilename = L"shaders/MeshletAS.cso";
-const wchar_t* c_meshShaderFilename = L"shaders/MeshletMS.cso";
+// Benchmark profile next to the executable, "<max verts> <max prims> <wave size>", naming the fastest pipeline measured on this machine.
+static const wchar_t* c_meshletProfileFilename = L"meshlet_profile.txt";
+
+const wchar_t* c_ampShaderFilename = L"shaders/MeshletAS_%ux%u_w%u.cso";
+const wchar_t* c_meshShaderFilename = L"shaders/MeshletMS_%ux%u_w%u.cso";
 const wchar_t* c_pixelShaderFilename = L"shaders/MeshletPS.cso";
 
 /*************************************************************************************
@@ -52,6 +78,11 @@ const wchar_t* c_pixelShaderFilename = L"shaders/MeshletPS.cso";
 
 static void LoadPipeline(DXSample* const sample);
 static void LoadAssets(DXSample* const sample);
+static void SelectMeshletPipeline(DXSample* const sample);
+static void LoadLodModel(DXSample* const sample, LodModel* const model, const char* const name);
+static void MeasureLodErrors(const LodModel* const model, LodErrorChain* const chain);
+static void CreateMeshTable(DXSample* const sample);
+static void CreateMeshDescriptors(DXSample* const sample);
 static void WaitForGpu(DXSample* sample);
 static void PopulateCommandList(DXSample* const sample);
 static void ReleaseAll(DXSample* const sample);
@@ -59,9 +90,19 @@ static void LoadShaderData(const WCHAR* const base, const WCHAR* const shaderRel
 static D3D12_CPU_DESCRIPTOR_HANDLE OffsetDescHandle(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle, uint32_t index, uint32_t srvDescriptorSize);
 static void MoveToNextFrame(DXSample* sample);
 static void RegenerateInstances(DXSample* sample);
+static void BuildFrameConstants(const DXSample* const sample, Constants* const constants);
+static void CreateInstanceBuffer(DXSample* const sample, UINT64 instanceBufferSize);
+static void BuildDispatchPlan(DXSample* const sample);
+static void UploadDirtyInstances(DXSample* const sample);
+static void LoadScene(DXSample* const sample);
+static void StreamSceneInstances(DXSample* const sample);
+static void CloseScene(DXSample* const sample);
+static void RetireResource(DXSample* const sample, ID3D12Resource** const resource);
+static void ReleaseComObject(void* object);
+static void StartAnimation(DXSample* const sample);
+static double FrameWorkMs(const DXSample* const sample);
 static UINT64 InstanceBufferWidth(ID3D12Resource* instanceBuffer);
 
-static UINT32 AlignU32(UINT32 size);
 static UINT64  AlignU64(UINT64 size);
 
 /*************************************************************************************
@@ -95,15 +136,72 @@ void Sample_Init(DXSample* const sample) {
 	sample->fenceEvent = NULL;
 	for(int i =0; i < FrameCount ; ++i) sample->fenceValues[i] = 0;
 	sample->constantData = NULL;
-	sample->instanceData = NULL;
+	sample->instances = NULL;
+	sample->instanceUploadData = NULL;
+	sample->instanceRegionSize = 0;
+	DirtyRanges_Clear(&sample->instanceDirty);
+	if (!ReleaseQueue_Init(&sample->releaseQueue, 8)) LogErrAndExit(E_OUTOFMEMORY);
+	sample->sceneOpen = false;
+	sample->sceneUpload = NULL;
+	sample->sceneUploadData = NULL;
+	sample->sceneModelSpheres = NULL;
+	sample->sceneCopyFence = 0;
+	sample->instanceSort = (InstanceSort){ 0 };
+	sample->dispatchPlan = (DispatchPlan){ 0 };
+	sample->models = NULL;
+	sample->modelDescs = NULL;
+	sample->modelCount = 0;
+	sample->meshCount = 0;
+	sample->frameStats = (FrameStatsRing){ 0 };
+	sample->animate = false;
+	sample->animation = (InstanceAnimation){ 0 };
+	sample->useLodBudget = false;
+	LodBudget_Init(&sample->lodBudget, c_lodTargetMs, c_lodTriangleBudget);
+	sample->timestampHeap = NULL;
+	sample->timestampReadback = NULL;
+	sample->timestamps = NULL;
+	sample->cpuFrameMs = 0.0;
+	sample->lodTriangles = 0;
+	sample->useLodSelect = false;
+	sample->lodSelector = (LodSelector){ .pixelError = c_lodPixelError, .hysteresis = LOD_SELECT_HYSTERESIS };
+	sample->lodErrors = NULL;
+	sample->spatialGrid = (SpatialGrid){ 0 };
+	sample->gridResults = (SpatialGridResults){ 0 };
+	sample->gridStale = true;
 	sample->renderMode = LOD;
 	sample->instanceLevel = 0;
+	sample->sceneLayout = SceneLayoutCube;
 	sample->instanceCount = 1;
-	sample->updateInstances = true;
 
 	LoadPipeline(sample);
+
+	// The model table of the scene decides which LOD chains to load.
+	if (sample->scenePath && sample->scenePath[0])
+	{
+		if (!SceneStream_Open(&sample->sceneStream, sample->scenePath)) LogErrAndExit(E_INVALIDARG);
+		sample->sceneOpen = true;
+	}
+
 	LoadAssets(sample);
-	RegenerateInstances(sample);
+	if (!SpatialGrid_Init(&sample->spatialGrid, c_gridCellRadii * sample->models[0].lods[0].boundingSphere.r)) LogErrAndExit(E_FAIL);
+
+	if (sample->sceneOpen)
+	{
+		LoadScene(sample);
+	}
+	else
+	{
+		RegenerateInstances(sample);
+	}
+
+	// One histogram column per LOD of the longest chain.
+	uint32_t lodCount = 0;
+	for (uint32_t i = 0; i < sample->modelCount; ++i)
+	{
+		lodCount = sample->models[i].lodCount > lodCount ? sample->models[i].lodCount : lodCount;
+	}
+	if (!FrameStatsRing_Init(&sample->frameStats, FRAME_STATS_DEFAULT_CAPACITY, lodCount)) LogErrAndExit(E_OUTOFMEMORY);
+	FrameStatsRing_Begin(&sample->frameStats);
 }
 
 void Sample_Destroy(DXSample* sample)
@@ -125,55 +223,92 @@ void Sample_AtExit(DXSample* sample)
 }
 
 void Sample_Update(DXSample* const sample) {
+	QueryPerformanceCounter(&sample->cpuFrameStart);
 	Tick(&sample->timer);
+
+	// The elapsed time covers the frame recorded since the last update. Culling runs on the GPU, so
+	// only the CPU-side counters of the statistics are filled, and the LODs when the CPU selects them.
+	const double frameTimeMs = TicksToSeconds(sample->timer.elapsedTicks) * 1000.0;
+	FrameStatsRing_End(&sample->frameStats, frameTimeMs);
+	FrameStats* const stats = FrameStatsRing_Begin(&sample->frameStats);
+
+	// The frame time includes the wait for vsync in Present, so the budget gets the work time instead. The
+	// triangles are only known when the CPU selects the LODs. Per-instance LOD hysteresis comes with the
+	// CPU selection too: its LOD_SELECT_HYSTERESIS band spans more than a bias step, so bias changes alone
+	// do not flip instances between LODs. The shaders keep no state to apply LOD_BUDGET_HYSTERESIS with.
+	if (sample->useLodBudget)
+	{
+		LodBudget_Update(&sample->lodBudget, FrameWorkMs(sample), sample->lodTriangles);
+	}
+	stats->LodBias = sample->lodBudget.bias;
+	stats->MinScreenSize = sample->lodBudget.minScreenSize;
+
 	if (sample->frameCounter++ % 30 == 0)
 	{
 		// Update window text with FPS value.
 		wchar_t fps[64];
-		swprintf_s(fps, 64, L"%ufps", sample->timer.framesPerSecond);
+		if (sample->sceneOpen)
+		{
+			swprintf_s(fps, 64, L"%ufps, %u/%u instances loaded", sample->timer.framesPerSecond,
+				sample->instanceCount, sample->sceneStream.header.InstanceCount);
+		}
+		else if (sample->useLodBudget)
+		{
+			swprintf_s(fps, 64, L"%ufps, LOD bias %.2f, min size %.3f", sample->timer.framesPerSecond,
+				sample->lodBudget.bias, sample->lodBudget.minScreenSize);
+		}
+		else if (sample->sceneLayout != SceneLayoutCube)
+		{
+			swprintf_s(fps, 64, L"%ufps, %hs scene", sample->timer.framesPerSecond, SceneGen_LayoutName(sample->sceneLayout));
+		}
+		else
+		{
+			swprintf_s(fps, 64, L"%ufps", sample->timer.framesPerSecond);
+		}
 		SetWindowTextW(G_HWND, fps);
 	}
 
 	SimpleCamera_Update(&sample->camera, TicksToSeconds(sample->timer.elapsedTicks));
-	XMMATRIX viewMatrix = SimpleCamera_GetViewMatrix(sample->camera.position, sample->camera.lookDirection, sample->camera.upDirection);
-	XMMATRIX projMatrix = SimpleCamera_GetProjectionMatrix(c_fovy, sample->aspectRatio, 1.0f, 1e4f);
-	XMMATRIX viewProj = XM_MAT_MULT(viewMatrix, projMatrix);
-	XMVECTOR scale, rot, viewPos;
-	XM_MAT_DECOMP(&scale, &rot, &viewPos, viewMatrix);
-
-	XMMATRIX vp = XM_MAT_TRANSP(viewProj);
-	XMVECTOR leftPlane = XM_VEC_ADD(vp.r[3], vp.r[0]);
-	XMVECTOR rightPlane = XM_VEC_SUBTRACT(vp.r[3], vp.r[0]);
-	XMVECTOR bottonPlane = XM_VEC_ADD(vp.r[3], vp.r[1]);
-	XMVECTOR topPlane = XM_VEC_SUBTRACT(vp.r[3], vp.r[1]);
-	XMVECTOR farPlane = XM_VEC_SUBTRACT(vp.r[3], vp.r[2]);
-	XMVECTOR planes[6] =
-	{
-		XM_PLANE_NORM(leftPlane),
-		XM_PLANE_NORM(rightPlane),
-		XM_PLANE_NORM(bottonPlane),
-		XM_PLANE_NORM(topPlane), 
-		XM_PLANE_NORM(vp.r[2]),
-		XM_PLANE_NORM(farPlane),
-	};
 
-	Constants* constants = &sample->constantData[sample->frameIndex];
-	XMMATRIX transposedView = XM_MAT_TRANSP(viewMatrix);
-	XM_STORE_FLOAT4X4(&constants->View, transposedView);
-	viewProj = XM_MAT_TRANSP(viewProj);
-	XM_STORE_FLOAT4X4(&constants->ViewProj, viewProj);
-	XMMATRIX viewProjInv = XM_MAT_INV(NULL, viewMatrix);
-	XMVECTOR baseToView = XM_VEC3_TRANSFORM(g_XMZero.v, viewProjInv);
-	XM_STORE_FLOAT3(&constants->ViewPosition, baseToView);
+	if (sample->animate && sample->instances)
+	{
+		InstanceAnimation_Update(&sample->animation, sample->instances, (float)TicksToSeconds(sample->timer.elapsedTicks), &sample->instanceDirty);
+	}
+
+	BuildFrameConstants(sample, &sample->constantData[sample->frameIndex]);
+	sample->frameStats.current->BytesUploaded += sizeof(Constants);
 
-	for (uint32_t i = 0; i < 6; ++i)
+	// After the animation, which writes the instances back with the LODs they had when it started. Instances
+	// standing still are found through the spatial grid; animated ones all move every frame, so all are tested.
+	if (sample->useLodSelect && sample->instances)
 	{
-		XM_STORE_FLOAT4(&constants->Planes[i], planes[i]);
+		const Constants* const constants = &sample->constantData[sample->frameIndex];
+		sample->gridStale = sample->gridStale || sample->animate;
+		if (sample->gridStale && !sample->animate)
+		{
+			sample->gridStale = !SpatialGrid_Build(&sample->spatialGrid, sample->instances, sample->instanceCount);
+		}
+
+		sample->gridResults.count = 0;
+		if (!sample->gridStale && SpatialGrid_QueryFrustum(&sample->spatialGrid, constants->Planes, &sample->gridResults))
+		{
+			LodSelector_UpdateCandidates(&sample->lodSelector, constants, sample->viewport.Height, sample->lodErrors,
+				sample->modelCount, sample->gridResults.indices, sample->gridResults.count, sample->instances, &sample->instanceDirty);
+		}
+		else
+		{
+			LodSelector_Update(&sample->lodSelector, constants, sample->viewport.Height,
+				sample->lodErrors, sample->modelCount, sample->instances, &sample->instanceDirty);
+		}
+		FrameStats_CountLods(stats, sample->lodSelector.lods, sample->instanceCount);
 	}
 
-	constants->RenderMode = sample->renderMode;
-	constants->LODCount = LodsCount;
-	constants->RecipTanHalfFovy = 1.0f / tanf(c_fovy * 0.5f);
+	// The cube instances all draw models[0].
+	sample->lodTriangles = 0;
+	for (uint32_t lod = 0; sample->useLodSelect && sample->instances && lod < sample->models[0].lodCount; ++lod)
+	{
+		sample->lodTriangles += (uint64_t)stats->LodHistogram[lod] * sample->models[0].lods[lod].meshes[0].PrimitiveIndices.count;
+	}
 }
 
 void Sample_Render(DXSample* const sample)
@@ -186,6 +321,10 @@ void Sample_Render(DXSample* const sample)
 	ID3D12CommandQueue_ExecuteCommandLists(sample->commandQueue, _countof(ppCommandLists), ppCommandLists);
 	RELEASE(asCommandList);
 
+	LARGE_INTEGER presentStart;
+	QueryPerformanceCounter(&presentStart);
+	sample->cpuFrameMs = (double)(presentStart.QuadPart - sample->cpuFrameStart.QuadPart) * 1000.0 / (double)sample->timer.qpcFrequency.QuadPart;
+
 	HRESULT hr = IDXGISwapChain3_Present(sample->swapChain, 1, 0);
 	if (FAILED(hr)) LogErrAndExit(IDXGISwapChain3_Present(sample->swapChain, 1, 0));
 
@@ -213,6 +352,52 @@ void Sample_KeyDown(DXSample* const sample, UINT8 key) {
 		uint32_t renderMode = 1 + sample->renderMode;
 		sample->renderMode = renderMode % Count;
 		break;
+
+	case VK_F2:
+		// Written to the working directory.
+		if (!FrameStatsRing_WriteCsv(&sample->frameStats, "frame_stats.csv") ||
+			!FrameStatsRing_WriteJson(&sample->frameStats, "frame_stats.json"))
+		{
+			OutputDebugStringA("ERROR: Failed to write the frame statistics\n");
+		}
+		break;
+
+	case VK_F3:
+		// Streamed scenes keep their instances in place, and no CPU copy of them even once loaded.
+		if (sample->instances)
+		{
+			sample->animate = !sample->animate;
+			if (sample->animate)
+			{
+				StartAnimation(sample);
+			}
+		}
+		break;
+
+	case VK_F4:
+		// Back to the plain screen-size mapping when disabled.
+		sample->useLodBudget = !sample->useLodBudget;
+		LodBudget_Init(&sample->lodBudget, c_lodTargetMs, c_lodTriangleBudget);
+		break;
+
+	case VK_F5:
+		sample->sceneLayout = (sample->sceneLayout + 1) % SceneLayoutCount;
+		RegenerateInstances(sample);
+		break;
+
+	case VK_F6:
+		// Back to the screen-size mapping of the shaders when disabled. The animation restarts from
+		// the released instances, or it would write the CPU LODs back.
+		sample->useLodSelect = !sample->useLodSelect;
+		if (!sample->useLodSelect && sample->instances)
+		{
+			LodSelector_Release(&sample->lodSelector, sample->instances, &sample->instanceDirty);
+			if (sample->animate)
+			{
+				StartAnimation(sample);
+			}
+		}
+		break;
 	}
 	SimpleCamera_OnKeyDown(&sample->camera, key);
 }
@@ -358,15 +543,7 @@ static void LoadPipeline(DXSample* const sample)
 
 		sample->dsvDescriptorSize = ID3D12Device2_GetDescriptorHandleIncrementSize(sample->device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
 
-		// Describe and create a shader resource view (SRV) descriptor heap.
-		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {
-			.NumDescriptors = SRV_Count,
-			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
-		};
-		hr = ID3D12Device2_CreateDescriptorHeap(sample->device, &srvHeapDesc, &IID_ID3D12DescriptorHeap, (void**)&sample->srvHeap);
-		if (FAILED(hr)) LogErrAndExit(hr);
-
+		// The shader resource view (SRV) descriptor heap is sized by the models, in LoadAssets.
 		sample->srvDescriptorSize = ID3D12Device2_GetDescriptorHandleIncrementSize(sample->device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	}
 
@@ -468,6 +645,36 @@ static void LoadPipeline(DXSample* const sample)
 		hr = ID3D12Resource_Map(sample->constantBuffer, 0, &readRange, (void**) &sample->constantData);
 		if (FAILED(hr)) LogErrAndExit(hr);
 	}
+
+	// Create the timestamp queries, two per frame in flight, resolved into a readback buffer.
+	{
+		const D3D12_QUERY_HEAP_DESC timestampHeapDesc = {
+			.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP,
+			.Count = 2 * FrameCount,
+			.NodeMask = 0,
+		};
+		hr = ID3D12Device2_CreateQueryHeap(sample->device, &timestampHeapDesc, &IID_ID3D12QueryHeap, (void**)&sample->timestampHeap);
+		if (FAILED(hr)) LogErrAndExit(hr);
+
+		const D3D12_HEAP_PROPERTIES readbackHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+		const D3D12_RESOURCE_DESC readbackDesc = CD3DX12_RESOURCE_DESC_BUFFER(2 * FrameCount * sizeof(UINT64), D3D12_RESOURCE_FLAG_NONE, 0);
+		hr = ID3D12Device2_CreateCommittedResource(sample->device,
+			&readbackHeapProps,
+			D3D12_HEAP_FLAG_NONE,
+			&readbackDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			NULL,
+			&IID_ID3D12Resource,
+			(void**)&sample->timestampReadback);
+		if (FAILED(hr)) LogErrAndExit(hr);
+
+		// Kept mapped like the constant buffer: a frame only reads the slots of a frame the fence has passed.
+		hr = ID3D12Resource_Map(sample->timestampReadback, 0, NULL, (void**)&sample->timestamps);
+		if (FAILED(hr)) LogErrAndExit(hr);
+
+		hr = ID3D12CommandQueue_GetTimestampFrequency(sample->commandQueue, &sample->timestampFrequency);
+		if (FAILED(hr)) LogErrAndExit(hr);
+	}
 	RELEASE(factory);
 }
 
@@ -495,9 +702,16 @@ static void LoadAssets(DXSample* const sample)
 			uint32_t size;
 		} ampShader, meshShader, pixelShader;
 
-		/* Load pre-compiled shaders */
-		LoadShaderData(sample->currentPath, c_ampShaderFilename, &ampShader.data, &ampShader.size);
-		LoadShaderData(sample->currentPath, c_meshShaderFilename, &meshShader.data, &meshShader.size);
+		/* Load pre-compiled shaders, built for the meshlet pipeline */
+		SelectMeshletPipeline(sample);
+		const MeshletPipeline* pipeline = &sample->meshletPipeline;
+
+		wchar_t ampShaderFilename[64];
+		wchar_t meshShaderFilename[64];
+		swprintf(ampShaderFilename, _countof(ampShaderFilename), c_ampShaderFilename, pipeline->Limits.MaxVerts, pipeline->Limits.MaxPrims, pipeline->WaveSize);
+		swprintf(meshShaderFilename, _countof(meshShaderFilename), c_meshShaderFilename, pipeline->Limits.MaxVerts, pipeline->Limits.MaxPrims, pipeline->WaveSize);
+		LoadShaderData(sample->currentPath, ampShaderFilename, &ampShader.data, &ampShader.size);
+		LoadShaderData(sample->currentPath, meshShaderFilename, &meshShader.data, &meshShader.size);
 		LoadShaderData(sample->currentPath, c_pixelShaderFilename, &pixelShader.data, &pixelShader.size);
 
 		// Pull root signature from the precompiled mesh shader.
@@ -549,14 +763,149 @@ static void LoadAssets(DXSample* const sample)
 		if (FAILED(hr)) LogErrAndExit(hr);
 	}
 
-	for (uint32_t i = 0; i < LodsCount; ++i)
+	// Load the LOD chain of every scene model, or the default model for the instance cube.
+	sample->modelCount = sample->sceneOpen ? sample->sceneStream.header.ModelCount : 1;
+	sample->models = calloc(sample->modelCount, sizeof(LodModel));
+	sample->lodErrors = calloc(sample->modelCount, sizeof(LodErrorChain));
+	if (!sample->models || !sample->lodErrors) LogErrAndExit(E_OUTOFMEMORY);
+
+	sample->meshCount = 0;
+	for (uint32_t i = 0; i < sample->modelCount; ++i)
+	{
+		LodModel* model = &sample->models[i];
+		LoadLodModel(sample, model, sample->sceneOpen ? sample->sceneStream.models[i].Name : c_defaultModel);
+		MeasureLodErrors(model, &sample->lodErrors[i]);
+
+		model->firstMesh = sample->meshCount;
+		sample->meshCount += model->lodCount;
+	}
+
+	CreateMeshTable(sample);
+	CreateMeshDescriptors(sample);
+
+	// Create synchronization objects and wait until assets have been uploaded to the GPU.
+	{
+		HRESULT hr = ID3D12Device2_CreateFence(sample->device, 0, D3D12_FENCE_FLAG_NONE, &IID_ID3D12Fence, (void**)&sample->fence);
+		if (FAILED(hr)) LogErrAndExit(hr);
+		sample->fenceValues[sample->frameIndex]++;
+
+		// Create an event handle to use for frame synchronization.
+		sample->fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if (sample->fenceEvent == NULL)
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			if (FAILED(hr)) LogErrAndExit(hr);
+		}
+
+		// Wait for the command list to execute; we are reusing the same command 
+		// list in our main loop but for now, we just want to wait for setup to 
+		// complete before continuing.
+		WaitForGpu(sample);
+	}
+}
+
+// Picks the shaders to draw with: the default limits at the device's wave size, unless the benchmark
+// profile names another compiled pipeline for that wave size.
+static void SelectMeshletPipeline(DXSample* const sample)
+{
+	// The amplification shader runs as a single wave, so its group can only be as wide as the narrowest wave.
+	D3D12_FEATURE_DATA_D3D12_OPTIONS1 options = {0};
+	HRESULT hr = ID3D12Device2_CheckFeatureSupport(sample->device, D3D12_FEATURE_D3D12_OPTIONS1, &options, sizeof(options));
+	const uint32_t waveSize = SUCCEEDED(hr) && options.WaveLaneCountMin >= 64 ? 64 : THREADS_PER_WAVE;
+
+	MeshletPipeline wanted = { { MAX_VERTS, MAX_PRIMS }, waveSize };
+
+	wchar_t profilePath[_countof(sample->currentPath) + 32];
+	swprintf(profilePath, _countof(profilePath), L"%s%s", sample->currentPath, c_meshletProfileFilename);
+	FILE* profile = _wfopen(profilePath, L"r");
+	if (profile)
 	{
-		Model *lod = &sample->lods[i];
-		// Load and upload model resources to the GPU
-	    // Just use the D3D12_COMMAND_LIST_TYPE_DIRECT queue since it's a one-and-done operation. 
-	    // For per-frame uploads consider using the D3D12_COMMAND_LIST_TYPE_COPY command queue.
-		HRESULT hr = Model_LoadFromFile(lod, sample->currentPath, c_lodFilenames[i]);
+		MeshletPipeline measured;
+		if (fscanf(profile, "%u %u %u", &measured.Limits.MaxVerts, &measured.Limits.MaxPrims, &measured.WaveSize) == 3 &&
+			measured.WaveSize == waveSize)
+		{
+			wanted = measured;
+		}
+		fclose(profile);
+	}
+
+	sample->meshletPipeline = (MeshletPipeline){ { MAX_VERTS, MAX_PRIMS }, waveSize };
+	for (uint32_t i = 0; i < _countof(c_meshletPipelines); ++i)
+	{
+		const MeshletPipeline* p = &c_meshletPipelines[i];
+		if (p->Limits.MaxVerts == wanted.Limits.MaxVerts && p->Limits.MaxPrims == wanted.Limits.MaxPrims && p->WaveSize == wanted.WaveSize)
+		{
+			sample->meshletPipeline = *p;
+		}
+	}
+
+	char message[96];
+	sprintf_s(message, sizeof(message), "Meshlet pipeline: %u vertices, %u primitives, wave %u\n",
+		sample->meshletPipeline.Limits.MaxVerts, sample->meshletPipeline.Limits.MaxPrims, sample->meshletPipeline.WaveSize);
+	OutputDebugStringA(message);
+}
+
+// Loads "<name>_LOD0.bin", "<name>_LOD1.bin"... until one is missing, merges their vertices into one
+// pool, and uploads them to the GPU.
+static void LoadLodModel(DXSample* const sample, LodModel* const model, const char* const name)
+{
+	model->lodCount = 0;
+	for (uint32_t i = 0; i < MAX_LOD_LEVELS; ++i)
+	{
+		wchar_t assetPath[SCENE_MODEL_NAME_SIZE + 16];
+		swprintf(assetPath, _countof(assetPath), L"%hs_LOD%u.bin", name, i);
+
+		wchar_t fullPath[_countof(sample->currentPath) + _countof(assetPath)];
+		swprintf(fullPath, _countof(fullPath), L"%s%s", sample->currentPath, assetPath);
+		if (GetFileAttributesW(fullPath) == INVALID_FILE_ATTRIBUTES)
+		{
+			break;
+		}
+
+		Model *lod = &model->lods[i];
+		HRESULT hr = Model_LoadFromFile(lod, sample->currentPath, assetPath);
 		if(FAILED(hr)) LogErrAndExit(hr);
+		// Only the meshlet variant the pipeline draws is uploaded, next to the single copy of the vertices.
+		if (!Model_SelectMeshletVariant(lod, sample->meshletPipeline.Limits)) LogErrAndExit(E_FAIL);
+		++model->lodCount;
+	}
+
+	// A model needs at least its LOD 0.
+	if (model->lodCount == 0) LogErrAndExit(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+
+	// Simplified LODs mostly keep vertices of the finer ones: resident vertices then approach those of LOD 0 alone.
+	// Chains of another layout keep a buffer per LOD, unless some of their files rely on the pool.
+	uint32_t lodVertexCount = 0;
+	bool needsPool = false;
+	for (uint32_t i = 0; i < model->lodCount; ++i)
+	{
+		for (int j = 0; j < model->lods[i].nMeshes; ++j)
+		{
+			lodVertexCount += model->lods[i].meshes[j].VertexCount;
+			needsPool |= model->lods[i].meshes[j].SharedVertices;
+		}
+	}
+
+	HRESULT hr = Model_ShareVertices(model->lods, model->lodCount, &model->vertexPool);
+	if (SUCCEEDED(hr))
+	{
+		char message[SCENE_MODEL_NAME_SIZE + 96];
+		sprintf_s(message, sizeof(message), "%s: %u LODs share %u vertices, down from %u\n",
+			name, model->lodCount, model->vertexPool.vertexCount, lodVertexCount);
+		OutputDebugStringA(message);
+	}
+	else
+	{
+		VertexPool_Destroy(&model->vertexPool);
+		if (hr != E_INVALIDARG || needsPool) LogErrAndExit(hr);
+	}
+
+	for (uint32_t i = 0; i < model->lodCount; ++i)
+	{
+		Model *lod = &model->lods[i];
+		// Upload model resources to the GPU, LOD 0 first as it holds the vertex pool.
+		// Just use the D3D12_COMMAND_LIST_TYPE_DIRECT queue since it's a one-and-done operation. 
+		// For per-frame uploads consider using the D3D12_COMMAND_LIST_TYPE_COPY command queue.
 		hr = Model_UploadGpuResources(lod, sample->device, sample->commandQueue, sample->commandAllocators[sample->frameIndex], sample->commandList);
 		if (FAILED(hr)) LogErrAndExit(hr);
 #ifdef _DEBUG
@@ -582,122 +931,159 @@ static void LoadAssets(DXSample* const sample)
 		}
 #endif
 	}
-	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle;
-	ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(sample->srvHeap, &srvHandle);
-	
-	// Populate descriptor table with arrays of SRVs for each LOD
-	for (uint32_t i = 0; i < LodsCount; ++i)
-	{
-		Mesh* mesh = &sample->lods[i].meshes[0];
-		// Mesh Info Buffers
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {
-			.BufferLocation = ID3D12Resource_GetGPUVirtualAddress(mesh->MeshInfoResource),
-			.SizeInBytes = AlignU32(sizeof(MeshInfo)),
-		};
-		ID3D12Device2_CreateConstantBufferView(
-			sample->device, 
-			&cbvDesc, 
-			OffsetDescHandle(srvHandle, SRV_MeshInfoLODs + i, sample->srvDescriptorSize)
-		);
-		
-		// Populate common shader resource view desc with shared settings.
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
-			.Format = DXGI_FORMAT_UNKNOWN,
-			.ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
-			.Buffer.FirstElement = 0,
-			.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-		};
+}
 
+// Geometric error of each LOD for the CPU LOD selector: from the files, or else measured against LOD 0.
+static void MeasureLodErrors(const LodModel* const model, LodErrorChain* const chain)
+{
+	const MeshletMesh reference = Mesh_GetMeshletView(&model->lods[0].meshes[0]);
 
-		// Vertices
-		srvDesc.Buffer = (D3D12_BUFFER_SRV){
-			.StructureByteStride = mesh->VertexStrides[0], // We assume we'll only use the first vertex buffer
-			.NumElements = mesh->VertexCount,
-		};
-		ID3D12Device2_CreateShaderResourceView(
-			sample->device,
-			mesh->VertexResources[0],
-			&srvDesc, 
-			OffsetDescHandle(srvHandle, SRV_VertexLODs + i, sample->srvDescriptorSize)
-		);
+	float errors[MAX_LOD_LEVELS];
+	for (uint32_t i = 0; i < model->lodCount; ++i)
+	{
+		const Mesh* mesh = &model->lods[i].meshes[0];
+		if (mesh->GeometricError >= 0.0f || i == 0)
+		{
+			errors[i] = mesh->GeometricError > 0.0f ? mesh->GeometricError : 0.0f;
+			continue;
+		}
 
-		// Meshlets
-		srvDesc.Buffer.StructureByteStride = sizeof(Meshlet);
-		srvDesc.Buffer.NumElements = mesh->Meshlets.count;
-		ID3D12Device2_CreateShaderResourceView(
-			sample->device, 
-			mesh->MeshletResource, 
-			&srvDesc, 
-			OffsetDescHandle(srvHandle, SRV_MeshletLODs + i, sample->srvDescriptorSize)
-		);
+		const MeshletMesh view = Mesh_GetMeshletView(mesh);
+		errors[i] = LodError_Estimate(&reference, &view);
+		if (errors[i] < 0.0f) LogErrAndExit(E_OUTOFMEMORY);
+	}
+	LodErrorChain_Init(chain, errors, model->lodCount, model->lods[0].boundingSphere.r);
+}
 
+// Writes the MeshDesc of every mesh and the ModelDesc of every model into an upload buffer the
+// shaders read directly: it is small and never changes.
+static void CreateMeshTable(DXSample* const sample)
+{
+	const UINT64 meshesSize = (UINT64)sample->meshCount * sizeof(MeshDesc);
+	const UINT64 tableSize = meshesSize + (UINT64)sample->modelCount * sizeof(ModelDesc);
+
+	const D3D12_HEAP_PROPERTIES meshTableHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	const D3D12_RESOURCE_DESC meshTableDesc = CD3DX12_RESOURCE_DESC_BUFFER(tableSize, D3D12_RESOURCE_FLAG_NONE, 0);
+	HRESULT hr = ID3D12Device2_CreateCommittedResource(sample->device,
+		&meshTableHeapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&meshTableDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		NULL,
+		&IID_ID3D12Resource,
+		(void**)(&sample->meshTable)
+	);
+	if (FAILED(hr)) LogErrAndExit(hr);
 
-		// Primitive Indices
-		srvDesc.Buffer.StructureByteStride = sizeof(uint32_t);
-		srvDesc.Buffer.NumElements = mesh->IndexCount / 3;
-		ID3D12Device2_CreateShaderResourceView(
-			sample->device,
-			mesh->PrimitiveIndexResource, 
-			&srvDesc, 
-			OffsetDescHandle(srvHandle, SRV_PrimitiveIndexLODs + i, sample->srvDescriptorSize)
-		);
+	uint8_t* tableData = NULL;
+	D3D12_RANGE readRange = { 0, 0 }; // We do not intend to read from this resource on the CPU.
+	hr = ID3D12Resource_Map(sample->meshTable, 0, &readRange, (void**)&tableData);
+	if (FAILED(hr)) LogErrAndExit(hr);
 
-		// Unique Vertex Indices
-		srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		srvDesc.Buffer.StructureByteStride = 0;
-		srvDesc.Buffer.NumElements = DivRoundUp_uint32(mesh->UniqueVertexIndices.count, 4);
-		srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-		ID3D12Device2_CreateShaderResourceView(
-			sample->device,
-			mesh->UniqueVertexIndexResource,
-			&srvDesc,
-			OffsetDescHandle(srvHandle, SRV_UniqueVertexIndexLODs + i, sample->srvDescriptorSize)
-		);
-	}
+	sample->modelDescs = malloc(sample->modelCount * sizeof(ModelDesc));
+	if (!sample->modelDescs) LogErrAndExit(E_OUTOFMEMORY);
 
-	// Null-out remaining LOD slots in the descriptor table.
-	for (uint32_t i = LodsCount; i < MAX_LOD_LEVELS; ++i)
+	MeshDesc* meshDescs = (MeshDesc*)tableData;
+	for (uint32_t i = 0; i < sample->modelCount; ++i)
 	{
-		ID3D12Device2_CreateConstantBufferView(sample->device, NULL, OffsetDescHandle(srvHandle, SRV_MeshInfoLODs + i, sample->srvDescriptorSize));
+		const LodModel* model = &sample->models[i];
+		for (uint32_t lod = 0; lod < model->lodCount; ++lod)
+		{
+			const Mesh* mesh = &model->lods[lod].meshes[0];
+			meshDescs[model->firstMesh + lod] = (MeshDesc){
+				.IndexBytes = mesh->IndexSize,
+				.MeshletCount = (uint32_t)mesh->Meshlets.count,
+				.LastMeshletVertCount = SPAN_BACK(mesh->Meshlets).VertCount,
+				.LastMeshletPrimCount = SPAN_BACK(mesh->Meshlets).PrimCount,
+				.LOD = lod,
+				.LODCount = model->lodCount,
+			};
+		}
 
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
-			.Format = DXGI_FORMAT_UNKNOWN,
-			.ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
-			.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-			.Buffer.StructureByteStride = 24,
+		sample->modelDescs[i] = (ModelDesc){
+			.FirstMesh = model->firstMesh,
+			.LODCount = model->lodCount,
 		};
-		ID3D12Device2_CreateShaderResourceView(sample->device, NULL, &srvDesc, OffsetDescHandle(srvHandle, SRV_VertexLODs + i, sample->srvDescriptorSize));
+	}
+	memcpy(tableData + meshesSize, sample->modelDescs, sample->modelCount * sizeof(ModelDesc));
 
-		srvDesc.Buffer.StructureByteStride = sizeof(Meshlet);
-		ID3D12Device2_CreateShaderResourceView(sample->device, NULL, &srvDesc, OffsetDescHandle(srvHandle, SRV_MeshletLODs + i, sample->srvDescriptorSize));
+	ID3D12Resource_Unmap(sample->meshTable, 0, NULL);
+}
 
-		srvDesc.Buffer.StructureByteStride = sizeof(uint32_t);
-		ID3D12Device2_CreateShaderResourceView(sample->device, NULL, &srvDesc, OffsetDescHandle(srvHandle, SRV_PrimitiveIndexLODs + i, sample->srvDescriptorSize));
+// Creates the SRV heap and fills the bindless tables: descriptor Table_* * meshCount + mesh.
+static void CreateMeshDescriptors(DXSample* const sample)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {
+		.NumDescriptors = Table_Count * sample->meshCount,
+		.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+		.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+	};
+	HRESULT hr = ID3D12Device2_CreateDescriptorHeap(sample->device, &srvHeapDesc, &IID_ID3D12DescriptorHeap, (void**)&sample->srvHeap);
+	if (FAILED(hr)) LogErrAndExit(hr);
 
-		srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		srvDesc.Buffer.StructureByteStride = 0;
-		srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-		ID3D12Device2_CreateShaderResourceView(sample->device, NULL, &srvDesc, OffsetDescHandle(srvHandle, SRV_UniqueVertexIndexLODs + i, sample->srvDescriptorSize));
-	}
+	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle;
+	ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(sample->srvHeap, &srvHandle);
 
-	// Create synchronization objects and wait until assets have been uploaded to the GPU.
+	for (uint32_t m = 0; m < sample->modelCount; ++m)
 	{
-		HRESULT hr = ID3D12Device2_CreateFence(sample->device, 0, D3D12_FENCE_FLAG_NONE, &IID_ID3D12Fence, (void**)&sample->fence);
-		if (FAILED(hr)) LogErrAndExit(hr);
-		sample->fenceValues[sample->frameIndex]++;
-
-		// Create an event handle to use for frame synchronization.
-		sample->fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-		if (sample->fenceEvent == NULL)
+		const LodModel* model = &sample->models[m];
+		for (uint32_t lod = 0; lod < model->lodCount; ++lod)
 		{
-			hr = HRESULT_FROM_WIN32(GetLastError());
-			if (FAILED(hr)) LogErrAndExit(hr);
+			const Mesh* mesh = &model->lods[lod].meshes[0];
+			const uint32_t meshIndex = model->firstMesh + lod;
+
+			// Populate common shader resource view desc with shared settings.
+			D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
+				.Format = DXGI_FORMAT_UNKNOWN,
+				.ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
+				.Buffer.FirstElement = 0,
+				.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+			};
+
+			// Vertices
+			srvDesc.Buffer = (D3D12_BUFFER_SRV){
+				.StructureByteStride = mesh->VertexStrides[0], // We assume we'll only use the first vertex buffer
+				.NumElements = mesh->VertexCount,
+			};
+			ID3D12Device2_CreateShaderResourceView(
+				sample->device,
+				mesh->VertexResources[0],
+				&srvDesc,
+				OffsetDescHandle(srvHandle, Table_Vertices * sample->meshCount + meshIndex, sample->srvDescriptorSize)
+			);
+
+			// Meshlets
+			srvDesc.Buffer.StructureByteStride = sizeof(Meshlet);
+			srvDesc.Buffer.NumElements = mesh->Meshlets.count;
+			ID3D12Device2_CreateShaderResourceView(
+				sample->device,
+				mesh->MeshletResource,
+				&srvDesc,
+				OffsetDescHandle(srvHandle, Table_Meshlets * sample->meshCount + meshIndex, sample->srvDescriptorSize)
+			);
+
+			// Primitive Indices
+			srvDesc.Buffer.StructureByteStride = sizeof(uint32_t);
+			srvDesc.Buffer.NumElements = mesh->IndexCount / 3;
+			ID3D12Device2_CreateShaderResourceView(
+				sample->device,
+				mesh->PrimitiveIndexResource,
+				&srvDesc,
+				OffsetDescHandle(srvHandle, Table_PrimitiveIndices * sample->meshCount + meshIndex, sample->srvDescriptorSize)
+			);
+
+			// Unique Vertex Indices
+			srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+			srvDesc.Buffer.StructureByteStride = 0;
+			srvDesc.Buffer.NumElements = DivRoundUp_uint32(mesh->UniqueVertexIndices.count, 4);
+			srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+			ID3D12Device2_CreateShaderResourceView(
+				sample->device,
+				mesh->UniqueVertexIndexResource,
+				&srvDesc,
+				OffsetDescHandle(srvHandle, Table_UniqueVertexIndices * sample->meshCount + meshIndex, sample->srvDescriptorSize)
+			);
 		}
-
-		// Wait for the command list to execute; we are reusing the same command 
-		// list in our main loop but for now, we just want to wait for setup to 
-		// complete before continuing.
-		WaitForGpu(sample);
 	}
 }
 
@@ -715,25 +1101,20 @@ static void PopulateCommandList(DXSample* const sample)
 	// re-recording
 	hr = ID3D12GraphicsCommandList_Reset(sample->commandList, sample->commandAllocators[sample->frameIndex], sample->pipelineState);
 	if (FAILED(hr)) LogErrAndExit(hr);
+	ID3D12GraphicsCommandList_EndQuery(sample->commandList, sample->timestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * sample->frameIndex);
+	FrameStats* const stats = sample->frameStats.current;
+	++stats->PsoChanges;
 
-	// Only upload instance data if we've had a change
-	if (sample->updateInstances)
+	// Only upload instance data if we've had a change, from the CPU copy a streamed scene does not have
+	if (sample->instances && !DirtyRanges_IsEmpty(&sample->instanceDirty))
 	{
-		const D3D12_RESOURCE_BARRIER toCopyBarrier = CD3DX12_Transition(sample->instanceBuffer,
-			D3D12_RESOURCE_STATE_GENERIC_READ, 
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-			D3D12_RESOURCE_BARRIER_FLAG_NONE);
-		ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &toCopyBarrier);
-		ID3D12GraphicsCommandList_CopyResource(sample->commandList, sample->instanceBuffer, sample->instanceUpload);
-		
-		const D3D12_RESOURCE_BARRIER toGenericBarrier = CD3DX12_Transition(sample->instanceBuffer,
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-			D3D12_RESOURCE_BARRIER_FLAG_NONE);
-		ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &toGenericBarrier);
-		sample->updateInstances = false;
+		UploadDirtyInstances(sample);
+	}
+
+	// Copy the instances the scene loader has finished since the last frame
+	if (sample->sceneOpen)
+	{
+		StreamSceneInstances(sample);
 	}
 
 	// Set necessary state
@@ -765,29 +1146,37 @@ static void PopulateCommandList(DXSample* const sample)
 	ID3D12GraphicsCommandList_ClearDepthStencilView(sample->commandList, dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, NULL);
 	ID3D12GraphicsCommandList_SetGraphicsRootConstantBufferView(
 		sample->commandList, 
-		0, 
+		Root_Constants, 
 		ID3D12Resource_GetGPUVirtualAddress(sample->constantBuffer) + sizeof(Constants) * sample->frameIndex
 	);
-	D3D12_GPU_DESCRIPTOR_HANDLE srvHeapGPUDescHandle;
-	ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(sample->srvHeap, &srvHeapGPUDescHandle);
-	ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(sample->commandList, 2, srvHeapGPUDescHandle);
-	D3D12_GPU_VIRTUAL_ADDRESS instanceBufferGPUVirtualAddress = ID3D12Resource_GetGPUVirtualAddress(sample->instanceBuffer);
 	ID3D12GraphicsCommandList_SetGraphicsRootShaderResourceView(
 		sample->commandList, 
-		3, 
+		Root_Instances, 
 		ID3D12Resource_GetGPUVirtualAddress(sample->instanceBuffer)
 	);
+	const D3D12_GPU_VIRTUAL_ADDRESS meshTableAddress = ID3D12Resource_GetGPUVirtualAddress(sample->meshTable);
+	ID3D12GraphicsCommandList_SetGraphicsRootShaderResourceView(sample->commandList, Root_Meshes, meshTableAddress);
+	ID3D12GraphicsCommandList_SetGraphicsRootShaderResourceView(sample->commandList, Root_Models,
+		meshTableAddress + (UINT64)sample->meshCount * sizeof(MeshDesc));
 
-	uint32_t dispatchCount = DivRoundUp_uint32(sample->instanceCount, c_maxGroupDispatchCount);
+	D3D12_GPU_DESCRIPTOR_HANDLE srvHeapGPUDescHandle;
+	ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(sample->srvHeap, &srvHeapGPUDescHandle);
+	for (uint32_t table = 0; table < Table_Count; ++table)
+	{
+		const D3D12_GPU_DESCRIPTOR_HANDLE tableHandle = {
+			.ptr = srvHeapGPUDescHandle.ptr + (UINT64)table * sample->meshCount * sample->srvDescriptorSize
+		};
+		ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(sample->commandList, Root_Vertices + table, tableHandle);
+	}
 
-	for (uint32_t i = 0; i < dispatchCount; ++i)
+	for (uint32_t i = 0; i < sample->dispatchPlan.batchCount; ++i)
 	{
-		uint32_t offset = dispatchCount * i;
-		uint32_t count = min(sample->instanceCount - offset, c_maxGroupDispatchCount);
-		ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstant(sample->commandList, 1, offset, 0);
-		ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstant(sample->commandList, 1, count, 1);
-		ID3D12GraphicsCommandList6_DispatchMesh(sample->commandList, count, 1, 1);
+		const DispatchBatch* batch = &sample->dispatchPlan.batches[i];
+		ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstants(sample->commandList, Root_DrawParams, sizeof(DrawParams) / sizeof(uint32_t), &batch->Params, 0);
+		ID3D12GraphicsCommandList6_DispatchMesh(sample->commandList, batch->GroupCount, 1, 1);
 	}
+	stats->InstancesSubmitted = sample->instanceCount;
+	stats->DrawCalls += sample->dispatchPlan.batchCount;
 
 	D3D12_RESOURCE_BARRIER toPresentBarrier = CD3DX12_Transition(sample->renderTargets[sample->frameIndex],
 		D3D12_RESOURCE_STATE_RENDER_TARGET,
@@ -797,6 +1186,9 @@ static void PopulateCommandList(DXSample* const sample)
 
 	// Indicate that the back buffer will now be used to present
 	ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &toPresentBarrier);
+	ID3D12GraphicsCommandList_EndQuery(sample->commandList, sample->timestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * sample->frameIndex + 1);
+	ID3D12GraphicsCommandList_ResolveQueryData(sample->commandList, sample->timestampHeap, D3D12_QUERY_TYPE_TIMESTAMP,
+		2 * sample->frameIndex, 2, sample->timestampReadback, 2 * sample->frameIndex * sizeof(UINT64));
 	hr = ID3D12GraphicsCommandList_Close(sample->commandList);
 	if (FAILED(hr)) LogErrAndExit(hr);
 }
@@ -819,14 +1211,6 @@ static D3D12_CPU_DESCRIPTOR_HANDLE OffsetDescHandle(D3D12_CPU_DESCRIPTOR_HANDLE
 	};
 };
 
-// aligns a given UINT32 value to the D3D12 constant buffer alignment requirement,
-// rounding size up to the next multiple of alignment
-static UINT32 AlignU32(UINT32 size) {
-	const UINT32 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
-	const UINT32 alignedSize = (size + alignment - 1) & ~(alignment - 1);
-	return alignedSize;
-}
-
 // aligns a given UINT64 value to the D3D12 constant buffer alignment requirement,
 // rounding size up to the next multiple of alignment
 static UINT64  AlignU64(UINT64 size) {
@@ -871,50 +1255,39 @@ static void MoveToNextFrame(DXSample* sample)
 
 	// Set the fence value for the next frame.
 	sample->fenceValues[sample->frameIndex] = currentFenceValue + 1;
+
+	// Drop the resources retired by the frames that have completed.
+	ReleaseQueue_Collect(&sample->releaseQueue, ID3D12Fence_GetCompletedValue(sample->fence));
 }
 
 static void RegenerateInstances(DXSample* sample)
 {
-	sample->updateInstances = true;
-
-	const float radius = sample->lods[0].boundingSphere.r;
-	const float padding = 0.5f;
-	const float spacing = (1.0f + padding) * radius;
-
-	// Create the instances in a growing cube volume
-	const uint32_t width = sample->instanceLevel * 2 + 1;
-	const float extents = spacing * sample->instanceLevel;
-
-	sample->instanceCount = width * width * width;
+	sample->instanceCount = SceneGen_CubeCount(sample->instanceLevel);
 
 	const UINT64 instanceBufferSize = AlignU64(sample->instanceCount * sizeof(Instance));
 
-	// Only recreate instance-sized buffers if necessary.
-	if (!sample->instanceBuffer || InstanceBufferWidth(sample->instanceBuffer) < instanceBufferSize)
+	// Only recreate instance-sized buffers if necessary. A streamed scene has no upload regions.
+	// The frames in flight keep reading the old buffers until they complete, see RetireResource.
+	if (!sample->instanceUpload || InstanceBufferWidth(sample->instanceBuffer) < instanceBufferSize)
 	{
-		WaitForGpu(sample);
-		const D3D12_HEAP_PROPERTIES instanceBufferDefaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-		const D3D12_RESOURCE_DESC instanceBufferDesc = CD3DX12_RESOURCE_DESC_BUFFER(instanceBufferSize, D3D12_RESOURCE_FLAG_NONE, 0);
+		if (sample->sceneOpen)
+		{
+			CloseScene(sample);
+		}
+		RetireResource(sample, &sample->instanceUpload);
 
-		// Create/re-create the instance buffer
-		HRESULT hr = ID3D12Device2_CreateCommittedResource(sample->device,
-			&instanceBufferDefaultHeapProps,
-			D3D12_HEAP_FLAG_NONE,
-			&instanceBufferDesc,
-			D3D12_RESOURCE_STATE_COMMON,
-			NULL,
-			&IID_ID3D12Resource,
-			(void**)(&sample->instanceBuffer)
-		);
-		if(FAILED(hr)) LogErrAndExit(hr);
+		CreateInstanceBuffer(sample, instanceBufferSize);
 
+		// The upload buffer holds one region per frame in flight, so the CPU only ever writes
+		// the region of the current frame, which the fence in MoveToNextFrame has already freed.
 		const D3D12_HEAP_PROPERTIES instanceBufferUploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		const D3D12_RESOURCE_DESC instanceUploadDesc = CD3DX12_RESOURCE_DESC_BUFFER(instanceBufferSize * FrameCount, D3D12_RESOURCE_FLAG_NONE, 0);
 
-		// Create/re-create the instance buffer
-		hr = ID3D12Device2_CreateCommittedResource(sample->device,
+		// Create/re-create the instance upload buffer
+		HRESULT hr = ID3D12Device2_CreateCommittedResource(sample->device,
 			&instanceBufferUploadHeapProps,
 			D3D12_HEAP_FLAG_NONE,
-			&instanceBufferDesc,
+			&instanceUploadDesc,
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			NULL,
 			&IID_ID3D12Resource,
@@ -922,31 +1295,299 @@ static void RegenerateInstances(DXSample* sample)
 		);
 		if (FAILED(hr)) LogErrAndExit(hr);
 		
-		ID3D12Resource_Map(sample->instanceUpload, 0, NULL, (void**)&sample->instanceData);
+		D3D12_RANGE readRange = { 0, 0 }; // We do not intend to read from this resource on the CPU.
+		hr = ID3D12Resource_Map(sample->instanceUpload, 0, &readRange, (void**)&sample->instanceUploadData);
+		if (FAILED(hr)) LogErrAndExit(hr);
+		sample->instanceRegionSize = instanceBufferSize;
+
+		Instance* instances = realloc(sample->instances, instanceBufferSize);
+		if (!instances) LogErrAndExit(E_OUTOFMEMORY);
+		sample->instances = instances;
+	}
+
+	// Regenerate the instances in our scene. They carry no LOD until the next update selects them.
+	SceneGen_Generate(sample->instances, sample->sceneLayout, sample->instanceLevel, sample->models[0].lods[0].boundingSphere.r, c_sceneSeed);
+	if (!LodSelector_Reset(&sample->lodSelector, sample->instanceCount)) LogErrAndExit(E_OUTOFMEMORY);
+
+	// Group them by LOD for the current camera. The order only affects performance, so a failed
+	// sort just keeps the generator's order.
+	Constants constants;
+	BuildFrameConstants(sample, &constants);
+	InstanceSort_ByModelLod(&sample->instanceSort, sample->instances, sample->instanceCount, &constants, sample->modelDescs, sample->modelCount);
+	sample->gridStale = true;
+
+	DirtyRanges_Clear(&sample->instanceDirty);
+	DirtyRanges_Add(&sample->instanceDirty, 0, sample->instanceCount);
+
+	BuildDispatchPlan(sample);
+
+	if (sample->animate)
+	{
+		StartAnimation(sample);
+	}
+}
+
+// Animates the instances from where they are, on one worker per core beside the main thread.
+static void StartAnimation(DXSample* const sample)
+{
+	if (!sample->animation.jobs)
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		if (!JobSystem_Init(&sample->jobs, info.dwNumberOfProcessors > 1 ? info.dwNumberOfProcessors - 1 : 0)) LogErrAndExit(E_FAIL);
+		InstanceAnimation_Init(&sample->animation, &sample->jobs);
+	}
+
+	const float speed = c_animationSpeed * sample->models[0].lods[0].boundingSphere.r;
+	if (!InstanceAnimation_Start(&sample->animation, sample->instances, sample->instanceCount, speed, 1)) LogErrAndExit(E_OUTOFMEMORY);
+}
+
+// Work time of the last frames without the wait for vsync: the CPU time of the last one, or the GPU time of the
+// commands of the last one on this frame index, which MoveToNextFrame has waited for, if longer.
+static double FrameWorkMs(const DXSample* const sample)
+{
+	const UINT64* const gpu = &sample->timestamps[2 * sample->frameIndex];
+	const double gpuMs = sample->frameCounter > FrameCount && gpu[1] > gpu[0]
+		? (double)(gpu[1] - gpu[0]) * 1000.0 / (double)sample->timestampFrequency : 0.0;
+	return gpuMs > sample->cpuFrameMs ? gpuMs : sample->cpuFrameMs;
+}
+
+// View constants of the camera, as the shaders get them this frame.
+static void BuildFrameConstants(const DXSample* const sample, Constants* const constants)
+{
+	ViewConstants_Build(constants,
+		sample->camera.position,
+		sample->camera.lookDirection,
+		sample->camera.upDirection,
+		c_fovy,
+		sample->aspectRatio,
+		1.0f,
+		1e4f);
+
+	constants->RenderMode = sample->renderMode;
+	constants->LODCount = sample->models[0].lodCount;
+	LodBudget_Apply(&sample->lodBudget, constants);
+}
+
+// Creates the default heap instance buffer read by the shaders, retiring the previous one.
+static void CreateInstanceBuffer(DXSample* const sample, UINT64 instanceBufferSize)
+{
+	RetireResource(sample, &sample->instanceBuffer);
+
+	const D3D12_HEAP_PROPERTIES instanceBufferDefaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	const D3D12_RESOURCE_DESC instanceBufferDesc = CD3DX12_RESOURCE_DESC_BUFFER(instanceBufferSize, D3D12_RESOURCE_FLAG_NONE, 0);
+
+	// Create/re-create the instance buffer
+	HRESULT hr = ID3D12Device2_CreateCommittedResource(sample->device,
+		&instanceBufferDefaultHeapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&instanceBufferDesc,
+		D3D12_RESOURCE_STATE_COMMON,
+		NULL,
+		&IID_ID3D12Resource,
+		(void**)(&sample->instanceBuffer)
+	);
+	if(FAILED(hr)) LogErrAndExit(hr);
+}
+
+// Split the draw into dispatches that stay within the threadgroup count limits.
+static void BuildDispatchPlan(DXSample* const sample)
+{
+	// An amplification group may draw any mesh of any model.
+	DispatchLod* dispatchLods = malloc(sample->meshCount * sizeof(DispatchLod));
+	if (!dispatchLods) LogErrAndExit(E_OUTOFMEMORY);
+
+	for (uint32_t m = 0; m < sample->modelCount; ++m)
+	{
+		const LodModel* model = &sample->models[m];
+		for (uint32_t lod = 0; lod < model->lodCount; ++lod)
+		{
+			const Span_Meshlet meshlets = model->lods[lod].meshes[0].Meshlets;
+			dispatchLods[model->firstMesh + lod] = (DispatchLod){
+				.MeshletCount = (uint32_t)meshlets.count,
+				.LastMeshletVertCount = SPAN_BACK(meshlets).VertCount,
+				.LastMeshletPrimCount = SPAN_BACK(meshlets).PrimCount,
+			};
+		}
+	}
+
+	const DispatchGroupLimits limits = { sample->meshletPipeline.WaveSize, sample->meshletPipeline.Limits };
+	const bool built = DispatchPlan_Build(&sample->dispatchPlan, dispatchLods, sample->meshCount, limits, sample->instanceCount);
+	free(dispatchLods);
+	if (!built)
+	{
+		LogErrAndExit(E_FAIL);
+	}
+}
+
+// Writes the modified instances into this frame's upload region and copies only those ranges
+// to the instance buffer.
+static void UploadDirtyInstances(DXSample* const sample)
+{
+	const UINT64 regionOffset = sample->instanceRegionSize * sample->frameIndex;
+	uint8_t* region = sample->instanceUploadData + regionOffset;
+
+	const D3D12_RESOURCE_BARRIER toCopyBarrier = CD3DX12_Transition(sample->instanceBuffer,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+		D3D12_RESOURCE_BARRIER_FLAG_NONE);
+	ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &toCopyBarrier);
+
+	for (uint32_t i = 0; i < sample->instanceDirty.count; ++i)
+	{
+		const DirtyRange* range = &sample->instanceDirty.ranges[i];
+		const UINT64 offset = (UINT64)range->Begin * sizeof(Instance);
+		const UINT64 size = (UINT64)(range->End - range->Begin) * sizeof(Instance);
+
+		memcpy(region + offset, &sample->instances[range->Begin], size);
+		sample->frameStats.current->BytesUploaded += size;
+		ID3D12GraphicsCommandList_CopyBufferRegion(sample->commandList,
+			sample->instanceBuffer,
+			offset,
+			sample->instanceUpload,
+			regionOffset + offset,
+			size);
+	}
+
+	const D3D12_RESOURCE_BARRIER toGenericBarrier = CD3DX12_Transition(sample->instanceBuffer,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+		D3D12_RESOURCE_BARRIER_FLAG_NONE);
+	ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &toGenericBarrier);
+
+	DirtyRanges_Clear(&sample->instanceDirty);
+}
+
+// Starts streaming the instances of the scene file opened by Sample_Init in the background.
+static void LoadScene(DXSample* const sample)
+{
+	const SceneFileHeader* header = &sample->sceneStream.header;
+	const UINT64 instanceBufferSize = AlignU64((UINT64)header->InstanceCount * sizeof(Instance));
+
+	// Streamed instances go from sceneUpload to the instance buffer once: the per-frame upload
+	// regions and the CPU copy of the cube are not needed.
+	RetireResource(sample, &sample->instanceUpload);
+	sample->instanceUploadData = NULL;
+	sample->instanceRegionSize = 0;
+	free(sample->instances);
+	sample->instances = NULL;
+	LodSelector_Reset(&sample->lodSelector, 0);
+	DirtyRanges_Clear(&sample->instanceDirty);
+
+	CreateInstanceBuffer(sample, instanceBufferSize);
+
+	const D3D12_HEAP_PROPERTIES sceneUploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	const D3D12_RESOURCE_DESC sceneUploadDesc = CD3DX12_RESOURCE_DESC_BUFFER(instanceBufferSize, D3D12_RESOURCE_FLAG_NONE, 0);
+	HRESULT hr = ID3D12Device2_CreateCommittedResource(sample->device,
+		&sceneUploadHeapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&sceneUploadDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		NULL,
+		&IID_ID3D12Resource,
+		(void**)(&sample->sceneUpload)
+	);
+	if (FAILED(hr)) LogErrAndExit(hr);
+
+	D3D12_RANGE readRange = { 0, 0 }; // We do not intend to read from this resource on the CPU.
+	hr = ID3D12Resource_Map(sample->sceneUpload, 0, &readRange, (void**)&sample->sceneUploadData);
+	if (FAILED(hr)) LogErrAndExit(hr);
+
+	// As for the cube, the bounding sphere of each model is centered on the instance origin.
+	sample->sceneModelSpheres = malloc(header->ModelCount * sizeof(XMFLOAT4));
+	if (!sample->sceneModelSpheres) LogErrAndExit(E_OUTOFMEMORY);
+	for (uint32_t i = 0; i < header->ModelCount; ++i)
+	{
+		sample->sceneModelSpheres[i] = (XMFLOAT4){ 0.0f, 0.0f, 0.0f, sample->models[i].lods[0].boundingSphere.r };
 	}
 
-	// Regenerate the instances in our scene.
-	for (uint32_t i = 0; i < sample->instanceCount; ++i)
+	if (!SceneStream_Start(&sample->sceneStream, (Instance*)sample->sceneUploadData, sample->sceneModelSpheres))
 	{
-		XMVECTOR index = XMVectorSet((float)(i % width), (float)((i / width) % width), (float)(i / (width * width)), 0);
-		XMVECTOR indexScaled = XM_VEC_SCALE(index, spacing);
-		XMVECTOR extentsVec = XMVectorReplicate(extents);
-		XMVECTOR location = XM_VEC_SUBTRACT(indexScaled, extentsVec);
-		location = XM_VEC_SETW(location, radius);
+		LogErrAndExit(E_FAIL);
+	}
+
+	// Nothing is drawn until the first chunk arrives.
+	sample->instanceCount = 0;
+	sample->sceneCopyFence = 0;
+	BuildDispatchPlan(sample);
+}
+
+// Copies the newly loaded instances to the instance buffer and extends the draw to cover them.
+static void StreamSceneInstances(DXSample* const sample)
+{
+	uint32_t first, count;
+	const SceneStreamStatus status = SceneStream_Poll(&sample->sceneStream, &first, &count);
+	if (status == SceneStreamFailed) LogErrAndExit(E_FAIL);
+
+	if (count != 0)
+	{
+		const D3D12_RESOURCE_BARRIER toCopyBarrier = CD3DX12_Transition(sample->instanceBuffer,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+			D3D12_RESOURCE_BARRIER_FLAG_NONE);
+		ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &toCopyBarrier);
+
+		// The loader never writes a range again once it is published, so the GPU can read it
+		// straight from the upload heap.
+		const UINT64 offset = (UINT64)first * sizeof(Instance);
+		ID3D12GraphicsCommandList_CopyBufferRegion(sample->commandList,
+			sample->instanceBuffer,
+			offset,
+			sample->sceneUpload,
+			offset,
+			(UINT64)count * sizeof(Instance));
+		sample->frameStats.current->BytesUploaded += (UINT64)count * sizeof(Instance);
+
+		const D3D12_RESOURCE_BARRIER toGenericBarrier = CD3DX12_Transition(sample->instanceBuffer,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+			D3D12_RESOURCE_BARRIER_FLAG_NONE);
+		ID3D12GraphicsCommandList_ResourceBarrier(sample->commandList, 1, &toGenericBarrier);
 
-		XMMATRIX world = XM_MAT_TRANSLATION_FROM_VEC(location);
+		sample->instanceCount = first + count;
+		sample->sceneCopyFence = sample->fenceValues[sample->frameIndex];
+		BuildDispatchPlan(sample);
+	}
+	else if (status == SceneStreamDone && ID3D12Fence_GetCompletedValue(sample->fence) >= sample->sceneCopyFence)
+	{
+		// Everything is in the instance buffer and the last copy has executed.
+		CloseScene(sample);
+	}
+}
 
-		Instance *inst = &sample->instanceData[i];
-		world = XM_MAT_TRANSP(world);
-		XM_STORE_FLOAT4X4(&inst->World, world);
+// Stops the loader and retires the staging memory.
+static void CloseScene(DXSample* const sample)
+{
+	SceneStream_Close(&sample->sceneStream);
+	RetireResource(sample, &sample->sceneUpload);
+	sample->sceneUploadData = NULL;
+	free(sample->sceneModelSpheres);
+	sample->sceneModelSpheres = NULL;
+	sample->sceneOpen = false;
+}
 
-		world = XM_MAT_INV(NULL, world);
-		world = XM_MAT_TRANSP(world);
-		XM_STORE_FLOAT4X4(&inst->WorldInvTranspose, world);
-		XM_STORE_FLOAT4(&inst->BoundingSphere, location);
+// Hands a resource the GPU may still be reading to the release queue instead of draining the GPU:
+// it is released once the fence passes the value this frame signals in MoveToNextFrame.
+static void RetireResource(DXSample* const sample, ID3D12Resource** const resource)
+{
+	if (*resource && !ReleaseQueue_Retire(&sample->releaseQueue, *resource, ReleaseComObject, sample->fenceValues[sample->frameIndex]))
+	{
+		// Out of memory for the queue: fall back to waiting for the GPU.
+		WaitForGpu(sample);
+		ReleaseComObject(*resource);
 	}
+	*resource = NULL;
 }
 
+static void ReleaseComObject(void* object)
+{
+	IUnknown* unknown = object;
+	RELEASE(unknown);
+}
 
 static UINT64 InstanceBufferWidth(ID3D12Resource *instanceBuffer) {
 	D3D12_RESOURCE_DESC resourceDesc;
@@ -956,17 +1597,35 @@ static UINT64 InstanceBufferWidth(ID3D12Resource *instanceBuffer) {
 
 static void ReleaseAll(DXSample* const sample)
 {
+	FrameStatsRing_Destroy(&sample->frameStats);
+	if (sample->animation.jobs)
+	{
+		JobSystem_Destroy(&sample->jobs);
+	}
+	InstanceAnimation_Destroy(&sample->animation);
+	sample->animate = false;
 	RELEASE(sample->swapChain);
 	RELEASE(sample->device);
 	for (int i = 0; i < FrameCount; ++i) {
 		RELEASE(sample->renderTargets[i]);
 		RELEASE(sample->commandAllocators[i]);
 	}
-	for (int i = 0; i < LodsCount; ++i) {
-		for (int j = 0; i < sample->lods[i].nMeshes; ++j) {
-			Mesh_Release(&sample->lods[i].meshes[j]);
+	for (uint32_t i = 0; sample->models && i < sample->modelCount; ++i) {
+		for (uint32_t lod = 0; lod < sample->models[i].lodCount; ++lod) {
+			Model* model = &sample->models[i].lods[lod];
+			for (int j = 0; j < model->nMeshes; ++j) {
+				Mesh_Release(&model->meshes[j]);
+			}
 		}
+		VertexPool_Destroy(&sample->models[i].vertexPool);
 	}
+	free(sample->models);
+	sample->models = NULL;
+	free(sample->modelDescs);
+	sample->modelDescs = NULL;
+	free(sample->lodErrors);
+	sample->lodErrors = NULL;
+	RELEASE(sample->meshTable);
 	RELEASE(sample->commandQueue);
 	RELEASE(sample->rootSignature);
 	RELEASE(sample->rtvHeap);
@@ -976,8 +1635,22 @@ static void ReleaseAll(DXSample* const sample)
 	RELEASE(sample->commandList);
 	RELEASE(sample->fence);
 	RELEASE(sample->constantBuffer);
+	RELEASE(sample->timestampHeap);
+	RELEASE(sample->timestampReadback);
+	if (sample->sceneOpen)
+	{
+		CloseScene(sample);
+	}
 	RELEASE(sample->instanceBuffer);
 	RELEASE(sample->instanceUpload);
+	ReleaseQueue_Destroy(&sample->releaseQueue);
+	free(sample->instances);
+	sample->instances = NULL;
+	InstanceSort_Destroy(&sample->instanceSort);
+	DispatchPlan_Release(&sample->dispatchPlan);
+	LodSelector_Destroy(&sample->lodSelector);
+	SpatialGrid_Destroy(&sample->spatialGrid);
+	SpatialGridResults_Release(&sample->gridResults);
 #if defined(_DEBUG)
 	IDXGIDebug1* debugDev = NULL;
 	if (SUCCEEDED(DXGIGetDebugInterface1(0, &IID_IDXGIDebug1, (void**)&debugDev)))
@@ -8,20 +8,50 @@
 #include "step_timer.h"
 #include "simple_camera.h"
 #include "model.h"
+#include "dirty_ranges.h"
+#include "dispatch_planner.h"
+#include "scene_stream.h"
+#include "instance_sort.h"
+#include "frame_stats.h"
+#include "instance_animation.h"
+#include "job_system.h"
+#include "lod_budget.h"
+#include "scene_gen.h"
+#include "release_queue.h"
+#include "lod_select.h"
+#include "spatial_grid.h"
 #include <dxgi1_6.h>
 
 #define FrameCount 2
-#define LodsCount 6
 
 extern const float     c_fovy;
-extern const wchar_t*  c_lodFilenames[LodsCount];
-extern const wchar_t*  c_ampShaderFilename;
+extern const char*     c_defaultModel;
+extern const wchar_t*  c_ampShaderFilename;   // Format strings taking the MeshletPipeline: max verts, max prims, wave size
 extern const wchar_t*  c_meshShaderFilename;
 extern const wchar_t*  c_pixelShaderFilename;
 
 typedef struct Constants Constants;
 typedef struct DrawParams DrawParams;
 typedef struct Instance Instance;
+typedef struct MeshDesc MeshDesc;
+typedef struct ModelDesc ModelDesc;
+
+// A model and its LOD chain, LOD n loaded from "<name>_LOD<n>.bin".
+typedef struct LodModel
+{
+    Model      lods[MAX_LOD_LEVELS];
+    uint32_t   lodCount;
+    uint32_t   firstMesh;     // Index of lods[0] in the mesh table and the bindless descriptor tables
+    VertexPool vertexPool;    // Vertices of every LOD (Model_ShareVertices), empty if they keep their own
+} LodModel;
+
+// Meshlet limits and wave size the amplification and mesh shaders are compiled for. The meshes use
+// their largest meshlet variant within the limits.
+typedef struct MeshletPipeline
+{
+    MeshletLimits Limits;
+    uint32_t      WaveSize;
+} MeshletPipeline;
 
 enum RenderMode
 {
@@ -43,6 +73,8 @@ typedef struct DXSample
     WCHAR currentPath[512];
     // Window title.
     CHAR* title;
+    // Scene file to stream instead of the instance cube, NULL or empty for the cube.
+    const CHAR* scenePath;
 
     // Pipeline objects.
     D3D12_VIEWPORT               viewport;
@@ -72,22 +104,70 @@ typedef struct DXSample
 
     ID3D12RootSignature*        rootSignature;
     ID3D12PipelineState*        pipelineState;
+    MeshletPipeline             meshletPipeline;    // Shaders of pipelineState, from the device or meshlet_profile.txt
     ID3D12Resource*             constantBuffer;
     ID3D12Resource*             instanceBuffer;
-    ID3D12Resource*             instanceUpload;
+    ID3D12Resource*             instanceUpload;     // FrameCount regions, one per frame in flight
+    ID3D12Resource*             meshTable;          // MeshDesc per mesh, then ModelDesc per model
 
     ID3D12GraphicsCommandList6* commandList;
     Constants*                  constantData;
-    Instance*                   instanceData;
+    Instance*                   instances;          // CPU copy of the instance data
+    uint8_t*                    instanceUploadData; // Mapped instanceUpload
+    UINT64                      instanceRegionSize; // Size in bytes of each per-frame upload region
+    DirtyRanges                 instanceDirty;      // Instances modified since the last upload
+    DispatchPlan                dispatchPlan;       // DispatchMesh batches covering all instances
+    ReleaseQueue                releaseQueue;       // Replaced resources, released once the frames using them complete
+    InstanceSort                instanceSort;       // Groups the cube instances by (model, LOD)
+
+    // Streamed scene. The loader thread writes instances straight into sceneUpload.
+    bool                        sceneOpen;
+    SceneStream                 sceneStream;
+    ID3D12Resource*             sceneUpload;
+    uint8_t*                    sceneUploadData;    // Mapped sceneUpload
+    XMFLOAT4*                   sceneModelSpheres;  // Model-space bounding sphere of each scene model
+    UINT64                      sceneCopyFence;     // Fence value of the frame holding the last copy from sceneUpload
 
     StepTimer                   timer;
     SimpleCamera                camera;
-    Model                       lods[LodsCount];
+    LodModel*                   models;             // The cube only uses models[0]; scenes use all of them
+    ModelDesc*                  modelDescs;         // CPU copy of the model part of meshTable
+    uint32_t                    modelCount;
+    uint32_t                    meshCount;          // Sum of the LOD counts of the models
+    FrameStatsRing              frameStats;         // Workload of the last frames, exported with F2
+
+    // Moves every cube instance each frame, toggled with F3. The workers are created on first use.
+    bool                        animate;
+    JobSystem                   jobs;
+    InstanceAnimation           animation;
+
+    // Holds c_lodTargetMs through Constants.LODBias and MinScreenSize, toggled with F4. It is fed the
+    // work time of the frames, without the wait for vsync in Present, and the triangles of the LODs the
+    // CPU selects.
+    bool                        useLodBudget;
+    LodBudget                   lodBudget;
+    ID3D12QueryHeap*            timestampHeap;      // Start and end of the commands of each frame in flight
+    ID3D12Resource*             timestampReadback;
+    UINT64*                     timestamps;         // Mapped timestampReadback, 2 per frame in flight
+    UINT64                      timestampFrequency;
+    LARGE_INTEGER               cpuFrameStart;      // Start of the last Sample_Update
+    double                      cpuFrameMs;         // From Sample_Update to Present, last frame
+    uint64_t                    lodTriangles;       // Triangles of the LODs the CPU selected last frame, 0 if it did not
+
+    // Picks the LOD of the cube instances on the CPU by screen-space error, off until F6 toggles it. Streamed
+    // scenes keep no CPU copy of their instances: the shaders select from the screen size.
+    bool                        useLodSelect;
+    LodSelector                 lodSelector;
+    LodErrorChain*              lodErrors;          // Per model
+    SpatialGrid                 spatialGrid;        // Cube instances, for the frustum query of the LOD selection
+    SpatialGridResults          gridResults;
+    bool                        gridStale;          // Instances moved or regenerated since the grid was built
+
     enum RenderMode             renderMode;
     uint32_t                    instanceLevel;
+    SceneLayout                 sceneLayout;        // Layout of the generated instances, cycled with F5
 
     uint32_t                    instanceCount;
-    bool                        updateInstances;
 
 } DXSample;
 
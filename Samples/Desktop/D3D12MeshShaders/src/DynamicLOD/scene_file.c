@@ -0,0 +1,40 @@
+#include "scene_file.h"
+
+_Static_assert(sizeof(SceneFileHeader) == 16, "SceneFileHeader must not be padded");
+_Static_assert(sizeof(SceneFileModel) == SCENE_MODEL_NAME_SIZE, "SceneFileModel must not be padded");
+_Static_assert(sizeof(SceneFileInstance) == 52, "SceneFileInstance must not be padded");
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool SceneFile_WriteHeader(FILE* const file, const SceneFileModel* const models, uint32_t modelCount, uint32_t instanceCount)
+{
+    const SceneFileHeader header = {
+        .Magic = SCENE_FILE_MAGIC,
+        .Version = SCENE_FILE_VERSION,
+        .ModelCount = modelCount,
+        .InstanceCount = instanceCount,
+    };
+
+    return fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(models, sizeof(SceneFileModel), modelCount, file) == modelCount;
+}
+
+bool SceneFile_WriteInstances(FILE* const file, const SceneFileInstance* const instances, uint32_t count)
+{
+    return fwrite(instances, sizeof(SceneFileInstance), count, file) == count;
+}
+
+bool SceneFile_ReadHeader(FILE* const file, SceneFileHeader* const header)
+{
+    if (fread(header, sizeof(*header), 1, file) != 1)
+    {
+        return false;
+    }
+
+    return header->Magic == SCENE_FILE_MAGIC &&
+           header->Version == SCENE_FILE_VERSION &&
+           header->ModelCount > 0 &&
+           header->ModelCount <= SCENE_FILE_MAX_MODELS;
+}
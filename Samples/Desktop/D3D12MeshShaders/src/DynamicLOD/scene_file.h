@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+#define SCENE_FILE_MAGIC      0x454E4353u // "SCNE"
+#define SCENE_FILE_VERSION    1
+#define SCENE_MODEL_NAME_SIZE 64
+#define SCENE_FILE_MAX_MODELS 4096u // Instances store their model index in 12 bits
+
+/****************************************************************************************************
+ * Binary scene file, little endian:                                                                *
+ *                                                                                                  *
+ *   SceneFileHeader                                                                                *
+ *   SceneFileModel    [ModelCount]                                                                 *
+ *   SceneFileInstance [InstanceCount]                                                              *
+ *                                                                                                  *
+ * Instances are fixed-size records, so the file can be streamed in chunks and any range of         *
+ * instances found by its offset. The structs have no padding.                                      *
+ ****************************************************************************************************/
+typedef struct SceneFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t ModelCount;
+    uint32_t InstanceCount;
+} SceneFileHeader;
+
+// A model referenced by the instances, as the asset path of its LOD chain without the "_LOD<n>.bin" suffix.
+typedef struct SceneFileModel
+{
+    char Name[SCENE_MODEL_NAME_SIZE];
+} SceneFileModel;
+
+typedef struct SceneFileInstance
+{
+    XMFLOAT4 World[3];  // Rows of the transposed world matrix, as in Instance
+    uint32_t Model;     // Index into the model table
+} SceneFileInstance;
+
+bool SceneFile_WriteHeader    (FILE* const file, const SceneFileModel* const models, uint32_t modelCount, uint32_t instanceCount);
+bool SceneFile_WriteInstances (FILE* const file, const SceneFileInstance* const instances, uint32_t count);
+
+// Reads and validates the header. On success, the file is positioned on the model table.
+bool SceneFile_ReadHeader     (FILE* const file, SceneFileHeader* const header);
@@ -0,0 +1,159 @@
+/*************************************************************************************
+ Scene file tests.
+
+ Writes a scene with a model table and instance records, reads it back the way the
+ streaming loader does, and compares every byte. Then corrupts the header one field
+ at a time: a bad magic, another version, no models or more than the maximum must
+ all be rejected, as must a file that ends inside the header. A file that ends
+ inside the model table or the instances passes the header check but comes up
+ short when those are read.
+
+ Usage: SceneFileTest
+**************************************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+#include "scene_file.h"
+#include "test_check.h"
+
+#define MODEL_COUNT    5
+#define INSTANCE_COUNT 700
+#define TEST_FILE      "scene_file_test.scene"
+
+static SceneFileModel    s_models[MODEL_COUNT];
+static SceneFileInstance s_instances[INSTANCE_COUNT];
+static uint8_t           s_bytes[sizeof(SceneFileHeader) + sizeof(s_models) + sizeof(s_instances)];
+
+// Opens the test file for reading and writing, emptied.
+static FILE* OpenTestFile(void)
+{
+    FILE* const file = fopen(TEST_FILE, "w+b");
+    CHECK(file != NULL);
+    return file;
+}
+
+// Writes the first 'size' bytes of s_bytes to a new test file and rewinds it.
+static FILE* WriteBytes(size_t size)
+{
+    FILE* const file = OpenTestFile();
+    if (file)
+    {
+        CHECK(fwrite(s_bytes, 1, size, file) == size);
+        rewind(file);
+    }
+    return file;
+}
+
+static void TestRoundTrip(void)
+{
+    for (uint32_t m = 0; m < MODEL_COUNT; ++m)
+    {
+        memset(&s_models[m], 0, sizeof(SceneFileModel));
+        snprintf(s_models[m].Name, sizeof(s_models[m].Name), "Model%u.bin", m);
+    }
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        float* const world = &s_instances[i].World[0].x;
+        for (uint32_t k = 0; k < 12; ++k)
+        {
+            world[k] = TestRandomFloat(-100.0f, 100.0f);
+        }
+        s_instances[i].Model = TestRandom() % MODEL_COUNT;
+    }
+
+    // The instances go out in chunks, as the scene tool writes them.
+    FILE* file = OpenTestFile();
+    if (!file)
+    {
+        return;
+    }
+    CHECK(SceneFile_WriteHeader(file, s_models, MODEL_COUNT, INSTANCE_COUNT));
+    for (uint32_t first = 0; first < INSTANCE_COUNT; first += 256)
+    {
+        const uint32_t count = INSTANCE_COUNT - first < 256 ? INSTANCE_COUNT - first : 256;
+        CHECK(SceneFile_WriteInstances(file, &s_instances[first], count));
+    }
+    CHECK(ftell(file) == (long)sizeof(s_bytes));
+
+    rewind(file);
+    CHECK(fread(s_bytes, 1, sizeof(s_bytes), file) == sizeof(s_bytes));
+    rewind(file);
+
+    SceneFileHeader header;
+    CHECK(SceneFile_ReadHeader(file, &header));
+    CHECK(header.Magic == SCENE_FILE_MAGIC && header.Version == SCENE_FILE_VERSION);
+    CHECK(header.ModelCount == MODEL_COUNT && header.InstanceCount == INSTANCE_COUNT);
+
+    static SceneFileModel    models[MODEL_COUNT];
+    static SceneFileInstance instances[INSTANCE_COUNT];
+    CHECK(fread(models, sizeof(SceneFileModel), MODEL_COUNT, file) == MODEL_COUNT);
+    CHECK(fread(instances, sizeof(SceneFileInstance), INSTANCE_COUNT, file) == INSTANCE_COUNT);
+    CHECK(memcmp(models, s_models, sizeof(models)) == 0);
+    CHECK(memcmp(instances, s_instances, sizeof(instances)) == 0);
+    CHECK(fgetc(file) == EOF);
+    fclose(file);
+}
+
+// Reads the header of s_bytes with 'offset' overwritten by 'value'.
+static bool ReadCorruptHeader(size_t offset, uint32_t value)
+{
+    uint32_t saved;
+    memcpy(&saved, &s_bytes[offset], sizeof(saved));
+    memcpy(&s_bytes[offset], &value, sizeof(value));
+
+    FILE* const file = WriteBytes(sizeof(s_bytes));
+    SceneFileHeader header;
+    const bool ok = file && SceneFile_ReadHeader(file, &header);
+    if (file)
+    {
+        fclose(file);
+    }
+    memcpy(&s_bytes[offset], &saved, sizeof(saved));
+    return ok;
+}
+
+static void TestInvalid(void)
+{
+    CHECK(ReadCorruptHeader(offsetof(SceneFileHeader, Magic), SCENE_FILE_MAGIC));
+    CHECK(!ReadCorruptHeader(offsetof(SceneFileHeader, Magic), SCENE_FILE_MAGIC ^ 1));
+    CHECK(!ReadCorruptHeader(offsetof(SceneFileHeader, Magic), 0x5343454E));     // Byte-swapped
+    CHECK(!ReadCorruptHeader(offsetof(SceneFileHeader, Version), SCENE_FILE_VERSION + 1));
+    CHECK(!ReadCorruptHeader(offsetof(SceneFileHeader, Version), 0));
+    CHECK(!ReadCorruptHeader(offsetof(SceneFileHeader, ModelCount), 0));
+    CHECK(ReadCorruptHeader(offsetof(SceneFileHeader, ModelCount), SCENE_FILE_MAX_MODELS));
+    CHECK(!ReadCorruptHeader(offsetof(SceneFileHeader, ModelCount), SCENE_FILE_MAX_MODELS + 1));
+    CHECK(!ReadCorruptHeader(offsetof(SceneFileHeader, ModelCount), UINT32_MAX));
+    CHECK(ReadCorruptHeader(offsetof(SceneFileHeader, InstanceCount), 0));
+
+    // Cut inside the header: rejected. Cut further on: the header reads, the rest comes up short.
+    uint32_t badCuts = 0;
+    for (size_t size = 0; size < sizeof(s_bytes); size += size < sizeof(SceneFileHeader) + 2 * sizeof(SceneFileModel) ? 1 : 97)
+    {
+        FILE* const file = WriteBytes(size);
+        if (!file)
+        {
+            return;
+        }
+        SceneFileHeader header;
+        const bool headerRead = SceneFile_ReadHeader(file, &header);
+        badCuts += headerRead != (size >= sizeof(SceneFileHeader));
+        if (headerRead)
+        {
+            static SceneFileModel    models[MODEL_COUNT];
+            static SceneFileInstance instances[INSTANCE_COUNT];
+            const bool complete = fread(models, sizeof(SceneFileModel), MODEL_COUNT, file) == MODEL_COUNT &&
+                                  fread(instances, sizeof(SceneFileInstance), INSTANCE_COUNT, file) == INSTANCE_COUNT;
+            badCuts += complete;
+        }
+        fclose(file);
+    }
+    CHECK(badCuts == 0);
+}
+
+int main(void)
+{
+    TestRoundTrip();
+    TestInvalid();
+    remove(TEST_FILE);
+    return TEST_RESULT();
+}
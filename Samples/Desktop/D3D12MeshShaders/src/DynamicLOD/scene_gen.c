@@ -0,0 +1,349 @@
+#include "scene_gen.h"
+#include "instance_pack.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+static const float c_cubePadding = 0.5f;
+
+static const uint32_t c_clusterSize = 512;        // Average instances per cluster
+static const float c_clusterSpread = 0.1f;        // Cluster radius, as a fraction of the cube's half width
+static const float c_terrainJitter = 0.25f;       // Largest offset from the grid cell center, in spacings
+static const float c_terrainHeight = 0.15f;       // Peak to valley, as a fraction of the terrain's half width
+static const uint32_t c_terrainOctaves = 4;
+static const uint32_t c_terrainCells = 4;         // Noise cells across the terrain in the first octave
+static const int32_t c_corridorHalfWidth = 4;     // Grid cells from the axis to the inner wall
+static const int32_t c_corridorWallLayers = 4;
+static const float c_flyThroughSpacing = 0.8f;    // Average distance between instances, in cube spacings
+static const float c_flyThroughRadius = 0.5f;     // Tube radius, as a fraction of the cube's half width
+static const float c_flyThroughCore = 2.0f;       // Radius of the empty core, in instance radii
+
+static const char* const c_layoutNames[SceneLayoutCount] =
+{
+    "cube",
+    "random",
+    "clustered",
+    "terrain",
+    "corridor",
+    "flythrough",
+};
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// Turned by a yaw of (cosYaw, sinYaw) around y.
+static void PackPlaced(Instance* const instance, float x, float y, float z, float cosYaw, float sinYaw, float radius)
+{
+    XMFLOAT4X4 world;
+    float* m = (float*)&world;
+    for (int k = 0; k < 16; ++k)
+    {
+        m[k] = k % 5 == 0 ? 1.0f : 0.0f;
+    }
+    m[0] = cosYaw;
+    m[2] = 0.0f - sinYaw;  // Not -sinYaw, which would store -0 in the cube
+    m[8] = sinYaw;
+    m[10] = cosYaw;
+    m[12] = x;
+    m[13] = y;
+    m[14] = z;
+
+    Instance_Pack(instance, &world, (XMFLOAT4){ x, y, z, radius });
+}
+
+// Avalanching integer hash (the finalizer of MurmurHash3).
+static uint32_t Hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
+
+// Uniform in [lo, hi].
+static float RandomRange(uint32_t* const state, float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(SceneGen_Random(state) >> 8) * (1.0f / 16777215.0f);
+}
+
+// A yaw uniform enough for a benchmark, from the rational parametrization of the circle:
+// no sinf or cosf, whose results vary between C libraries.
+static void RandomYaw(uint32_t* const state, float* const cosYaw, float* const sinYaw)
+{
+    const float t = RandomRange(state, -1.0f, 1.0f);
+    const float d = 1.0f / (1.0f + t * t);
+    *cosYaw = (1.0f - t * t) * d;
+    *sinYaw = 2.0f * t * d;
+}
+
+// Bell shaped in [-1, 1]: the sum of four uniforms, with a standard deviation of about 0.58.
+static float RandomBell(uint32_t* const state)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        sum += RandomRange(state, -0.25f, 0.25f);
+    }
+    return sum;
+}
+
+// Value noise in [0, 1], with a smoothstep between random lattice values.
+static float ValueNoise(float x, float z, uint32_t seed)
+{
+    const float fx = floorf(x);
+    const float fz = floorf(z);
+    const uint32_t ix = (uint32_t)(int32_t)fx;
+    const uint32_t iz = (uint32_t)(int32_t)fz;
+
+    float corners[4];
+    for (uint32_t k = 0; k < 4; ++k)
+    {
+        const uint32_t h = Hash(seed ^ Hash((ix + (k & 1)) ^ Hash(iz + (k >> 1))));
+        corners[k] = (float)(h >> 8) * (1.0f / 16777215.0f);
+    }
+
+    const float tx = x - fx;
+    const float tz = z - fz;
+    const float sx = tx * tx * (3.0f - 2.0f * tx);
+    const float sz = tz * tz * (3.0f - 2.0f * tz);
+    const float a = corners[0] + (corners[1] - corners[0]) * sx;
+    const float b = corners[2] + (corners[3] - corners[2]) * sx;
+    return a + (b - a) * sz;
+}
+
+static void GenerateRandom(Instance* const instances, uint32_t count, float halfWidth, float radius, uint32_t* const state)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float x = RandomRange(state, -halfWidth, halfWidth);
+        const float y = RandomRange(state, -halfWidth, halfWidth);
+        const float z = RandomRange(state, -halfWidth, halfWidth);
+        float c, s;
+        RandomYaw(state, &c, &s);
+        PackPlaced(&instances[i], x, y, z, c, s, radius);
+    }
+}
+
+static void GenerateClustered(Instance* const instances, uint32_t count, float halfWidth, float radius, uint32_t* const state)
+{
+    enum { MaxClusters = 4096 };
+    XMFLOAT3 centers[MaxClusters];
+
+    uint32_t clusterCount = (count + c_clusterSize - 1) / c_clusterSize;
+    clusterCount = clusterCount < MaxClusters ? clusterCount : MaxClusters;
+    for (uint32_t k = 0; k < clusterCount; ++k)
+    {
+        centers[k].x = RandomRange(state, -halfWidth, halfWidth);
+        centers[k].y = RandomRange(state, -halfWidth, halfWidth);
+        centers[k].z = RandomRange(state, -halfWidth, halfWidth);
+    }
+
+    const float spread = c_clusterSpread * halfWidth + radius;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const XMFLOAT3 center = centers[SceneGen_Random(state) % clusterCount];
+        const float x = center.x + spread * RandomBell(state);
+        const float y = center.y + spread * RandomBell(state);
+        const float z = center.z + spread * RandomBell(state);
+        float c, s;
+        RandomYaw(state, &c, &s);
+        PackPlaced(&instances[i], x, y, z, c, s, radius);
+    }
+}
+
+static void GenerateTerrain(Instance* const instances, uint32_t count, float spacing, float radius, uint32_t* const state)
+{
+    // A square grid of at least 'count' cells, filled row by row.
+    uint32_t side = (uint32_t)sqrtf((float)count);
+    while ((uint64_t)side * side < count)
+    {
+        ++side;
+    }
+    const float halfWidth = 0.5f * spacing * (float)side;
+    const float height = c_terrainHeight * halfWidth;
+    const uint32_t noiseSeed = SceneGen_Random(state);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float x = ((float)(i % side) + 0.5f + RandomRange(state, -c_terrainJitter, c_terrainJitter)) * spacing - halfWidth;
+        const float z = ((float)(i / side) + 0.5f + RandomRange(state, -c_terrainJitter, c_terrainJitter)) * spacing - halfWidth;
+
+        // Fractal sum of octaves, normalized back to [0, 1].
+        float noise = 0.0f;
+        float amplitude = 0.5f;
+        float frequency = (float)c_terrainCells / (2.0f * halfWidth);
+        float total = 0.0f;
+        for (uint32_t octave = 0; octave < c_terrainOctaves; ++octave)
+        {
+            noise += amplitude * ValueNoise(x * frequency, z * frequency, noiseSeed + octave);
+            total += amplitude;
+            amplitude *= 0.5f;
+            frequency *= 2.0f;
+        }
+        const float y = (noise / total - 0.5f) * height;
+
+        float c, s;
+        RandomYaw(state, &c, &s);
+        PackPlaced(&instances[i], x, y, z, c, s, radius);
+    }
+}
+
+static void GenerateCorridor(Instance* const instances, uint32_t count, float spacing, float radius, uint32_t* const state)
+{
+    // Each slice along z is a square ring of grid cells, c_corridorWallLayers thick.
+    const int32_t outer = c_corridorHalfWidth + c_corridorWallLayers;
+    const uint32_t sliceCount = (uint32_t)((2 * outer + 1) * (2 * outer + 1) - (2 * c_corridorHalfWidth - 1) * (2 * c_corridorHalfWidth - 1));
+    const uint32_t slices = (count + sliceCount - 1) / sliceCount;
+    const float halfLength = 0.5f * spacing * (float)(slices - 1);
+
+    uint32_t i = 0;
+    for (uint32_t slice = 0; i < count; ++slice)
+    {
+        const float z = (float)slice * spacing - halfLength;
+        for (int32_t row = -outer; row <= outer && i < count; ++row)
+        {
+            for (int32_t column = -outer; column <= outer && i < count; ++column)
+            {
+                const int32_t distance = abs(row) > abs(column) ? abs(row) : abs(column);
+                if (distance >= c_corridorHalfWidth)
+                {
+                    float c, s;
+                    RandomYaw(state, &c, &s);
+                    PackPlaced(&instances[i++], (float)column * spacing, (float)row * spacing, z, c, s, radius);
+                }
+            }
+        }
+    }
+}
+
+static void GenerateFlyThrough(Instance* const instances, uint32_t count, float spacing, float halfWidth, float radius,
+                               uint32_t* const state)
+{
+    // Long enough for the requested density.
+    const float outer = c_flyThroughRadius * halfWidth + c_flyThroughCore * radius + spacing;
+    const float inner = c_flyThroughCore * radius;
+    const float cell = c_flyThroughSpacing * spacing;
+    const float area = XM_PI * (outer * outer - inner * inner);
+    const float halfLength = 0.5f * (float)count * cell * cell * cell / area;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // Uniform in the annulus, by rejection from its bounding square.
+        float x, y, lengthSq;
+        do
+        {
+            x = RandomRange(state, -outer, outer);
+            y = RandomRange(state, -outer, outer);
+            lengthSq = x * x + y * y;
+        } while (lengthSq > outer * outer || lengthSq < inner * inner);
+
+        const float z = RandomRange(state, -halfLength, halfLength);
+        float c, s;
+        RandomYaw(state, &c, &s);
+        PackPlaced(&instances[i], x, y, z, c, s, radius);
+    }
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+uint32_t SceneGen_CubeCount(uint32_t level)
+{
+    const uint32_t width = level * 2 + 1;
+    return width * width * width;
+}
+
+void SceneGen_Cube(Instance* const instances, uint32_t level, float radius)
+{
+    const float spacing = (1.0f + c_cubePadding) * radius;
+
+    // Create the instances in a growing cube volume
+    const uint32_t width = level * 2 + 1;
+    const float extents = spacing * level;
+    const uint32_t count = width * width * width;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float x = (float)(i % width) * spacing - extents;
+        const float y = (float)((i / width) % width) * spacing - extents;
+        const float z = (float)(i / (width * width)) * spacing - extents;
+
+        PackPlaced(&instances[i], x, y, z, 1.0f, 0.0f, radius);
+    }
+}
+
+void SceneGen_Generate(Instance* const instances, SceneLayout layout, uint32_t level, float radius, uint32_t seed)
+{
+    const uint32_t count = SceneGen_CubeCount(level);
+    const float spacing = (1.0f + c_cubePadding) * radius;
+    const float halfWidth = 0.5f * spacing * (float)(level * 2 + 1);
+
+    // Each layout draws its own sequence: the same seed gives unrelated scenes.
+    uint32_t state = SceneGen_Seed(seed ^ Hash((uint32_t)layout));
+
+    switch (layout)
+    {
+    case SceneLayoutRandom:
+        GenerateRandom(instances, count, halfWidth, radius, &state);
+        break;
+    case SceneLayoutClustered:
+        GenerateClustered(instances, count, halfWidth, radius, &state);
+        break;
+    case SceneLayoutTerrain:
+        GenerateTerrain(instances, count, spacing, radius, &state);
+        break;
+    case SceneLayoutCorridor:
+        GenerateCorridor(instances, count, spacing, radius, &state);
+        break;
+    case SceneLayoutFlyThrough:
+        GenerateFlyThrough(instances, count, spacing, halfWidth, radius, &state);
+        break;
+    default:
+        SceneGen_Cube(instances, level, radius);
+        break;
+    }
+}
+
+const char* SceneGen_LayoutName(SceneLayout layout)
+{
+    return (uint32_t)layout < SceneLayoutCount ? c_layoutNames[layout] : NULL;
+}
+
+bool SceneGen_ParseLayout(const char* const name, SceneLayout* const layout)
+{
+    for (uint32_t i = 0; i < SceneLayoutCount; ++i)
+    {
+        if (strcmp(name, c_layoutNames[i]) == 0)
+        {
+            *layout = (SceneLayout)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// xorshift32: reproducible across platforms, unlike rand().
+uint32_t SceneGen_Random(uint32_t* const state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+uint32_t SceneGen_Seed(uint32_t seed)
+{
+    // Nearby seeds would otherwise start with nearby numbers.
+    const uint32_t state = Hash(seed + 0x9E3779B9u);
+    return state ? state : 1;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+typedef struct Instance Instance;
+
+typedef enum SceneLayout
+{
+    SceneLayoutCube,        // Uniform grid, the layout of SceneGen_Cube
+    SceneLayoutRandom,      // Uniformly random positions in the volume of the cube
+    SceneLayoutClustered,   // Dense clusters around random centers, empty space between them
+    SceneLayoutTerrain,     // A rolling height field: a wide, flat scene spanning every distance
+    SceneLayoutCorridor,    // A long square tube with thick walls: high depth complexity, mostly occluded
+    SceneLayoutFlyThrough,  // A dense tube around the z axis, with an empty core for the camera to fly along
+    SceneLayoutCount,
+} SceneLayout;
+
+// Number of instances in a cube of the given level: (2 * level + 1)^3.
+uint32_t    SceneGen_CubeCount    (uint32_t level);
+
+/*****************************************************************************************
+ * Fills 'instances' with a cube grid of SceneGen_CubeCount(level) instances centered on *
+ * the origin. Each instance is a copy of a model whose bounding sphere has the given    *
+ * radius, spaced so that neighbouring spheres never touch.                              *
+ *****************************************************************************************/
+void        SceneGen_Cube         (Instance* const instances, uint32_t level, float radius);
+
+/*****************************************************************************************
+ * Fills 'instances' with SceneGen_CubeCount(level) instances of the given layout, so    *
+ * that every layout of a level has the same instance count as the cube. The layouts are *
+ * sized from the same spacing as the cube, and all but the cube turn each instance by a *
+ * random yaw.                                                                           *
+ *                                                                                       *
+ * The result only depends on the arguments: the random numbers come from a seeded       *
+ * xorshift generator, and the math avoids the C library's transcendental functions,     *
+ * whose results differ between platforms. Benchmarks on the same layout, level and      *
+ * seed see the same scene on every machine.                                             *
+ *****************************************************************************************/
+void        SceneGen_Generate     (Instance* const instances, SceneLayout layout, uint32_t level, float radius, uint32_t seed);
+
+// Lower-case name of a layout ("cube", "random", ...), NULL if out of range.
+const char* SceneGen_LayoutName   (SceneLayout layout);
+
+// Parses a layout name, as returned by SceneGen_LayoutName. Returns false if unknown.
+bool        SceneGen_ParseLayout  (const char* const name, SceneLayout* const layout);
+
+// Next number of a xorshift32 generator. The state must not be 0; SceneGen_Seed makes one from any seed.
+uint32_t    SceneGen_Random       (uint32_t* const state);
+uint32_t    SceneGen_Seed         (uint32_t seed);
@@ -0,0 +1,154 @@
+/*************************************************************************************
+ Scene generator tests.
+
+ Generates every layout twice with the same arguments and checks that the scenes
+ are identical byte for byte, that another seed gives another scene, and that each
+ layout writes exactly the cube's instance count. Checks what every instance holds:
+ a turn around y only, a bounding sphere of the given radius centered on the
+ instance, inside the layout's volume; the fly-through's empty core; the cube
+ layout matching SceneGen_Cube; and the layout names.
+
+ Usage: SceneGenTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "scene_gen.h"
+#include "instance_pack.h"
+#include "test_check.h"
+
+#define SCENE_LEVEL 10    // 9261 instances
+#define GUARD_COUNT 4
+
+static const float c_radius = 3.0f;
+static const float c_spacing = 1.5f * 3.0f;     // The cube's spacing for c_radius
+
+// The instances plus a few guard instances past the end, to catch writes past the count.
+static Instance* Allocate(uint32_t count)
+{
+    Instance* const instances = malloc(sizeof(Instance) * (count + GUARD_COUNT));
+    if (instances)
+    {
+        memset(instances, 0xCD, sizeof(Instance) * (count + GUARD_COUNT));
+    }
+    return instances;
+}
+
+static bool GuardsIntact(const Instance* const instances, uint32_t count)
+{
+    const uint8_t* const bytes = (const uint8_t*)&instances[count];
+    for (size_t k = 0; k < sizeof(Instance) * GUARD_COUNT; ++k)
+    {
+        if (bytes[k] != 0xCD)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void CheckInstances(const Instance* const instances, uint32_t count, SceneLayout layout)
+{
+    const float halfWidth = 0.5f * c_spacing * (float)(SCENE_LEVEL * 2 + 1);
+    uint32_t badTurns = 0, badSpheres = 0, outside = 0, inCore = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        XMFLOAT4X4 world;
+        Instance_UnpackWorld(&instances[i], &world);
+        const float* const m = (const float*)&world;
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&instances[i]);
+
+        // Rows (c, 0, -s), (0, 1, 0), (s, 0, c) with c^2 + s^2 = 1, then the translation.
+        badTurns += fabsf(m[0] * m[0] + m[2] * m[2] - 1.0f) > 1e-5f || m[0] != m[10] || m[2] != -m[8];
+        badTurns += m[1] != 0.0f || m[4] != 0.0f || m[5] != 1.0f || m[6] != 0.0f || m[9] != 0.0f;
+        badTurns += m[3] != 0.0f || m[7] != 0.0f || m[11] != 0.0f || m[15] != 1.0f;
+        badSpheres += sphere.x != m[12] || sphere.y != m[13] || sphere.z != m[14];
+        badSpheres += fabsf(sphere.w - c_radius) > c_radius * 1e-3f;
+
+        // The random and cube layouts fill the cube's volume.
+        if (layout == SceneLayoutRandom || layout == SceneLayoutCube)
+        {
+            outside += fabsf(sphere.x) > halfWidth || fabsf(sphere.y) > halfWidth || fabsf(sphere.z) > halfWidth;
+        }
+        if (layout == SceneLayoutFlyThrough)
+        {
+            inCore += sphere.x * sphere.x + sphere.y * sphere.y < 4.0f * c_radius * c_radius * 0.999f;
+        }
+    }
+    CHECK(badTurns == 0);
+    CHECK(badSpheres == 0);
+    CHECK(outside == 0);
+    CHECK(inCore == 0);
+}
+
+static void TestLayouts(void)
+{
+    const uint32_t count = SceneGen_CubeCount(SCENE_LEVEL);
+    CHECK(count == 21 * 21 * 21);
+
+    Instance* const first = Allocate(count);
+    Instance* const second = Allocate(count);
+    CHECK(first != NULL && second != NULL);
+    if (!first || !second)
+    {
+        free(first);
+        free(second);
+        return;
+    }
+
+    for (uint32_t l = 0; l < SceneLayoutCount; ++l)
+    {
+        const SceneLayout layout = (SceneLayout)l;
+        SceneGen_Generate(first, layout, SCENE_LEVEL, c_radius, 7);
+        SceneGen_Generate(second, layout, SCENE_LEVEL, c_radius, 7);
+        CHECK(GuardsIntact(first, count) && GuardsIntact(second, count));
+        CHECK(memcmp(first, second, sizeof(Instance) * count) == 0);
+        CheckInstances(first, count, layout);
+
+        // Another seed moves every layout but the cube.
+        SceneGen_Generate(second, layout, SCENE_LEVEL, c_radius, 8);
+        CHECK((memcmp(first, second, sizeof(Instance) * count) == 0) == (layout == SceneLayoutCube));
+
+        SceneLayout parsed;
+        CHECK(SceneGen_ParseLayout(SceneGen_LayoutName(layout), &parsed) && parsed == layout);
+    }
+
+    // The cube layout is SceneGen_Cube.
+    SceneGen_Generate(first, SceneLayoutCube, SCENE_LEVEL, c_radius, 7);
+    SceneGen_Cube(second, SCENE_LEVEL, c_radius);
+    CHECK(memcmp(first, second, sizeof(Instance) * count) == 0);
+
+    // Level 0 is a single instance at the origin.
+    SceneGen_Cube(first, 0, c_radius);
+    const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&first[0]);
+    CHECK(SceneGen_CubeCount(0) == 1 && sphere.x == 0.0f && sphere.y == 0.0f && sphere.z == 0.0f);
+
+    free(first);
+    free(second);
+}
+
+static void TestNamesAndRandom(void)
+{
+    SceneLayout layout = SceneLayoutRandom;
+    CHECK(SceneGen_LayoutName(SceneLayoutCount) == NULL);
+    CHECK(!SceneGen_ParseLayout("sphere", &layout) && layout == SceneLayoutRandom);
+    CHECK(SceneGen_ParseLayout("flythrough", &layout) && layout == SceneLayoutFlyThrough);
+
+    // Any seed, 0 included, makes a usable xorshift state that never reaches 0.
+    uint32_t state = SceneGen_Seed(0);
+    CHECK(state != 0);
+    uint32_t zeros = 0;
+    for (uint32_t i = 0; i < 100000; ++i)
+    {
+        zeros += SceneGen_Random(&state) == 0;
+    }
+    CHECK(zeros == 0);
+    CHECK(SceneGen_Seed(1) != SceneGen_Seed(2));
+}
+
+int main(void)
+{
+    TestLayouts();
+    TestNamesAndRandom();
+    return TEST_RESULT();
+}
@@ -0,0 +1,173 @@
+#include "scene_stream.h"
+#include "instance_pack.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// World-space bounding sphere of a model placed by a transposed 3x4 world matrix.
+static XMFLOAT4 TransformSphere(const XMFLOAT4 World[3], XMFLOAT4 sphere)
+{
+    XMFLOAT4 result;
+    result.x = World[0].x * sphere.x + World[0].y * sphere.y + World[0].z * sphere.z + World[0].w;
+    result.y = World[1].x * sphere.x + World[1].y * sphere.y + World[1].z * sphere.z + World[1].w;
+    result.z = World[2].x * sphere.x + World[2].y * sphere.y + World[2].z * sphere.z + World[2].w;
+
+    // The radius grows with the largest axis scale, which is the length of a column of the 3x3 part.
+    float maxScaleSq = 0.0f;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float x = (&World[0].x)[axis];
+        const float y = (&World[1].x)[axis];
+        const float z = (&World[2].x)[axis];
+        maxScaleSq = fmaxf(maxScaleSq, x * x + y * y + z * z);
+    }
+    result.w = sphere.w * sqrtf(maxScaleSq);
+    return result;
+}
+
+static void SetStatus(SceneStream* const stream, SceneStreamStatus status)
+{
+    mtx_lock(&stream->lock);
+    stream->status = status;
+    mtx_unlock(&stream->lock);
+}
+
+static int LoaderMain(void* arg)
+{
+    SceneStream* stream = arg;
+    const uint32_t total = stream->header.InstanceCount;
+
+    for (uint32_t first = 0; first < total; first += SCENE_STREAM_CHUNK)
+    {
+        mtx_lock(&stream->lock);
+        const bool cancel = stream->cancel;
+        mtx_unlock(&stream->lock);
+        if (cancel)
+        {
+            return 0;
+        }
+
+        const uint32_t count = total - first < SCENE_STREAM_CHUNK ? total - first : SCENE_STREAM_CHUNK;
+        if (fread(stream->chunk, sizeof(SceneFileInstance), count, stream->file) != count)
+        {
+            SetStatus(stream, SceneStreamFailed);
+            return 0;
+        }
+
+        Instance* out = stream->destination + first;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const SceneFileInstance* in = &stream->chunk[i];
+            if (in->Model >= stream->header.ModelCount)
+            {
+                SetStatus(stream, SceneStreamFailed);
+                return 0;
+            }
+
+            // Build the whole instance locally: the destination may be write-combined memory.
+            const XMFLOAT4 sphere = TransformSphere(in->World, stream->modelSpheres[in->Model]);
+            Instance instance = {
+                .World = { in->World[0], in->World[1], in->World[2] },
+                .SphereCenter = { sphere.x, sphere.y, sphere.z },
+                .PackedRadius = HalfFromFloatRoundUp(sphere.w) | (in->Model << INSTANCE_MODEL_SHIFT),
+            };
+            out[i] = instance;
+        }
+
+        mtx_lock(&stream->lock);
+        stream->loaded = first + count;
+        mtx_unlock(&stream->lock);
+    }
+
+    SetStatus(stream, SceneStreamDone);
+    return 0;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool SceneStream_Open(SceneStream* const stream, const char* const path)
+{
+    *stream = (SceneStream){ 0 };
+
+    if (mtx_init(&stream->lock, mtx_plain) != thrd_success)
+    {
+        return false;
+    }
+
+    stream->file = fopen(path, "rb");
+    if (!stream->file || !SceneFile_ReadHeader(stream->file, &stream->header))
+    {
+        SceneStream_Close(stream);
+        return false;
+    }
+
+    stream->models = malloc(stream->header.ModelCount * sizeof(SceneFileModel));
+    if (!stream->models ||
+        fread(stream->models, sizeof(SceneFileModel), stream->header.ModelCount, stream->file) != stream->header.ModelCount)
+    {
+        SceneStream_Close(stream);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < stream->header.ModelCount; ++i)
+    {
+        stream->models[i].Name[SCENE_MODEL_NAME_SIZE - 1] = '\0';
+    }
+    return true;
+}
+
+bool SceneStream_Start(SceneStream* const stream, Instance* const destination, const XMFLOAT4* const modelSpheres)
+{
+    stream->destination = destination;
+    stream->modelSpheres = modelSpheres;
+    stream->status = SceneStreamLoading;
+
+    stream->chunk = malloc(SCENE_STREAM_CHUNK * sizeof(SceneFileInstance));
+    if (!stream->chunk || thrd_create(&stream->thread, LoaderMain, stream) != thrd_success)
+    {
+        stream->status = SceneStreamFailed;
+        return false;
+    }
+    stream->threadStarted = true;
+    return true;
+}
+
+SceneStreamStatus SceneStream_Poll(SceneStream* const stream, uint32_t* const first, uint32_t* const count)
+{
+    mtx_lock(&stream->lock);
+    const uint32_t loaded = stream->loaded;
+    const SceneStreamStatus status = stream->status;
+    mtx_unlock(&stream->lock);
+
+    *first = stream->polled;
+    *count = loaded - stream->polled;
+    stream->polled = loaded;
+    return status;
+}
+
+void SceneStream_Close(SceneStream* const stream)
+{
+    if (stream->threadStarted)
+    {
+        mtx_lock(&stream->lock);
+        stream->cancel = true;
+        mtx_unlock(&stream->lock);
+
+        thrd_join(stream->thread, NULL);
+        stream->threadStarted = false;
+    }
+
+    if (stream->file)
+    {
+        fclose(stream->file);
+    }
+    free(stream->chunk);
+    free(stream->models);
+    mtx_destroy(&stream->lock);
+    *stream = (SceneStream){ 0 };
+}
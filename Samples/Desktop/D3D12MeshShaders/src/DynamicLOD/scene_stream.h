@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <threads.h>
+#include "shared.h"
+#include "scene_file.h"
+
+typedef struct Instance Instance;
+
+#define SCENE_STREAM_CHUNK 65536 // Instances read and published at once
+
+typedef enum SceneStreamStatus
+{
+    SceneStreamLoading,
+    SceneStreamDone,
+    SceneStreamFailed,     // Read error, truncated file or invalid model index
+} SceneStreamStatus;
+
+/****************************************************************************************************
+ * Loads the instances of a scene file on a background thread.                                      *
+ *                                                                                                  *
+ * The loader reads SCENE_STREAM_CHUNK records at a time, packs them and writes them straight into  *
+ * the destination given to SceneStream_Start, usually mapped upload memory, then publishes how     *
+ * many instances are ready. The frame loop calls SceneStream_Poll once per frame and copies the    *
+ * new range to the GPU: it never waits for the disk.                                               *
+ *                                                                                                  *
+ * Instances are published in file order, so the loaded part is always a prefix [0, loaded).        *
+ ****************************************************************************************************/
+typedef struct SceneStream
+{
+    FILE*              file;
+    SceneFileHeader    header;
+    SceneFileModel*    models;          // header.ModelCount entries
+
+    Instance*          destination;     // header.InstanceCount instances, written by the loader thread
+    const XMFLOAT4*    modelSpheres;    // Model-space bounding sphere per model (xyz = center, w = radius)
+    SceneFileInstance* chunk;           // Read buffer of the loader thread
+
+    thrd_t             thread;
+    bool               threadStarted;
+    mtx_t              lock;
+    uint32_t           loaded;          // Instances written to destination, guarded by lock
+    SceneStreamStatus  status;          // Guarded by lock
+    bool               cancel;          // Guarded by lock
+
+    uint32_t           polled;          // Instances already returned by SceneStream_Poll
+} SceneStream;
+
+// Opens a scene file and reads its header and model table. Returns false if the file is missing or invalid.
+bool              SceneStream_Open   (SceneStream* const stream, const char* const path);
+
+/****************************************************************************************************
+ * Starts loading into 'destination', which must hold stream->header.InstanceCount instances and    *
+ * stay valid until SceneStream_Close. 'modelSpheres' gives the bounding sphere of each of the      *
+ * header.ModelCount models, used to compute the world-space sphere of every instance.              *
+ ****************************************************************************************************/
+bool              SceneStream_Start  (SceneStream* const stream, Instance* const destination, const XMFLOAT4* const modelSpheres);
+
+/****************************************************************************************************
+ * Returns the instances loaded since the previous call as [*first, *first + *count), and the       *
+ * loader status. Once it returns SceneStreamDone with a zero count, the whole scene was returned.  *
+ ****************************************************************************************************/
+SceneStreamStatus SceneStream_Poll   (SceneStream* const stream, uint32_t* const first, uint32_t* const count);
+
+// Stops the loader thread if it is still running and closes the file.
+void              SceneStream_Close  (SceneStream* const stream);
@@ -9,12 +9,17 @@
 //
 //*********************************************************
 
+// The mesh buffers are bindless: each table is an unbounded array with one descriptor per mesh.
 #define ROOT_SIG \
     "CBV(b0), \
-     RootConstants(b1, num32BitConstants = 2), \
-     DescriptorTable( CBV(b2, numDescriptors = 8), \
-                      SRV(t0, numDescriptors = 32)), \
-     SRV(t32)"
+     RootConstants(b1, num32BitConstants = 3), \
+     SRV(t0), \
+     SRV(t1), \
+     SRV(t2), \
+     DescriptorTable(SRV(t0, space = 1, numDescriptors = unbounded)), \
+     DescriptorTable(SRV(t0, space = 2, numDescriptors = unbounded)), \
+     DescriptorTable(SRV(t0, space = 3, numDescriptors = unbounded)), \
+     DescriptorTable(SRV(t0, space = 4, numDescriptors = unbounded))"
 
 
 struct VertexOut
@@ -30,23 +35,20 @@ struct VertexOut
 // This is the data which will be exported from the Amplification Shader
 // and supplied as an extra 'in' argument to its dispatched Mesh Shader
 // children.
+//
+// The visible instances are grouped in buckets, one per distinct mesh (model LOD), in increasing
+// mesh order. A group of AS_GROUP_SIZE instances has at most AS_GROUP_SIZE buckets.
 struct Payload
 {
-    uint InstanceCounts[MAX_LOD_LEVELS];   // The instance count for each LOD level.
-    uint GroupOffsets[MAX_LOD_LEVELS + 1]; // The offset in threadgroups for each LOD level.
+    uint BucketCount;
+    uint MeshIndices[AS_GROUP_SIZE];     // The mesh drawn by each bucket.
+    uint InstanceCounts[AS_GROUP_SIZE];  // The instance count of each bucket.
+    uint GroupOffsets[AS_GROUP_SIZE];    // The offset in threadgroups of each bucket.
 
-    // The list of instance indices after culling. Ordered as:
-    // (list of LOD 0 instance indices), (list of LOD 1 instance indices), ... (list of LOD MAX_LOD_LEVELS-1 instance indices)                                            
+    // The list of instance indices after culling, relative to DrawParams.InstanceOffset. Ordered as:
+    // (list of bucket 0 instance indices), (list of bucket 1 instance indices), ...
     uint InstanceList[AS_GROUP_SIZE];
-    uint InstanceOffsets[MAX_LOD_LEVELS + 1]; // The offset into the Instance List at which each LOD level begins.
-};
-
-struct MeshInfo
-{
-    uint IndexBytes;
-    uint MeshletCount;
-    uint LastMeshletVertCount;
-    uint LastMeshletPrimCount;
+    uint InstanceOffsets[AS_GROUP_SIZE]; // The offset into the Instance List at which each bucket begins.
 };
 
 struct Vertex
@@ -66,13 +68,56 @@ struct Meshlet
 ConstantBuffer<Constants>  Constants : register(b0);
 ConstantBuffer<DrawParams> DrawParams : register(b1);
 
-ConstantBuffer<MeshInfo>   MeshInfo[MAX_LOD_LEVELS] : register(b2);
-StructuredBuffer<Vertex>   Vertices[MAX_LOD_LEVELS] : register(t0);
-StructuredBuffer<Meshlet>  Meshlets[MAX_LOD_LEVELS] : register(t8);
-ByteAddressBuffer          UniqueVertexIndices[MAX_LOD_LEVELS] : register(t16);
-StructuredBuffer<uint>     PrimitiveIndices[MAX_LOD_LEVELS] : register(t24);
-StructuredBuffer<Instance> Instances : register(t32);
+StructuredBuffer<Instance>  Instances : register(t0);
+StructuredBuffer<MeshDesc>  Meshes : register(t1);
+StructuredBuffer<ModelDesc> Models : register(t2);
+
+// Indexed by mesh. Every thread of a mesh shader group reads the same mesh, so the index is uniform.
+StructuredBuffer<Vertex>    Vertices[] : register(t0, space1);
+StructuredBuffer<Meshlet>   Meshlets[] : register(t0, space2);
+ByteAddressBuffer           UniqueVertexIndices[] : register(t0, space3);
+StructuredBuffer<uint>      PrimitiveIndices[] : register(t0, space4);
+
+
+// Unpacks the world-space bounding sphere of an instance (xyz = center, w = radius).
+float4 GetBoundingSphere(Instance instance)
+{
+    return float4(instance.SphereCenter, f16tof32(instance.PackedRadius));
+}
 
+// Index of the instance's model in Models.
+uint GetModel(Instance instance)
+{
+    return (instance.PackedRadius >> 16) & 0xFFF;
+}
+
+// LOD the CPU selected for the instance (see lod_select.h), ~0 if the shaders select it.
+uint GetSelectedLOD(Instance instance)
+{
+    return (instance.PackedRadius >> 28) - 1;
+}
+
+// Transforms an object-space position by the instance's affine 3x4 world matrix.
+float3 TransformPosition(Instance instance, float3 position)
+{
+    float4 p = float4(position, 1);
+    return float3(dot(p, instance.World[0]), dot(p, instance.World[1]), dot(p, instance.World[2]));
+}
+
+// Transforms an object-space normal by the inverse transpose of the world matrix.
+// The cofactor matrix equals it up to the determinant, whose magnitude is irrelevant
+// since normals are renormalized, but whose sign must be kept for mirroring transforms.
+float3 TransformNormal(Instance instance, float3 normal)
+{
+    float3 a0 = instance.World[0].xyz;
+    float3 a1 = instance.World[1].xyz;
+    float3 a2 = instance.World[2].xyz;
+
+    float3 c0 = cross(a1, a2);
+    float3 n = float3(dot(c0, normal), dot(cross(a2, a0), normal), dot(cross(a0, a1), normal));
+
+    return dot(a0, c0) < 0 ? -n : n;
+}
 
 // Computes visiblity of an instance
 // Performs a simple world-space bounding sphere vs. frustum plane check.
@@ -92,18 +137,29 @@ bool IsVisible(float4 boundingSphere)
     return true;
 }
 
-// Computes the LOD for a given instance.
-// Calculates the spread of the instance's world-space bounding sphere in screen space.
-uint ComputeLOD(float4 boundingSphere)
+// Calculates the spread of the instance's world-space bounding sphere in screen space, at most 1.
+float ScreenSize(float4 boundingSphere)
 {
     float3 v = boundingSphere.xyz - Constants.ViewPosition;
     float r = boundingSphere.w;
 
     // Sphere radius in screen space
     float size = Constants.RecipTanHalfFovy * r / sqrt(dot(v, v) - r * r);
-    size = min(size, 1.0);
+    return min(size, 1.0);
+}
+
+// Contribution culling: instances below the minimum screen size are not worth drawing.
+bool IsContributing(float4 boundingSphere)
+{
+    return ScreenSize(boundingSphere) >= Constants.MinScreenSize;
+}
 
-    return (1.0 - size) * (Constants.LODCount - 1);
+// Computes the LOD for a given instance, among the lodCount LODs of its model.
+// The screen size maps linearly onto the LODs, shifted by the bias of the LOD budget.
+uint ComputeLOD(float4 boundingSphere, uint lodCount)
+{
+    float lod = (1.0 - ScreenSize(boundingSphere)) * (lodCount - 1) + Constants.LODBias;
+    return clamp(lod, 0.0, float(lodCount - 1));
 }
 
 uint DivRoundUp(uint num, uint denom)
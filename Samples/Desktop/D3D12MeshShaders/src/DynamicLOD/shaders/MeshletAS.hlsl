@@ -14,112 +14,101 @@
 // Threadgroup's export payload data
 groupshared Payload s_Payload;
 
-// Working groupshared memory for accumulating counts & offsets (copied to payload)
-groupshared uint s_InstanceCounts[MAX_LOD_LEVELS];
-groupshared uint s_GroupOffsets[MAX_LOD_LEVELS + 1];
-groupshared uint s_InstanceList[AS_GROUP_SIZE];
-groupshared uint s_InstanceOffsets[MAX_LOD_LEVELS + 1];
-
 //----------------------------------------------------------------------------------
 // NOTE: This shader is only intended to be ran as a threadgroup with a single wave.
 //       Thus AS_GROUP_SIZE is defined as the platform's wave size in Shared.h
 
 [RootSignature(ROOT_SIG)]
 [NumThreads(AS_GROUP_SIZE, 1, 1)]
-void main(uint dtid : SV_DispatchThreadID, uint gtid : SV_GroupThreadID, uint gid : SV_GroupID)
+void main(uint gtid : SV_GroupThreadID, uint gid : SV_GroupID)
 {
     // Zero out groupshared memory which requires it.
-    s_InstanceList[gtid] = 0;
-
-    if (gtid == 0)
-    {
-        s_InstanceOffsets[0] = 0;
-        s_GroupOffsets[0] = 0;
-    }
-
-    if (gtid < MAX_LOD_LEVELS)
-    {
-        s_InstanceCounts[gtid] = 0;
-    }
+    s_Payload.InstanceList[gtid] = 0;
 
 
-    // Cull & compact the instances
-    uint lodLevel = MAX_LOD_LEVELS; // LOD level of this thread's instance
-    uint lodOffset = 0;             // Offset into its LOD-level instance list
+    // Cull & select the mesh of this thread's instance
+    uint meshIndex = ~0u; // Mesh of this thread's instance, ~0 if culled
 
-    uint instanceIndex = DrawParams.InstanceOffset + dtid;
-    if (instanceIndex < DrawParams.InstanceCount)
+    // Heavy LODs may leave some threads idle, so that this group's worst case fits in one DispatchMesh.
+    uint instanceIndex = gid * DrawParams.InstancesPerGroup + gtid; // Relative to the batch
+    if (gtid < DrawParams.InstancesPerGroup && instanceIndex < DrawParams.InstanceCount)
     {
-        Instance instance = Instances[instanceIndex];
+        Instance instance = Instances[DrawParams.InstanceOffset + instanceIndex];
+        float4 boundingSphere = GetBoundingSphere(instance);
 
-        if (IsVisible(instance.BoundingSphere))
+        if (IsVisible(boundingSphere) && IsContributing(boundingSphere))
         {
-            lodLevel = ComputeLOD(instance.BoundingSphere);
+            ModelDesc model = Models[GetModel(instance)];
+            uint lod = GetSelectedLOD(instance);
+            meshIndex = model.FirstMesh + (lod < model.LODCount ? lod : ComputeLOD(boundingSphere, model.LODCount));
         }
     }
 
-    // Determine counts for each LOD and each thread's offset into its LOD instance list
-    [unroll]
-    for (uint i = 0; i < MAX_LOD_LEVELS; ++i)
+    // Bucket the instances by mesh, smallest mesh index first. Each pass takes one mesh, so sorted
+    // instances (see instance_sort.h) only loop a few times. Lane b keeps the mesh & count of bucket b.
+    bool pending = meshIndex != ~0u;
+    uint bucketCount = 0;
+    uint bucket = 0;        // Bucket of this thread's instance
+    uint bucketOffset = 0;  // Offset into its bucket's instance list
+    uint laneMesh = 0;
+    uint laneInstanceCount = 0;
+
+    while (WaveActiveAnyTrue(pending))
     {
-        bool lodMatch = lodLevel == i; // Whether this thread's calculated LOD matches the current one.
+        uint bucketMesh = WaveActiveMin(pending ? meshIndex : ~0u);
+        bool meshMatch = pending && meshIndex == bucketMesh;
 
-        if (lodMatch)
+        if (meshMatch)
         {
-            lodOffset = WavePrefixCountBits(lodMatch);
+            bucket = bucketCount;
+            bucketOffset = WavePrefixCountBits(meshMatch);
         }
 
-        s_InstanceCounts[i] = WaveActiveCountBits(lodMatch);
-    }
-
-    // Compute instance and Level-of-detail
-    if (gtid < MAX_LOD_LEVELS)
-    {
-        uint lodInstanceCount = s_InstanceCounts[gtid];
-
-        s_InstanceOffsets[gtid + 1] = lodInstanceCount;
-
-        uint unpackedGroupCount = (MeshInfo[gtid].MeshletCount - 1) * lodInstanceCount;
-
-        uint packCount = min(MAX_VERTS / MeshInfo[gtid].LastMeshletVertCount, MAX_PRIMS / MeshInfo[gtid].LastMeshletPrimCount);
-        uint packedGroupCount = DivRoundUp(lodInstanceCount, packCount);
+        uint matchCount = WaveActiveCountBits(meshMatch);
+        if (gtid == bucketCount)
+        {
+            laneMesh = bucketMesh;
+            laneInstanceCount = matchCount;
+        }
 
-        s_GroupOffsets[gtid + 1] = unpackedGroupCount + packedGroupCount;
+        pending = pending && !meshMatch;
+        ++bucketCount;
     }
 
-    // Accumulate LOD & instance counts to create offset lookup tables for mesh shader threadgroups
-    if (gtid <= MAX_LOD_LEVELS)
+    // Compute the threadgroup count of each bucket
+    uint laneGroupCount = 0;
+    if (gtid < bucketCount)
     {
-        uint instanceCount = s_InstanceOffsets[gtid];
-        s_InstanceOffsets[gtid] = instanceCount + WavePrefixSum(instanceCount);
+        MeshDesc mesh = Meshes[laneMesh];
 
-        uint lodCount = s_GroupOffsets[gtid];
-        s_GroupOffsets[gtid] = lodCount + WavePrefixSum(lodCount);
-    }
+        uint unpackedGroupCount = (mesh.MeshletCount - 1) * laneInstanceCount;
 
-    // Place this thread's instance index at its assigned slot from compaction.
-    if (lodLevel != MAX_LOD_LEVELS)
-    {
-        uint lodStart = s_InstanceOffsets[lodLevel];
+        uint packCount = min(MAX_VERTS / mesh.LastMeshletVertCount, MAX_PRIMS / mesh.LastMeshletPrimCount);
+        uint packedGroupCount = DivRoundUp(laneInstanceCount, packCount);
 
-        s_InstanceList[lodStart + lodOffset] = instanceIndex;
+        laneGroupCount = unpackedGroupCount + packedGroupCount;
     }
 
-    // Copy groupshared memory to payload
-    s_Payload.InstanceList[gtid] = s_InstanceList[gtid];
+    // Accumulate bucket instance & group counts to create offset lookup tables for mesh shader threadgroups
+    s_Payload.MeshIndices[gtid] = laneMesh;
+    s_Payload.InstanceCounts[gtid] = laneInstanceCount;
+    s_Payload.InstanceOffsets[gtid] = WavePrefixSum(laneInstanceCount);
+    s_Payload.GroupOffsets[gtid] = WavePrefixSum(laneGroupCount);
 
-    if (gtid < MAX_LOD_LEVELS)
+    if (gtid == 0)
     {
-        s_Payload.InstanceCounts[gtid] = s_InstanceCounts[gtid];
+        s_Payload.BucketCount = bucketCount;
     }
 
-    if (gtid <= MAX_LOD_LEVELS)
+    // Place this thread's instance index at its assigned slot from compaction.
+    if (meshIndex != ~0u)
     {
-        s_Payload.GroupOffsets[gtid] = s_GroupOffsets[gtid];
-        s_Payload.InstanceOffsets[gtid] = s_InstanceOffsets[gtid];
+        uint bucketStart = s_Payload.InstanceOffsets[bucket];
+
+        s_Payload.InstanceList[bucketStart + bucketOffset] = instanceIndex;
     }
 
-    // NOTE: Be aware that the maximum threadgroup count of a single dimension is 65536.
-    //       This method is limited to an LOD 0 size of (65536 / AS_GROUP_SIZE) meshlets.
-    DispatchMesh(s_GroupOffsets[Constants.LODCount], 1, 1, s_Payload);
+    // NOTE: The maximum threadgroup count of a single dimension is 65535. The CPU dispatch planner
+    //       picks DrawParams.InstancesPerGroup so that no mesh assignment can exceed it.
+    DispatchMesh(WaveActiveSum(laneGroupCount), 1, 1, s_Payload);
 }
@@ -11,10 +11,9 @@
 #include "../shared.h"
 #include "Common.hlsli"
 
-float4 LODColor(float4 boundingSphere)
+float4 LODColor(MeshDesc mesh)
 {
-    uint lodLevel = ComputeLOD(boundingSphere);
-    float alpha = float(lodLevel) / (Constants.LODCount - 1);
+    float alpha = float(mesh.LOD) / max(mesh.LODCount - 1, 1);
 
     return lerp(float4(1, 0, 0, 1), float4(0, 1, 0, 1), alpha);
 }
@@ -25,18 +24,18 @@ uint3 UnpackPrimitive(uint primitive)
     return uint3(primitive & 0x3FF, (primitive >> 10) & 0x3FF, (primitive >> 20) & 0x3FF);
 }
 
-uint3 GetPrimitive(uint lodIndex, Meshlet m, uint index)
+uint3 GetPrimitive(uint meshIndex, Meshlet m, uint index)
 {
-    return UnpackPrimitive(PrimitiveIndices[lodIndex][m.PrimOffset + index]);
+    return UnpackPrimitive(PrimitiveIndices[meshIndex][m.PrimOffset + index]);
 }
 
-uint GetVertexIndex(uint lodIndex, Meshlet m, uint localIndex)
+uint GetVertexIndex(uint meshIndex, MeshDesc mesh, Meshlet m, uint localIndex)
 {
     localIndex = m.VertOffset + localIndex;
 
-    if (MeshInfo[lodIndex].IndexBytes == 4) // 32-bit Vertex Indices
+    if (mesh.IndexBytes == 4) // 32-bit Vertex Indices
     {
-        return UniqueVertexIndices[lodIndex].Load(localIndex * 4);
+        return UniqueVertexIndices[meshIndex].Load(localIndex * 4);
     }
     else // 16-bit Vertex Indices
     {
@@ -45,25 +44,25 @@ uint GetVertexIndex(uint lodIndex, Meshlet m, uint localIndex)
         uint byteOffset = (localIndex / 2) * 4;
 
         // Grab the pair of 16-bit indices, shift & mask off proper 16-bits.
-        uint indexPair = UniqueVertexIndices[lodIndex].Load(byteOffset);
+        uint indexPair = UniqueVertexIndices[meshIndex].Load(byteOffset);
         uint index = (indexPair >> (wordOffset * 16)) & 0xffff;
 
         return index;
     }
 }
 
-VertexOut GetVertexAttributes(uint lodIndex, uint meshletIndex, uint vertexIndex, uint instanceIndex)
+VertexOut GetVertexAttributes(uint meshIndex, MeshDesc mesh, uint meshletIndex, uint vertexIndex, uint instanceIndex)
 {
     Instance n = Instances[DrawParams.InstanceOffset + instanceIndex];
-    Vertex v = Vertices[lodIndex][vertexIndex];
+    Vertex v = Vertices[meshIndex][vertexIndex];
 
-    float4 positionWS = mul(float4(v.Position, 1), n.World);
+    float4 positionWS = float4(TransformPosition(n, v.Position), 1);
 
     VertexOut vout;
     vout.PositionVS   = mul(positionWS, Constants.View).xyz;
     vout.PositionHS   = mul(positionWS, Constants.ViewProj);
-    vout.Normal       = mul(float4(v.Normal, 0), n.WorldInvTranspose).xyz;
-    vout.Color        = LODColor(n.BoundingSphere);
+    vout.Normal       = TransformNormal(n, v.Normal);
+    vout.Color        = LODColor(mesh);
     vout.MeshletIndex = meshletIndex;
 
     return vout;
@@ -80,39 +79,41 @@ void main(
     out vertices VertexOut verts[MAX_VERTS],
     out indices uint3 tris[MAX_PRIMS])
 {
-    // Find the LOD to which this threadgroup is assigned.
+    // Find the bucket to which this threadgroup is assigned.
     // Each wave does this independently to avoid groupshared memory & sync.
     uint offsetCheck = 0;
     uint laneIndex = gtid % WaveGetLaneCount();
 
-    if (laneIndex <= MAX_LOD_LEVELS)
+    if (laneIndex < payload.BucketCount)
     {
         offsetCheck = WaveActiveCountBits(gid >= payload.GroupOffsets[laneIndex]) - 1;
     }
-    uint lodIndex = WaveReadLaneFirst(offsetCheck);
+    uint bucket = WaveReadLaneFirst(offsetCheck);
 
-    // Load our LOD meshlet offset & LOD instance count
-    uint lodOffset = payload.GroupOffsets[lodIndex];
-    uint lodCount = payload.InstanceCounts[lodIndex];
+    // Load our bucket's mesh, meshlet offset & instance count
+    uint meshIndex = payload.MeshIndices[bucket];
+    MeshDesc mesh = Meshes[meshIndex];
+    uint bucketOffset = payload.GroupOffsets[bucket];
+    uint bucketCount = payload.InstanceCounts[bucket];
 
     // Calculate and load our meshlet.
-    uint meshletIndex = (gid - lodOffset) / lodCount;
-    Meshlet m = Meshlets[lodIndex][meshletIndex];
+    uint meshletIndex = (gid - bucketOffset) / bucketCount;
+    Meshlet m = Meshlets[meshIndex][meshletIndex];
 
     // Determine instance count - only 1 instance per threadgroup in the general case
     uint instanceCount = 1;
 
     // Last meshlet in mesh may be be packed - multiple instances rendered from a single threadgroup.
-    if (meshletIndex == MeshInfo[lodIndex].MeshletCount - 1)
+    if (meshletIndex == mesh.MeshletCount - 1)
     {
         // Determine how many packed instances there are in this group
-        uint unpackedGroupCount = (MeshInfo[lodIndex].MeshletCount - 1) * lodCount;
-        uint packedIndex = gid - (unpackedGroupCount + lodOffset);
+        uint unpackedGroupCount = (mesh.MeshletCount - 1) * bucketCount;
+        uint packedIndex = gid - (unpackedGroupCount + bucketOffset);
 
         uint instancesPerGroup = min(MAX_VERTS / m.VertCount, MAX_PRIMS / m.PrimCount);
         uint startInstance = packedIndex * instancesPerGroup;
 
-        instanceCount = min(lodCount - startInstance, instancesPerGroup);
+        instanceCount = min(bucketCount - startInstance, instancesPerGroup);
     }
 
     // Compute our total vertex & primitive counts
@@ -123,29 +124,32 @@ void main(
 
     //--------------------------------------------------------------------
     // Export Primitive & Vertex Data
+    //
+    // Large meshlet limits can exceed MS_MAX_THREADS, threads then loop over the outputs.
+    // With the default limits every thread exports at most one vertex and one primitive.
 
-    if (gtid < totalVertCount)
+    for (uint vertexOut = gtid; vertexOut < totalVertCount; vertexOut += MS_GROUP_SIZE)
     {
-        uint readIndex = gtid % m.VertCount;  // Wrap our reads for packed instancing.
-        uint vertexIndex = GetVertexIndex(lodIndex, m, readIndex);
+        uint readIndex = vertexOut % m.VertCount;  // Wrap our reads for packed instancing.
+        uint vertexIndex = GetVertexIndex(meshIndex, mesh, m, readIndex);
 
         // Determine our instance index
-        uint instanceId = gtid / m.VertCount; // Instance index into this threadgroup's instances (only non-zero for packed threadgroups.)
+        uint instanceId = vertexOut / m.VertCount; // Instance index into this threadgroup's instances (only non-zero for packed threadgroups.)
 
-        uint lodInstance = (gid - lodOffset) % lodCount + instanceId;           // Instance index into this LOD level's instances
-        uint instanceOffset = payload.InstanceOffsets[lodIndex] + lodInstance;  // Instance index into the payload instance list
+        uint bucketInstance = (gid - bucketOffset) % bucketCount + instanceId;      // Instance index into this bucket's instances
+        uint instanceOffset = payload.InstanceOffsets[bucket] + bucketInstance;     // Instance index into the payload instance list
 
         uint instanceIndex = payload.InstanceList[instanceOffset]; // The final instance index of this vertex.
 
-        verts[gtid] = GetVertexAttributes(lodIndex, meshletIndex, vertexIndex, instanceIndex);
+        verts[vertexOut] = GetVertexAttributes(meshIndex, mesh, meshletIndex, vertexIndex, instanceIndex);
     }
 
-    if (gtid < totalPrimCount)
+    for (uint primOut = gtid; primOut < totalPrimCount; primOut += MS_GROUP_SIZE)
     {
-        uint readIndex = gtid % m.PrimCount;  // Wrap our reads for packed instancing.
-        uint instanceId = gtid / m.PrimCount; // Instance index within this threadgroup (only non-zero in last meshlet threadgroups.)
+        uint readIndex = primOut % m.PrimCount;  // Wrap our reads for packed instancing.
+        uint instanceId = primOut / m.PrimCount; // Instance index within this threadgroup (only non-zero in last meshlet threadgroups.)
 
         // Must offset the vertex indices to this thread's instanced verts
-        tris[gtid] = GetPrimitive(lodIndex, m, readIndex) + (m.VertCount * instanceId);
+        tris[primOut] = GetPrimitive(meshIndex, m, readIndex) + (m.VertCount * instanceId);
     }
 }
@@ -6,17 +6,32 @@
 */
 
 #define MAX(x, y) (x > y ? x : y)
+#define MIN(x, y) (x < y ? x : y)
 #define ROUNDUP(x, y) ((x + y - 1) & ~(y - 1))
 
+// Meshlet limits of the pipeline. The shaders are compiled once per supported set, overriding these
+// with -D (see MESHLET_PIPELINES in CMakeLists.txt). The sample reads the set it draws with at run
+// time from its MeshletPipeline; the headless tools use these defaults.
+#ifndef MAX_VERTS
 #define MAX_VERTS 64
+#endif
+#ifndef MAX_PRIMS
 #define MAX_PRIMS 126
+#endif
 #define MAX_LOD_LEVELS 8
 
+#ifndef THREADS_PER_WAVE
 #define THREADS_PER_WAVE 32 // Assumes availability of wave size of 32 threads
+#endif
+
+// D3D12 caps on a mesh shader group: its outputs and its threads.
+#define MESHLET_MAX_VERTS_LIMIT 256
+#define MESHLET_MAX_PRIMS_LIMIT 256
+#define MS_MAX_THREADS 128
 
-// Pre-defined threadgroup sizes for AS & MS stages
+// Pre-defined threadgroup sizes for AS & MS stages. Past MS_MAX_THREADS, mesh shader threads export several vertices and primitives.
 #define AS_GROUP_SIZE THREADS_PER_WAVE
-#define MS_GROUP_SIZE ROUNDUP(MAX(MAX_VERTS, MAX_PRIMS), THREADS_PER_WAVE)
+#define MS_GROUP_SIZE (MIN(ROUNDUP(MAX(MAX_VERTS, MAX_PRIMS), THREADS_PER_WAVE), MS_MAX_THREADS))
 
 #ifndef __HLSL__
 #include <DirectXMathC.h>
@@ -28,10 +43,12 @@ typedef uint32_t uint;
 #endif
 
 
-#ifndef __HLSL__ 
+#if defined(__HLSL__)
+#define CBUFFER_ALIGN
+#elif defined(_MSC_VER)
 #define CBUFFER_ALIGN __declspec(align(256))
 #else
-#define CBUFFER_ALIGN 
+#define CBUFFER_ALIGN __attribute__((aligned(256)))
 #endif
 
 struct CBUFFER_ALIGN Constants
@@ -44,18 +61,47 @@ struct CBUFFER_ALIGN Constants
     float RecipTanHalfFovy;
 
     uint RenderMode;
-    uint LODCount;
+    uint LODCount;        // LOD levels of single-model draws. Multi-model draws read ModelDesc.LODCount instead.
+    float LODBias;        // Added to the LOD ComputeLOD derives from the screen size, see lod_budget.h
+    float MinScreenSize;  // Instances smaller than this on screen are culled as not contributing
 };
 
 struct DrawParams
 {
-    uint InstanceOffset;
-    uint InstanceCount;
+    uint InstanceOffset;    // First instance of this batch
+    uint InstanceCount;     // Instances in this batch
+    uint InstancesPerGroup; // Instances culled by each amplification threadgroup, at most AS_GROUP_SIZE
 };
 
+/*
+* Compact instance encoding (64 bytes), read by every amplification and mesh shader thread.
+* The normal matrix is not stored: shaders derive it from the cofactors of World.
+* Use instance_pack.h to build it on the CPU.
+*/
 struct Instance
 {
-    float4x4 World;
-    float4x4 WorldInvTranspose;
-    float4   BoundingSphere;
+    float4 World[3];      // Rows of the transposed world matrix. The implicit 4th row is (0, 0, 0, 1).
+    float3 SphereCenter;  // World-space bounding sphere center
+    uint   PackedRadius;  // Low 16 bits: bounding sphere radius as a half, rounded up. Bits 16-27: model index.
+                          // Bits 28-31: LOD selected on the CPU plus one, 0 if the shaders select it.
+};
+
+/*
+* One LOD of one model. Meshes are numbered model by model, LOD 0 first, and the bindless descriptor
+* tables hold the buffers of mesh i at index i.
+*/
+struct MeshDesc
+{
+    uint IndexBytes;
+    uint MeshletCount;
+    uint LastMeshletVertCount;
+    uint LastMeshletPrimCount;
+    uint LOD;
+    uint LODCount;        // Of the model this mesh belongs to
+};
+
+struct ModelDesc
+{
+    uint FirstMesh;     // Mesh index of the model's LOD 0
+    uint LODCount;
 };
\ No newline at end of file
@@ -0,0 +1,956 @@
+#include "soft_raster.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include "impostor.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+#define AMPLIFICATION_JOB_SIZE 4096 // Instances culled by one job
+
+static const float c_impostorColor[3] = { 0.0f, 0.5f, 1.0f }; // In the LOD spectrum, past the green of the last LOD
+
+/*****************************************************************
+    Private types
+******************************************************************/
+
+// Output of the mesh stage, in clip space. Attributes are interpolated linearly when clipping.
+typedef struct ClipVertex
+{
+    float Clip[4];
+    float Normal[3];
+    float PositionVS[3];
+} ClipVertex;
+
+// A triangle ready for rasterization. Interpolated attributes are premultiplied by 1/w.
+typedef struct SoftTriangle
+{
+    float    X[3];
+    float    Y[3];
+    float    Z[3];             // Depth, interpolated linearly in screen space
+    float    InvW[3];
+    float    Normal[3][3];
+    float    PositionVS[3][3];
+    float    Color[3];         // Per instance (LOD color)
+    uint32_t MeshletIndex;
+    uint32_t Impostor;         // 1 + index into the chunk's impostors for an impostor quad, whose Normal holds (u, v, 0)
+    float    Area;             // Twice the screen-space area, > 0 for front faces
+} SoftTriangle;
+
+typedef struct SoftImpostor
+{
+    ImpostorViews   Views;
+    const Instance* Instance;
+} SoftImpostor;
+
+typedef struct BinEntry
+{
+    uint32_t Tile;
+    uint32_t Triangle;
+} BinEntry;
+
+// The triangles produced by one mesh stage job, binned per tile.
+struct SoftRasterChunk
+{
+    SoftTriangle* triangles;
+    uint32_t      triangleCount;
+    uint32_t      triangleCapacity;
+
+    BinEntry*     entries;
+    uint32_t      entryCount;
+    uint32_t      entryCapacity;
+
+    uint32_t*     sorted;          // Triangle indices sorted by tile
+    uint32_t      sortedCapacity;
+    uint32_t*     tileStart;       // tilesX * tilesY + 1 offsets into 'sorted'
+
+    SoftImpostor* impostors;
+    uint32_t      impostorCount;
+    uint32_t      impostorCapacity;
+
+    uint64_t      meshlets;
+    uint64_t      exported;        // Triangles exported by the mesh stage
+    bool          failed;          // An allocation failed
+};
+
+typedef struct DrawContext
+{
+    SoftRasterizer*    rast;
+    const Constants*   constants;
+    const Instance*    instances;
+    uint32_t           instanceCount;
+    const uint8_t*     instanceLods;      // rast->instanceLods, or the caller's for SoftRaster_DrawCulled
+    const MeshletMesh* lods;
+    uint32_t           lodCount;
+    uint32_t           visibleCount;
+    uint64_t           meshletTotal;
+    uint32_t           clearColor;
+} DrawContext;
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static float Saturate(float x)
+{
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static void Normalize3(float v[3])
+{
+    const float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    const float inv = len > 0.0f ? 1.0f / len : 0.0f;
+    v[0] *= inv;
+    v[1] *= inv;
+    v[2] *= inv;
+}
+
+static float Dot3(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// mul(float4(p, 1), M) for a matrix stored the way the constant buffer holds it (transposed).
+static float DotRow(const float* const row, const float p[3])
+{
+    return row[0] * p[0] + row[1] * p[1] + row[2] * p[2] + row[3];
+}
+
+static bool Reserve(void** data, uint32_t* capacity, uint32_t needed, size_t elementSize)
+{
+    if (needed <= *capacity)
+    {
+        return true;
+    }
+
+    uint32_t newCapacity = *capacity ? *capacity : 1024;
+    while (newCapacity < needed)
+    {
+        newCapacity *= 2;
+    }
+
+    void* grown = realloc(*data, (size_t)newCapacity * elementSize);
+    if (!grown)
+    {
+        return false;
+    }
+    *data = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+static uint32_t PackColor(float r, float g, float b)
+{
+    const uint32_t ri = (uint32_t)(Saturate(r) * 255.0f + 0.5f);
+    const uint32_t gi = (uint32_t)(Saturate(g) * 255.0f + 0.5f);
+    const uint32_t bi = (uint32_t)(Saturate(b) * 255.0f + 0.5f);
+    return ri | (gi << 8) | (bi << 16) | 0xFF000000u;
+}
+
+// MeshletPS.hlsl
+static uint32_t ShadePixel(uint32_t renderMode, float normal[3], float positionVS[3], const float color[3], uint32_t meshletIndex)
+{
+    if (renderMode == SOFT_RASTER_RENDER_NORMALS)
+    {
+        Normalize3(normal);
+        return PackColor(normal[0] * 0.5f + 0.5f, normal[1] * 0.5f + 0.5f, normal[2] * 0.5f + 0.5f);
+    }
+
+    const float ambientIntensity = 0.1f;
+    const float c = 0.57735027f; // 1 / sqrt(3)
+    const float lightDir[3] = { -c, c, -c };
+
+    float diffuseColor[3];
+    float shininess;
+
+    if (renderMode == 0)
+    {
+        diffuseColor[0] = diffuseColor[1] = diffuseColor[2] = 0.5f;
+        shininess = 4.0f;
+    }
+    else if (renderMode == 1)
+    {
+        diffuseColor[0] = (float)(meshletIndex & 1);
+        diffuseColor[1] = (float)(meshletIndex & 3) / 4;
+        diffuseColor[2] = (float)(meshletIndex & 7) / 8;
+        shininess = 16.0f;
+    }
+    else // Dynamic LOD spectrum (LOD 0 - red, LOD n - green)
+    {
+        diffuseColor[0] = color[0];
+        diffuseColor[1] = color[1];
+        diffuseColor[2] = color[2];
+        shininess = 8.0f;
+    }
+
+    Normalize3(normal);
+
+    const float cosAngle = Saturate(Dot3(normal, lightDir));
+
+    float viewDir[3] = { -positionVS[0], -positionVS[1], -positionVS[2] };
+    Normalize3(viewDir);
+    float halfAngle[3] = { lightDir[0] + viewDir[0], lightDir[1] + viewDir[1], lightDir[2] + viewDir[2] };
+    Normalize3(halfAngle);
+
+    float blinnTerm = Saturate(Dot3(normal, halfAngle));
+    blinnTerm = cosAngle != 0.0f ? blinnTerm : 0.0f;
+    blinnTerm = powf(blinnTerm, shininess);
+
+    const float intensity = cosAngle + blinnTerm + ambientIntensity;
+    return PackColor(intensity * diffuseColor[0], intensity * diffuseColor[1], intensity * diffuseColor[2]);
+}
+
+static uint32_t LoadVertexIndex(const MeshletMesh* const mesh, uint32_t index)
+{
+    const uint8_t* addr = mesh->UniqueVertexIndices + (size_t)index * mesh->IndexSize;
+    if (mesh->IndexSize == 4)
+    {
+        uint32_t value;
+        memcpy(&value, addr, sizeof(value));
+        return value;
+    }
+    uint16_t value;
+    memcpy(&value, addr, sizeof(value));
+    return value;
+}
+
+static ClipVertex LerpVertex(const ClipVertex* const a, const ClipVertex* const b, float t)
+{
+    ClipVertex v;
+    for (int i = 0; i < 4; ++i) v.Clip[i] = a->Clip[i] + (b->Clip[i] - a->Clip[i]) * t;
+    for (int i = 0; i < 3; ++i) v.Normal[i] = a->Normal[i] + (b->Normal[i] - a->Normal[i]) * t;
+    for (int i = 0; i < 3; ++i) v.PositionVS[i] = a->PositionVS[i] + (b->PositionVS[i] - a->PositionVS[i]) * t;
+    return v;
+}
+
+// Clips a triangle against the near plane (z >= 0). Returns the vertex count of the resulting convex polygon (0, 3 or 4).
+static uint32_t ClipNear(const ClipVertex* const in[3], ClipVertex out[4])
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        const ClipVertex* a = in[i];
+        const ClipVertex* b = in[(i + 1) % 3];
+        const bool aInside = a->Clip[2] >= 0.0f;
+        const bool bInside = b->Clip[2] >= 0.0f;
+
+        if (aInside)
+        {
+            out[count++] = *a;
+        }
+        if (aInside != bInside)
+        {
+            const float t = a->Clip[2] / (a->Clip[2] - b->Clip[2]);
+            out[count++] = LerpVertex(a, b, t);
+        }
+    }
+    return count;
+}
+
+// Projects, culls and bins one clipped triangle.
+static void SetupTriangle(SoftRasterizer* const rast, struct SoftRasterChunk* const chunk,
+                          const ClipVertex* const v0, const ClipVertex* const v1, const ClipVertex* const v2,
+                          const float color[3], uint32_t meshletIndex, uint32_t impostor)
+{
+    const ClipVertex* v[3] = { v0, v1, v2 };
+    SoftTriangle tri;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const float invW = 1.0f / v[i]->Clip[3];
+        tri.X[i] = (v[i]->Clip[0] * invW * 0.5f + 0.5f) * (float)rast->width;
+        tri.Y[i] = (0.5f - v[i]->Clip[1] * invW * 0.5f) * (float)rast->height;
+        tri.Z[i] = v[i]->Clip[2] * invW;
+        tri.InvW[i] = invW;
+        for (int k = 0; k < 3; ++k)
+        {
+            tri.Normal[i][k] = v[i]->Normal[k] * invW;
+            tri.PositionVS[i][k] = v[i]->PositionVS[k] * invW;
+        }
+    }
+
+    // Clockwise on screen (y down) is front facing; cull back faces and degenerate triangles.
+    tri.Area = (tri.X[1] - tri.X[0]) * (tri.Y[2] - tri.Y[0]) - (tri.Y[1] - tri.Y[0]) * (tri.X[2] - tri.X[0]);
+    if (!(tri.Area > 0.0f))
+    {
+        return;
+    }
+
+    const float minX = fminf(tri.X[0], fminf(tri.X[1], tri.X[2]));
+    const float maxX = fmaxf(tri.X[0], fmaxf(tri.X[1], tri.X[2]));
+    const float minY = fminf(tri.Y[0], fminf(tri.Y[1], tri.Y[2]));
+    const float maxY = fmaxf(tri.Y[0], fmaxf(tri.Y[1], tri.Y[2]));
+    if (maxX <= 0.0f || maxY <= 0.0f || minX >= (float)rast->width || minY >= (float)rast->height)
+    {
+        return;
+    }
+
+    const int32_t lastTileX = (int32_t)rast->tilesX - 1;
+    const int32_t lastTileY = (int32_t)rast->tilesY - 1;
+    int32_t tx0 = (int32_t)(fmaxf(minX, 0.0f)) / SOFT_RASTER_TILE_SIZE;
+    int32_t ty0 = (int32_t)(fmaxf(minY, 0.0f)) / SOFT_RASTER_TILE_SIZE;
+    int32_t tx1 = (int32_t)(fminf(maxX, (float)rast->width - 1.0f)) / SOFT_RASTER_TILE_SIZE;
+    int32_t ty1 = (int32_t)(fminf(maxY, (float)rast->height - 1.0f)) / SOFT_RASTER_TILE_SIZE;
+    tx1 = tx1 > lastTileX ? lastTileX : tx1;
+    ty1 = ty1 > lastTileY ? lastTileY : ty1;
+
+    const uint32_t tileCount = (uint32_t)((tx1 - tx0 + 1) * (ty1 - ty0 + 1));
+    if (!Reserve((void**)&chunk->triangles, &chunk->triangleCapacity, chunk->triangleCount + 1, sizeof(SoftTriangle)) ||
+        !Reserve((void**)&chunk->entries, &chunk->entryCapacity, chunk->entryCount + tileCount, sizeof(BinEntry)))
+    {
+        chunk->failed = true;
+        return;
+    }
+
+    tri.Color[0] = color[0];
+    tri.Color[1] = color[1];
+    tri.Color[2] = color[2];
+    tri.MeshletIndex = meshletIndex;
+    tri.Impostor = impostor;
+
+    const uint32_t triIndex = chunk->triangleCount++;
+    chunk->triangles[triIndex] = tri;
+
+    for (int32_t ty = ty0; ty <= ty1; ++ty)
+    {
+        for (int32_t tx = tx0; tx <= tx1; ++tx)
+        {
+            chunk->entries[chunk->entryCount++] = (BinEntry){ (uint32_t)(ty * (int32_t)rast->tilesX + tx), triIndex };
+        }
+    }
+}
+
+// Rejects, clips and sets up one triangle of the mesh stage.
+static void EmitTriangle(SoftRasterizer* const rast, struct SoftRasterChunk* const chunk, const ClipVertex* const tri[3],
+                         const float color[3], uint32_t meshletIndex, uint32_t impostor)
+{
+    // Trivially reject triangles entirely outside one of the side or far planes.
+    bool outside = false;
+    for (int axis = 0; axis < 3 && !outside; ++axis)
+    {
+        outside = (tri[0]->Clip[axis] > tri[0]->Clip[3] && tri[1]->Clip[axis] > tri[1]->Clip[3] && tri[2]->Clip[axis] > tri[2]->Clip[3]) ||
+                  (axis < 2 && tri[0]->Clip[axis] < -tri[0]->Clip[3] && tri[1]->Clip[axis] < -tri[1]->Clip[3] && tri[2]->Clip[axis] < -tri[2]->Clip[3]);
+    }
+    if (outside)
+    {
+        return;
+    }
+
+    ClipVertex clipped[4];
+    const uint32_t count = ClipNear(tri, clipped);
+    for (uint32_t k = 2; k < count; ++k)
+    {
+        SetupTriangle(rast, chunk, &clipped[0], &clipped[k - 1], &clipped[k], color, meshletIndex, impostor);
+    }
+}
+
+// A quad facing the eye over the instance's bounding sphere, in the basis its impostor views were baked with.
+static void EmitImpostor(DrawContext* const ctx, struct SoftRasterChunk* const chunk, const Instance* const instance)
+{
+    SoftRasterizer* rast = ctx->rast;
+    if (!Reserve((void**)&chunk->impostors, &chunk->impostorCapacity, chunk->impostorCount + 1, sizeof(SoftImpostor)))
+    {
+        chunk->failed = true;
+        return;
+    }
+
+    // The world matrix is stored transposed: World[k][j] maps object axis j to world axis k. Directions go to
+    // object space through the transpose of its 3x3 part, exact for rotations; scale is normalized away.
+    const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(instance);
+    const float* world = &instance->World[0].x;
+    const float toEye[3] =
+    {
+        ctx->constants->ViewPosition.x - sphere.x,
+        ctx->constants->ViewPosition.y - sphere.y,
+        ctx->constants->ViewPosition.z - sphere.z,
+    };
+    const XMFLOAT3 direction =
+    {
+        world[0] * toEye[0] + world[4] * toEye[1] + world[8] * toEye[2],
+        world[1] * toEye[0] + world[5] * toEye[1] + world[9] * toEye[2],
+        world[2] * toEye[0] + world[6] * toEye[1] + world[10] * toEye[2],
+    };
+
+    SoftImpostor* impostor = &chunk->impostors[chunk->impostorCount++];
+    impostor->Instance = instance;
+    Impostor_SelectViews(rast->impostors, direction, &impostor->Views);
+
+    XMFLOAT3 rightOS, upOS;
+    Impostor_Basis(direction, &rightOS, &upOS);
+    float right[3] =
+    {
+        world[0] * rightOS.x + world[1] * rightOS.y + world[2] * rightOS.z,
+        world[4] * rightOS.x + world[5] * rightOS.y + world[6] * rightOS.z,
+        world[8] * rightOS.x + world[9] * rightOS.y + world[10] * rightOS.z,
+    };
+    float up[3] =
+    {
+        world[0] * upOS.x + world[1] * upOS.y + world[2] * upOS.z,
+        world[4] * upOS.x + world[5] * upOS.y + world[6] * upOS.z,
+        world[8] * upOS.x + world[9] * upOS.y + world[10] * upOS.z,
+    };
+    Normalize3(right);
+    Normalize3(up);
+
+    // Corners clockwise from the top left, with their texture coordinates.
+    const float* view = (const float*)&ctx->constants->View;
+    const float* viewProj = (const float*)&ctx->constants->ViewProj;
+    const float corners[4][2] = { { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, -1.0f }, { -1.0f, -1.0f } };
+    ClipVertex verts[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float sx = corners[i][0] * sphere.w;
+        const float sy = corners[i][1] * sphere.w;
+        const float positionWS[3] =
+        {
+            sphere.x + sx * right[0] + sy * up[0],
+            sphere.y + sx * right[1] + sy * up[1],
+            sphere.z + sx * right[2] + sy * up[2],
+        };
+        for (int k = 0; k < 4; ++k)
+        {
+            verts[i].Clip[k] = DotRow(viewProj + 4 * k, positionWS);
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            verts[i].PositionVS[k] = DotRow(view + 4 * k, positionWS);
+        }
+        verts[i].Normal[0] = corners[i][0] * 0.5f + 0.5f;
+        verts[i].Normal[1] = 0.5f - corners[i][1] * 0.5f;
+        verts[i].Normal[2] = 0.0f;
+    }
+
+    const ClipVertex* first[3] = { &verts[0], &verts[1], &verts[2] };
+    const ClipVertex* second[3] = { &verts[0], &verts[2], &verts[3] };
+    EmitTriangle(rast, chunk, first, c_impostorColor, 0, chunk->impostorCount);
+    EmitTriangle(rast, chunk, second, c_impostorColor, 0, chunk->impostorCount);
+    chunk->exported += 2;
+}
+
+// Counting sort of a chunk's bin entries by tile.
+static void SortBins(SoftRasterizer* const rast, struct SoftRasterChunk* const chunk)
+{
+    const uint32_t tileCount = rast->tilesX * rast->tilesY;
+
+    if (!Reserve((void**)&chunk->sorted, &chunk->sortedCapacity, chunk->entryCount, sizeof(uint32_t)))
+    {
+        chunk->failed = true;
+        return;
+    }
+
+    memset(chunk->tileStart, 0, (tileCount + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < chunk->entryCount; ++i)
+    {
+        chunk->tileStart[chunk->entries[i].Tile + 1]++;
+    }
+    for (uint32_t t = 0; t < tileCount; ++t)
+    {
+        chunk->tileStart[t + 1] += chunk->tileStart[t];
+    }
+
+    // Fill in order, using tileStart as the write cursor, then shift it back.
+    for (uint32_t i = 0; i < chunk->entryCount; ++i)
+    {
+        chunk->sorted[chunk->tileStart[chunk->entries[i].Tile]++] = chunk->entries[i].Triangle;
+    }
+    for (uint32_t t = tileCount; t > 0; --t)
+    {
+        chunk->tileStart[t] = chunk->tileStart[t - 1];
+    }
+    chunk->tileStart[0] = 0;
+}
+
+// Amplification stage: cull and select the LOD of a block of instances.
+static void AmplificationJob(void* context, uint32_t index)
+{
+    DrawContext* ctx = context;
+    const uint32_t begin = index * AMPLIFICATION_JOB_SIZE;
+    const uint32_t end = begin + AMPLIFICATION_JOB_SIZE < ctx->instanceCount ? begin + AMPLIFICATION_JOB_SIZE : ctx->instanceCount;
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&ctx->instances[i]);
+        ctx->rast->instanceLods[i] = InstanceCull_IsVisible(ctx->constants, sphere) && InstanceCull_IsContributing(ctx->constants, sphere)
+            ? (uint8_t)InstanceCull_ComputeLOD(ctx->constants, sphere)
+            : SOFT_RASTER_CULLED;
+    }
+}
+
+// Mesh stage: a contiguous range of the (visible instance, meshlet) pairs of the frame.
+static void MeshJob(void* context, uint32_t index)
+{
+    DrawContext* ctx = context;
+    SoftRasterizer* rast = ctx->rast;
+    struct SoftRasterChunk* chunk = &rast->chunks[index];
+
+    chunk->triangleCount = 0;
+    chunk->entryCount = 0;
+    chunk->impostorCount = 0;
+    chunk->meshlets = 0;
+    chunk->exported = 0;
+    chunk->failed = false;
+
+    const uint64_t begin = ctx->meshletTotal * index / SOFT_RASTER_CHUNK_COUNT;
+    const uint64_t end = ctx->meshletTotal * (index + 1) / SOFT_RASTER_CHUNK_COUNT;
+
+    // First visible instance whose meshlet range contains 'begin'.
+    uint32_t lo = 0;
+    uint32_t hi = ctx->visibleCount;
+    while (lo < hi)
+    {
+        const uint32_t mid = (lo + hi) / 2;
+        if (rast->visibleMeshlets[mid + 1] <= begin) lo = mid + 1;
+        else hi = mid;
+    }
+
+    const float* view = (const float*)&ctx->constants->View;
+    const float* viewProj = (const float*)&ctx->constants->ViewProj;
+    ClipVertex verts[MESHLET_MAX_VERTS_LIMIT];  // Whatever meshlet variant the meshes were loaded with
+
+    uint64_t unit = begin;
+    for (uint32_t v = lo; v < ctx->visibleCount && unit < end; ++v)
+    {
+        const uint32_t instanceIndex = rast->visible[v];
+        const Instance* instance = &ctx->instances[instanceIndex];
+        const uint32_t lod = rast->visibleLods[v];
+
+        // A single work unit.
+        if (lod == SOFT_RASTER_IMPOSTOR)
+        {
+            EmitImpostor(ctx, chunk, instance);
+            ++unit;
+            continue;
+        }
+        const MeshletMesh* mesh = &ctx->lods[lod];
+
+        // LODColor in MeshletMS.hlsl
+        const float alpha = ctx->lodCount > 1 ? (float)lod / (float)(ctx->lodCount - 1) : 0.0f;
+        const float color[3] = { 1.0f - alpha, alpha, 0.0f };
+
+        const uint32_t firstMeshlet = (uint32_t)(unit - rast->visibleMeshlets[v]);
+        const uint32_t lastMeshlet = (uint32_t)((end < rast->visibleMeshlets[v + 1] ? end : rast->visibleMeshlets[v + 1]) - rast->visibleMeshlets[v]);
+
+        for (uint32_t meshletIndex = firstMeshlet; meshletIndex < lastMeshlet; ++meshletIndex, ++unit)
+        {
+            const Meshlet* m = &mesh->Meshlets[meshletIndex];
+
+            for (uint32_t i = 0; i < m->VertCount; ++i)
+            {
+                const uint32_t vertexIndex = LoadVertexIndex(mesh, m->VertOffset + i);
+                const uint8_t* src = mesh->Vertices + (size_t)vertexIndex * mesh->VertexStride;
+
+                float position[3];
+                XMFLOAT3 normal;
+                memcpy(position, src, sizeof(position));
+                memcpy(&normal, src + sizeof(position), sizeof(normal));
+
+                const float* world = &instance->World[0].x;
+                const float positionWS[3] = { DotRow(world, position), DotRow(world + 4, position), DotRow(world + 8, position) };
+                const XMFLOAT3 normalWS = Instance_TransformNormal(instance, normal);
+
+                ClipVertex* out = &verts[i];
+                for (int k = 0; k < 4; ++k)
+                {
+                    out->Clip[k] = DotRow(viewProj + 4 * k, positionWS);
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    out->PositionVS[k] = DotRow(view + 4 * k, positionWS);
+                }
+                out->Normal[0] = normalWS.x;
+                out->Normal[1] = normalWS.y;
+                out->Normal[2] = normalWS.z;
+            }
+
+            for (uint32_t p = 0; p < m->PrimCount; ++p)
+            {
+                const uint32_t packed = mesh->PrimitiveIndices[m->PrimOffset + p];
+                const ClipVertex* tri[3] = { &verts[packed & 0x3FF], &verts[(packed >> 10) & 0x3FF], &verts[(packed >> 20) & 0x3FF] };
+                EmitTriangle(rast, chunk, tri, color, meshletIndex, 0);
+            }
+
+            chunk->meshlets++;
+            chunk->exported += m->PrimCount;
+        }
+    }
+
+    SortBins(rast, chunk);
+}
+
+static bool IsTopLeft(float ax, float ay, float bx, float by)
+{
+    // For clockwise triangles on a y-down screen, top edges go right and left edges go up.
+    return (ay == by && bx > ax) || by < ay;
+}
+
+// Alpha test and normal of an impostor pixel: the blended atlas normal, to world space like the mesh normals.
+static bool SampleImpostor(const ImpostorAtlas* const atlas, const SoftImpostor* const impostor, float u, float v, float normal[3])
+{
+    XMFLOAT3 normalOS;
+    if (Impostor_Sample(atlas, &impostor->Views, u, v, &normalOS) < 0.5f)
+    {
+        return false;
+    }
+    const XMFLOAT3 normalWS = Instance_TransformNormal(impostor->Instance, normalOS);
+    normal[0] = normalWS.x;
+    normal[1] = normalWS.y;
+    normal[2] = normalWS.z;
+    return true;
+}
+
+// 'impostor' is the quad's entry for impostor triangles, NULL for mesh triangles.
+static void RasterTriangle(SoftRasterizer* const rast, const SoftTriangle* const tri, const SoftImpostor* const impostor,
+                           uint32_t renderMode, int32_t tileX0, int32_t tileY0, int32_t tileX1, int32_t tileY1,
+                           uint64_t* const shaded)
+{
+    int32_t x0 = (int32_t)floorf(fminf(tri->X[0], fminf(tri->X[1], tri->X[2])));
+    int32_t y0 = (int32_t)floorf(fminf(tri->Y[0], fminf(tri->Y[1], tri->Y[2])));
+    int32_t x1 = (int32_t)ceilf(fmaxf(tri->X[0], fmaxf(tri->X[1], tri->X[2])));
+    int32_t y1 = (int32_t)ceilf(fmaxf(tri->Y[0], fmaxf(tri->Y[1], tri->Y[2])));
+    x0 = x0 < tileX0 ? tileX0 : x0;
+    y0 = y0 < tileY0 ? tileY0 : y0;
+    x1 = x1 > tileX1 ? tileX1 : x1;
+    y1 = y1 > tileY1 ? tileY1 : y1;
+    if (x0 >= x1 || y0 >= y1)
+    {
+        return;
+    }
+
+    // Edge i is opposite to vertex i: E(p) = (b - a) x (p - a), positive inside.
+    float dx[3], dy[3], rowE[3];
+    bool topLeft[3];
+    const float px = (float)x0 + 0.5f;
+    const float py = (float)y0 + 0.5f;
+    for (int i = 0; i < 3; ++i)
+    {
+        const int a = (i + 1) % 3;
+        const int b = (i + 2) % 3;
+        dx[i] = tri->X[b] - tri->X[a];
+        dy[i] = tri->Y[b] - tri->Y[a];
+        rowE[i] = dx[i] * (py - tri->Y[a]) - dy[i] * (px - tri->X[a]);
+        topLeft[i] = IsTopLeft(tri->X[a], tri->Y[a], tri->X[b], tri->Y[b]);
+    }
+
+    const float invArea = 1.0f / tri->Area;
+
+    for (int32_t y = y0; y < y1; ++y)
+    {
+        float e[3] = { rowE[0], rowE[1], rowE[2] };
+        uint32_t* colorRow = rast->color + (size_t)y * rast->width;
+        float* depthRow = rast->depth + (size_t)y * rast->width;
+
+        for (int32_t x = x0; x < x1; ++x)
+        {
+            const bool inside =
+                (e[0] > 0.0f || (e[0] == 0.0f && topLeft[0])) &&
+                (e[1] > 0.0f || (e[1] == 0.0f && topLeft[1])) &&
+                (e[2] > 0.0f || (e[2] == 0.0f && topLeft[2]));
+
+            if (inside)
+            {
+                const float b0 = e[0] * invArea;
+                const float b1 = e[1] * invArea;
+                const float b2 = e[2] * invArea;
+                const float z = b0 * tri->Z[0] + b1 * tri->Z[1] + b2 * tri->Z[2];
+
+                if (z >= 0.0f && z <= 1.0f && z < depthRow[x])
+                {
+                    const float w = 1.0f / (b0 * tri->InvW[0] + b1 * tri->InvW[1] + b2 * tri->InvW[2]);
+                    float normal[3], positionVS[3];
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        normal[k] = (b0 * tri->Normal[0][k] + b1 * tri->Normal[1][k] + b2 * tri->Normal[2][k]) * w;
+                        positionVS[k] = (b0 * tri->PositionVS[0][k] + b1 * tri->PositionVS[1][k] + b2 * tri->PositionVS[2][k]) * w;
+                    }
+
+                    // Impostor quads interpolate their texture coordinates in place of the normal, and discard uncovered pixels.
+                    if (!impostor || SampleImpostor(rast->impostors, impostor, normal[0], normal[1], normal))
+                    {
+                        depthRow[x] = z;
+                        colorRow[x] = ShadePixel(renderMode, normal, positionVS, tri->Color, tri->MeshletIndex);
+                        ++*shaded;
+                    }
+                }
+            }
+
+            e[0] -= dy[0];
+            e[1] -= dy[1];
+            e[2] -= dy[2];
+        }
+
+        rowE[0] += dx[0];
+        rowE[1] += dx[1];
+        rowE[2] += dx[2];
+    }
+}
+
+static void TileRect(const SoftRasterizer* const rast, uint32_t tile, int32_t* x0, int32_t* y0, int32_t* x1, int32_t* y1)
+{
+    *x0 = (int32_t)((tile % rast->tilesX) * SOFT_RASTER_TILE_SIZE);
+    *y0 = (int32_t)((tile / rast->tilesX) * SOFT_RASTER_TILE_SIZE);
+    *x1 = *x0 + SOFT_RASTER_TILE_SIZE < (int32_t)rast->width ? *x0 + SOFT_RASTER_TILE_SIZE : (int32_t)rast->width;
+    *y1 = *y0 + SOFT_RASTER_TILE_SIZE < (int32_t)rast->height ? *y0 + SOFT_RASTER_TILE_SIZE : (int32_t)rast->height;
+}
+
+// Raster stage: all the triangles of one tile, in chunk order so the result is deterministic.
+static void RasterJob(void* context, uint32_t tile)
+{
+    DrawContext* ctx = context;
+    SoftRasterizer* rast = ctx->rast;
+
+    int32_t x0, y0, x1, y1;
+    TileRect(rast, tile, &x0, &y0, &x1, &y1);
+
+    uint64_t shaded = 0;
+    for (uint32_t c = 0; c < SOFT_RASTER_CHUNK_COUNT; ++c)
+    {
+        const struct SoftRasterChunk* chunk = &rast->chunks[c];
+        for (uint32_t i = chunk->tileStart[tile]; i < chunk->tileStart[tile + 1]; ++i)
+        {
+            const SoftTriangle* tri = &chunk->triangles[chunk->sorted[i]];
+            const SoftImpostor* impostor = tri->Impostor ? &chunk->impostors[tri->Impostor - 1] : NULL;
+            RasterTriangle(rast, tri, impostor, ctx->constants->RenderMode, x0, y0, x1, y1, &shaded);
+        }
+    }
+    rast->tilePixels[tile] = shaded;
+}
+
+static void ClearJob(void* context, uint32_t tile)
+{
+    DrawContext* ctx = context;
+    SoftRasterizer* rast = ctx->rast;
+
+    int32_t x0, y0, x1, y1;
+    TileRect(rast, tile, &x0, &y0, &x1, &y1);
+
+    for (int32_t y = y0; y < y1; ++y)
+    {
+        for (int32_t x = x0; x < x1; ++x)
+        {
+            rast->color[(size_t)y * rast->width + x] = ctx->clearColor;
+            rast->depth[(size_t)y * rast->width + x] = 1.0f;
+        }
+    }
+}
+
+static bool ReserveInstances(SoftRasterizer* const rast, uint32_t instanceCount)
+{
+    if (instanceCount > rast->instanceCapacity)
+    {
+        uint8_t* instanceLods = realloc(rast->instanceLods, instanceCount * sizeof(uint8_t));
+        if (instanceLods) rast->instanceLods = instanceLods;
+        uint32_t* visible = realloc(rast->visible, instanceCount * sizeof(uint32_t));
+        if (visible) rast->visible = visible;
+        uint8_t* visibleLods = realloc(rast->visibleLods, instanceCount * sizeof(uint8_t));
+        if (visibleLods) rast->visibleLods = visibleLods;
+        uint64_t* visibleMeshlets = realloc(rast->visibleMeshlets, ((size_t)instanceCount + 1) * sizeof(uint64_t));
+        if (visibleMeshlets) rast->visibleMeshlets = visibleMeshlets;
+
+        if (!instanceLods || !visible || !visibleLods || !visibleMeshlets)
+        {
+            return false;
+        }
+        rast->instanceCapacity = instanceCount;
+    }
+    return true;
+}
+
+// Mesh and raster stages, once ctx->instanceLods holds the LOD of every instance.
+static bool DrawInstances(SoftRasterizer* const rast, DrawContext* const ctx, SoftRasterStats* const stats)
+{
+    // Compact the visible instances; the prefix sum lets the mesh jobs split work by meshlet count. An impostor
+    // counts as one meshlet.
+    rast->visibleMeshlets[0] = 0;
+    for (uint32_t i = 0; i < ctx->instanceCount; ++i)
+    {
+        uint8_t lod = ctx->instanceLods[i];
+        if (lod != SOFT_RASTER_CULLED)
+        {
+            if (rast->impostors && lod + 1u == ctx->lodCount &&
+                InstanceCull_ScreenSize(ctx->constants, Instance_UnpackBoundingSphere(&ctx->instances[i])) < rast->impostorScreenSize)
+            {
+                lod = SOFT_RASTER_IMPOSTOR;
+            }
+
+            rast->visible[ctx->visibleCount] = i;
+            rast->visibleLods[ctx->visibleCount] = lod;
+            rast->visibleMeshlets[ctx->visibleCount + 1] = rast->visibleMeshlets[ctx->visibleCount] +
+                (lod == SOFT_RASTER_IMPOSTOR ? 1 : ctx->lods[lod].MeshletCount);
+            ctx->visibleCount++;
+        }
+    }
+    ctx->meshletTotal = rast->visibleMeshlets[ctx->visibleCount];
+
+    JobSystem_ParallelFor(rast->jobs, SOFT_RASTER_CHUNK_COUNT, MeshJob, ctx);
+
+    for (uint32_t c = 0; c < SOFT_RASTER_CHUNK_COUNT; ++c)
+    {
+        const struct SoftRasterChunk* chunk = &rast->chunks[c];
+        if (chunk->failed)
+        {
+            return false;
+        }
+        stats->Meshlets += chunk->meshlets;
+        stats->Triangles += chunk->exported;
+        stats->RasterTriangles += chunk->triangleCount;
+        stats->BinEntries += chunk->entryCount;
+        stats->Impostors += chunk->impostorCount;
+    }
+
+    const uint32_t tileCount = rast->tilesX * rast->tilesY;
+    JobSystem_ParallelFor(rast->jobs, tileCount, RasterJob, ctx);
+
+    stats->VisibleInstances = ctx->visibleCount;
+    for (uint32_t t = 0; t < tileCount; ++t)
+    {
+        stats->PixelsShaded += rast->tilePixels[t];
+    }
+    return true;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool SoftRaster_Init(SoftRasterizer* const rast, JobSystem* const jobs, uint32_t width, uint32_t height)
+{
+    *rast = (SoftRasterizer){
+        .jobs = jobs,
+        .width = width,
+        .height = height,
+        .tilesX = (width + SOFT_RASTER_TILE_SIZE - 1) / SOFT_RASTER_TILE_SIZE,
+        .tilesY = (height + SOFT_RASTER_TILE_SIZE - 1) / SOFT_RASTER_TILE_SIZE,
+    };
+
+    const uint32_t tileCount = rast->tilesX * rast->tilesY;
+    rast->color = malloc((size_t)width * height * sizeof(uint32_t));
+    rast->depth = malloc((size_t)width * height * sizeof(float));
+    rast->tilePixels = calloc(tileCount, sizeof(uint64_t));
+    rast->chunks = calloc(SOFT_RASTER_CHUNK_COUNT, sizeof(struct SoftRasterChunk));
+    if (!rast->color || !rast->depth || !rast->tilePixels || !rast->chunks)
+    {
+        SoftRaster_Destroy(rast);
+        return false;
+    }
+
+    for (uint32_t c = 0; c < SOFT_RASTER_CHUNK_COUNT; ++c)
+    {
+        rast->chunks[c].tileStart = calloc(tileCount + 1, sizeof(uint32_t));
+        if (!rast->chunks[c].tileStart)
+        {
+            SoftRaster_Destroy(rast);
+            return false;
+        }
+    }
+
+    SoftRaster_Clear(rast, 0);
+    return true;
+}
+
+void SoftRaster_Destroy(SoftRasterizer* const rast)
+{
+    if (rast->chunks)
+    {
+        for (uint32_t c = 0; c < SOFT_RASTER_CHUNK_COUNT; ++c)
+        {
+            free(rast->chunks[c].triangles);
+            free(rast->chunks[c].entries);
+            free(rast->chunks[c].sorted);
+            free(rast->chunks[c].tileStart);
+            free(rast->chunks[c].impostors);
+        }
+    }
+
+    free(rast->chunks);
+    free(rast->tilePixels);
+    free(rast->color);
+    free(rast->depth);
+    free(rast->instanceLods);
+    free(rast->visible);
+    free(rast->visibleLods);
+    free(rast->visibleMeshlets);
+    *rast = (SoftRasterizer){ 0 };
+}
+
+void SoftRaster_SetImpostors(SoftRasterizer* const rast, const ImpostorAtlas* const atlas, float screenSize)
+{
+    rast->impostors = atlas;
+    rast->impostorScreenSize = screenSize;
+}
+
+void SoftRaster_Clear(SoftRasterizer* const rast, uint32_t color)
+{
+    DrawContext ctx = { .rast = rast, .clearColor = color };
+    JobSystem_ParallelFor(rast->jobs, rast->tilesX * rast->tilesY, ClearJob, &ctx);
+}
+
+bool SoftRaster_Draw(SoftRasterizer* const rast, const Constants* const constants, const Instance* const instances,
+                     uint32_t instanceCount, const MeshletMesh* const lods, SoftRasterStats* const stats)
+{
+    *stats = (SoftRasterStats){ 0 };
+    if (!ReserveInstances(rast, instanceCount))
+    {
+        return false;
+    }
+
+    DrawContext ctx = {
+        .rast = rast,
+        .constants = constants,
+        .instances = instances,
+        .instanceCount = instanceCount,
+        .instanceLods = rast->instanceLods,
+        .lods = lods,
+        .lodCount = constants->LODCount,
+    };
+
+    JobSystem_ParallelFor(rast->jobs, (instanceCount + AMPLIFICATION_JOB_SIZE - 1) / AMPLIFICATION_JOB_SIZE, AmplificationJob, &ctx);
+    return DrawInstances(rast, &ctx, stats);
+}
+
+bool SoftRaster_DrawCulled(SoftRasterizer* const rast, const Constants* const constants, const Instance* const instances,
+                           uint32_t instanceCount, const uint8_t* const instanceLods, const MeshletMesh* const lods,
+                           SoftRasterStats* const stats)
+{
+    *stats = (SoftRasterStats){ 0 };
+    if (!ReserveInstances(rast, instanceCount))
+    {
+        return false;
+    }
+
+    DrawContext ctx = {
+        .rast = rast,
+        .constants = constants,
+        .instances = instances,
+        .instanceCount = instanceCount,
+        .instanceLods = instanceLods,
+        .lods = lods,
+        .lodCount = constants->LODCount,
+    };
+    return DrawInstances(rast, &ctx, stats);
+}
+
+bool SoftRaster_WritePPM(const SoftRasterizer* const rast, const char* const path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", rast->width, rast->height);
+    for (size_t i = 0; i < (size_t)rast->width * rast->height; ++i)
+    {
+        const uint32_t c = rast->color[i];
+        const uint8_t rgb[3] = { (uint8_t)(c & 0xFF), (uint8_t)((c >> 8) & 0xFF), (uint8_t)((c >> 16) & 0xFF) };
+        fwrite(rgb, 1, sizeof(rgb), file);
+    }
+
+    const bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+#include "meshlet_mesh.h"
+#include "job_system.h"
+
+typedef struct Constants Constants;
+typedef struct Instance Instance;
+typedef struct ImpostorAtlas ImpostorAtlas;
+
+#define SOFT_RASTER_TILE_SIZE   64   // Square screen tiles, in pixels
+#define SOFT_RASTER_CHUNK_COUNT 256  // Mesh stage work items per frame. Fixed, so the output does not depend on the thread count.
+#define SOFT_RASTER_CULLED      0xFF // instanceLods value of culled instances
+#define SOFT_RASTER_IMPOSTOR    0xFE // Drawn as a quad of the impostor atlas instead of its LOD
+
+// Constants.RenderMode writing the normal, scaled to [0, 1], with full coverage instead of shading. Used to bake impostors.
+#define SOFT_RASTER_RENDER_NORMALS 0xFFFFFFFFu
+
+typedef struct SoftRasterStats
+{
+    uint64_t VisibleInstances;   // Instances passing the amplification stage
+    uint64_t Meshlets;           // Meshlets processed by the mesh stage, over all visible instances
+    uint64_t Triangles;          // Triangles exported by the mesh stage
+    uint64_t RasterTriangles;    // Triangles left after clipping and back-face culling
+    uint64_t BinEntries;         // Triangle/tile pairs
+    uint64_t PixelsShaded;       // Pixels passing the depth test
+    uint64_t Impostors;          // Visible instances drawn as impostors, two triangles each
+} SoftRasterStats;
+
+struct SoftRasterChunk;
+
+/****************************************************************************************************
+ * Multi-threaded, tile-binned CPU implementation of the DynamicLOD meshlet pipeline.               *
+ *                                                                                                  *
+ * A frame runs in three parallel passes over the job system:                                       *
+ *   1. amplification: frustum culling and LOD selection of every instance, as in MeshletAS.hlsl;   *
+ *   2. mesh: meshlet vertex transform and primitive assembly as in MeshletMS.hlsl, then near-plane *
+ *      clipping, back-face culling and binning of the triangles into screen tiles;                 *
+ *   3. raster: each tile rasterizes its triangles, depth tests and shades them as MeshletPS.hlsl.  *
+ *                                                                                                  *
+ * Rasterization follows the D3D12 rules the sample relies on: clockwise front faces, back faces    *
+ * culled, top-left fill rule, LESS depth test and pixel centers at half-integer coordinates.       *
+ *                                                                                                  *
+ * With an impostor atlas set, visible instances at the last LOD whose screen size is below the     *
+ * impostor threshold skip their meshlets: the mesh stage emits a camera-facing quad over their     *
+ * bounding sphere instead, which the raster stage alpha tests and lights from the atlas normals.   *
+ ****************************************************************************************************/
+typedef struct SoftRasterizer
+{
+    JobSystem*              jobs;
+
+    uint32_t                width;
+    uint32_t                height;
+    uint32_t                tilesX;
+    uint32_t                tilesY;
+
+    uint32_t*               color;             // RGBA8 (R in the low byte), width * height
+    float*                  depth;             // Depth in [0, 1], cleared to 1
+
+    struct SoftRasterChunk* chunks;            // SOFT_RASTER_CHUNK_COUNT
+    uint64_t*               tilePixels;        // Pixels shaded per tile this frame
+
+    const ImpostorAtlas*    impostors;         // NULL to always draw meshes
+    float                   impostorScreenSize;
+
+    uint8_t*                instanceLods;      // LOD per instance, SOFT_RASTER_CULLED if culled
+    uint32_t*               visible;           // Indices of the visible instances
+    uint8_t*                visibleLods;       // LOD drawn for each visible instance, or SOFT_RASTER_IMPOSTOR
+    uint64_t*               visibleMeshlets;   // Prefix sum of the meshlet counts of the visible instances
+    uint32_t                instanceCapacity;
+} SoftRasterizer;
+
+bool SoftRaster_Init         (SoftRasterizer* const rast, JobSystem* const jobs, uint32_t width, uint32_t height);
+void SoftRaster_Destroy      (SoftRasterizer* const rast);
+
+// Draws the last LOD below 'screenSize' as impostors from then on; NULL for no impostors. The atlas must outlive its use.
+void SoftRaster_SetImpostors (SoftRasterizer* const rast, const ImpostorAtlas* const atlas, float screenSize);
+
+// Clears the color buffer to 'color' (RGBA8) and the depth buffer to 1.
+void SoftRaster_Clear        (SoftRasterizer* const rast, uint32_t color);
+
+/****************************************************************************************************
+ * Draws 'instanceCount' instances with the shader constants of a frame. 'lods' holds one mesh per  *
+ * LOD, constants->LODCount of them. Returns false on allocation failure.                           *
+ ****************************************************************************************************/
+bool SoftRaster_Draw         (SoftRasterizer* const rast, const Constants* const constants, const Instance* const instances,
+                              uint32_t instanceCount, const MeshletMesh* const lods, SoftRasterStats* const stats);
+
+/****************************************************************************************************
+ * Same, but skips the amplification stage: 'instanceLods' already holds the LOD of every instance, *
+ * SOFT_RASTER_CULLED for culled ones, e.g. from a VisibilityCache.                                 *
+ ****************************************************************************************************/
+bool SoftRaster_DrawCulled   (SoftRasterizer* const rast, const Constants* const constants, const Instance* const instances,
+                              uint32_t instanceCount, const uint8_t* const instanceLods, const MeshletMesh* const lods,
+                              SoftRasterStats* const stats);
+
+// Writes the color buffer as a binary PPM image.
+bool SoftRaster_WritePPM     (const SoftRasterizer* const rast, const char* const path);
@@ -0,0 +1,369 @@
+/*************************************************************************************
+ Headless software renderer.
+
+ Loads the LOD chain and builds the same instance cube and per-frame constants as the
+ sample, then renders frames with the CPU implementation of the meshlet pipeline,
+ prints the per-stage counts and timings, and writes the last frame as a PPM image.
+ No window and no GPU are needed.
+
+ With visibilityCache set to 1, culling and LOD selection go through a VisibilityCache
+ instead of the amplification stage. The camera moves 'dolly' units forward per frame.
+ With occlusion set to 1, the instances the cache keeps are then tested against a masked
+ software occlusion buffer drawn with the coarsest LOD, approximate at occluder edges
+ (see masked_occlusion.h); it implies visibilityCache.
+ The per-frame statistics are written to stats, as JSON if its name ends in .json and
+ as CSV otherwise. With animationSpeed above 0, every instance moves every frame, at
+ up to that many model radii per second of a 60 Hz frame. With lodTargetMs or
+ lodTriangleBudget above 0, a LodBudget adjusts the LOD bias and minimum screen size
+ to hold them, and the visibility cache applies LOD hysteresis. With cullViews above 0,
+ the instances are also frustum culled against that many views, the camera turned by
+ equal yaw steps, in a single MultiFrustum pass, then once per view for comparison.
+ The instances follow the SceneGen layout named by 'layout', generated from 'seed'.
+ With impostorScreenSize above 0, an impostor atlas is baked from a mid LOD at startup,
+ and visible instances at the last LOD below that screen size are drawn as impostors.
+
+ Usage: SoftRaster [instanceLevel] [threads] [frames] [renderMode] [output.ppm]
+                   [visibilityCache] [dolly] [occlusion] [stats.csv|stats.json]
+                   [animationSpeed] [lodTargetMs] [lodTriangleBudget] [cullViews]
+                   [layout] [seed] [impostorScreenSize]
+        layouts: cube (default), random, clustered, terrain, corridor, flythrough
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "model.h"
+#include "sample_commons.h"
+#include "scene_gen.h"
+#include "view_constants.h"
+#include "job_system.h"
+#include "soft_raster.h"
+#include "visibility_cache.h"
+#include "masked_occlusion.h"
+#include "frame_stats.h"
+#include "instance_animation.h"
+#include "lod_budget.h"
+#include "multi_frustum.h"
+#include "impostor.h"
+
+#define SimLodCount 6
+
+static const uint32_t c_width = 1280;
+static const uint32_t c_height = 720;
+static const float c_fovy = XM_PI / 3.0f;
+static const uint32_t c_clearColor = 0xFF663300; // { 0.0f, 0.2f, 0.4f, 1.0f } as in the sample
+static const uint32_t c_occlusionWidth = 320;     // Whole 32x8 tiles, close to the aspect ratio of the frame
+static const uint32_t c_occlusionHeight = 184;
+static const float c_frameSeconds = 1.0f / 60.0f; // Animation time step
+static const uint32_t c_impostorBakeLod = 2;      // Plenty of detail for a 64 pixel view
+
+static double ElapsedMs(const struct timespec* const start, const struct timespec* const end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e3 + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t level = argc > 1 ? (uint32_t)atoi(argv[1]) : 10;
+    const uint32_t threadCount = argc > 2 ? (uint32_t)atoi(argv[2]) : 0;
+    const uint32_t frameCount = argc > 3 ? (uint32_t)atoi(argv[3]) : 10;
+    const uint32_t renderMode = argc > 4 ? (uint32_t)atoi(argv[4]) : 2;
+    const char* outputPath = argc > 5 ? argv[5] : "SoftRaster.ppm";
+    const float dolly = argc > 7 ? (float)atof(argv[7]) : 0.0f;
+    const bool useOcclusion = argc > 8 && atoi(argv[8]) != 0;
+    const bool useCache = useOcclusion || (argc > 6 && atoi(argv[6]) != 0);
+    const char* statsPath = argc > 9 ? argv[9] : NULL;
+    const float animationSpeed = argc > 10 ? (float)atof(argv[10]) : 0.0f;
+    const float lodTargetMs = argc > 11 ? (float)atof(argv[11]) : 0.0f;
+    const uint64_t lodTriangleBudget = argc > 12 ? strtoull(argv[12], NULL, 10) : 0;
+    const bool useBudget = lodTargetMs > 0.0f || lodTriangleBudget > 0;
+    uint32_t cullViews = argc > 13 ? (uint32_t)atoi(argv[13]) : 0;
+    cullViews = cullViews < MULTI_FRUSTUM_MAX_VIEWS ? cullViews : MULTI_FRUSTUM_MAX_VIEWS;
+    SceneLayout layout = SceneLayoutCube;
+    if (argc > 14 && !SceneGen_ParseLayout(argv[14], &layout))
+    {
+        fprintf(stderr, "Unknown scene layout %s\n", argv[14]);
+        return EXIT_FAILURE;
+    }
+    const uint32_t seed = argc > 15 ? (uint32_t)strtoul(argv[15], NULL, 10) : 1;
+    const float impostorScreenSize = argc > 16 ? (float)atof(argv[16]) : 0.0f;
+
+    WCHAR basePath[512];
+    GetCurrentPath(basePath, _countof(basePath));
+
+    Model lods[SimLodCount] = { 0 };
+    MeshletMesh meshes[SimLodCount];
+    for (uint32_t i = 0; i < SimLodCount; ++i)
+    {
+        wchar_t assetPath[64];
+        swprintf(assetPath, _countof(assetPath), L"lod_assets/Dragon_LOD%u.bin", i);
+
+        HRESULT hr = Model_LoadFromFile(&lods[i], basePath, assetPath);
+        if (FAILED(hr))
+        {
+            fprintf(stderr, "Failed to load %ls (0x%08X)\n", assetPath, (unsigned)hr);
+            return EXIT_FAILURE;
+        }
+        meshes[i] = Mesh_GetMeshletView(&lods[i].meshes[0]);
+    }
+
+    const uint32_t instanceCount = SceneGen_CubeCount(level);
+    Instance* instances = malloc(instanceCount * sizeof(Instance));
+    if (!instances)
+    {
+        fprintf(stderr, "Out of memory for %u instances\n", instanceCount);
+        return EXIT_FAILURE;
+    }
+    SceneGen_Generate(instances, layout, level, lods[0].boundingSphere.r, seed);
+
+    Constants constants = { 0 };
+    VisibilityCache cache = { 0 };
+    JobSystem jobs;
+    SoftRasterizer rast;
+    MaskedOcclusion occlusion;
+    FrameStatsRing frameStats;
+    InstanceAnimation animation;
+    MultiFrustum multiFrustum;
+    if (!FrameStatsRing_Init(&frameStats, frameCount, SimLodCount) || !JobSystem_Init(&jobs, threadCount) || !SoftRaster_Init(&rast, &jobs, c_width, c_height) ||
+        !MaskedOcclusion_Init(&occlusion, &jobs, c_occlusionWidth, c_occlusionHeight) || !MultiFrustum_Init(&multiFrustum, &jobs) ||
+        !MaskedOcclusion_SetOccluderMesh(&occlusion, &meshes[SimLodCount - 1]))
+    {
+        fprintf(stderr, "Failed to create the software rasterizer\n");
+        return EXIT_FAILURE;
+    }
+
+    InstanceAnimation_Init(&animation, &jobs);
+    if (animationSpeed > 0.0f && !InstanceAnimation_Start(&animation, instances, instanceCount, animationSpeed * lods[0].boundingSphere.r, 1))
+    {
+        fprintf(stderr, "Out of memory for %u animated instances\n", instanceCount);
+        return EXIT_FAILURE;
+    }
+    DirtyRanges moved;
+    DirtyRanges_Clear(&moved);
+
+    // Centered on the origin, like the instance spheres of SceneGen.
+    ImpostorAtlas impostors = { 0 };
+    double bakeMs = 0.0;
+    if (impostorScreenSize > 0.0f)
+    {
+        struct timespec bakeStart, bakeEnd;
+        timespec_get(&bakeStart, TIME_UTC);
+        if (!Impostor_Bake(&impostors, &jobs, &meshes[c_impostorBakeLod], (XMFLOAT4){ 0.0f, 0.0f, 0.0f, lods[0].boundingSphere.r },
+                IMPOSTOR_DEFAULT_VIEWS, IMPOSTOR_DEFAULT_CELL_SIZE))
+        {
+            fprintf(stderr, "Out of memory baking the impostors\n");
+            return EXIT_FAILURE;
+        }
+        timespec_get(&bakeEnd, TIME_UTC);
+        bakeMs = ElapsedMs(&bakeStart, &bakeEnd);
+        SoftRaster_SetImpostors(&rast, &impostors, impostorScreenSize);
+    }
+
+    LodBudget budget;
+    LodBudget_Init(&budget, lodTargetMs, lodTriangleBudget);
+    cache.hysteresis = useBudget ? LOD_BUDGET_HYSTERESIS : 0.0f;
+    uint32_t budgetChanges = 0;
+
+    SoftRasterStats stats = { 0 };
+    VisibilityCacheStats cacheStats = { 0 };
+    MaskedOcclusionStats occlusionStats = { 0 };
+    uint64_t retested = 0;
+    uint64_t occluded = 0;
+    double cullMs = 0.0;
+    double occlusionMs = 0.0;
+    double animationMs = 0.0;
+    MultiFrustumStats viewStats = { 0 };
+    double multiFrustumMs = 0.0;
+    double perViewMs = 0.0;
+    double totalMs = 0.0;
+    double bestMs = 0.0;
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+        ViewConstants_Build(&constants, (XMFLOAT3){ 0, 75, 150 - dolly * (float)frame }, (XMFLOAT3){ 0, 0, -1 }, (XMFLOAT3){ 0, 1, 0 },
+            c_fovy, (float)c_width / (float)c_height, 1.0f, 1e4f);
+        constants.RenderMode = renderMode;
+        constants.LODCount = SimLodCount;
+        LodBudget_Apply(&budget, &constants);
+
+        struct timespec start, animated, culled, occludedEnd, end;
+        timespec_get(&start, TIME_UTC);
+
+        InstanceAnimation_Update(&animation, instances, c_frameSeconds, &moved);
+        timespec_get(&animated, TIME_UTC);
+        animationMs += ElapsedMs(&start, &animated);
+
+        SoftRaster_Clear(&rast, c_clearColor);
+        const uint8_t* instanceLods;
+        bool ok = true;
+        if (useCache)
+        {
+            for (uint32_t i = 0; ok && i < moved.count; ++i)
+            {
+                ok = VisibilityCache_Invalidate(&cache, moved.ranges[i].Begin, moved.ranges[i].End - moved.ranges[i].Begin);
+            }
+            ok = ok && VisibilityCache_Update(&cache, &constants, instances, instanceCount, &cacheStats);
+            timespec_get(&culled, TIME_UTC);
+
+            instanceLods = cache.lods;
+            if (ok && useOcclusion)
+            {
+                ok = MaskedOcclusion_Cull(&occlusion, &constants, instances, instanceCount, cache.lods, &occlusionStats);
+                timespec_get(&occludedEnd, TIME_UTC);
+                instanceLods = occlusion.lods;
+
+                occlusionMs += ElapsedMs(&culled, &occludedEnd);
+                occluded += occlusionStats.Occluded;
+            }
+            ok = ok && SoftRaster_DrawCulled(&rast, &constants, instances, instanceCount, instanceLods, meshes, &stats);
+
+            cullMs += frame > 0 ? ElapsedMs(&animated, &culled) : 0.0;
+            retested += frame > 0 ? cacheStats.Retested : 0;
+        }
+        else
+        {
+            ok = SoftRaster_Draw(&rast, &constants, instances, instanceCount, meshes, &stats);
+            instanceLods = rast.instanceLods;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "Out of memory while rendering\n");
+            return EXIT_FAILURE;
+        }
+
+        timespec_get(&end, TIME_UTC);
+        const double ms = ElapsedMs(&start, &end);
+        totalMs += ms;
+        bestMs = frame == 0 || ms < bestMs ? ms : bestMs;
+
+        // Outside the frame time: nothing is drawn from the other views.
+        if (cullViews > 0)
+        {
+            XMFLOAT4 planes[MULTI_FRUSTUM_MAX_VIEWS][6];
+            for (uint32_t v = 0; v < cullViews; ++v)
+            {
+                const float yaw = 2.0f * XM_PI * (float)v / (float)cullViews;
+                Constants view = { 0 };
+                ViewConstants_Build(&view, constants.ViewPosition, (XMFLOAT3){ -sinf(yaw), 0, -cosf(yaw) }, (XMFLOAT3){ 0, 1, 0 },
+                    c_fovy, (float)c_width / (float)c_height, 1.0f, 1e4f);
+                memcpy(planes[v], view.Planes, sizeof(planes[v]));
+            }
+
+            struct timespec multiEnd, perViewEnd;
+            MultiFrustum_SetViews(&multiFrustum, planes, cullViews);
+            ok = MultiFrustum_Cull(&multiFrustum, instances, instanceCount, &viewStats);
+            timespec_get(&multiEnd, TIME_UTC);
+
+            MultiFrustumStats singleStats;
+            for (uint32_t v = 0; ok && v < cullViews; ++v)
+            {
+                MultiFrustum_SetViews(&multiFrustum, &planes[v], 1);
+                ok = MultiFrustum_Cull(&multiFrustum, instances, instanceCount, &singleStats);
+            }
+            timespec_get(&perViewEnd, TIME_UTC);
+            if (!ok)
+            {
+                fprintf(stderr, "Out of memory while culling %u views\n", cullViews);
+                return EXIT_FAILURE;
+            }
+
+            multiFrustumMs += ElapsedMs(&end, &multiEnd);
+            perViewMs += ElapsedMs(&multiEnd, &perViewEnd);
+        }
+
+        // Counted outside the timed region. No draw calls: everything stays on the CPU. The upload
+        // is what the sample would copy for the instances that moved.
+        FrameStats* frameStat = FrameStatsRing_Begin(&frameStats);
+        FrameStats_CountLods(frameStat, instanceLods, instanceCount);
+        frameStat->Meshlets = stats.Meshlets;
+        frameStat->Triangles = stats.Triangles;
+        frameStat->BytesUploaded = (uint64_t)DirtyRanges_ElementCount(&moved) * sizeof(Instance);
+        frameStat->LodBias = constants.LODBias;
+        frameStat->MinScreenSize = constants.MinScreenSize;
+        FrameStatsRing_End(&frameStats, ms);
+        DirtyRanges_Clear(&moved);
+
+        budgetChanges += useBudget && LodBudget_Update(&budget, ms, stats.Triangles);
+    }
+
+    printf("level %u, %u instances (%s, seed %u), %u worker threads, %ux%u\n", level, instanceCount, SceneGen_LayoutName(layout), seed,
+        threadCount, c_width, c_height);
+    printf("visible instances  %llu\n", (unsigned long long)stats.VisibleInstances);
+    printf("meshlets           %llu\n", (unsigned long long)stats.Meshlets);
+    printf("triangles          %llu\n", (unsigned long long)stats.Triangles);
+    printf("raster triangles   %llu\n", (unsigned long long)stats.RasterTriangles);
+    printf("bin entries        %llu\n", (unsigned long long)stats.BinEntries);
+    printf("pixels shaded      %llu\n", (unsigned long long)stats.PixelsShaded);
+    if (impostorScreenSize > 0.0f)
+    {
+        printf("impostors          %llu, %ux%u views baked in %.1f ms\n", (unsigned long long)stats.Impostors,
+            impostors.viewsPerSide, impostors.viewsPerSide, bakeMs);
+    }
+    if (frameCount > 0)
+    {
+        printf("frame time         %.2f ms average, %.2f ms best over %u frames\n", totalMs / frameCount, bestMs, frameCount);
+    }
+    if (useCache && frameCount > 1)
+    {
+        // The first frame fills the cache with a full pass.
+        printf("visibility cache   %.0f instances retested, %.3f ms per frame after the first\n",
+            (double)retested / (frameCount - 1), cullMs / (frameCount - 1));
+    }
+    if (useOcclusion && frameCount > 0)
+    {
+        printf("occlusion          %.0f instances occluded by %u occluders (%u triangles), %.3f ms per frame\n",
+            (double)occluded / frameCount, occlusionStats.Occluders, occlusionStats.OccluderTriangles, occlusionMs / frameCount);
+    }
+
+    if (animationSpeed > 0.0f && frameCount > 0)
+    {
+        printf("animation          %u instances moved, %.3f ms per frame\n", instanceCount, animationMs / frameCount);
+    }
+
+    if (cullViews > 0 && frameCount > 0)
+    {
+        printf("multi-frustum      %u views, %u instances visible in any, %.3f ms per frame in one pass, %.3f ms in one pass per view\n",
+            cullViews, viewStats.VisibleAny, multiFrustumMs / frameCount, perViewMs / frameCount);
+        for (uint32_t v = 0; v < cullViews; ++v)
+        {
+            printf("  view %2u          %u visible\n", v, viewStats.Visible[v]);
+        }
+    }
+
+    if (useBudget)
+    {
+        printf("lod budget         bias %.2f, min screen size %.4f, load %.2f after %u changes\n",
+            budget.bias, budget.minScreenSize, budget.load, budgetChanges);
+    }
+
+    if (!SoftRaster_WritePPM(&rast, outputPath))
+    {
+        fprintf(stderr, "Failed to write %s\n", outputPath);
+    }
+    if (statsPath)
+    {
+        const size_t length = strlen(statsPath);
+        const bool json = length >= 5 && strcmp(statsPath + length - 5, ".json") == 0;
+        if (!(json ? FrameStatsRing_WriteJson(&frameStats, statsPath) : FrameStatsRing_WriteCsv(&frameStats, statsPath)))
+        {
+            fprintf(stderr, "Failed to write %s\n", statsPath);
+        }
+    }
+
+    MaskedOcclusion_Destroy(&occlusion);
+    MultiFrustum_Destroy(&multiFrustum);
+    Impostor_Destroy(&impostors);
+    FrameStatsRing_Destroy(&frameStats);
+    InstanceAnimation_Destroy(&animation);
+    VisibilityCache_Destroy(&cache);
+    SoftRaster_Destroy(&rast);
+    JobSystem_Destroy(&jobs);
+    free(instances);
+    for (uint32_t i = 0; i < SimLodCount; ++i)
+    {
+        free(lods[i].meshes);
+        free(lods[i].buffer);
+    }
+    return EXIT_SUCCESS;
+}
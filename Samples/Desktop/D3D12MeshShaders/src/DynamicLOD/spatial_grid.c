@@ -0,0 +1,561 @@
+#include "spatial_grid.h"
+#include "instance_pack.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+#define CELL_COORD_LIMIT 0xFFFFF // Cell coordinates are clamped to +-2^20, 21 bits each in the hash key
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static bool Grow(void** data, uint32_t* capacity, uint32_t needed, size_t elementSize)
+{
+    if (needed <= *capacity)
+    {
+        return true;
+    }
+
+    uint32_t newCapacity = *capacity ? *capacity : 16;
+    while (newCapacity < needed)
+    {
+        newCapacity *= 2;
+    }
+
+    void* grown = realloc(*data, (size_t)newCapacity * elementSize);
+    if (!grown)
+    {
+        return false;
+    }
+    *data = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+static int32_t CellCoord(const SpatialGrid* const grid, float x)
+{
+    const float c = floorf(x * grid->invCellSize);
+    if (!(c > -CELL_COORD_LIMIT)) return -CELL_COORD_LIMIT; // Also catches NaN
+    if (c > CELL_COORD_LIMIT) return CELL_COORD_LIMIT;
+    return (int32_t)c;
+}
+
+static uint32_t HashSlot(const SpatialGrid* const grid, int32_t x, int32_t y, int32_t z)
+{
+    const uint64_t key =
+        ((uint64_t)(x + CELL_COORD_LIMIT) << 42) |
+        ((uint64_t)(y + CELL_COORD_LIMIT) << 21) |
+        (uint64_t)(z + CELL_COORD_LIMIT);
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (grid->tableSize - 1);
+}
+
+static uint32_t FindCell(const SpatialGrid* const grid, int32_t x, int32_t y, int32_t z)
+{
+    if (grid->tableSize == 0)
+    {
+        return SPATIAL_GRID_NONE;
+    }
+
+    for (uint32_t slot = HashSlot(grid, x, y, z);; slot = (slot + 1) & (grid->tableSize - 1))
+    {
+        const uint32_t index = grid->table[slot];
+        if (index == SPATIAL_GRID_NONE)
+        {
+            return SPATIAL_GRID_NONE;
+        }
+        const SpatialGridCell* cell = &grid->cells[index];
+        if (cell->X == x && cell->Y == y && cell->Z == z)
+        {
+            return index;
+        }
+    }
+}
+
+static bool Rehash(SpatialGrid* const grid, uint32_t tableSize)
+{
+    uint32_t* table = malloc(tableSize * sizeof(uint32_t));
+    if (!table)
+    {
+        return false;
+    }
+    memset(table, 0xFF, tableSize * sizeof(uint32_t));
+
+    free(grid->table);
+    grid->table = table;
+    grid->tableSize = tableSize;
+
+    for (uint32_t i = 0; i < grid->cellCount; ++i)
+    {
+        const SpatialGridCell* cell = &grid->cells[i];
+        uint32_t slot = HashSlot(grid, cell->X, cell->Y, cell->Z);
+        while (grid->table[slot] != SPATIAL_GRID_NONE)
+        {
+            slot = (slot + 1) & (grid->tableSize - 1);
+        }
+        grid->table[slot] = i;
+    }
+    return true;
+}
+
+static uint32_t FindOrAddCell(SpatialGrid* const grid, int32_t x, int32_t y, int32_t z)
+{
+    const uint32_t found = FindCell(grid, x, y, z);
+    if (found != SPATIAL_GRID_NONE)
+    {
+        return found;
+    }
+
+    if (!Grow((void**)&grid->cells, &grid->cellCapacity, grid->cellCount + 1, sizeof(SpatialGridCell)))
+    {
+        return SPATIAL_GRID_NONE;
+    }
+
+    // Keep the load factor at or below 1/2.
+    if ((grid->cellCount + 1) * 2 > grid->tableSize && !Rehash(grid, grid->tableSize ? grid->tableSize * 2 : 64))
+    {
+        return SPATIAL_GRID_NONE;
+    }
+
+    const int32_t coords[3] = { x, y, z };
+    for (int i = 0; i < 3; ++i)
+    {
+        grid->cellMin[i] = grid->cellCount == 0 || coords[i] < grid->cellMin[i] ? coords[i] : grid->cellMin[i];
+        grid->cellMax[i] = grid->cellCount == 0 || coords[i] > grid->cellMax[i] ? coords[i] : grid->cellMax[i];
+    }
+
+    const uint32_t index = grid->cellCount++;
+    grid->cells[index] = (SpatialGridCell){ .X = x, .Y = y, .Z = z };
+
+    uint32_t slot = HashSlot(grid, x, y, z);
+    while (grid->table[slot] != SPATIAL_GRID_NONE)
+    {
+        slot = (slot + 1) & (grid->tableSize - 1);
+    }
+    grid->table[slot] = index;
+    return index;
+}
+
+static bool AddEntry(SpatialGrid* const grid, uint32_t cellIndex, uint32_t instance, XMFLOAT4 sphere)
+{
+    SpatialGridCell* cell = &grid->cells[cellIndex];
+    if (!Grow((void**)&cell->entries, &cell->capacity, cell->count + 1, sizeof(SpatialGridEntry)))
+    {
+        return false;
+    }
+
+    const uint32_t slot = cell->count++;
+    cell->entries[slot] = (SpatialGridEntry){ sphere, instance };
+    grid->locations[instance] = (SpatialGridLocation){ cellIndex, slot };
+    grid->maxRadius = fmaxf(grid->maxRadius, sphere.w);
+    return true;
+}
+
+static void RemoveEntry(SpatialGrid* const grid, SpatialGridLocation location)
+{
+    SpatialGridCell* cell = &grid->cells[location.Cell];
+    const uint32_t last = --cell->count;
+    if (location.Slot != last)
+    {
+        cell->entries[location.Slot] = cell->entries[last];
+        grid->locations[cell->entries[location.Slot].Instance].Slot = location.Slot;
+    }
+}
+
+static bool Append(SpatialGridResults* const results, uint32_t instance)
+{
+    if (!Grow((void**)&results->indices, &results->capacity, results->count + 1, sizeof(uint32_t)))
+    {
+        return false;
+    }
+    results->indices[results->count++] = instance;
+    return true;
+}
+
+static bool AppendCell(SpatialGridResults* const results, const SpatialGridCell* const cell)
+{
+    if (!Grow((void**)&results->indices, &results->capacity, results->count + cell->count, sizeof(uint32_t)))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < cell->count; ++i)
+    {
+        results->indices[results->count++] = cell->entries[i].Instance;
+    }
+    return true;
+}
+
+static bool SphereInFrustum(const XMFLOAT4 planes[6], XMFLOAT4 sphere)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4 p = planes[i];
+        if (p.x * sphere.x + p.y * sphere.y + p.z * sphere.z + p.w < -sphere.w)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool SpheresOverlap(XMFLOAT4 a, XMFLOAT4 b)
+{
+    const float dx = a.x - b.x;
+    const float dy = a.y - b.y;
+    const float dz = a.z - b.z;
+    const float r = a.w + b.w;
+    return dx * dx + dy * dy + dz * dz <= r * r;
+}
+
+/****************************************************************************************************
+ * Range of cells holding every sphere center that can pass the frustum test: the bounding box of   *
+ * the frustum with its planes pushed out by maxRadius, clipped to the occupied cells. Each corner   *
+ * solves one plane of each pair. Returns false if two of the planes are parallel, as with a        *
+ * frustum open on one side, and the caller sweeps the occupied cells instead.                      *
+ ****************************************************************************************************/
+static bool FrustumCellRange(const SpatialGrid* const grid, const XMFLOAT4 planes[6], int32_t lo[3], int32_t hi[3])
+{
+    double boxMin[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+    double boxMax[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const XMFLOAT4 a = planes[corner & 1], b = planes[2 + ((corner >> 1) & 1)], c = planes[4 + (corner >> 2)];
+
+        // n_a . x = -(w_a + maxRadius), and so on: x = -(w_a' (n_b x n_c) + w_b' (n_c x n_a) + w_c' (n_a x n_b)) / det.
+        const double bc[3] = { (double)b.y * c.z - (double)b.z * c.y, (double)b.z * c.x - (double)b.x * c.z, (double)b.x * c.y - (double)b.y * c.x };
+        const double ca[3] = { (double)c.y * a.z - (double)c.z * a.y, (double)c.z * a.x - (double)c.x * a.z, (double)c.x * a.y - (double)c.y * a.x };
+        const double ab[3] = { (double)a.y * b.z - (double)a.z * b.y, (double)a.z * b.x - (double)a.x * b.z, (double)a.x * b.y - (double)a.y * b.x };
+        const double det = a.x * bc[0] + a.y * bc[1] + a.z * bc[2];
+        if (!(fabs(det) > 1e-6))
+        {
+            return false;
+        }
+
+        const double wa = a.w + grid->maxRadius, wb = b.w + grid->maxRadius, wc = c.w + grid->maxRadius;
+        for (int i = 0; i < 3; ++i)
+        {
+            const double x = -(wa * bc[i] + wb * ca[i] + wc * ab[i]) / det;
+            boxMin[i] = fmin(boxMin[i], x);
+            boxMax[i] = fmax(boxMax[i], x);
+        }
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        // Padded for the float rounding of the plane test, and clamped like CellCoord but in double: the
+        // box of a far plane may overflow a float cell index.
+        const double padMin = 1e-4 * (fabs(boxMin[i]) + grid->cellSize), padMax = 1e-4 * (fabs(boxMax[i]) + grid->cellSize);
+        const double cellLo = floor((boxMin[i] - padMin) * grid->invCellSize), cellHi = floor((boxMax[i] + padMax) * grid->invCellSize);
+        lo[i] = cellLo > grid->cellMin[i] ? (int32_t)fmin(cellLo, CELL_COORD_LIMIT) : grid->cellMin[i];
+        hi[i] = cellHi < grid->cellMax[i] ? (int32_t)fmax(cellHi, -CELL_COORD_LIMIT) : grid->cellMax[i];
+    }
+    return true;
+}
+
+// Appends the entries of a cell passing the frustum test, testing none of them if the whole cell is inside.
+static bool QueryFrustumCell(const SpatialGrid* const grid, const SpatialGridCell* const cell, const XMFLOAT4 planes[6],
+                             SpatialGridResults* const results)
+{
+    const float half = grid->cellSize * 0.5f;
+    const float cx = ((float)cell->X + 0.5f) * grid->cellSize;
+    const float cy = ((float)cell->Y + 0.5f) * grid->cellSize;
+    const float cz = ((float)cell->Z + 0.5f) * grid->cellSize;
+
+    // Centers lie in the cell box and spheres reach at most maxRadius beyond it.
+    bool inside = true;
+    for (int i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4 p = planes[i];
+        const float d = p.x * cx + p.y * cy + p.z * cz + p.w;
+        const float extent = (fabsf(p.x) + fabsf(p.y) + fabsf(p.z)) * half;
+        if (d + extent + grid->maxRadius < 0.0f)
+        {
+            return true;
+        }
+        inside = inside && d - extent >= 0.0f;
+    }
+
+    if (inside)
+    {
+        return AppendCell(results, cell);
+    }
+
+    for (uint32_t i = 0; i < cell->count; ++i)
+    {
+        if (SphereInFrustum(planes, cell->entries[i].Sphere) && !Append(results, cell->entries[i].Instance))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool SpatialGrid_Init(SpatialGrid* const grid, float cellSize)
+{
+    if (!(cellSize > 0.0f))
+    {
+        return false;
+    }
+
+    *grid = (SpatialGrid){
+        .cellSize = cellSize,
+        .invCellSize = 1.0f / cellSize,
+    };
+    return true;
+}
+
+void SpatialGrid_Destroy(SpatialGrid* const grid)
+{
+    for (uint32_t i = 0; i < grid->cellCount; ++i)
+    {
+        free(grid->cells[i].entries);
+    }
+    free(grid->cells);
+    free(grid->table);
+    free(grid->locations);
+    *grid = (SpatialGrid){ 0 };
+}
+
+void SpatialGrid_Clear(SpatialGrid* const grid)
+{
+    for (uint32_t i = 0; i < grid->cellCount; ++i)
+    {
+        free(grid->cells[i].entries);
+    }
+    grid->cellCount = 0;
+    grid->maxRadius = 0.0f;
+    grid->instanceCount = 0;
+
+    if (grid->table)
+    {
+        memset(grid->table, 0xFF, grid->tableSize * sizeof(uint32_t));
+    }
+    if (grid->locations)
+    {
+        memset(grid->locations, 0xFF, grid->locationCapacity * sizeof(SpatialGridLocation));
+    }
+}
+
+bool SpatialGrid_Build(SpatialGrid* const grid, const Instance* const instances, uint32_t count)
+{
+    SpatialGrid_Clear(grid);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!SpatialGrid_Insert(grid, i, Instance_UnpackBoundingSphere(&instances[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SpatialGrid_Insert(SpatialGrid* const grid, uint32_t instance, XMFLOAT4 sphere)
+{
+    if (instance < grid->locationCapacity && grid->locations[instance].Cell != SPATIAL_GRID_NONE)
+    {
+        return SpatialGrid_Move(grid, instance, sphere);
+    }
+
+    const uint32_t oldCapacity = grid->locationCapacity;
+    if (!Grow((void**)&grid->locations, &grid->locationCapacity, instance + 1, sizeof(SpatialGridLocation)))
+    {
+        return false;
+    }
+    memset(grid->locations + oldCapacity, 0xFF, (grid->locationCapacity - oldCapacity) * sizeof(SpatialGridLocation));
+
+    const uint32_t cell = FindOrAddCell(grid, CellCoord(grid, sphere.x), CellCoord(grid, sphere.y), CellCoord(grid, sphere.z));
+    if (cell == SPATIAL_GRID_NONE || !AddEntry(grid, cell, instance, sphere))
+    {
+        return false;
+    }
+    grid->instanceCount++;
+    return true;
+}
+
+bool SpatialGrid_Move(SpatialGrid* const grid, uint32_t instance, XMFLOAT4 sphere)
+{
+    if (instance >= grid->locationCapacity || grid->locations[instance].Cell == SPATIAL_GRID_NONE)
+    {
+        return SpatialGrid_Insert(grid, instance, sphere);
+    }
+
+    const SpatialGridLocation location = grid->locations[instance];
+    const uint32_t cell = FindOrAddCell(grid, CellCoord(grid, sphere.x), CellCoord(grid, sphere.y), CellCoord(grid, sphere.z));
+    if (cell == SPATIAL_GRID_NONE)
+    {
+        return false;
+    }
+
+    if (cell == location.Cell)
+    {
+        grid->cells[cell].entries[location.Slot].Sphere = sphere;
+        grid->maxRadius = fmaxf(grid->maxRadius, sphere.w);
+        return true;
+    }
+
+    // Make room first, so a failure leaves the instance where it was.
+    SpatialGridCell* target = &grid->cells[cell];
+    if (!Grow((void**)&target->entries, &target->capacity, target->count + 1, sizeof(SpatialGridEntry)))
+    {
+        return false;
+    }
+    RemoveEntry(grid, location);
+    return AddEntry(grid, cell, instance, sphere);
+}
+
+void SpatialGrid_Remove(SpatialGrid* const grid, uint32_t instance)
+{
+    if (instance >= grid->locationCapacity || grid->locations[instance].Cell == SPATIAL_GRID_NONE)
+    {
+        return;
+    }
+
+    RemoveEntry(grid, grid->locations[instance]);
+    grid->locations[instance].Cell = SPATIAL_GRID_NONE;
+    grid->instanceCount--;
+}
+
+bool SpatialGrid_QueryFrustum(const SpatialGrid* const grid, const XMFLOAT4 planes[6], SpatialGridResults* const results)
+{
+    if (grid->cellCount == 0)
+    {
+        return true;
+    }
+
+    int32_t lo[3], hi[3];
+    const bool bounded = FrustumCellRange(grid, planes, lo, hi);
+    if (bounded && (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2]))
+    {
+        return true;
+    }
+
+    // Large frusta sweep the occupied cells instead of the cell range.
+    const double rangeCells = bounded ? ((double)hi[0] - lo[0] + 1) * ((double)hi[1] - lo[1] + 1) * ((double)hi[2] - lo[2] + 1) : DBL_MAX;
+    if (rangeCells > (double)grid->cellCount)
+    {
+        for (uint32_t c = 0; c < grid->cellCount; ++c)
+        {
+            const SpatialGridCell* cell = &grid->cells[c];
+            if (cell->count > 0 && !QueryFrustumCell(grid, cell, planes, results))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (int32_t z = lo[2]; z <= hi[2]; ++z)
+    {
+        for (int32_t y = lo[1]; y <= hi[1]; ++y)
+        {
+            for (int32_t x = lo[0]; x <= hi[0]; ++x)
+            {
+                const uint32_t c = FindCell(grid, x, y, z);
+                if (c != SPATIAL_GRID_NONE && grid->cells[c].count > 0 && !QueryFrustumCell(grid, &grid->cells[c], planes, results))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool SpatialGrid_QueryRadius(const SpatialGrid* const grid, XMFLOAT4 query, SpatialGridResults* const results)
+{
+    const float reach = query.w + grid->maxRadius;
+    const int32_t x0 = CellCoord(grid, query.x - reach), x1 = CellCoord(grid, query.x + reach);
+    const int32_t y0 = CellCoord(grid, query.y - reach), y1 = CellCoord(grid, query.y + reach);
+    const int32_t z0 = CellCoord(grid, query.z - reach), z1 = CellCoord(grid, query.z + reach);
+    const double rangeCells = ((double)x1 - x0 + 1) * ((double)y1 - y0 + 1) * ((double)z1 - z0 + 1);
+
+    // Large queries sweep the occupied cells instead of the cell range.
+    if (rangeCells > (double)grid->cellCount)
+    {
+        for (uint32_t c = 0; c < grid->cellCount; ++c)
+        {
+            const SpatialGridCell* cell = &grid->cells[c];
+            if (cell->X < x0 || cell->X > x1 || cell->Y < y0 || cell->Y > y1 || cell->Z < z0 || cell->Z > z1)
+            {
+                continue;
+            }
+            for (uint32_t i = 0; i < cell->count; ++i)
+            {
+                if (SpheresOverlap(cell->entries[i].Sphere, query) && !Append(results, cell->entries[i].Instance))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    for (int32_t z = z0; z <= z1; ++z)
+    {
+        for (int32_t y = y0; y <= y1; ++y)
+        {
+            for (int32_t x = x0; x <= x1; ++x)
+            {
+                const uint32_t c = FindCell(grid, x, y, z);
+                if (c == SPATIAL_GRID_NONE)
+                {
+                    continue;
+                }
+                const SpatialGridCell* cell = &grid->cells[c];
+                for (uint32_t i = 0; i < cell->count; ++i)
+                {
+                    if (SpheresOverlap(cell->entries[i].Sphere, query) && !Append(results, cell->entries[i].Instance))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool SpatialGrid_QueryFrusta(const SpatialGrid* const grid, const XMFLOAT4* const planes, uint32_t count,
+                             SpatialGridResults* const results, uint32_t* const offsets)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        offsets[i] = results->count;
+        if (!SpatialGrid_QueryFrustum(grid, planes + 6 * i, results))
+        {
+            return false;
+        }
+    }
+    offsets[count] = results->count;
+    return true;
+}
+
+bool SpatialGrid_QueryRadii(const SpatialGrid* const grid, const XMFLOAT4* const queries, uint32_t count,
+                            SpatialGridResults* const results, uint32_t* const offsets)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        offsets[i] = results->count;
+        if (!SpatialGrid_QueryRadius(grid, queries[i], results))
+        {
+            return false;
+        }
+    }
+    offsets[count] = results->count;
+    return true;
+}
+
+void SpatialGridResults_Release(SpatialGridResults* const results)
+{
+    free(results->indices);
+    *results = (SpatialGridResults){ 0 };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+typedef struct Instance Instance;
+
+#define SPATIAL_GRID_NONE 0xFFFFFFFFu
+
+// An instance stored in a cell, with a copy of its bounding sphere so queries never touch the instance array.
+typedef struct SpatialGridEntry
+{
+    XMFLOAT4 Sphere;    // xyz = center, w = radius
+    uint32_t Instance;
+} SpatialGridEntry;
+
+typedef struct SpatialGridCell
+{
+    int32_t           X, Y, Z;      // Cell coordinates
+    uint32_t          count;
+    uint32_t          capacity;
+    SpatialGridEntry* entries;      // Contiguous, unordered
+} SpatialGridCell;
+
+// Where an instance is stored: cells[Cell].entries[Slot].
+typedef struct SpatialGridLocation
+{
+    uint32_t Cell;
+    uint32_t Slot;
+} SpatialGridLocation;
+
+// Instance indices returned by the queries. Queries append to it.
+typedef struct SpatialGridResults
+{
+    uint32_t* indices;
+    uint32_t  count;
+    uint32_t  capacity;
+} SpatialGridResults;
+
+/****************************************************************************************************
+ * Uniform spatial hash grid over instance bounding spheres.                                        *
+ *                                                                                                  *
+ * Each instance lives in the cell holding its sphere center; queries widen their search by the    *
+ * largest radius inserted so far. Cells are found through an open-addressing hash table on their  *
+ * coordinates, so the grid is unbounded and only occupied cells use memory.                        *
+ *                                                                                                  *
+ * Insert, move and remove are O(1): an instance's location is looked up by index, and removal     *
+ * swaps the last entry of the cell into the hole. Cells left empty are kept for reuse until        *
+ * SpatialGrid_Clear.                                                                               *
+ *                                                                                                  *
+ * Queries cost the number of cells they visit plus the results: cells entirely inside a frustum   *
+ * are emitted without testing their entries. A query visits the cells of its bounding box, within *
+ * the bounds of the occupied cells, or sweeps the occupied cells when they are fewer.              *
+ ****************************************************************************************************/
+typedef struct SpatialGrid
+{
+    float                cellSize;
+    float                invCellSize;
+    float                maxRadius;         // Largest radius inserted since the last clear
+
+    SpatialGridCell*     cells;
+    uint32_t             cellCount;
+    uint32_t             cellCapacity;
+
+    int32_t              cellMin[3];        // Bounds of the cells added since the last clear, if any
+    int32_t              cellMax[3];
+
+    uint32_t*            table;             // Cell index per slot, SPATIAL_GRID_NONE if free
+    uint32_t             tableSize;         // Power of two, at least twice cellCount
+
+    SpatialGridLocation* locations;         // Per instance index, Cell = SPATIAL_GRID_NONE if absent
+    uint32_t             locationCapacity;
+    uint32_t             instanceCount;
+} SpatialGrid;
+
+// 'cellSize' should be a few times the typical instance radius.
+bool SpatialGrid_Init          (SpatialGrid* const grid, float cellSize);
+void SpatialGrid_Destroy       (SpatialGrid* const grid);
+void SpatialGrid_Clear         (SpatialGrid* const grid);
+
+// Inserts all 'count' instances, indexed from 0, after clearing the grid.
+bool SpatialGrid_Build         (SpatialGrid* const grid, const Instance* const instances, uint32_t count);
+
+// Insert (or move, if already present) returns false on allocation failure.
+bool SpatialGrid_Insert        (SpatialGrid* const grid, uint32_t instance, XMFLOAT4 sphere);
+bool SpatialGrid_Move          (SpatialGrid* const grid, uint32_t instance, XMFLOAT4 sphere);
+void SpatialGrid_Remove        (SpatialGrid* const grid, uint32_t instance);
+
+/****************************************************************************************************
+ * Appends the instances whose sphere intersects a frustum, given as 6 planes as in Constants.    *
+ * Same test as InstanceCull_IsVisible. The planes go in opposite pairs, (0, 1), (2, 3) and (4, 5), *
+ * as left/right, bottom/top and near/far do: the frustum's corners, and so its bounding box, are   *
+ * where one plane of each pair meet.                                                               *
+ ****************************************************************************************************/
+bool SpatialGrid_QueryFrustum  (const SpatialGrid* const grid, const XMFLOAT4 planes[6], SpatialGridResults* const results);
+
+// Appends the instances whose sphere intersects the query sphere (xyz = center, w = radius).
+bool SpatialGrid_QueryRadius   (const SpatialGrid* const grid, XMFLOAT4 query, SpatialGridResults* const results);
+
+/****************************************************************************************************
+ * Batch versions: query i appends results [offsets[i], offsets[i + 1]). 'offsets' holds count + 1 *
+ * entries. 'planes' holds 6 planes per frustum.                                                    *
+ ****************************************************************************************************/
+bool SpatialGrid_QueryFrusta   (const SpatialGrid* const grid, const XMFLOAT4* const planes, uint32_t count,
+                                SpatialGridResults* const results, uint32_t* const offsets);
+bool SpatialGrid_QueryRadii    (const SpatialGrid* const grid, const XMFLOAT4* const queries, uint32_t count,
+                                SpatialGridResults* const results, uint32_t* const offsets);
+
+void SpatialGridResults_Release(SpatialGridResults* const results);
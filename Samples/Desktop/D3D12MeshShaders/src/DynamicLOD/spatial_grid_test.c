@@ -0,0 +1,259 @@
+/*************************************************************************************
+ Spatial grid tests.
+
+ Fills a grid with random spheres, moves, reinserts and removes them at random, then
+ checks every frustum and radius query, single and batched, against a brute-force
+ pass over the live spheres: same instances, each once. Covers cells entirely inside
+ a frustum, frustum and radius queries probing the cell range and sweeping the
+ occupied cells, camera frusta reaching far past the scene, a frustum with parallel
+ planes, SpatialGrid_Build from packed instances and SpatialGrid_Clear.
+
+ Usage: SpatialGridTest
+**************************************************************************************/
+
+#include <string.h>
+#include "spatial_grid.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include "test_check.h"
+#include "test_view.h"
+
+#define SPHERE_COUNT 60000u
+#define EDIT_COUNT 30000u
+
+typedef struct Scene
+{
+    XMFLOAT4 spheres[SPHERE_COUNT];
+    bool     alive[SPHERE_COUNT];
+} Scene;
+
+static int CompareIndices(const void* a, const void* b)
+{
+    const uint32_t left = *(const uint32_t*)a;
+    const uint32_t right = *(const uint32_t*)b;
+    return (left > right) - (left < right);
+}
+
+static bool SpheresOverlap(XMFLOAT4 a, XMFLOAT4 b)
+{
+    const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    const float r = a.w + b.w;
+    return dx * dx + dy * dy + dz * dz <= r * r;
+}
+
+// Sorts the query's results and compares them with the live spheres passing 'test', in index order.
+static void CheckResults(const Scene* const scene, uint32_t* const results, uint32_t count,
+                         bool (*test)(const void* query, XMFLOAT4 sphere), const void* query)
+{
+    if (count > 1)
+    {
+        qsort(results, count, sizeof(uint32_t), CompareIndices);
+    }
+
+    uint32_t expected = 0;
+    bool same = true;
+    for (uint32_t i = 0; i < SPHERE_COUNT; ++i)
+    {
+        if (scene->alive[i] && test(query, scene->spheres[i]))
+        {
+            same = same && expected < count && results[expected] == i;
+            expected++;
+        }
+    }
+    CHECK(same);
+    CHECK(count == expected);
+}
+
+static bool InFrustum(const void* query, XMFLOAT4 sphere)
+{
+    Constants constants;
+    memcpy(constants.Planes, query, sizeof(constants.Planes));
+    return InstanceCull_IsVisible(&constants, sphere);
+}
+
+static bool InRadius(const void* query, XMFLOAT4 sphere)
+{
+    return SpheresOverlap(sphere, *(const XMFLOAT4*)query);
+}
+
+static XMFLOAT4 RandomSphere(void)
+{
+    // Mostly small spheres, a few large ones widening every query.
+    const float radius = TestRandom() % 500 == 0 ? TestRandomFloat(10.0f, 40.0f) : TestRandomFloat(0.5f, 3.5f);
+    return (XMFLOAT4){ TestRandomFloat(-1000.0f, 1000.0f), TestRandomFloat(-100.0f, 100.0f), TestRandomFloat(-1000.0f, 1000.0f), radius };
+}
+
+// Frusta, 6 planes each (inward normals, as in Constants): a box, a slanted slab, a thin slice, a box
+// containing the whole scene, one containing nothing, and a wedge whose near plane is parallel to its left one.
+// The first three and the fifth cover fewer cells than the scene occupies.
+static const XMFLOAT4 c_frusta[][6] = {
+    { { 1, 0, 0, 300 }, { -1, 0, 0, 100 }, { 0, 1, 0, 50 }, { 0, -1, 0, 50 }, { 0.6f, 0, 0.8f, 200 }, { -0.6f, 0, -0.8f, 500 } },
+    { { 0.8f, 0.6f, 0, 0 }, { -0.8f, -0.6f, 0, 400 }, { 0, 0, 1, 1000 }, { 0, 0, -1, 1000 }, { 0, 1, 0, 100 }, { 0, -1, 0, 100 } },
+    { { 1, 0, 0, -10 }, { -1, 0, 0, 12 }, { 0, 1, 0, 1000 }, { 0, -1, 0, 1000 }, { 0, 0, 1, 1000 }, { 0, 0, -1, 1000 } },
+    { { 1, 0, 0, 2000 }, { -1, 0, 0, 2000 }, { 0, 1, 0, 2000 }, { 0, -1, 0, 2000 }, { 0, 0, 1, 2000 }, { 0, 0, -1, 2000 } },
+    { { 1, 0, 0, -5000 }, { -1, 0, 0, 6000 }, { 0, 1, 0, 10 }, { 0, -1, 0, 10 }, { 0, 0, 1, 10 }, { 0, 0, -1, 10 } },
+    { { 0.8f, 0, 0.6f, 0 }, { -1, 0, 0, 50 }, { 0, 1, 0, 100 }, { 0, -1, 0, 100 }, { 0.8f, 0, 0.6f, 30 }, { 0, 0, -1, 80 } },
+};
+
+// Radius queries: small ones probing a few cells, large ones sweeping the occupied cells, a point, and an empty region.
+static const XMFLOAT4 c_radii[] = {
+    { 0, 0, 0, 30 }, { 500, 0, -200, 5 }, { -999, 99, 999, 12 }, { 0, 0, 0, 5000 }, { 100, 0, 100, 700 },
+    { 10, 0, 10, 0 }, { 5000, 5000, 5000, 10 },
+};
+
+static void CheckQueries(const SpatialGrid* const grid, const Scene* const scene)
+{
+    SpatialGridResults results = { 0 };
+    const uint32_t frustumCount = (uint32_t)_countof(c_frusta);
+    const uint32_t radiusCount = (uint32_t)_countof(c_radii);
+
+    for (uint32_t f = 0; f < frustumCount; ++f)
+    {
+        results.count = 0;
+        CHECK(SpatialGrid_QueryFrustum(grid, c_frusta[f], &results));
+        CheckResults(scene, results.indices, results.count, InFrustum, c_frusta[f]);
+    }
+    // Cameras inside the scene and outside it, whose far plane at 10000 lies well past the scene.
+    for (uint32_t v = 0; v < 6; ++v)
+    {
+        Constants constants;
+        const XMFLOAT3 eye = { TestRandomFloat(-1500.0f, 1500.0f), TestRandomFloat(-150.0f, 150.0f), TestRandomFloat(-1500.0f, 1500.0f) };
+        TestView_Build(&constants, eye, TestRandomFloat(0.0f, 6.2831853f), v % 2 ? 0.3f : 1.2f, 1.6f);
+        results.count = 0;
+        CHECK(SpatialGrid_QueryFrustum(grid, constants.Planes, &results));
+        CheckResults(scene, results.indices, results.count, InFrustum, constants.Planes);
+    }
+
+    for (uint32_t r = 0; r < radiusCount; ++r)
+    {
+        results.count = 0;
+        CHECK(SpatialGrid_QueryRadius(grid, c_radii[r], &results));
+        CheckResults(scene, results.indices, results.count, InRadius, &c_radii[r]);
+    }
+
+    // The batch versions give each query its own range, with the same results.
+    uint32_t offsets[_countof(c_radii) > _countof(c_frusta) ? _countof(c_radii) + 1 : _countof(c_frusta) + 1];
+    results.count = 0;
+    CHECK(SpatialGrid_QueryFrusta(grid, &c_frusta[0][0], frustumCount, &results, offsets));
+    CHECK(offsets[0] == 0 && offsets[frustumCount] == results.count);
+    for (uint32_t f = 0; f < frustumCount; ++f)
+    {
+        CheckResults(scene, results.indices + offsets[f], offsets[f + 1] - offsets[f], InFrustum, c_frusta[f]);
+    }
+    results.count = 0;
+    CHECK(SpatialGrid_QueryRadii(grid, c_radii, radiusCount, &results, offsets));
+    CHECK(offsets[0] == 0 && offsets[radiusCount] == results.count);
+    for (uint32_t r = 0; r < radiusCount; ++r)
+    {
+        CheckResults(scene, results.indices + offsets[r], offsets[r + 1] - offsets[r], InRadius, &c_radii[r]);
+    }
+
+    SpatialGridResults_Release(&results);
+}
+
+static uint32_t AliveCount(const Scene* const scene)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < SPHERE_COUNT; ++i)
+    {
+        count += scene->alive[i];
+    }
+    return count;
+}
+
+static void TestEdits(Scene* const scene)
+{
+    SpatialGrid grid;
+    CHECK(SpatialGrid_Init(&grid, 10.0f));
+
+    for (uint32_t i = 0; i < SPHERE_COUNT; ++i)
+    {
+        scene->spheres[i] = RandomSphere();
+        scene->alive[i] = true;
+        CHECK(SpatialGrid_Insert(&grid, i, scene->spheres[i]));
+    }
+    CHECK(grid.instanceCount == SPHERE_COUNT);
+    CheckQueries(&grid, scene);
+
+    // Removals, moves within and across cells, inserts of instances already present, and removals of absent ones.
+    for (uint32_t edit = 0; edit < EDIT_COUNT; ++edit)
+    {
+        const uint32_t i = TestRandom() % SPHERE_COUNT;
+        const uint32_t op = TestRandom() % 4;
+        if (op == 0)
+        {
+            SpatialGrid_Remove(&grid, i);
+            scene->alive[i] = false;
+            continue;
+        }
+        scene->spheres[i].x += TestRandomFloat(-20.0f, 20.0f);
+        scene->spheres[i].z += TestRandomFloat(-20.0f, 20.0f);
+        scene->spheres[i].w = op == 3 ? TestRandomFloat(0.5f, 3.5f) : scene->spheres[i].w;
+        CHECK(op == 1 ? SpatialGrid_Move(&grid, i, scene->spheres[i]) : SpatialGrid_Insert(&grid, i, scene->spheres[i]));
+        scene->alive[i] = true;
+    }
+    SpatialGrid_Remove(&grid, SPHERE_COUNT + 10);
+    CHECK(grid.instanceCount == AliveCount(scene));
+    CheckQueries(&grid, scene);
+
+    // A cleared grid is empty, and can be filled again.
+    SpatialGrid_Clear(&grid);
+    memset(scene->alive, 0, sizeof(scene->alive));
+    CHECK(grid.instanceCount == 0);
+    CheckQueries(&grid, scene);
+    for (uint32_t i = 0; i < SPHERE_COUNT; i += 3)
+    {
+        scene->alive[i] = true;
+        CHECK(SpatialGrid_Insert(&grid, i, scene->spheres[i]));
+    }
+    CheckQueries(&grid, scene);
+
+    SpatialGrid_Destroy(&grid);
+}
+
+static void TestBuild(Scene* const scene)
+{
+    Instance* const instances = malloc(sizeof(Instance) * SPHERE_COUNT);
+    CHECK(instances != NULL);
+    if (!instances)
+    {
+        return;
+    }
+
+    const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    XMFLOAT4X4 world;
+    memcpy(&world, identity, sizeof(world));
+    for (uint32_t i = 0; i < SPHERE_COUNT; ++i)
+    {
+        Instance_Pack(&instances[i], &world, RandomSphere());
+
+        // The grid indexes the packed sphere: its radius rounded up to a half.
+        scene->spheres[i] = Instance_UnpackBoundingSphere(&instances[i]);
+        scene->alive[i] = true;
+    }
+
+    SpatialGrid grid;
+    CHECK(SpatialGrid_Init(&grid, 25.0f));
+    CHECK(SpatialGrid_Build(&grid, instances, SPHERE_COUNT));
+    CHECK(grid.instanceCount == SPHERE_COUNT);
+    CheckQueries(&grid, scene);
+
+    SpatialGrid_Destroy(&grid);
+    free(instances);
+}
+
+int main(void)
+{
+    Scene* const scene = malloc(sizeof(Scene));
+    if (!scene)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    TestEdits(scene);
+    TestBuild(scene);
+
+    free(scene);
+    return TEST_RESULT();
+}
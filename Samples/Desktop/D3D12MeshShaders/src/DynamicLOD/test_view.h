@@ -0,0 +1,70 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include "shared.h"
+
+/*
+ * Same constants as ViewConstants_Build, for the headless tests: a camera at 'eye' turned by 'yaw'
+ * around the y axis (looking down +z at 0), with near and far planes at 1 and 10000. Fills the
+ * transposed view and view-projection matrices, the normalized frustum planes, the eye position
+ * and the LOD scale, without going through DirectXMath.
+ */
+static void TestView_Build(Constants* const constants, XMFLOAT3 eye, float yaw, float fovy, float aspectRatio)
+{
+    const float nearPlane = 1.0f, farPlane = 1e4f;
+    const float f = 1.0f / tanf(fovy * 0.5f);
+    const float axes[3][3] = { { cosf(yaw), 0, -sinf(yaw) }, { 0, 1, 0 }, { sinf(yaw), 0, cosf(yaw) } };   // Right, up, forward
+    const float projection[4][4] = {
+        { f / aspectRatio, 0, 0, 0 },
+        { 0, f, 0, 0 },
+        { 0, 0, farPlane / (farPlane - nearPlane), -nearPlane * farPlane / (farPlane - nearPlane) },
+        { 0, 0, 1, 0 },
+    };
+
+    float view[16] = { 0 };
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            view[4 * k + j] = axes[k][j];
+        }
+        view[4 * k + 3] = -(axes[k][0] * eye.x + axes[k][1] * eye.y + axes[k][2] * eye.z);
+    }
+    view[15] = 1.0f;
+
+    float viewProj[16];
+    for (int k = 0; k < 4; ++k)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            viewProj[4 * k + j] = 0.0f;
+            for (int m = 0; m < 4; ++m)
+            {
+                viewProj[4 * k + j] += projection[k][m] * view[4 * m + j];
+            }
+        }
+    }
+    memcpy(&constants->View, view, sizeof(view));
+    memcpy(&constants->ViewProj, viewProj, sizeof(viewProj));
+
+    // Left, right, bottom, top, near, far.
+    const float* const vp = viewProj;
+    for (int j = 0; j < 4; ++j)
+    {
+        const float planes[6] = { vp[12 + j] + vp[j], vp[12 + j] - vp[j], vp[12 + j] + vp[4 + j], vp[12 + j] - vp[4 + j], vp[8 + j], vp[12 + j] - vp[8 + j] };
+        for (int i = 0; i < 6; ++i)
+        {
+            ((float*)&constants->Planes[i])[j] = planes[i];
+        }
+    }
+    for (int i = 0; i < 6; ++i)
+    {
+        XMFLOAT4* const p = &constants->Planes[i];
+        const float length = sqrtf(p->x * p->x + p->y * p->y + p->z * p->z);
+        *p = (XMFLOAT4){ p->x / length, p->y / length, p->z / length, p->w / length };
+    }
+
+    constants->ViewPosition = eye;
+    constants->RecipTanHalfFovy = f;
+}
@@ -0,0 +1,161 @@
+#include "vertex_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+// FNV-1a over the vertex bytes.
+static uint32_t HashVertex(const uint8_t* const vertex, uint32_t stride)
+{
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < stride; ++i)
+    {
+        hash = (hash ^ vertex[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Slot holding an index of a vertex equal to 'vertex', or the empty slot where it would go.
+static uint32_t FindSlot(const VertexPool* const pool, const uint8_t* const vertex)
+{
+    const uint32_t mask = pool->slotCount - 1;
+    uint32_t slot = HashVertex(vertex, pool->stride) & mask;
+    while (pool->slots[slot] != VERTEX_POOL_INVALID &&
+           memcmp(pool->vertices + (size_t)pool->slots[slot] * pool->stride, vertex, pool->stride) != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Keeps the table at most half full. Earlier vertices are reinserted first, so that lookups still
+// find the first of several equal vertices.
+static bool ReserveSlots(VertexPool* const pool, uint32_t vertexCount)
+{
+    if ((uint64_t)vertexCount * 2 <= pool->slotCount)
+    {
+        return true;
+    }
+
+    uint32_t slotCount = pool->slotCount ? pool->slotCount : 64;
+    while ((uint64_t)slotCount < (uint64_t)vertexCount * 2)
+    {
+        slotCount *= 2;
+    }
+
+    uint32_t* slots = malloc((size_t)slotCount * sizeof(uint32_t));
+    if (!slots)
+    {
+        return false;
+    }
+    memset(slots, 0xFF, (size_t)slotCount * sizeof(uint32_t));
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slotCount = slotCount;
+    for (uint32_t i = 0; i < pool->vertexCount; ++i)
+    {
+        const uint32_t slot = FindSlot(pool, pool->vertices + (size_t)i * pool->stride);
+        if (pool->slots[slot] == VERTEX_POOL_INVALID)
+        {
+            pool->slots[slot] = i;
+        }
+    }
+    return true;
+}
+
+static bool ReserveVertices(VertexPool* const pool, uint32_t vertexCount)
+{
+    if (vertexCount <= pool->capacity)
+    {
+        return true;
+    }
+
+    const uint32_t capacity = vertexCount > pool->capacity * 2 ? vertexCount : pool->capacity * 2;
+    uint8_t* vertices = realloc(pool->vertices, (size_t)capacity * pool->stride);
+    if (!vertices)
+    {
+        return false;
+    }
+    pool->vertices = vertices;
+    pool->capacity = capacity;
+    return true;
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+bool VertexPool_Init(VertexPool* const pool, uint32_t stride, uint32_t capacity)
+{
+    *pool = (VertexPool){ .stride = stride };
+    return stride > 0 && ReserveVertices(pool, capacity) && ReserveSlots(pool, capacity);
+}
+
+void VertexPool_Destroy(VertexPool* const pool)
+{
+    for (uint32_t i = 0; i < pool->blockCount; ++i)
+    {
+        free(pool->blocks[i]);
+    }
+    free(pool->blocks);
+    free(pool->slots);
+    free(pool->vertices);
+    *pool = (VertexPool){0};
+}
+
+uint32_t VertexPool_Append(VertexPool* const pool, const uint8_t* const vertex)
+{
+    if (pool->vertexCount == VERTEX_POOL_INVALID ||
+        !ReserveVertices(pool, pool->vertexCount + 1) || !ReserveSlots(pool, pool->vertexCount + 1))
+    {
+        return VERTEX_POOL_INVALID;
+    }
+
+    const uint32_t index = pool->vertexCount++;
+    memcpy(pool->vertices + (size_t)index * pool->stride, vertex, pool->stride);
+
+    const uint32_t slot = FindSlot(pool, vertex);
+    if (pool->slots[slot] == VERTEX_POOL_INVALID)
+    {
+        pool->slots[slot] = index;
+    }
+    return index;
+}
+
+uint32_t VertexPool_Insert(VertexPool* const pool, const uint8_t* const vertex)
+{
+    if (pool->slotCount > 0)
+    {
+        const uint32_t slot = FindSlot(pool, vertex);
+        if (pool->slots[slot] != VERTEX_POOL_INVALID)
+        {
+            return pool->slots[slot];
+        }
+    }
+    return VertexPool_Append(pool, vertex);
+}
+
+void* VertexPool_Alloc(VertexPool* const pool, size_t size)
+{
+    if (pool->blockCount == pool->blockCapacity)
+    {
+        const uint32_t capacity = pool->blockCapacity ? pool->blockCapacity * 2 : 16;
+        void** blocks = realloc(pool->blocks, capacity * sizeof(void*));
+        if (!blocks)
+        {
+            return NULL;
+        }
+        pool->blocks = blocks;
+        pool->blockCapacity = capacity;
+    }
+
+    void* block = malloc(size ? size : 1);
+    if (block)
+    {
+        pool->blocks[pool->blockCount++] = block;
+    }
+    return block;
+}
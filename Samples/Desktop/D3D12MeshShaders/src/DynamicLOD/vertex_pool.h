@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define VERTEX_POOL_INVALID UINT32_MAX
+
+/****************************************************************************************************
+ * One deduplicated vertex buffer for all the LODs of a model (see Model_ShareVertices).            *
+ *                                                                                                  *
+ * Vertices are compared byte for byte: simplifiers that keep a subset of the original vertices     *
+ * copy them unchanged, so an exact match finds them. The pool also owns the index arrays           *
+ * rewritten to address it, which outlive the model files they replace.                             *
+ ****************************************************************************************************/
+typedef struct VertexPool
+{
+    uint8_t*  vertices;
+    uint32_t  vertexCount;
+    uint32_t  capacity;
+    uint32_t  stride;
+
+    uint32_t* slots;            // Open-addressing table of vertex indices, VERTEX_POOL_INVALID if empty
+    uint32_t  slotCount;        // Power of two
+
+    void**    blocks;           // Allocations made for the owner, freed with the pool
+    uint32_t  blockCount;
+    uint32_t  blockCapacity;
+} VertexPool;
+
+// Returns false on allocation failure. 'capacity' is a hint, in vertices.
+bool     VertexPool_Init    (VertexPool* const pool, uint32_t stride, uint32_t capacity);
+void     VertexPool_Destroy (VertexPool* const pool);
+
+// Adds the vertex without looking for an equal one, so that a first mesh keeps its own indices.
+// Returns its index, VERTEX_POOL_INVALID on allocation failure.
+uint32_t VertexPool_Append  (VertexPool* const pool, const uint8_t* const vertex);
+
+// Index of the first vertex equal to 'vertex', which is added if there is none.
+// Returns VERTEX_POOL_INVALID on allocation failure.
+uint32_t VertexPool_Insert  (VertexPool* const pool, const uint8_t* const vertex);
+
+// Memory that lives as long as the pool. NULL on allocation failure.
+void*    VertexPool_Alloc   (VertexPool* const pool, size_t size);
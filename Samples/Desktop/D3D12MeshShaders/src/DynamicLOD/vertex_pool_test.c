@@ -0,0 +1,127 @@
+/*************************************************************************************
+ Vertex pool tests.
+
+ Appends and inserts random vertices drawn from a small set, so that most repeat,
+ and checks every returned index against a linear search for the first equal
+ vertex: appended vertices always get a new index, inserted ones the first equal
+ vertex's, which the pool must still find after its tables grew from any
+ capacity hint. The stored vertices must match byte for byte. Covers strides that
+ are not a multiple of 4, vertices that differ in their last byte only, and the
+ allocations the pool owns.
+
+ Usage: VertexPoolTest
+**************************************************************************************/
+
+#include <string.h>
+#include "vertex_pool.h"
+#include "test_check.h"
+
+#define MAX_STRIDE   40
+#define VERTEX_COUNT 30000
+
+// Vertex 'id' of a stride: all the ids share the same leading bytes and differ in the last ones.
+static void MakeVertex(uint8_t* const vertex, uint32_t id, uint32_t stride)
+{
+    memset(vertex, 0x5A, stride);
+    for (uint32_t k = 0; k < 4 && k < stride; ++k)
+    {
+        vertex[stride - 1 - k] = (uint8_t)(id >> (8 * k));
+    }
+}
+
+static uint32_t s_ids[VERTEX_COUNT];
+
+static void TestDedup(uint32_t stride, uint32_t capacity, uint32_t distinct)
+{
+    VertexPool pool;
+    CHECK(VertexPool_Init(&pool, stride, capacity));
+
+    uint8_t vertex[MAX_STRIDE];
+    uint32_t count = 0, badIndices = 0;
+    for (uint32_t i = 0; i < VERTEX_COUNT; ++i)
+    {
+        const uint32_t id = TestRandom() % distinct;
+        MakeVertex(vertex, id, stride);
+
+        // The first few hundred vertices are appended, duplicates included, as LOD 0's are.
+        uint32_t expected = count;
+        if (i >= 500)
+        {
+            for (uint32_t j = 0; j < count; ++j)
+            {
+                if (s_ids[j] == id)
+                {
+                    expected = j;
+                    break;
+                }
+            }
+        }
+        const uint32_t index = i < 500 ? VertexPool_Append(&pool, vertex) : VertexPool_Insert(&pool, vertex);
+        badIndices += index != expected;
+        if (expected == count)
+        {
+            s_ids[count++] = id;
+        }
+    }
+    CHECK(badIndices == 0);
+    CHECK(pool.vertexCount == count && pool.capacity >= count);
+
+    uint32_t badVertices = 0;
+    for (uint32_t j = 0; j < count; ++j)
+    {
+        MakeVertex(vertex, s_ids[j], stride);
+        badVertices += memcmp(pool.vertices + (size_t)j * stride, vertex, stride) != 0;
+    }
+    CHECK(badVertices == 0);
+
+    VertexPool_Destroy(&pool);
+    CHECK(pool.vertices == NULL && pool.vertexCount == 0);
+}
+
+static void TestAlloc(void)
+{
+    VertexPool pool;
+    CHECK(!VertexPool_Init(&pool, 0, 16));
+    CHECK(VertexPool_Init(&pool, 4, 0));
+
+    // Every block stays valid until the pool goes; writing all of them catches a lost one under ASan.
+    uint8_t* blocks[100];
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        blocks[i] = VertexPool_Alloc(&pool, i * 3);
+        CHECK(blocks[i] != NULL);
+        memset(blocks[i], (int)i, i * 3);
+    }
+    uint32_t badBlocks = 0;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        for (uint32_t k = 0; k < i * 3; ++k)
+        {
+            badBlocks += blocks[i][k] != (uint8_t)i;
+        }
+    }
+    CHECK(badBlocks == 0);
+    CHECK(pool.blockCount == 100);
+
+    // An empty pool inserts, then finds, its first vertex.
+    const uint8_t vertex[4] = { 1, 2, 3, 4 };
+    CHECK(VertexPool_Insert(&pool, vertex) == 0);
+    CHECK(VertexPool_Insert(&pool, vertex) == 0);
+    CHECK(VertexPool_Append(&pool, vertex) == 1);
+    CHECK(VertexPool_Insert(&pool, vertex) == 0);
+    VertexPool_Destroy(&pool);
+}
+
+int main(void)
+{
+    const uint32_t strides[] = { 1, 3, 12, 24, 37, MAX_STRIDE };
+    for (uint32_t s = 0; s < (uint32_t)_countof(strides); ++s)
+    {
+        const uint32_t distinct = strides[s] == 1 ? 256 : 5000;
+        TestDedup(strides[s], 0, distinct);
+        TestDedup(strides[s], 100, distinct);
+        TestDedup(strides[s], VERTEX_COUNT, distinct);
+    }
+    TestAlloc();
+    return TEST_RESULT();
+}
@@ -0,0 +1,46 @@
+#include "view_constants.h"
+#include "simple_camera.h"
+#include <math.h>
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+void ViewConstants_Build(Constants* const constants, XMFLOAT3 position, XMFLOAT3 lookDirection, XMFLOAT3 upDirection,
+                         float fovy, float aspectRatio, float nearPlane, float farPlane)
+{
+    XMMATRIX viewMatrix = SimpleCamera_GetViewMatrix(position, lookDirection, upDirection);
+    XMMATRIX projMatrix = SimpleCamera_GetProjectionMatrix(fovy, aspectRatio, nearPlane, farPlane);
+    XMMATRIX viewProj = XM_MAT_MULT(viewMatrix, projMatrix);
+
+    XMMATRIX vp = XM_MAT_TRANSP(viewProj);
+    XMVECTOR leftPlane = XM_VEC_ADD(vp.r[3], vp.r[0]);
+    XMVECTOR rightPlane = XM_VEC_SUBTRACT(vp.r[3], vp.r[0]);
+    XMVECTOR bottonPlane = XM_VEC_ADD(vp.r[3], vp.r[1]);
+    XMVECTOR topPlane = XM_VEC_SUBTRACT(vp.r[3], vp.r[1]);
+    XMVECTOR farPlaneVec = XM_VEC_SUBTRACT(vp.r[3], vp.r[2]);
+    XMVECTOR planes[6] =
+    {
+        XM_PLANE_NORM(leftPlane),
+        XM_PLANE_NORM(rightPlane),
+        XM_PLANE_NORM(bottonPlane),
+        XM_PLANE_NORM(topPlane),
+        XM_PLANE_NORM(vp.r[2]),
+        XM_PLANE_NORM(farPlaneVec),
+    };
+
+    XMMATRIX transposedView = XM_MAT_TRANSP(viewMatrix);
+    XM_STORE_FLOAT4X4(&constants->View, transposedView);
+    viewProj = XM_MAT_TRANSP(viewProj);
+    XM_STORE_FLOAT4X4(&constants->ViewProj, viewProj);
+    XMMATRIX viewProjInv = XM_MAT_INV(NULL, viewMatrix);
+    XMVECTOR baseToView = XM_VEC3_TRANSFORM(g_XMZero.v, viewProjInv);
+    XM_STORE_FLOAT3(&constants->ViewPosition, baseToView);
+
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        XM_STORE_FLOAT4(&constants->Planes[i], planes[i]);
+    }
+
+    constants->RecipTanHalfFovy = 1.0f / tanf(fovy * 0.5f);
+}
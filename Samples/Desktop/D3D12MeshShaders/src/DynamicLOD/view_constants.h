@@ -0,0 +1,14 @@
+#pragma once
+
+#include "shared.h"
+#include "DirectXMathC.h"
+
+typedef struct Constants Constants;
+
+/*****************************************************************************************
+ * Fills the camera-dependent part of the per-frame constants: transposed view and       *
+ * view-projection matrices, normalized frustum planes, eye position and the LOD scale.  *
+ * RenderMode, LODCount, LODBias and MinScreenSize are left untouched.                   *
+ *****************************************************************************************/
+void ViewConstants_Build(Constants* const constants, XMFLOAT3 position, XMFLOAT3 lookDirection, XMFLOAT3 upDirection,
+                         float fovy, float aspectRatio, float nearPlane, float farPlane);
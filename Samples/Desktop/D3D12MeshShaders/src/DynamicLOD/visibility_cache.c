@@ -0,0 +1,528 @@
+#include "visibility_cache.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+    Constants
+******************************************************************/
+
+static const float c_marginEpsilon = 1e-5f;     // Relative to the distance, absorbs float rounding in the margins
+static const float c_planeEpsilon = 1e-3f;      // Plane drift still treated as the same projection
+static const double c_soonFrames = 8.0;         // Deadlines within that many frames of motion skip the heap
+static const uint32_t c_scaleSamples = 4096;    // Instances averaged for the motion scale
+static const uint32_t c_fullUpdateRatio = 32;   // Past 1 / ratio of the instances retested, a full update is cheaper
+
+/*****************************************************************
+    Private functions
+******************************************************************/
+
+static bool DeadlinesReserve(VisibilityDeadline** const entries, uint32_t* const capacity, uint32_t needed)
+{
+    if (needed <= *capacity)
+    {
+        return true;
+    }
+
+    uint32_t newCapacity = *capacity ? *capacity : 1024;
+    while (newCapacity < needed)
+    {
+        newCapacity *= 2;
+    }
+
+    VisibilityDeadline* newEntries = realloc(*entries, newCapacity * sizeof(VisibilityDeadline));
+    if (!newEntries)
+    {
+        return false;
+    }
+    *entries = newEntries;
+    *capacity = newCapacity;
+    return true;
+}
+
+static void SiftDown(VisibilityQueue* const queue, uint32_t i)
+{
+    VisibilityDeadline* e = queue->entries;
+    const VisibilityDeadline entry = e[i];
+    for (;;)
+    {
+        uint32_t child = 2 * i + 1;
+        if (child >= queue->count)
+        {
+            break;
+        }
+        if (child + 1 < queue->count && e[child + 1].Motion < e[child].Motion)
+        {
+            ++child;
+        }
+        if (!(e[child].Motion < entry.Motion))
+        {
+            break;
+        }
+        e[i] = e[child];
+        i = child;
+    }
+    e[i] = entry;
+}
+
+static void Heapify(VisibilityQueue* const queue)
+{
+    for (uint32_t i = queue->count / 2; i-- > 0;)
+    {
+        SiftDown(queue, i);
+    }
+}
+
+static VisibilityDeadline HeapPop(VisibilityQueue* const queue)
+{
+    const VisibilityDeadline top = queue->entries[0];
+    queue->entries[0] = queue->entries[--queue->count];
+    if (queue->count != 0)
+    {
+        SiftDown(queue, 0);
+    }
+    return top;
+}
+
+/*
+* Instances near a boundary get deadlines just above the current motion, which would sift up the
+* whole heap every frame. Those go to the unordered 'soon' list instead, scanned on every move.
+*/
+static bool Schedule(VisibilityQueue* const queue, VisibilityDeadline entry)
+{
+    if (entry.Motion < queue->horizon)
+    {
+        if (!DeadlinesReserve(&queue->soon, &queue->soonCapacity, queue->soonCount + 1))
+        {
+            return false;
+        }
+        queue->soon[queue->soonCount++] = entry;
+        return true;
+    }
+
+    if (!DeadlinesReserve(&queue->entries, &queue->capacity, queue->count + 1))
+    {
+        return false;
+    }
+    VisibilityDeadline* e = queue->entries;
+    uint32_t i = queue->count++;
+    while (i > 0 && entry.Motion < e[(i - 1) / 2].Motion)
+    {
+        e[i] = e[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    e[i] = entry;
+    return true;
+}
+
+// Eye distance at which a sphere of radius r has the given screen size.
+static float SizeDistance(const Constants* const constants, float size, float r)
+{
+    const float s = constants->RecipTanHalfFovy * r / size;
+    return sqrtf(s * s + r * r);
+}
+
+// Fractional LOD that ComputeLOD truncates, before clamping.
+static float LodValue(const Constants* const constants, float size)
+{
+    return (1.0f - size) * (float)(constants->LODCount - 1) + constants->LODBias;
+}
+
+// Distances between which the selection keeps returning 'lod', widened by the hysteresis, for a sphere of radius r.
+static void LodDistanceRange(const Constants* const constants, uint32_t lod, float hysteresis, float r,
+                             float* const nearest, float* const farthest)
+{
+    // ComputeLOD: lod = (1 - size) * (LODCount - 1) + LODBias, clamped to [0, LODCount - 1],
+    // with size = RecipTanHalfFovy * r / sqrt(d^2 - r^2).
+    const uint32_t last = constants->LODCount - 1;
+    const float steps = (float)last;
+    const float sizeMax = 1.0f - ((float)lod - hysteresis - constants->LODBias) / steps;       // Size at the switch to lod - 1
+    const float sizeMin = 1.0f - ((float)(lod + 1) + hysteresis - constants->LODBias) / steps; // Size at the switch to lod + 1
+
+    *nearest = 0.0f;
+    *farthest = INFINITY;
+    if (lod > 0 && sizeMax < 1.0f)
+    {
+        *nearest = SizeDistance(constants, sizeMax, r);
+    }
+    if (lod < last && sizeMin > 0.0f)
+    {
+        *farthest = SizeDistance(constants, sizeMin, r);
+    }
+}
+
+/*
+* Tests one instance and returns the motion at which it must be tested again.
+*
+* A plane distance moves by at most T + R * (D + T) <= M + M / S * (D + M) after a motion M, since
+* both T and R * S are at most M. The budget is the M where that reaches the margin.
+*/
+static double Retest(VisibilityCache* const cache, const Constants* const constants, const Instance* const instance, uint32_t index)
+{
+    const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(instance);
+    const float dx = sphere.x - constants->ViewPosition.x;
+    const float dy = sphere.y - constants->ViewPosition.y;
+    const float dz = sphere.z - constants->ViewPosition.z;
+    const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    // Visible: the smallest slack d + r over all planes. Culled: the largest overshoot of a plane it fails.
+    // Either way, minus the rounding drift SameProjection lets through.
+    const bool visible = InstanceCull_IsVisible(constants, sphere);
+    float planeMargin = visible ? INFINITY : 0.0f;
+    const float size = InstanceCull_ScreenSize(constants, sphere);
+    const float cullDistance = constants->MinScreenSize > 0.0f ? SizeDistance(constants, constants->MinScreenSize, sphere.w) : INFINITY;
+    for (int i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4 p = constants->Planes[i];
+        const float slack = p.x * sphere.x + p.y * sphere.y + p.z * sphere.z + p.w + sphere.w;
+        const float drift = 2.0f * c_planeEpsilon * (1.0f + fabsf(cache->viewPlanes[i].w) + distance);
+        planeMargin = visible ? fminf(planeMargin, slack - drift) : fmaxf(planeMargin, -slack - drift);
+    }
+    planeMargin = fmaxf(planeMargin, 0.0f);
+
+    // Positive root of M^2 / S + M * (1 + D / S) - margin, in its cancellation-free form.
+    const float b = 1.0f + distance / cache->motionScale;
+    float budget = 2.0f * planeMargin / (b + sqrtf(b * b + 4.0f * planeMargin / cache->motionScale));
+
+    uint8_t lod = VISIBILITY_CULLED;
+    if (visible && size < constants->MinScreenSize)
+    {
+        // Too small to contribute: only coming closer can change that. The eye distance changes by
+        // at most the translation.
+        budget = distance - cullDistance;
+    }
+    else if (visible)
+    {
+        lod = (uint8_t)InstanceCull_ComputeLOD(constants, sphere);
+
+        const uint8_t previous = cache->lods[index];
+        const float value = LodValue(constants, size);
+        if (previous != VISIBILITY_CULLED && previous != lod &&
+            value > (float)previous - cache->hysteresis && value < (float)(previous + 1) + cache->hysteresis)
+        {
+            lod = previous;
+        }
+
+        float nearest, farthest;
+        LodDistanceRange(constants, lod, cache->hysteresis, sphere.w, &nearest, &farthest);
+        budget = fminf(budget, fminf(distance - nearest, fminf(farthest, cullDistance) - distance));
+    }
+    budget = fmaxf(budget - c_marginEpsilon * (1.0f + distance), 0.0f);
+
+    cache->visibleCount += (lod != VISIBILITY_CULLED) - (cache->lods[index] != VISIBILITY_CULLED);
+    cache->lods[index] = lod;
+    return cache->motion + budget;
+}
+
+static bool RetestAndSchedule(VisibilityCache* const cache, const Constants* const constants, const Instance* const instances,
+                              uint32_t index, VisibilityCacheStats* const stats)
+{
+    const uint8_t before = cache->lods[index];
+    const double deadline = Retest(cache, constants, &instances[index], index);
+    stats->Retested++;
+    stats->Changed += before != cache->lods[index];
+    return Schedule(&cache->queue, (VisibilityDeadline){ deadline, index, ++cache->stamps[index] });
+}
+
+static void ExtractCamera(const Constants* const constants, float axes[9], XMFLOAT4 viewPlanes[6])
+{
+    // View is stored transposed: memory row k holds the world-space direction of view axis k.
+    const float* view = (const float*)&constants->View;
+    for (int k = 0; k < 3; ++k)
+    {
+        axes[3 * k + 0] = view[4 * k + 0];
+        axes[3 * k + 1] = view[4 * k + 1];
+        axes[3 * k + 2] = view[4 * k + 2];
+    }
+
+    const XMFLOAT3 eye = constants->ViewPosition;
+    for (int i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4 p = constants->Planes[i];
+        viewPlanes[i] = (XMFLOAT4){
+            axes[0] * p.x + axes[1] * p.y + axes[2] * p.z,
+            axes[3] * p.x + axes[4] * p.y + axes[5] * p.z,
+            axes[6] * p.x + axes[7] * p.y + axes[8] * p.z,
+            p.w + p.x * eye.x + p.y * eye.y + p.z * eye.z,
+        };
+    }
+}
+
+/*
+* Compares the view-space frustum with the one of the last full update. Float rounding moves the
+* planes a little even for a fixed projection (the far plane by ~1e-4 of its distance), so
+* planes within the epsilon count as unchanged and Retest keeps twice that slack off every margin.
+*/
+static bool SameProjection(const VisibilityCache* const cache, const Constants* const constants, const XMFLOAT4 viewPlanes[6])
+{
+    if (cache->recipTanHalfFovy != constants->RecipTanHalfFovy || cache->lodCount != constants->LODCount ||
+        cache->lodBias != constants->LODBias || cache->minScreenSize != constants->MinScreenSize)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4 a = cache->viewPlanes[i];
+        const XMFLOAT4 b = viewPlanes[i];
+        const float nx = a.x - b.x;
+        const float ny = a.y - b.y;
+        const float nz = a.z - b.z;
+        if (nx * nx + ny * ny + nz * nz > c_planeEpsilon * c_planeEpsilon ||
+            fabsf(a.w - b.w) > c_planeEpsilon * (1.0f + fabsf(a.w)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Mean distance to the eye over a sample of the instances.
+static float MotionScale(const Constants* const constants, const Instance* const instances, uint32_t instanceCount)
+{
+    const uint32_t stride = instanceCount > c_scaleSamples ? instanceCount / c_scaleSamples : 1;
+    double sum = 0.0;
+    uint32_t samples = 0;
+    for (uint32_t i = 0; i < instanceCount; i += stride, ++samples)
+    {
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&instances[i]);
+        const float dx = sphere.x - constants->ViewPosition.x;
+        const float dy = sphere.y - constants->ViewPosition.y;
+        const float dz = sphere.z - constants->ViewPosition.z;
+        sum += sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+    return samples != 0 ? fmaxf((float)(sum / samples), 1.0f) : 1.0f;
+}
+
+static bool FullUpdate(VisibilityCache* const cache, const Constants* const constants, const XMFLOAT4 viewPlanes[6],
+                       const Instance* const instances, uint32_t instanceCount, VisibilityCacheStats* const stats)
+{
+    if (instanceCount > cache->capacity)
+    {
+        uint8_t* lods = realloc(cache->lods, instanceCount * sizeof(uint8_t));
+        if (lods) cache->lods = lods;
+        uint32_t* stamps = realloc(cache->stamps, instanceCount * sizeof(uint32_t));
+        if (stamps) cache->stamps = stamps;
+        if (!lods || !stamps)
+        {
+            return false;
+        }
+        cache->capacity = instanceCount;
+    }
+
+    VisibilityQueue* queue = &cache->queue;
+    if (!DeadlinesReserve(&queue->entries, &queue->capacity, instanceCount))
+    {
+        return false;
+    }
+
+    // The hysteresis compares with the LODs of the last frame, when they belong to the same instances.
+    if (!cache->valid || cache->instanceCount != instanceCount)
+    {
+        cache->visibleCount = 0;
+        memset(cache->lods, VISIBILITY_CULLED, instanceCount * sizeof(uint8_t));
+    }
+
+    cache->instanceCount = instanceCount;
+    cache->motion = 0.0;
+    cache->motionScale = MotionScale(constants, instances, instanceCount);
+    cache->invalidCount = 0;
+    memcpy(cache->viewPlanes, viewPlanes, 6 * sizeof(XMFLOAT4));
+    memset(cache->stamps, 0, instanceCount * sizeof(uint32_t));
+
+    queue->count = instanceCount;
+    queue->soonCount = 0;
+    queue->horizon = 0.0;
+    for (uint32_t i = 0; i < instanceCount; ++i)
+    {
+        queue->entries[i] = (VisibilityDeadline){ Retest(cache, constants, &instances[i], i), i, 0 };
+    }
+    Heapify(queue);
+
+    stats->Retested = instanceCount;
+    stats->Changed = instanceCount;
+    stats->FullUpdate = true;
+    return true;
+}
+
+// Retests the instances whose budget ran out.
+static bool Expire(VisibilityCache* const cache, const Constants* const constants, const Instance* const instances,
+                   double step, VisibilityCacheStats* const stats)
+{
+    VisibilityQueue* queue = &cache->queue;
+    const double motion = cache->motion;
+    queue->horizon = motion + c_soonFrames * step;
+
+    // Retests append to the list: only scan what was there, and keep the unexpired entries.
+    const uint32_t scanned = queue->soonCount;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < scanned; ++i)
+    {
+        const VisibilityDeadline entry = queue->soon[i];
+        if (entry.Stamp != cache->stamps[entry.Instance])
+        {
+            continue;
+        }
+        if (entry.Motion >= motion)
+        {
+            queue->soon[kept++] = entry;
+        }
+        else if (!RetestAndSchedule(cache, constants, instances, entry.Instance, stats))
+        {
+            return false;
+        }
+    }
+    if (kept != scanned)
+    {
+        memmove(queue->soon + kept, queue->soon + scanned, (queue->soonCount - scanned) * sizeof(VisibilityDeadline));
+    }
+    queue->soonCount = kept + (queue->soonCount - scanned);
+
+    // Strictly below: retests schedule deadlines of at least 'motion', which wait for more.
+    while (queue->count != 0 && queue->entries[0].Motion < motion)
+    {
+        const VisibilityDeadline entry = HeapPop(queue);
+        if (entry.Stamp == cache->stamps[entry.Instance] &&
+            !RetestAndSchedule(cache, constants, instances, entry.Instance, stats))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Invalidated instances leave a stale entry behind. Drop them when they dominate.
+static void CompactQueue(VisibilityCache* const cache)
+{
+    VisibilityQueue* queue = &cache->queue;
+    if (queue->count <= 2 * cache->instanceCount + 1024)
+    {
+        return;
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < queue->count; ++i)
+    {
+        if (queue->entries[i].Stamp == cache->stamps[queue->entries[i].Instance])
+        {
+            queue->entries[kept++] = queue->entries[i];
+        }
+    }
+    queue->count = kept;
+    Heapify(queue);
+}
+
+/*****************************************************************
+    Public functions
+******************************************************************/
+
+void VisibilityCache_Destroy(VisibilityCache* const cache)
+{
+    free(cache->lods);
+    free(cache->stamps);
+    free(cache->invalid);
+    free(cache->queue.entries);
+    free(cache->queue.soon);
+    *cache = (VisibilityCache){ 0 };
+}
+
+bool VisibilityCache_Update(VisibilityCache* const cache, const Constants* const constants,
+                            const Instance* const instances, uint32_t instanceCount, VisibilityCacheStats* const stats)
+{
+    *stats = (VisibilityCacheStats){ 0 };
+
+    float axes[9];
+    XMFLOAT4 viewPlanes[6];
+    ExtractCamera(constants, axes, viewPlanes);
+
+    // Retests pop the heap in random order: under fast motion, rebuilding it all beats keeping up.
+    const bool full = !cache->valid || cache->instanceCount != instanceCount || !SameProjection(cache, constants, viewPlanes) ||
+                      cache->retested > instanceCount / c_fullUpdateRatio;
+    if (full)
+    {
+        cache->valid = FullUpdate(cache, constants, viewPlanes, instances, instanceCount, stats);
+    }
+    else
+    {
+        bool ok = true;
+        for (uint32_t i = 0; ok && i < cache->invalidCount; ++i)
+        {
+            ok = RetestAndSchedule(cache, constants, instances, cache->invalid[i], stats);
+        }
+        cache->invalidCount = 0;
+
+        const float tx = constants->ViewPosition.x - cache->eye.x;
+        const float ty = constants->ViewPosition.y - cache->eye.y;
+        const float tz = constants->ViewPosition.z - cache->eye.z;
+
+        // The chord swept by any unit vector is at most ||R1 - R0|| (Frobenius) / sqrt(2).
+        float chordSq = 0.0f;
+        for (int k = 0; k < 9; ++k)
+        {
+            chordSq += (axes[k] - cache->axes[k]) * (axes[k] - cache->axes[k]);
+        }
+
+        // A still camera changes nothing, even for instances sitting exactly on a boundary.
+        const double translation = sqrt((double)tx * tx + (double)ty * ty + (double)tz * tz);
+        const double rotation = sqrt(0.5 * (double)chordSq) * cache->motionScale;
+        const double step = fmax(translation, rotation);
+        if (ok && step > 0.0)
+        {
+            cache->motion += step;
+            ok = Expire(cache, constants, instances, step, stats);
+        }
+        CompactQueue(cache);
+        cache->valid = ok;
+    }
+    stats->Visible = cache->visibleCount;
+    cache->retested = stats->FullUpdate ? 0 : stats->Retested;
+
+    cache->eye = constants->ViewPosition;
+    memcpy(cache->axes, axes, sizeof(axes));
+    cache->recipTanHalfFovy = constants->RecipTanHalfFovy;
+    cache->lodCount = constants->LODCount;
+    cache->lodBias = constants->LODBias;
+    cache->minScreenSize = constants->MinScreenSize;
+    return cache->valid;
+}
+
+bool VisibilityCache_Invalidate(VisibilityCache* const cache, uint32_t first, uint32_t count)
+{
+    if (!cache->valid)
+    {
+        return true;
+    }
+
+    const uint32_t last = first + count < cache->instanceCount ? first + count : cache->instanceCount;
+    if (first >= last)
+    {
+        return true;
+    }
+
+    const uint32_t needed = cache->invalidCount + (last - first);
+    if (needed > cache->invalidCapacity)
+    {
+        uint32_t capacity = cache->invalidCapacity ? cache->invalidCapacity : 256;
+        while (capacity < needed)
+        {
+            capacity *= 2;
+        }
+        uint32_t* invalid = realloc(cache->invalid, capacity * sizeof(uint32_t));
+        if (!invalid)
+        {
+            cache->valid = false;
+            return false;
+        }
+        cache->invalid = invalid;
+        cache->invalidCapacity = capacity;
+    }
+
+    // Retested by the next update whatever the camera does.
+    for (uint32_t i = first; i < last; ++i)
+    {
+        cache->invalid[cache->invalidCount++] = i;
+    }
+    return true;
+}
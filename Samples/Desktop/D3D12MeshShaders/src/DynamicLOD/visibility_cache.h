@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shared.h"
+
+typedef struct Constants Constants;
+typedef struct Instance Instance;
+
+#define VISIBILITY_CULLED 0xFF // lods value of culled instances
+
+typedef struct VisibilityCacheStats
+{
+    uint32_t Retested;      // Instances culled and LOD-selected again this frame
+    uint32_t Changed;       // Instances whose visibility or LOD changed
+    uint32_t Visible;
+    bool     FullUpdate;    // Every instance was retested (first frame, new instances or projection change)
+} VisibilityCacheStats;
+
+// Retest deadline of an instance, in cumulative camera motion.
+typedef struct VisibilityDeadline
+{
+    double   Motion;
+    uint32_t Instance;
+    uint32_t Stamp;         // Entry is stale unless it matches stamps[Instance]
+} VisibilityDeadline;
+
+// Min-heap of deadlines, plus an unordered list of those due within a few frames.
+typedef struct VisibilityQueue
+{
+    VisibilityDeadline* entries;
+    uint32_t            count;
+    uint32_t            capacity;
+
+    VisibilityDeadline* soon;
+    uint32_t            soonCount;
+    uint32_t            soonCapacity;
+    double              horizon;        // Deadlines below go to 'soon'
+} VisibilityQueue;
+
+/****************************************************************************************************
+ * Frame-to-frame cache of InstanceCull_IsVisible and InstanceCull_ComputeLOD.                      *
+ *                                                                                                  *
+ * When an instance is tested, the cache also records how far the camera may move before the        *
+ * result can change: the distance of its sphere to the nearest frustum plane it could cross, and   *
+ * to the nearest LOD switch distance. Under rigid camera motion, a plane distance changes by at    *
+ * most T + R * (D + T), with T the eye translation, R the chord swept by the view axes and D the   *
+ * distance to the eye.                                                                             *
+ *                                                                                                  *
+ * Each frame adds max(T, R * S) to a single motion counter, S being the mean instance distance at  *
+ * the last full update, and each instance is queued at the counter value where its margin may run  *
+ * out. A frame only pops and retests the expired ones, so a slowly moving camera costs a small     *
+ * fraction of a full pass, and a still one costs nothing.                                          *
+ *                                                                                                  *
+ * A change of projection, LOD count, LOD bias, minimum screen size or instance count retests       *
+ * everything, and so does the frame after one that retested more than 1/32 of the instances, where *
+ * popping them is the slower path.                                                                 *
+ *                                                                                                  *
+ * With a hysteresis h, a retested instance keeps its LOD l while the fractional LOD ComputeLOD     *
+ * truncates stays within (l - h, l + 1 + h), so instances near a switch distance do not flip LOD   *
+ * every time the camera or the LOD bias wavers.                                                    *
+ ****************************************************************************************************/
+typedef struct VisibilityCache
+{
+    uint8_t*        lods;               // LOD per instance, VISIBILITY_CULLED if culled
+    uint32_t*       stamps;             // Incremented on every retest
+    uint32_t        instanceCount;
+    uint32_t        capacity;
+    uint32_t        visibleCount;
+
+    VisibilityQueue queue;
+    double          motion;             // Camera motion accumulated since the last full update
+    float           motionScale;        // S: the distance at which a rotation counts as much as a translation
+    uint32_t        retested;           // By the last incremental update
+
+    uint32_t*       invalid;            // Instances to retest on the next update
+    uint32_t        invalidCount;
+    uint32_t        invalidCapacity;
+
+    bool            valid;
+    XMFLOAT3        eye;
+    float           axes[9];            // Rotation part of the view matrix
+    XMFLOAT4        viewPlanes[6];      // View-space frustum of the last full update, to detect projection changes
+    float           recipTanHalfFovy;
+    uint32_t        lodCount;
+    float           lodBias;
+    float           minScreenSize;
+    float           hysteresis;         // In LODs, set by the owner. 0 selects exactly the LOD of ComputeLOD.
+} VisibilityCache;
+
+void VisibilityCache_Destroy    (VisibilityCache* const cache);
+
+// Brings cache->lods up to date for the frame's constants. Returns false on allocation failure.
+bool VisibilityCache_Update     (VisibilityCache* const cache, const Constants* const constants,
+                                 const Instance* const instances, uint32_t instanceCount, VisibilityCacheStats* const stats);
+
+// Forces a retest of instances that moved or changed, on the next update.
+bool VisibilityCache_Invalidate (VisibilityCache* const cache, uint32_t first, uint32_t count);
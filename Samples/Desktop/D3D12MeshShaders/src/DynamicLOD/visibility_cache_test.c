@@ -0,0 +1,203 @@
+/*************************************************************************************
+ Visibility cache tests.
+
+ Flies a camera through a random scene and compares the cache, every frame, with
+ InstanceCull_IsVisible, InstanceCull_IsContributing and InstanceCull_ComputeLOD run
+ on every instance: the same instances culled and the same LODs, through moved and
+ invalidated instances and changes of projection, LOD bias, minimum screen size and
+ instance count. A still camera must retest nothing, a slow one only a fraction of
+ the scene. With a hysteresis, culling must still match exactly, and every LOD stay
+ within the hysteresis of the fractional LOD.
+
+ Usage: VisibilityCacheTest
+**************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "visibility_cache.h"
+#include "instance_pack.h"
+#include "instance_cull.h"
+#include "scene_gen.h"
+#include "test_check.h"
+#include "test_view.h"
+
+#define SCENE_LEVEL 20
+#define FRAME_COUNT 160
+
+static const float c_fovy = 1.0472f;
+static const float c_aspectRatio = 16.0f / 9.0f;
+
+// Camera on frame 'frame' of the fly-through: a slow dolly toward the scene, looking down -z with a swaying yaw.
+static void FlyThrough(Constants* const constants, uint32_t frame, float fovy)
+{
+    const float t = (float)frame * 0.002f;
+    TestView_Build(constants, (XMFLOAT3){ 40.0f * t, 20.0f, 150.0f - 60.0f * t }, 3.14159265f + 0.3f * sinf(20.0f * t), fovy, c_aspectRatio);
+}
+
+// The fractional LOD InstanceCull_ComputeLOD truncates, before clamping.
+static float FractionalLod(const Constants* const constants, XMFLOAT4 sphere)
+{
+    return (1.0f - InstanceCull_ScreenSize(constants, sphere)) * (float)(constants->LODCount - 1) + constants->LODBias;
+}
+
+// Compares the cache with culling and LOD selection of every instance. Without hysteresis the LODs must match exactly.
+static void CheckCache(const VisibilityCache* const cache, const VisibilityCacheStats* const stats, const Constants* const constants,
+                       const Instance* const instances, uint32_t instanceCount)
+{
+    uint32_t visible = 0;
+    uint32_t culledMismatches = 0;
+    uint32_t lodMismatches = 0;
+    for (uint32_t i = 0; i < instanceCount; ++i)
+    {
+        const XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&instances[i]);
+        const bool shown = InstanceCull_IsVisible(constants, sphere) && InstanceCull_IsContributing(constants, sphere);
+        const uint8_t cached = cache->lods[i];
+        visible += shown;
+        culledMismatches += shown != (cached != VISIBILITY_CULLED);
+        if (!shown || cached == VISIBILITY_CULLED)
+        {
+            continue;
+        }
+
+        const uint32_t lod = InstanceCull_ComputeLOD(constants, sphere);
+        if (cache->hysteresis == 0.0f)
+        {
+            lodMismatches += cached != lod;
+        }
+        else if (cached != lod)
+        {
+            // Kept from before: the fractional LOD is still within the hysteresis of it, and the LOD within range.
+            const float fractional = FractionalLod(constants, sphere);
+            const float slack = 1e-4f;
+            lodMismatches += cached >= constants->LODCount ||
+                             fractional <= (float)cached - cache->hysteresis - slack ||
+                             fractional >= (float)(cached + 1) + cache->hysteresis + slack;
+        }
+    }
+    CHECK(culledMismatches == 0);
+    CHECK(lodMismatches == 0);
+    CHECK(stats->Visible == visible);
+    CHECK(cache->visibleCount == visible);
+}
+
+static Instance* MakeScene(uint32_t* const instanceCount)
+{
+    *instanceCount = SceneGen_CubeCount(SCENE_LEVEL);
+    Instance* const instances = malloc(sizeof(Instance) * *instanceCount);
+    if (instances)
+    {
+        SceneGen_Generate(instances, SceneLayoutRandom, SCENE_LEVEL, 3.0f, 1);
+    }
+    return instances;
+}
+
+// Moves every 'stride'-th instance by 'offset' and invalidates it in the cache.
+static void MoveInstances(VisibilityCache* const cache, Instance* const instances, uint32_t instanceCount, uint32_t stride, XMFLOAT3 offset)
+{
+    for (uint32_t i = 0; i < instanceCount; i += stride)
+    {
+        XMFLOAT4X4 world;
+        Instance_UnpackWorld(&instances[i], &world);
+        float* const translation = (float*)&world + 12;
+        translation[0] += offset.x;
+        translation[1] += offset.y;
+        translation[2] += offset.z;
+
+        XMFLOAT4 sphere = Instance_UnpackBoundingSphere(&instances[i]);
+        sphere.x += offset.x;
+        sphere.y += offset.y;
+        sphere.z += offset.z;
+        Instance_Pack(&instances[i], &world, sphere);
+        CHECK(VisibilityCache_Invalidate(cache, i, 1));
+    }
+}
+
+static void TestFlyThrough(float hysteresis)
+{
+    uint32_t instanceCount;
+    Instance* const instances = MakeScene(&instanceCount);
+    CHECK(instances != NULL);
+    if (!instances)
+    {
+        return;
+    }
+
+    VisibilityCache cache = { 0 };
+    cache.hysteresis = hysteresis;
+    VisibilityCacheStats stats;
+    Constants constants = { 0 };
+    constants.LODCount = MAX_LOD_LEVELS;
+    constants.LODBias = 0.75f;
+    constants.MinScreenSize = 0.02f;
+
+    uint64_t incrementalRetests = 0;
+    uint32_t incrementalFrames = 0;
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        float fovy = c_fovy;
+        bool expectFull = frame == 0;
+        if (frame == 40)
+        {
+            // A change of LOD settings retests everything.
+            constants.LODBias = 1.0f;
+            constants.MinScreenSize = 0.03f;
+            expectFull = true;
+        }
+        if (frame >= 100 && frame < 110)
+        {
+            // So does a change of projection, and only the frame it happens on.
+            fovy = 1.2f;
+            expectFull = frame == 100;
+        }
+        expectFull = expectFull || frame == 110;
+        if (frame == 70)
+        {
+            MoveInstances(&cache, instances, instanceCount, 7, (XMFLOAT3){ 50.0f, 0.0f, -20.0f });
+        }
+        FlyThrough(&constants, frame, fovy);
+
+        CHECK(VisibilityCache_Update(&cache, &constants, instances, instanceCount, &stats));
+        CheckCache(&cache, &stats, &constants, instances, instanceCount);
+        if (expectFull)
+        {
+            CHECK(stats.FullUpdate);
+            CHECK(stats.Retested == instanceCount);
+        }
+        else if (!stats.FullUpdate)
+        {
+            incrementalRetests += stats.Retested;
+            incrementalFrames++;
+        }
+    }
+
+    // The slow camera retests a fraction of the scene on most frames.
+    CHECK(incrementalFrames > FRAME_COUNT / 2);
+    CHECK(incrementalRetests < (uint64_t)incrementalFrames * instanceCount / 16);
+
+    // Once the last motion is caught up with, a still camera retests nothing, and changes nothing.
+    CHECK(VisibilityCache_Update(&cache, &constants, instances, instanceCount, &stats));
+    CheckCache(&cache, &stats, &constants, instances, instanceCount);
+    CHECK(VisibilityCache_Update(&cache, &constants, instances, instanceCount, &stats));
+    CHECK(!stats.FullUpdate && stats.Retested == 0 && stats.Changed == 0);
+    CheckCache(&cache, &stats, &constants, instances, instanceCount);
+
+    // Neither do invalidations out of range.
+    CHECK(VisibilityCache_Invalidate(&cache, instanceCount, 10));
+    CHECK(VisibilityCache_Update(&cache, &constants, instances, instanceCount, &stats));
+    CHECK(stats.Retested == 0);
+
+    // Fewer instances retest everything.
+    CHECK(VisibilityCache_Update(&cache, &constants, instances, instanceCount / 2, &stats));
+    CHECK(stats.FullUpdate && stats.Retested == instanceCount / 2);
+    CheckCache(&cache, &stats, &constants, instances, instanceCount / 2);
+
+    VisibilityCache_Destroy(&cache);
+    free(instances);
+}
+
+int main(void)
+{
+    TestFlyThrough(0.0f);
+    TestFlyThrough(0.25f);
+    return TEST_RESULT();
+}